@@ -0,0 +1,547 @@
+#include "core/Key.h"
+#include "core/KeyRotator.h"
+#include "core/VaultManager.h"
+#include "core/VaultScrubber.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QThread>
+
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using dynamicencrypt::core::CryptoDriver;
+using dynamicencrypt::core::DriverMetrics;
+using dynamicencrypt::core::importSymmetricKey;
+using dynamicencrypt::core::Key;
+using dynamicencrypt::core::KeyRotationResult;
+using dynamicencrypt::core::KeyRotator;
+using dynamicencrypt::core::MetricsSnapshot;
+using dynamicencrypt::core::OperationMetrics;
+using dynamicencrypt::core::ScrubOptions;
+using dynamicencrypt::core::ScrubResult;
+using dynamicencrypt::core::SymmetricKeyTag;
+using dynamicencrypt::core::VaultEntry;
+using dynamicencrypt::core::VaultManager;
+using dynamicencrypt::core::VaultScrubber;
+
+namespace
+{
+    enum ExitCode
+    {
+        ExitOk = 0,
+        ExitFailures = 1,
+        ExitUsage = 2,
+    };
+
+    const QString kVaultSuffix = QStringLiteral(".vault");
+
+    struct Task
+    {
+        QString input;
+        QString output;
+    };
+
+    // Vault entries are keyed by absolute, clean paths, as the GUI and DirectoryEncryptor record them.
+    QString absolutePath(const QString &path)
+    {
+        return QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+    }
+
+    QTextStream &out()
+    {
+        static QTextStream stream(stdout);
+        return stream;
+    }
+
+    QTextStream &err()
+    {
+        static QTextStream stream(stderr);
+        return stream;
+    }
+
+    bool isGlob(const QString &argument)
+    {
+        return argument.contains(QLatin1Char('*')) || argument.contains(QLatin1Char('?')) ||
+               argument.contains(QLatin1Char('['));
+    }
+
+    QString outputPathFor(const QString &input, const QString &relative, const QString &outputDir, bool encrypt)
+    {
+        QString name = relative;
+        if (encrypt)
+        {
+            name += kVaultSuffix;
+        }
+        else if (name.endsWith(kVaultSuffix))
+        {
+            name.chop(kVaultSuffix.size());
+        }
+        else
+        {
+            name += QStringLiteral(".decrypted");
+        }
+        const QDir base(outputDir.isEmpty() ? QFileInfo(input).absolutePath() : outputDir);
+        return base.filePath(outputDir.isEmpty() ? QFileInfo(name).fileName() : name);
+    }
+
+    // Expands files, globs (the wildcard applies to the last path component) and directories into
+    // tasks. Directory trees keep their layout under outputDir; when encrypting, expanded .vault files
+    // are taken to be earlier outputs and left alone.
+    std::vector<Task> planTasks(const QStringList &arguments, const QString &outputDir, bool recursive, bool encrypt)
+    {
+        std::vector<Task> tasks;
+        auto add = [&](const QFileInfo &file, const QString &relative, bool expanded)
+        {
+            if (!expanded || !encrypt || !file.fileName().endsWith(kVaultSuffix))
+            {
+                tasks.push_back({file.absoluteFilePath(), outputPathFor(file.absoluteFilePath(), relative, outputDir, encrypt)});
+            }
+        };
+        for (const QString &argument : arguments)
+        {
+            const QFileInfo info(argument);
+            if (isGlob(argument))
+            {
+                const QDir dir(info.path());
+                for (const QFileInfo &match : dir.entryInfoList({info.fileName()}, QDir::Files, QDir::Name))
+                {
+                    add(match, match.fileName(), true);
+                }
+            }
+            else if (info.isDir())
+            {
+                const QDir root(info.absoluteFilePath());
+                QDirIterator it(root.absolutePath(), QDir::Files,
+                                recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+                while (it.hasNext())
+                {
+                    const QFileInfo file(it.next());
+                    add(file, root.relativeFilePath(file.absoluteFilePath()), true);
+                }
+            }
+            else if (info.isFile())
+            {
+                add(info, info.fileName(), false);
+            }
+            else
+            {
+                throw std::invalid_argument(QStringLiteral("No such file or directory: %1").arg(argument).toStdString());
+            }
+        }
+        return tasks;
+    }
+
+    Key<SymmetricKeyTag> loadKey(const QCommandLineParser &parser)
+    {
+        if (parser.isSet(QStringLiteral("key-file")))
+        {
+            return importSymmetricKey(parser.value(QStringLiteral("key-file")));
+        }
+        if (parser.isSet(QStringLiteral("key-json")))
+        {
+            const QString path = parser.value(QStringLiteral("key-json"));
+            QFile file(path);
+            if (!file.open(QIODevice::ReadOnly))
+            {
+                throw std::runtime_error(QStringLiteral("Failed to open key metadata: %1").arg(path).toStdString());
+            }
+            return importSymmetricKey(QJsonDocument::fromJson(file.readAll()).object());
+        }
+        if (parser.isSet(QStringLiteral("passphrase-env")))
+        {
+            // Read from the environment so the passphrase never appears in the process list.
+            const QString variable = parser.value(QStringLiteral("passphrase-env"));
+            bool ok = false;
+            const int bits = parser.value(QStringLiteral("key-bits")).toInt(&ok);
+            if (!ok)
+            {
+                throw std::invalid_argument("--key-bits must be a number");
+            }
+            return importSymmetricKey(qgetenv(variable.toLocal8Bit().constData()), bits);
+        }
+        throw std::invalid_argument("one of --key-file, --key-json or --passphrase-env is required");
+    }
+
+    CryptoDriver *selectDriver(const VaultManager &manager, const QString &name)
+    {
+        if (name.isEmpty())
+        {
+            if (CryptoDriver *preferred = manager.preferredDriver({{QStringLiteral("aead")}, true}))
+            {
+                return preferred;
+            }
+            const auto drivers = manager.drivers();
+            if (drivers.empty())
+            {
+                throw std::runtime_error("no crypto plugins found");
+            }
+            return drivers.front();
+        }
+        for (CryptoDriver *driver : manager.drivers())
+        {
+            if (driver->name().compare(name, Qt::CaseInsensitive) == 0)
+            {
+                return driver;
+            }
+        }
+        throw std::invalid_argument(QStringLiteral("unknown driver: %1").arg(name).toStdString());
+    }
+
+    // Rewraps every data key in the vault from the --key-* key to --new-key-file; payloads are not touched.
+    int rotateKeys(VaultManager &manager, const QCommandLineParser &parser)
+    {
+        if (!parser.isSet(QStringLiteral("vault")) || !parser.isSet(QStringLiteral("new-key-file")))
+        {
+            throw std::invalid_argument("rotate needs --vault and --new-key-file");
+        }
+        const Key<SymmetricKeyTag> oldKey = loadKey(parser);
+        const Key<SymmetricKeyTag> newKey = importSymmetricKey(parser.value(QStringLiteral("new-key-file")));
+        manager.setStorageDirectory(parser.value(QStringLiteral("vault")));
+        // Fails while another process, such as the GUI, has the vault open.
+        manager.requireWritableIndex();
+        const auto started = dynamicencrypt::core::MetricsClock::now();
+        const KeyRotationResult result = KeyRotator(manager).rotate(oldKey, newKey);
+        for (const KeyRotationResult::Failure &failure : result.failures)
+        {
+            err() << QStringLiteral("failed %1: %2").arg(failure.storedPath, failure.error) << Qt::endl;
+        }
+        out() << QStringLiteral("rotate %1 entries (%2 already current, %3 without a data key, %4 failed) in %5 s")
+                     .arg(result.rewrapped)
+                     .arg(result.current)
+                     .arg(result.direct)
+                     .arg(static_cast<qint64>(result.failures.size()))
+                     .arg(dynamicencrypt::core::nanosSince(started) / 1e9, 0, 'f', 2)
+              << Qt::endl;
+        return result.failures.empty() ? ExitOk : ExitFailures;
+    }
+
+    QString formatRate(double bytesPerSecond)
+    {
+        return QStringLiteral("%1 MB/s").arg(bytesPerSecond / 1e6, 0, 'f', 1);
+    }
+
+    int positiveOption(const QCommandLineParser &parser, const QString &name, int fallback)
+    {
+        if (!parser.isSet(name))
+        {
+            return fallback;
+        }
+        bool ok = false;
+        const int value = parser.value(name).toInt(&ok);
+        if (!ok || value < 1)
+        {
+            throw std::invalid_argument(QStringLiteral("--%1 must be a positive number").arg(name).toStdString());
+        }
+        return value;
+    }
+
+    const char *problemName(ScrubResult::Problem problem)
+    {
+        switch (problem)
+        {
+        case ScrubResult::Problem::Missing:
+            return "missing";
+        case ScrubResult::Problem::Unreadable:
+            return "unreadable";
+        case ScrubResult::Problem::Corrupt:
+            return "corrupt";
+        case ScrubResult::Problem::Untracked:
+            return "untracked";
+        }
+        return "unknown";
+    }
+
+    // Checks every stored file in the vault against its recorded digest; no key is needed.
+    int scrubVault(VaultManager &manager, const QCommandLineParser &parser)
+    {
+        if (!parser.isSet(QStringLiteral("vault")))
+        {
+            throw std::invalid_argument("scrub needs --vault");
+        }
+        manager.setStorageDirectory(parser.value(QStringLiteral("vault")));
+        ScrubOptions options;
+        options.threadCount = positiveOption(parser, QStringLiteral("jobs"), 0);
+        options.maxConcurrentReads = positiveOption(parser, QStringLiteral("max-reads"), options.maxConcurrentReads);
+        options.recordMissingDigests = parser.isSet(QStringLiteral("record-digests"));
+        const ScrubResult result = VaultScrubber(manager, options).scrub();
+        for (const ScrubResult::Issue &issue : result.issues)
+        {
+            if (issue.problem != ScrubResult::Problem::Untracked || !parser.isSet(QStringLiteral("quiet")))
+            {
+                err() << QStringLiteral("%1 %2: %3").arg(QLatin1String(problemName(issue.problem)), issue.path, issue.detail)
+                      << Qt::endl;
+            }
+        }
+        out() << QStringLiteral("scrub %1 entries (%2 verified, %3 without a digest, %4 issues) in %5 s, %6")
+                     .arg(result.files)
+                     .arg(result.verified)
+                     .arg(result.unverified)
+                     .arg(static_cast<qint64>(result.issues.size()))
+                     .arg(result.elapsedNanos / 1e9, 0, 'f', 2)
+                     .arg(formatRate(result.bytesPerSecond()))
+              << Qt::endl;
+        if (parser.isSet(QStringLiteral("metrics-json")))
+        {
+            manager.storage().store(parser.value(QStringLiteral("metrics-json")),
+                                    QJsonDocument(manager.metrics().toJson()).toJson(QJsonDocument::Indented));
+        }
+        return result.clean() ? ExitOk : ExitFailures;
+    }
+
+    void printOperation(const QString &driver, const char *label, const OperationMetrics &operation, qint64 elapsedNanos)
+    {
+        if (operation.operations == 0)
+        {
+            return;
+        }
+        const qint64 busy = operation.cipherNanos + operation.ioNanos;
+        out() << QStringLiteral("  %1 %2: %3 ops, %4 op/s, %5, cipher %6, p50 %7 ms, p99 %8 ms, io %9%")
+                     .arg(driver, QLatin1String(label))
+                     .arg(operation.operations)
+                     .arg(MetricsSnapshot::perSecond(operation.operations, elapsedNanos), 0, 'f', 1)
+                     .arg(formatRate(MetricsSnapshot::perSecond(operation.bytesIn, elapsedNanos)),
+                          formatRate(operation.cipherBytesPerSecond()))
+                     .arg(operation.p50Nanos() / 1e6, 0, 'f', 2)
+                     .arg(operation.p99Nanos() / 1e6, 0, 'f', 2)
+                     .arg(busy > 0 ? operation.ioNanos * 100 / busy : 0)
+              << Qt::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("dynamicencrypt-cli"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Encrypts or decrypts files, globs and directory trees in parallel."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("command"), QStringLiteral("encrypt, decrypt, rotate or scrub"));
+    parser.addPositionalArgument(QStringLiteral("inputs"), QStringLiteral("Files, globs or directories."), QStringLiteral("inputs..."));
+    parser.addOptions({
+        {{QStringLiteral("k"), QStringLiteral("key-file")}, QStringLiteral("Raw key file."), QStringLiteral("path")},
+        {QStringLiteral("key-json"), QStringLiteral("JSON key metadata with a base64 \"key\" field."), QStringLiteral("path")},
+        {QStringLiteral("passphrase-env"), QStringLiteral("Derive the key from the passphrase in this environment variable."),
+         QStringLiteral("variable")},
+        {QStringLiteral("key-bits"), QStringLiteral("Key size for --passphrase-env (default 256)."), QStringLiteral("bits"),
+         QStringLiteral("256")},
+        {{QStringLiteral("d"), QStringLiteral("driver")}, QStringLiteral("Driver name (default: fastest AEAD driver)."),
+         QStringLiteral("name")},
+        {{QStringLiteral("j"), QStringLiteral("jobs")}, QStringLiteral("Worker count (default: one per core)."), QStringLiteral("n")},
+        {{QStringLiteral("o"), QStringLiteral("output-dir")}, QStringLiteral("Write outputs here instead of next to the inputs."),
+         QStringLiteral("dir")},
+        {{QStringLiteral("r"), QStringLiteral("recursive")}, QStringLiteral("Descend into subdirectories.")},
+        {{QStringLiteral("f"), QStringLiteral("force")}, QStringLiteral("Overwrite existing outputs instead of skipping them.")},
+        {QStringLiteral("plugins"), QStringLiteral("Plugin directory (default: plugins/ next to the executable)."), QStringLiteral("dir")},
+        {QStringLiteral("vault"),
+         QStringLiteral("Record encrypted files in this vault, with per-file data keys; decrypt looks files up in it."),
+         QStringLiteral("dir")},
+        {QStringLiteral("new-key-file"), QStringLiteral("rotate: raw file of the new master key."), QStringLiteral("path")},
+        {QStringLiteral("max-reads"), QStringLiteral("scrub: reads in flight at once (default 4)."), QStringLiteral("n")},
+        {QStringLiteral("record-digests"), QStringLiteral("scrub: record digests for entries that have none.")},
+        {QStringLiteral("metrics-json"), QStringLiteral("Write the metrics snapshot to this file."), QStringLiteral("path")},
+        {{QStringLiteral("q"), QStringLiteral("quiet")}, QStringLiteral("Only print failures and the summary.")},
+        {QStringLiteral("list-drivers"), QStringLiteral("List the available drivers and exit.")},
+    });
+    parser.process(app);
+
+    try
+    {
+        // Only --vault is ever opened; commands without it leave no trace in the default vault.
+        VaultManager manager(VaultManager::InitialVault::None);
+        if (parser.isSet(QStringLiteral("plugins")))
+        {
+            manager.discoverPlugins({parser.value(QStringLiteral("plugins"))});
+        }
+        if (parser.isSet(QStringLiteral("list-drivers")))
+        {
+            for (const auto &descriptor : manager.pluginDescriptors())
+            {
+                out() << QStringLiteral("%1 %2 [%3]").arg(descriptor.name, descriptor.version,
+                                                          descriptor.capabilities.tags.join(QStringLiteral(", ")))
+                      << Qt::endl;
+            }
+            return ExitOk;
+        }
+
+        const QStringList positional = parser.positionalArguments();
+        const QString command = positional.value(0);
+        if (command == QStringLiteral("rotate"))
+        {
+            return rotateKeys(manager, parser);
+        }
+        if (command == QStringLiteral("scrub"))
+        {
+            return scrubVault(manager, parser);
+        }
+        if ((command != QStringLiteral("encrypt") && command != QStringLiteral("decrypt")) || positional.size() < 2)
+        {
+            err() << parser.helpText();
+            return ExitUsage;
+        }
+        const bool encrypt = command == QStringLiteral("encrypt");
+
+        const Key<SymmetricKeyTag> key = loadKey(parser);
+        CryptoDriver *driver = selectDriver(manager, parser.value(QStringLiteral("driver")));
+        const QString outputDir = parser.value(QStringLiteral("output-dir"));
+        const std::vector<Task> tasks = planTasks(positional.mid(1), outputDir, parser.isSet(QStringLiteral("recursive")), encrypt);
+        if (parser.isSet(QStringLiteral("vault")))
+        {
+            manager.setStorageDirectory(parser.value(QStringLiteral("vault")));
+            if (encrypt)
+            {
+                // Each file's data key exists only in its entry, so refuse before writing any output.
+                manager.requireWritableIndex();
+            }
+        }
+
+        int jobs = QThread::idealThreadCount();
+        if (parser.isSet(QStringLiteral("jobs")))
+        {
+            bool ok = false;
+            jobs = parser.value(QStringLiteral("jobs")).toInt(&ok);
+            if (!ok || jobs < 1)
+            {
+                throw std::invalid_argument("--jobs must be a positive number");
+            }
+        }
+        if (!driver->capabilities().threadSafe)
+        {
+            jobs = 1;
+        }
+        jobs = static_cast<int>(qMin<qsizetype>(jobs, qMax<qsizetype>(static_cast<qsizetype>(tasks.size()), 1)));
+
+        const bool quiet = parser.isSet(QStringLiteral("quiet"));
+        const bool force = parser.isSet(QStringLiteral("force"));
+        // With --vault, encrypted files are vault entries: each gets its own data key wrapped by the
+        // master key, and decrypting looks the file up to unwrap it.
+        const bool useVault = parser.isSet(QStringLiteral("vault"));
+        std::mutex printMutex;
+        std::atomic<std::size_t> next{0};
+        std::atomic<int> failed{0};
+        std::atomic<int> skipped{0};
+        std::atomic<qint64> bytes{0};
+
+        manager.resetMetrics();
+        const auto started = dynamicencrypt::core::MetricsClock::now();
+        auto work = [&]()
+        {
+            for (std::size_t i = next.fetch_add(1); i < tasks.size(); i = next.fetch_add(1))
+            {
+                const Task &task = tasks[i];
+                QString message;
+                try
+                {
+                    if (!force && QFileInfo::exists(task.output))
+                    {
+                        ++skipped;
+                        message = QStringLiteral("skipped %1 (output exists)").arg(task.input);
+                    }
+                    else
+                    {
+                        QDir().mkpath(QFileInfo(task.output).absolutePath());
+                        if (encrypt && useVault)
+                        {
+                            QByteArray nonce;
+                            QByteArray wrappedKey;
+                            QByteArray digest;
+                            const Key<SymmetricKeyTag> dataKey = VaultManager::createDataKey(driver, key, &wrappedKey);
+                            manager.encryptFile(driver, task.input, task.output, dataKey, &nonce,
+                                                VaultManager::kAutoChunkSize, {}, &digest);
+                            manager.addEntry({absolutePath(task.input), absolutePath(task.output), driver->name(), nonce,
+                                              QDateTime::currentDateTimeUtc(), wrappedKey, digest});
+                        }
+                        else if (encrypt)
+                        {
+                            manager.encryptFile(driver, task.input, task.output, key);
+                        }
+                        else if (const std::optional<VaultEntry> entry =
+                                     useVault ? manager.findEntry(absolutePath(task.input)) : std::nullopt)
+                        {
+                            manager.decryptEntry(*entry, task.output, key);
+                        }
+                        else
+                        {
+                            manager.decryptFile(driver, task.input, task.output, key);
+                        }
+                        bytes += QFileInfo(task.input).size();
+                        message = QStringLiteral("%1 -> %2").arg(task.input, task.output);
+                    }
+                }
+                catch (const std::exception &ex)
+                {
+                    ++failed;
+                    const std::lock_guard<std::mutex> lock(printMutex);
+                    err() << QStringLiteral("failed %1: %2").arg(task.input, QString::fromUtf8(ex.what())) << Qt::endl;
+                    continue;
+                }
+                if (!quiet)
+                {
+                    const std::lock_guard<std::mutex> lock(printMutex);
+                    out() << message << Qt::endl;
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (int worker = 1; worker < jobs; ++worker)
+        {
+            workers.emplace_back(work);
+        }
+        work();
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+        const qint64 elapsed = dynamicencrypt::core::nanosSince(started);
+
+        const MetricsSnapshot metrics = manager.metrics();
+        const qint64 done = static_cast<qint64>(tasks.size()) - failed.load() - skipped.load();
+        out() << QStringLiteral("%1 %2 files (%3 skipped, %4 failed) with %5 using %6 workers in %7 s, %8")
+                     .arg(command)
+                     .arg(done)
+                     .arg(skipped.load())
+                     .arg(failed.load())
+                     .arg(driver->name())
+                     .arg(jobs)
+                     .arg(elapsed / 1e9, 0, 'f', 2)
+                     .arg(formatRate(MetricsSnapshot::perSecond(static_cast<quint64>(bytes.load()), elapsed)))
+              << Qt::endl;
+        for (const DriverMetrics &entry : metrics.drivers)
+        {
+            printOperation(entry.driver, "encrypt", entry.encrypt, elapsed);
+            printOperation(entry.driver, "decrypt", entry.decrypt, elapsed);
+        }
+        if (parser.isSet(QStringLiteral("metrics-json")))
+        {
+            manager.storage().store(parser.value(QStringLiteral("metrics-json")),
+                                    QJsonDocument(metrics.toJson()).toJson(QJsonDocument::Indented));
+        }
+        return failed > 0 ? ExitFailures : ExitOk;
+    }
+    catch (const std::invalid_argument &ex)
+    {
+        err() << QString::fromUtf8(ex.what()) << Qt::endl;
+        return ExitUsage;
+    }
+    catch (const std::exception &ex)
+    {
+        err() << QString::fromUtf8(ex.what()) << Qt::endl;
+        return ExitFailures;
+    }
+}
@@ -0,0 +1,250 @@
+#include "ChangeCache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <QDebug>
+
+#include <bit>
+#include <mutex>
+#include <stdexcept>
+
+#if defined(Q_OS_UNIX)
+#include <sys/stat.h>
+#endif
+
+namespace dynamicencrypt::core
+{
+
+    namespace
+    {
+        constexpr quint32 kMagic = 0x44454343; // "DECC"
+        constexpr quint32 kVersion = 1;
+
+        constexpr quint64 kPrime1 = 0x9E3779B185EBCA87ull;
+        constexpr quint64 kPrime2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr quint64 kPrime3 = 0x165667B19E3779F9ull;
+
+        quint64 mixRound(quint64 lane, quint64 word) noexcept
+        {
+            return std::rotl(lane + word * kPrime2, 31) * kPrime1;
+        }
+
+        quint64 word64(const std::byte *bytes) noexcept
+        {
+            return qFromLittleEndian<quint64>(bytes);
+        }
+    }
+
+    FileSignature FileSignature::of(const QString &path)
+    {
+        FileSignature signature;
+#if defined(Q_OS_UNIX)
+        struct stat status{};
+        if (::stat(QFile::encodeName(path).constData(), &status) != 0 || !S_ISREG(status.st_mode))
+        {
+            return signature;
+        }
+#if defined(Q_OS_DARWIN)
+        const struct timespec &mtime = status.st_mtimespec;
+#else
+        const struct timespec &mtime = status.st_mtim;
+#endif
+        signature.size = static_cast<qint64>(status.st_size);
+        signature.mtimeNanos = static_cast<qint64>(mtime.tv_sec) * 1000000000 + mtime.tv_nsec;
+        signature.inode = static_cast<quint64>(status.st_ino);
+        signature.device = static_cast<quint64>(status.st_dev);
+#else
+        const QFileInfo info(path);
+        if (!info.isFile())
+        {
+            return signature;
+        }
+        signature.size = info.size();
+        signature.mtimeNanos = info.lastModified().toMSecsSinceEpoch() * 1000000;
+#endif
+        return signature;
+    }
+
+    void ChangeCache::open(const QString &path)
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_path = path;
+        m_records.clear();
+        m_loaded = false;
+        m_dirty = false;
+    }
+
+    void ChangeCache::save()
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        if (!m_dirty || m_path.isEmpty())
+        {
+            return;
+        }
+        QSaveFile file(m_path);
+        if (!file.open(QIODevice::WriteOnly))
+        {
+            throw std::runtime_error(QStringLiteral("Failed to write change cache: %1").arg(m_path).toStdString());
+        }
+        QDataStream out(&file);
+        out.setVersion(QDataStream::Qt_6_0);
+        out << kMagic << kVersion << static_cast<quint64>(m_records.size());
+        for (const auto &[sourcePath, record] : m_records)
+        {
+            out << sourcePath << record.signature.size << record.signature.mtimeNanos << record.signature.inode
+                << record.signature.device << record.contentHash << record.storedPath << record.algorithm
+                << record.keyCheck;
+        }
+        if (out.status() != QDataStream::Ok || !file.commit())
+        {
+            throw std::runtime_error(QStringLiteral("Failed to write change cache: %1").arg(m_path).toStdString());
+        }
+        m_dirty = false;
+    }
+
+    std::optional<ChangeCache::Record> ChangeCache::lookup(const QString &sourcePath) const
+    {
+        ensureLoaded();
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        const auto it = m_records.find(sourcePath);
+        if (it == m_records.end())
+        {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    void ChangeCache::update(const QString &sourcePath, Record record)
+    {
+        ensureLoaded();
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_records.insert_or_assign(sourcePath, std::move(record));
+        m_dirty = true;
+    }
+
+    void ChangeCache::removeMissing(const QString &root, const std::unordered_set<QString> &present)
+    {
+        ensureLoaded();
+        const QString prefix = root.endsWith(QLatin1Char('/')) ? root : root + QLatin1Char('/');
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        for (auto it = m_records.begin(); it != m_records.end();)
+        {
+            if (it->first.startsWith(prefix) && !present.contains(it->first))
+            {
+                it = m_records.erase(it);
+                m_dirty = true;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    qsizetype ChangeCache::size() const
+    {
+        ensureLoaded();
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return static_cast<qsizetype>(m_records.size());
+    }
+
+    quint64 ChangeCache::hashContent(std::span<const std::byte> bytes) noexcept
+    {
+        // xxHash64-style: four independent lanes over 32-byte stripes, then the tail and a final avalanche.
+        const std::byte *data = bytes.data();
+        const std::size_t size = bytes.size();
+        std::size_t offset = 0;
+        quint64 hash = kPrime3;
+        if (size >= 32)
+        {
+            quint64 lanes[4] = {kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1};
+            for (; offset + 32 <= size; offset += 32)
+            {
+                for (int lane = 0; lane < 4; ++lane)
+                {
+                    lanes[lane] = mixRound(lanes[lane], word64(data + offset + lane * 8));
+                }
+            }
+            hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+            for (const quint64 lane : lanes)
+            {
+                hash = (hash ^ mixRound(0, lane)) * kPrime1 + kPrime2;
+            }
+        }
+        hash += static_cast<quint64>(size);
+        for (; offset + 8 <= size; offset += 8)
+        {
+            hash = std::rotl(hash ^ mixRound(0, word64(data + offset)), 27) * kPrime1 + kPrime2;
+        }
+        for (; offset < size; ++offset)
+        {
+            hash = std::rotl(hash ^ (static_cast<quint64>(data[offset]) * kPrime3), 11) * kPrime1;
+        }
+        hash ^= hash >> 33;
+        hash *= kPrime2;
+        hash ^= hash >> 29;
+        hash *= kPrime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    QByteArray ChangeCache::keyCheckOf(const QByteArray &key)
+    {
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        hash.addData(QByteArrayLiteral("dynamicencrypt change cache"));
+        hash.addData(key);
+        return hash.result().left(8);
+    }
+
+    void ChangeCache::ensureLoaded() const
+    {
+        {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            if (m_loaded)
+            {
+                return;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        if (m_loaded)
+        {
+            return;
+        }
+        m_loaded = true;
+        QFile file(m_path);
+        if (m_path.isEmpty() || !file.open(QIODevice::ReadOnly))
+        {
+            return;
+        }
+        QDataStream in(&file);
+        in.setVersion(QDataStream::Qt_6_0);
+        quint32 magic = 0;
+        quint32 version = 0;
+        quint64 count = 0;
+        in >> magic >> version >> count;
+        if (magic == kMagic && version == kVersion)
+        {
+            for (quint64 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+            {
+                QString sourcePath;
+                Record record;
+                in >> sourcePath >> record.signature.size >> record.signature.mtimeNanos >> record.signature.inode >>
+                    record.signature.device >> record.contentHash >> record.storedPath >> record.algorithm >>
+                    record.keyCheck;
+                m_records.insert_or_assign(std::move(sourcePath), std::move(record));
+            }
+        }
+        if (magic != kMagic || version != kVersion || in.status() != QDataStream::Ok)
+        {
+            qWarning() << "Discarding unreadable change cache" << m_path;
+            m_records.clear();
+        }
+    }
+
+} // namespace dynamicencrypt::core
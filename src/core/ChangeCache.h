@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+#include <cstddef>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace dynamicencrypt::core
+{
+
+    // What a stat() call says about a file. Two equal signatures mean the file was not modified in
+    // between, short of someone restoring the mtime by hand.
+    struct FileSignature
+    {
+        qint64 size{-1};
+        qint64 mtimeNanos{0};
+        quint64 inode{0}; // 0 where the platform does not report one
+        quint64 device{0};
+
+        // size is -1 when path does not exist or is not a regular file.
+        static FileSignature of(const QString &path);
+
+        bool operator==(const FileSignature &) const = default;
+    };
+
+    // Remembers, per source file, the signature it had when it was last encrypted and where it went, so
+    // a later pass can skip files that did not change. Lives next to the vault index as change.cache and
+    // is loaded on first use. Losing it only costs a full pass, so a damaged file is discarded.
+    //
+    // Thread-safe: lookups share a lock, updates take it exclusively.
+    class ChangeCache
+    {
+    public:
+        static constexpr const char *kFileName = "change.cache";
+
+        struct Record
+        {
+            FileSignature signature;
+            quint64 contentHash{0}; // 0 when not computed
+            QString storedPath;
+            QString algorithm;
+            QByteArray keyCheck; // keyCheckOf() of the key the file was encrypted with
+        };
+
+        // Points the cache at path and forgets the records of the previous one.
+        void open(const QString &path);
+        // Writes the records back if they changed since the last load or save.
+        void save();
+
+        std::optional<Record> lookup(const QString &sourcePath) const;
+        void update(const QString &sourcePath, Record record);
+        // Drops the records of files under root that are not in present, e.g. files deleted since the last pass.
+        void removeMissing(const QString &root, const std::unordered_set<QString> &present);
+        qsizetype size() const;
+
+        // Fast non-cryptographic 64-bit hash; only meant to tell changed content from unchanged.
+        static quint64 hashContent(std::span<const std::byte> bytes) noexcept;
+        // Short SHA-256 fingerprint of a key, so a pass with another key does not skip anything.
+        static QByteArray keyCheckOf(const QByteArray &key);
+
+    private:
+        void ensureLoaded() const;
+
+        QString m_path;
+        mutable std::shared_mutex m_mutex;
+        mutable bool m_loaded{false};
+        bool m_dirty{false};
+        mutable std::unordered_map<QString, Record> m_records;
+    };
+
+} // namespace dynamicencrypt::core
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string_view>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DE_CPU_X86 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
+
+namespace dynamicencrypt::core
+{
+
+    // Instruction set extensions of the running CPU, detected once. Lets the engine tell which SIMD
+    // tier a plugin will run at from its plugin.json alone, without loading the plugin, and is the
+    // one detector the plugin kernels dispatch on, so it stays free of Qt.
+    struct CpuFeatures
+    {
+        bool sse2{false};
+        bool ssse3{false};
+        bool sse41{false};
+        bool avx2{false};
+        bool avx512f{false};
+        bool aes{false};
+        bool pclmul{false};
+
+        static const CpuFeatures &current() noexcept
+        {
+            static const CpuFeatures features = detect();
+            return features;
+        }
+
+        // Looks up a feature by its GCC target name ("sse4.1", "avx512f", ...); unknown names are unsupported.
+        bool has(std::string_view name) const noexcept
+        {
+            const std::pair<const char *, bool> table[] = {{"sse2", sse2},    {"ssse3", ssse3},     {"sse4.1", sse41},
+                                                           {"avx2", avx2},    {"avx512f", avx512f}, {"aes", aes},
+                                                           {"pclmul", pclmul}};
+            for (const auto &[feature, present] : table)
+            {
+                if (name == feature)
+                {
+                    return present;
+                }
+            }
+            return false;
+        }
+
+    private:
+        static CpuFeatures detect() noexcept
+        {
+            CpuFeatures features;
+#if defined(DE_CPU_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+            int regs[4] = {};
+            __cpuid(regs, 0);
+            const int maxLeaf = regs[0];
+            __cpuid(regs, 1);
+            features.sse2 = (regs[3] & (1 << 26)) != 0;
+            features.ssse3 = (regs[2] & (1 << 9)) != 0;
+            features.sse41 = (regs[2] & (1 << 19)) != 0;
+            features.aes = (regs[2] & (1 << 25)) != 0;
+            features.pclmul = (regs[2] & (1 << 1)) != 0;
+            const bool osxsave = (regs[2] & (1 << 27)) != 0;
+            const bool avx = (regs[2] & (1 << 28)) != 0;
+            if (osxsave && avx && maxLeaf >= 7)
+            {
+                const unsigned long long xcr0 = _xgetbv(0);
+                __cpuidex(regs, 7, 0);
+                features.avx2 = (xcr0 & 0x6) == 0x6 && (regs[1] & (1 << 5)) != 0;
+                features.avx512f = (xcr0 & 0xE6) == 0xE6 && (regs[1] & (1 << 16)) != 0;
+            }
+#else
+            __builtin_cpu_init();
+            features.sse2 = __builtin_cpu_supports("sse2");
+            features.ssse3 = __builtin_cpu_supports("ssse3");
+            features.sse41 = __builtin_cpu_supports("sse4.1");
+            features.avx2 = __builtin_cpu_supports("avx2");
+            features.avx512f = __builtin_cpu_supports("avx512f");
+            features.aes = __builtin_cpu_supports("aes");
+            features.pclmul = __builtin_cpu_supports("pclmul");
+#endif
+#endif
+            return features;
+        }
+    };
+
+} // namespace dynamicencrypt::core
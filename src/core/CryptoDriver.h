@@ -1,15 +1,78 @@
 #pragma once
 
+#include "ZeroizingBuffer.h"
+
 #include <QByteArray>
 #include <QString>
+#include <QStringList>
 #include <QtGlobal>
 #include <QtPlugin>
 
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <span>
 #include <stdexcept>
 
 namespace dynamicencrypt::core
 {
 
+    inline std::span<const std::byte> asBytes(const QByteArray &bytes) noexcept
+    {
+        return std::as_bytes(std::span<const char>(bytes.constData(), static_cast<std::size_t>(bytes.size())));
+    }
+
+    inline std::span<std::byte> asWritableBytes(QByteArray &bytes)
+    {
+        return std::as_writable_bytes(std::span<char>(bytes.data(), static_cast<std::size_t>(bytes.size())));
+    }
+
+    // Bytes a driver places before and after the payload; header < 0 means the size is not fixed.
+    struct CiphertextLayout
+    {
+        qsizetype header{-1};
+        qsizetype trailer{0};
+
+        bool known() const noexcept { return header >= 0 && trailer >= 0; }
+        qsizetype overhead() const noexcept { return header + trailer; }
+    };
+
+    // Performance traits a driver declares in its plugin.json. The defaults describe a driver that
+    // declared nothing: not known to be thread-safe, no preferred chunk size, unranked.
+    struct DriverCapabilities
+    {
+        bool threadSafe{false};      // one instance may serve several threads at once
+        bool streaming{false};       // createEncryptContext()/createDecryptContext() are implemented
+        bool segments{false};        // encryptSegment()/decryptSegment() are implemented
+        qsizetype chunkSize{0};      // preferred streaming chunk in bytes, 0 for no preference
+        qsizetype chunkAlignment{1}; // chunk sizes are rounded up to a multiple of this
+        QString simdTier;            // best declared tier this CPU can run
+        int speedRank{0};            // relative throughput at that tier; higher is faster
+        QStringList tags;            // free-form "capabilities" list, e.g. "symmetric", "aead"
+    };
+
+    // Incremental cipher state used to process inputs chunk by chunk.
+    class CipherContext
+    {
+    public:
+        virtual ~CipherContext() = default;
+
+        // Feeds the next chunk and returns the output that is ready so far.
+        virtual QByteArray update(const QByteArray &chunk) = 0;
+
+        // Flushes any buffered output; the context must not be fed afterwards.
+        virtual QByteArray finalize() = 0;
+    };
+
+    // Key state a driver expanded once (round keys, hash subkeys, ...) so later calls skip key setup.
+    // Opaque to callers and usable only with the driver that prepared it. Instances live in the
+    // SecureArena and are wiped on deletion. Const operations may run on several threads at once.
+    class PreparedKey : public SecureAllocated
+    {
+    public:
+        virtual ~PreparedKey() = default;
+    };
+
     // Abstract base demonstrates interface + overriding in plugins.
     class CryptoDriver
     {
@@ -35,8 +98,177 @@ namespace dynamicencrypt::core
             throw std::runtime_error("decrypt(metadata) not implemented for this driver");
         }
 
+        virtual CiphertextLayout ciphertextLayout() const { return {}; }
+
+        // Zero-copy overloads writing into caller-provided buffers; both return the number of bytes written.
+        // The defaults route through the QByteArray overloads so every driver accepts spans.
+        virtual qsizetype encrypt(std::span<const std::byte> plaintext, std::span<std::byte> out, const QByteArray &key)
+        {
+            return copyInto(encrypt(wrap(plaintext), key), out);
+        }
+
+        virtual qsizetype decrypt(std::span<const std::byte> ciphertext, std::span<std::byte> out, const QByteArray &key)
+        {
+            return copyInto(decrypt(wrap(ciphertext), key), out);
+        }
+
+        // In-place overloads: buffer is header + payload + trailer bytes long (see ciphertextLayout())
+        // and the plaintext sits right after the header. decryptInPlace returns the recovered payload.
+        virtual void encryptInPlace(std::span<std::byte> buffer, const QByteArray &key)
+        {
+            const CiphertextLayout layout = requireLayout(buffer);
+            const auto payload = buffer.subspan(static_cast<std::size_t>(layout.header),
+                                                buffer.size() - static_cast<std::size_t>(layout.overhead()));
+            const QByteArray cipher = encrypt(wrap(payload), key);
+            copyInto(cipher, buffer);
+        }
+
+        virtual std::span<std::byte> decryptInPlace(std::span<std::byte> buffer, const QByteArray &key)
+        {
+            const CiphertextLayout layout = requireLayout(buffer);
+            const QByteArray plain = decrypt(wrap(buffer), key);
+            std::span<std::byte> payload = buffer.subspan(static_cast<std::size_t>(layout.header),
+                                                          static_cast<std::size_t>(plain.size()));
+            copyInto(plain, payload);
+            return payload;
+        }
+
+        // Segment primitives sealing under a caller-supplied nonce, for formats that derive one nonce per
+        // segment and process segments independently. A nonce size of 0 means segments are unsupported.
+        // The output span holds in.size() + segmentOverhead() bytes (the reverse for decryptSegment).
+        virtual qsizetype segmentNonceSize() const { return 0; }
+        virtual qsizetype segmentOverhead() const { return 0; }
+
+        virtual void encryptSegment(std::span<const std::byte> in, std::span<std::byte> out, const QByteArray &key,
+                                    std::span<const std::byte> nonce)
+        {
+            Q_UNUSED(in);
+            Q_UNUSED(out);
+            Q_UNUSED(key);
+            Q_UNUSED(nonce);
+            throw std::runtime_error("segment encryption not implemented for this driver");
+        }
+
+        virtual void decryptSegment(std::span<const std::byte> in, std::span<std::byte> out, const QByteArray &key,
+                                    std::span<const std::byte> nonce)
+        {
+            Q_UNUSED(in);
+            Q_UNUSED(out);
+            Q_UNUSED(key);
+            Q_UNUSED(nonce);
+            throw std::runtime_error("segment decryption not implemented for this driver");
+        }
+
+        // Prepared-key overloads. The defaults keep a zeroizing copy of the raw key and route through the
+        // raw-key overloads, so every driver accepts prepared keys; drivers with a key schedule override them.
+        virtual std::unique_ptr<PreparedKey> prepareKey(const QByteArray &key)
+        {
+            if (key.isEmpty())
+            {
+                throw std::invalid_argument("Key must not be empty");
+            }
+            return std::make_unique<RawPreparedKey>(key);
+        }
+
+        virtual qsizetype encrypt(std::span<const std::byte> plaintext, std::span<std::byte> out, const PreparedKey &key)
+        {
+            return encrypt(plaintext, out, rawKey(key));
+        }
+
+        virtual qsizetype decrypt(std::span<const std::byte> ciphertext, std::span<std::byte> out, const PreparedKey &key)
+        {
+            return decrypt(ciphertext, out, rawKey(key));
+        }
+
+        virtual void encryptSegment(std::span<const std::byte> in, std::span<std::byte> out, const PreparedKey &key,
+                                    std::span<const std::byte> nonce)
+        {
+            encryptSegment(in, out, rawKey(key), nonce);
+        }
+
+        virtual void decryptSegment(std::span<const std::byte> in, std::span<std::byte> out, const PreparedKey &key,
+                                    std::span<const std::byte> nonce)
+        {
+            decryptSegment(in, out, rawKey(key), nonce);
+        }
+
+        // Streaming contexts; a full encrypt stream yields the same layout as encrypt().
+        virtual std::unique_ptr<CipherContext> createEncryptContext(const QByteArray &key)
+        {
+            Q_UNUSED(key);
+            throw std::runtime_error("streaming encrypt not implemented for this driver");
+        }
+
+        virtual std::unique_ptr<CipherContext> createDecryptContext(const QByteArray &key)
+        {
+            Q_UNUSED(key);
+            throw std::runtime_error("streaming decrypt not implemented for this driver");
+        }
+
         virtual QString name() const = 0;
         virtual QString version() const = 0;
+
+        // Plugins declare these in plugin.json; the loader supplies them, so drivers rarely override this.
+        virtual DriverCapabilities capabilities() const { return {}; }
+
+    protected:
+        static QByteArray wrap(std::span<const std::byte> bytes)
+        {
+            return QByteArray::fromRawData(reinterpret_cast<const char *>(bytes.data()), static_cast<qsizetype>(bytes.size()));
+        }
+
+        static qsizetype copyInto(const QByteArray &bytes, std::span<std::byte> out)
+        {
+            if (static_cast<std::size_t>(bytes.size()) > out.size())
+            {
+                throw std::length_error("output buffer too small");
+            }
+            if (!bytes.isEmpty())
+            {
+                std::memcpy(out.data(), bytes.constData(), static_cast<std::size_t>(bytes.size()));
+            }
+            return bytes.size();
+        }
+
+        // Downcasts a prepared key to the driver's own type, rejecting keys prepared by another driver.
+        template <typename KeyType>
+        static const KeyType &preparedAs(const PreparedKey &key)
+        {
+            const auto *prepared = dynamic_cast<const KeyType *>(&key);
+            if (!prepared)
+            {
+                throw std::invalid_argument("key was prepared by a different driver");
+            }
+            return *prepared;
+        }
+
+    private:
+        class RawPreparedKey final : public PreparedKey
+        {
+        public:
+            explicit RawPreparedKey(const QByteArray &key) : m_key(key) {}
+
+            const QByteArray &bytes() const noexcept { return m_key.bytes(); }
+
+        private:
+            ZeroizingBuffer m_key;
+        };
+
+        static const QByteArray &rawKey(const PreparedKey &key) { return preparedAs<RawPreparedKey>(key).bytes(); }
+
+        CiphertextLayout requireLayout(std::span<std::byte> buffer) const
+        {
+            const CiphertextLayout layout = ciphertextLayout();
+            if (!layout.known())
+            {
+                throw std::runtime_error("in-place operation requires a fixed ciphertext layout");
+            }
+            if (buffer.size() < static_cast<std::size_t>(layout.overhead()))
+            {
+                throw std::invalid_argument("buffer smaller than ciphertext overhead");
+            }
+            return layout;
+        }
     };
 
 } // namespace dynamicencrypt::core
@@ -0,0 +1,304 @@
+#include "DirectoryEncryptor.h"
+
+#include "WorkStealingPool.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+
+namespace dynamicencrypt::core
+{
+
+    namespace
+    {
+        using ChangeDetection = DirectoryJobOptions::ChangeDetection;
+
+        // State shared by the tasks of one encryptTree() call. Tasks catch their own errors, so the pool
+        // only sees an exception when the vault index cannot be written.
+        class TreeRun
+        {
+        public:
+            TreeRun(VaultManager &manager, CryptoDriver *driver, const QDir &source, const QDir &output,
+                    const Key<SymmetricKeyTag> &key, const JobControl &control, const DirectoryJobOptions &options,
+                    int threads)
+                : m_manager(manager),
+                  m_driver(driver),
+                  m_source(source),
+                  m_output(output),
+                  m_key(key),
+                  m_control(control),
+                  m_options(options),
+                  m_cache(manager.changeCache()),
+                  m_keyCheck(ChangeCache::keyCheckOf(key.raw())),
+                  m_batches(static_cast<std::size_t>(threads)),
+                  m_seen(static_cast<std::size_t>(threads)),
+                  m_pool(threads)
+            {
+                m_fileControl.cancelled = control.cancelled;
+            }
+
+            DirectoryJobResult run()
+            {
+                m_pool.submit([this]() { walk(QString()); });
+                m_pool.wait();
+                // Every worker is idle now, so their batches can be drained from this thread.
+                for (std::vector<VaultEntry> &batch : m_batches)
+                {
+                    flush(batch);
+                }
+                if (m_options.changeDetection != ChangeDetection::Off)
+                {
+                    if (m_options.recursive && !m_control.isCancelled() && !m_walkFailed.load())
+                    {
+                        std::unordered_set<QString> present;
+                        for (const std::vector<QString> &seen : m_seen)
+                        {
+                            present.insert(seen.cbegin(), seen.cend());
+                        }
+                        m_cache.removeMissing(m_source.path(), present);
+                    }
+                    m_cache.save();
+                }
+                DirectoryJobResult result;
+                result.directories = m_directories.load();
+                result.files = m_files.load();
+                result.bytes = m_bytes.load();
+                result.unchanged = m_unchanged.load();
+                result.failures = std::move(m_failures);
+                return result;
+            }
+
+        private:
+            void walk(const QString &relative)
+            {
+                if (m_control.isCancelled())
+                {
+                    return;
+                }
+                const QDir dir(relative.isEmpty() ? m_source.path() : m_source.filePath(relative));
+                if (!m_output.mkpath(relative.isEmpty() ? QStringLiteral(".") : relative))
+                {
+                    fail(dir.path(), QStringLiteral("Failed to create %1").arg(m_output.filePath(relative)));
+                    m_walkFailed = true;
+                    return;
+                }
+                ++m_directories;
+                const QFileInfoList entries = dir.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden,
+                                                                QDir::NoSort);
+                for (const QFileInfo &info : entries)
+                {
+                    QString child = relative.isEmpty() ? info.fileName() : relative + QLatin1Char('/') + info.fileName();
+                    if (info.isDir())
+                    {
+                        // Linked directories may form cycles, and an output tree inside the source must not
+                        // be encrypted again.
+                        if (m_options.recursive && !info.isSymLink() && info.absoluteFilePath() != m_output.absolutePath())
+                        {
+                            m_pool.submit([this, child = std::move(child)]() { walk(child); });
+                        }
+                    }
+                    else
+                    {
+                        ++m_found;
+                        m_pool.submit([this, child = std::move(child), size = info.size()]() { encrypt(child, size); });
+                    }
+                }
+            }
+
+            void encrypt(const QString &relative, qint64 size)
+            {
+                if (m_control.isCancelled())
+                {
+                    return;
+                }
+                const QString input = m_source.filePath(relative);
+                const QString output = m_output.filePath(relative + m_options.suffix);
+                const bool cached = m_options.changeDetection != ChangeDetection::Off;
+                ChangeCache::Record record;
+                VaultEntry entry;
+                bool replacing = false;
+                try
+                {
+                    if (cached)
+                    {
+                        m_seen[static_cast<std::size_t>(m_pool.currentWorker())].push_back(input);
+                        // Taken before reading, so a write during encryption shows up on the next pass.
+                        record = {FileSignature::of(input), 0, output, m_driver->name(), m_keyCheck};
+                        if (unchanged(input, record))
+                        {
+                            ++m_unchanged;
+                            reportProgress();
+                            return;
+                        }
+                    }
+                    QByteArray nonce;
+                    QByteArray wrappedKey;
+                    QByteArray digest;
+                    replacing = m_manager.findEntry(output).has_value();
+                    const Key<SymmetricKeyTag> dataKey = VaultManager::createDataKey(m_driver, m_key, &wrappedKey);
+                    m_manager.encryptFile(m_driver, input, output, dataKey, &nonce, VaultManager::kAutoChunkSize,
+                                          m_fileControl, &digest);
+                    entry = {input, output, m_driver->name(), nonce, QDateTime::currentDateTimeUtc(), wrappedKey, digest};
+                }
+                catch (const OperationCancelled &)
+                {
+                    return;
+                }
+                catch (const std::exception &ex)
+                {
+                    fail(input, QString::fromUtf8(ex.what()));
+                    reportProgress();
+                    return;
+                }
+                if (cached)
+                {
+                    m_cache.update(input, std::move(record));
+                }
+                ++m_files;
+                m_bytes += size;
+                std::vector<VaultEntry> &batch = m_batches[static_cast<std::size_t>(m_pool.currentWorker())];
+                batch.push_back(std::move(entry));
+                // The entry being replaced wraps a key that no longer opens its stored file, so it must not
+                // wait for the batch to fill.
+                if (replacing || static_cast<qsizetype>(batch.size()) >= m_options.batchSize)
+                {
+                    flush(batch);
+                }
+                reportProgress();
+            }
+
+            // True when the cache has input encrypted by this driver and key to the same place, with its
+            // vault entry and output still present, and record's signature, or failing that its content
+            // hash, still matches. record.contentHash is filled in when the mode asks for hashes.
+            bool unchanged(const QString &input, ChangeCache::Record &record)
+            {
+                const std::optional<ChangeCache::Record> previous = m_cache.lookup(input);
+                const bool sameTarget = previous && previous->storedPath == record.storedPath &&
+                                        previous->algorithm == record.algorithm && previous->keyCheck == record.keyCheck &&
+                                        QFileInfo::exists(record.storedPath) && m_manager.findEntry(record.storedPath);
+                if (sameTarget && previous->signature == record.signature)
+                {
+                    return true;
+                }
+                if (m_options.changeDetection != ChangeDetection::ContentHash || record.signature.size < 0)
+                {
+                    return false;
+                }
+                record.contentHash = ChangeCache::hashContent(m_manager.storage().map(input).bytes());
+                if (sameTarget && previous->signature.size == record.signature.size && previous->contentHash == record.contentHash)
+                {
+                    // Only touched: remember the new signature so the next pass needs no hash.
+                    m_cache.update(input, record);
+                    return true;
+                }
+                return false;
+            }
+
+            void flush(std::vector<VaultEntry> &batch)
+            {
+                if (!batch.empty())
+                {
+                    m_manager.addEntries(std::exchange(batch, {}));
+                }
+            }
+
+            void fail(const QString &path, const QString &error)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_failures.push_back({path, error});
+            }
+
+            void reportProgress()
+            {
+                if (m_control.progress)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_control.progress(++m_finished, m_found.load());
+                }
+            }
+
+            VaultManager &m_manager;
+            CryptoDriver *m_driver;
+            const QDir m_source;
+            const QDir m_output;
+            const Key<SymmetricKeyTag> &m_key;
+            const JobControl &m_control;
+            // Cancellation only: progress is reported per file, not per chunk.
+            JobControl m_fileControl;
+            const DirectoryJobOptions &m_options;
+            ChangeCache &m_cache;
+            const QByteArray m_keyCheck;
+
+            std::atomic<qint64> m_directories{0};
+            std::atomic<qint64> m_found{0};
+            std::atomic<qint64> m_files{0};
+            std::atomic<qint64> m_bytes{0};
+            std::atomic<qint64> m_unchanged{0};
+            // A directory that could not be mirrored hides its files, so they must not be pruned.
+            std::atomic_bool m_walkFailed{false};
+            // Guards m_failures and m_finished, and serializes progress callbacks.
+            std::mutex m_mutex;
+            std::vector<DirectoryJobResult::Failure> m_failures;
+            qint64 m_finished{0};
+            // One per worker, indexed by WorkStealingPool::currentWorker().
+            std::vector<std::vector<VaultEntry>> m_batches;
+            // Source files visited, for pruning the change cache.
+            std::vector<std::vector<QString>> m_seen;
+            // Last member: its destructor joins the workers before the state above goes away.
+            WorkStealingPool m_pool;
+        };
+    }
+
+    DirectoryEncryptor::DirectoryEncryptor(VaultManager &manager, DirectoryJobOptions options)
+        : m_manager(manager), m_options(std::move(options))
+    {
+        if (m_options.batchSize < 1)
+        {
+            throw std::invalid_argument("batch size must be positive");
+        }
+    }
+
+    DirectoryJobResult DirectoryEncryptor::encryptTree(CryptoDriver *driver, const QString &sourceDir,
+                                                       const QString &outputDir, const Key<SymmetricKeyTag> &key,
+                                                       const JobControl &control)
+    {
+        if (!driver)
+        {
+            throw std::invalid_argument("driver is null");
+        }
+        const QDir source(QFileInfo(sourceDir).absoluteFilePath());
+        const QDir output(QFileInfo(outputDir).absoluteFilePath());
+        if (!source.exists())
+        {
+            throw std::runtime_error(QStringLiteral("No such directory: %1").arg(sourceDir).toStdString());
+        }
+        if (source == output)
+        {
+            throw std::invalid_argument("output directory must differ from the source directory");
+        }
+        // Checked up front: a file encrypted under a data key the index cannot record is unreadable.
+        m_manager.requireWritableIndex();
+
+        int threads = 1;
+        if (driver->capabilities().threadSafe)
+        {
+            threads = m_options.threadCount > 0 ? m_options.threadCount : QThread::idealThreadCount();
+        }
+        TreeRun run(m_manager, driver, source, output, key, control, m_options, threads);
+        DirectoryJobResult result = run.run();
+        if (control.isCancelled())
+        {
+            throw OperationCancelled();
+        }
+        return result;
+    }
+
+} // namespace dynamicencrypt::core
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "VaultManager.h"
+
+#include <QString>
+
+#include <vector>
+
+namespace dynamicencrypt::core
+{
+
+    struct DirectoryJobOptions
+    {
+        // How a pass decides, through VaultManager::changeCache(), that a file is already in the vault.
+        enum class ChangeDetection
+        {
+            Off,         // encrypt everything
+            Metadata,    // skip files whose size, mtime, inode and device are unchanged
+            ContentHash, // also hash each file, and skip one that was only touched if its hash is unchanged
+        };
+
+        int threadCount{0};                       // 0: one per core; drivers that are not thread-safe get one
+        qsizetype batchSize{256};                 // entries handed to VaultManager::addEntries() at a time
+        QString suffix{QStringLiteral(".vault")}; // appended to each encrypted file's name
+        bool recursive{true};
+        ChangeDetection changeDetection{ChangeDetection::Metadata};
+    };
+
+    struct DirectoryJobResult
+    {
+        struct Failure
+        {
+            QString path;
+            QString error;
+        };
+
+        qint64 directories{0};
+        qint64 files{0};     // encrypted and recorded in the vault
+        qint64 bytes{0};     // plaintext bytes of those files
+        qint64 unchanged{0}; // skipped because the change cache showed them unmodified
+        std::vector<Failure> failures;
+    };
+
+    // Encrypts a directory tree through a VaultManager. Listing a directory and encrypting a file are
+    // separate tasks on a WorkStealingPool, so the walk runs concurrently with encryption and a few large
+    // files never hold back the many small ones queued behind them. Finished files become VaultEntry
+    // records that each worker collects and adds in batches; a file that overwrote the stored file of an
+    // existing entry is recorded before the worker moves on. Every file gets its own data key, wrapped by
+    // the key passed in (see VaultManager::createDataKey()). A file is skipped when the change cache shows
+    // it unmodified since it was last encrypted to the same place with the same driver and key, and its
+    // output and vault entry still exist, so a repeated pass reads and encrypts only what changed.
+    class DirectoryEncryptor
+    {
+    public:
+        explicit DirectoryEncryptor(VaultManager &manager, DirectoryJobOptions options = {});
+
+        // Writes every file under sourceDir to the same relative path under outputDir plus options.suffix.
+        // A file that fails is listed in the result and the others carry on. control.progress receives
+        // (files finished, files found so far) from worker threads, one call at a time. On cancellation the
+        // files already encrypted are still recorded, then OperationCancelled is thrown. The change cache
+        // is saved after every pass; a complete recursive pass also drops the records of deleted files.
+        // Throws before touching any file when the vault index is not writable.
+        DirectoryJobResult encryptTree(CryptoDriver *driver, const QString &sourceDir, const QString &outputDir,
+                                       const Key<SymmetricKeyTag> &key, const JobControl &control = {});
+
+    private:
+        VaultManager &m_manager;
+        DirectoryJobOptions m_options;
+    };
+
+} // namespace dynamicencrypt::core
@@ -0,0 +1,151 @@
+#include "EntryIndexes.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+namespace dynamicencrypt::core
+{
+
+    qint64 EntryIndexes::timeOf(const QDateTime &timestamp)
+    {
+        return timestamp.isValid() ? timestamp.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+    }
+
+    void EntryIndexes::insert(const VaultEntry &entry)
+    {
+        remove(entry.storedPath);
+        const Record *record =
+            &m_byStoredPath.try_emplace(entry.storedPath, Record{entry, timeOf(entry.timestamp)}).first->second;
+        m_byOriginalPath.emplace(entry.originalPath, record);
+        m_byTime.insert(record);
+        m_byAlgorithm[entry.algorithm].insert(record);
+    }
+
+    bool EntryIndexes::remove(const QString &storedPath)
+    {
+        const auto it = m_byStoredPath.find(storedPath);
+        if (it == m_byStoredPath.end())
+        {
+            return false;
+        }
+        unlink(it->second);
+        m_byStoredPath.erase(it);
+        return true;
+    }
+
+    void EntryIndexes::clear()
+    {
+        m_byOriginalPath.clear();
+        m_byTime.clear();
+        m_byAlgorithm.clear();
+        m_byStoredPath.clear();
+    }
+
+    const VaultEntry *EntryIndexes::find(const QString &storedPath) const
+    {
+        const auto it = m_byStoredPath.find(storedPath);
+        return it != m_byStoredPath.end() ? &it->second.entry : nullptr;
+    }
+
+    std::vector<VaultEntry> EntryIndexes::query(const EntryQuery &query) const
+    {
+        std::vector<VaultEntry> results;
+        const qint64 from = query.from.isValid() ? timeOf(query.from) : std::numeric_limits<qint64>::min();
+        const qint64 until = query.until.isValid() ? timeOf(query.until) : std::numeric_limits<qint64>::max();
+        if (query.until.isValid() && until <= from)
+        {
+            return results;
+        }
+        const auto limit = query.limit < 0 ? std::numeric_limits<std::size_t>::max() : static_cast<std::size_t>(query.limit);
+
+        if (!query.originalPath.isEmpty())
+        {
+            // Few entries share an original path, so filter and sort them directly.
+            std::vector<const Record *> matches;
+            const auto [first, last] = m_byOriginalPath.equal_range(query.originalPath);
+            for (auto it = first; it != last; ++it)
+            {
+                const Record *record = it->second;
+                if ((query.algorithm.isEmpty() || record->entry.algorithm == query.algorithm) && record->time >= from &&
+                    record->time < until)
+                {
+                    matches.push_back(record);
+                }
+            }
+            std::sort(matches.begin(), matches.end(), ByTime());
+            if (query.newestFirst)
+            {
+                std::reverse(matches.begin(), matches.end());
+            }
+            for (std::size_t i = 0; i < matches.size() && i < limit; ++i)
+            {
+                results.push_back(matches[i]->entry);
+            }
+            return results;
+        }
+
+        const TimeIndex *index = &m_byTime;
+        if (!query.algorithm.isEmpty())
+        {
+            const auto group = m_byAlgorithm.find(query.algorithm);
+            if (group == m_byAlgorithm.end())
+            {
+                return results;
+            }
+            index = &group->second;
+        }
+        const auto first = query.from.isValid() ? index->lower_bound(from) : index->begin();
+        const auto last = query.until.isValid() ? index->lower_bound(until) : index->end();
+        auto take = [&](auto it, auto end)
+        {
+            for (; it != end && results.size() < limit; ++it)
+            {
+                results.push_back((*it)->entry);
+            }
+        };
+        if (query.newestFirst)
+        {
+            take(std::make_reverse_iterator(last), std::make_reverse_iterator(first));
+        }
+        else
+        {
+            take(first, last);
+        }
+        return results;
+    }
+
+    QHash<QString, qsizetype> EntryIndexes::algorithmCounts() const
+    {
+        QHash<QString, qsizetype> counts;
+        for (const auto &[algorithm, index] : m_byAlgorithm)
+        {
+            counts.insert(algorithm, static_cast<qsizetype>(index.size()));
+        }
+        return counts;
+    }
+
+    void EntryIndexes::unlink(const Record &record)
+    {
+        const auto [first, last] = m_byOriginalPath.equal_range(record.entry.originalPath);
+        for (auto it = first; it != last; ++it)
+        {
+            if (it->second == &record)
+            {
+                m_byOriginalPath.erase(it);
+                break;
+            }
+        }
+        m_byTime.erase(&record);
+        const auto group = m_byAlgorithm.find(record.entry.algorithm);
+        if (group != m_byAlgorithm.end())
+        {
+            group->second.erase(&record);
+            if (group->second.empty())
+            {
+                m_byAlgorithm.erase(group);
+            }
+        }
+    }
+
+} // namespace dynamicencrypt::core
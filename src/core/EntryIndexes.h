@@ -0,0 +1,75 @@
+#pragma once
+
+#include "VaultEntry.h"
+
+#include <QDateTime>
+#include <QHash>
+#include <QString>
+
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace dynamicencrypt::core
+{
+
+    // Filters for VaultManager::findEntries(). Empty strings and invalid times match everything.
+    struct EntryQuery
+    {
+        QString originalPath;
+        QString algorithm;
+        QDateTime from;  // inclusive
+        QDateTime until; // exclusive
+        qsizetype limit{-1};
+        bool newestFirst{false};
+    };
+
+    // Secondary indexes over the vault entries: hashes on storedPath and originalPath, and timestamp-ordered
+    // sets for the whole vault and for each algorithm. A query walks only the entries it returns, plus the
+    // entries sharing its originalPath when one is given. Not synchronized; VaultManager guards it.
+    class EntryIndexes
+    {
+    public:
+        // Replaces the entry with the same storedPath, if any.
+        void insert(const VaultEntry &entry);
+        bool remove(const QString &storedPath);
+        void clear();
+
+        qsizetype size() const noexcept { return static_cast<qsizetype>(m_byStoredPath.size()); }
+        const VaultEntry *find(const QString &storedPath) const;
+        // Matches ordered by timestamp, then storedPath; entries without a valid timestamp sort first.
+        std::vector<VaultEntry> query(const EntryQuery &query) const;
+        QHash<QString, qsizetype> algorithmCounts() const;
+
+    private:
+        struct Record
+        {
+            VaultEntry entry;
+            qint64 time{0};
+        };
+
+        struct ByTime
+        {
+            using is_transparent = void;
+
+            bool operator()(const Record *a, const Record *b) const
+            {
+                return a->time != b->time ? a->time < b->time : a->entry.storedPath < b->entry.storedPath;
+            }
+            bool operator()(const Record *a, qint64 time) const { return a->time < time; }
+            bool operator()(qint64 time, const Record *b) const { return time < b->time; }
+        };
+
+        using TimeIndex = std::set<const Record *, ByTime>;
+
+        static qint64 timeOf(const QDateTime &timestamp);
+        void unlink(const Record &record);
+
+        // Node-based, so the Record addresses held by the other indexes survive rehashing.
+        std::unordered_map<QString, Record> m_byStoredPath;
+        std::unordered_multimap<QString, const Record *> m_byOriginalPath;
+        TimeIndex m_byTime;
+        std::unordered_map<QString, TimeIndex> m_byAlgorithm;
+    };
+
+} // namespace dynamicencrypt::core
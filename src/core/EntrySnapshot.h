@@ -0,0 +1,173 @@
+#pragma once
+
+#include "VaultEntry.h"
+#include "VaultIndex.h"
+
+#include <QtGlobal>
+
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace dynamicencrypt::core
+{
+
+    // Immutable view of the vault entries at one point in time; it stays valid however long it is held.
+    // Entries sit in fixed-size chunks shared between successive snapshots, so publishing a change
+    // copies one chunk and the chunk table instead of every entry.
+    class EntrySnapshot
+    {
+    public:
+        static constexpr qsizetype kChunkSize = 256;
+
+        qsizetype size() const noexcept { return m_size; }
+        bool isEmpty() const noexcept { return m_size == 0; }
+        // Counts every change made to the vault, so a newer snapshot always has a larger version.
+        quint64 version() const noexcept { return m_version; }
+
+        const VaultEntry &at(qsizetype position) const
+        {
+            if (position < 0 || position >= m_size)
+            {
+                throw std::out_of_range("vault snapshot position out of range");
+            }
+            return (*m_chunks[static_cast<std::size_t>(position / kChunkSize)])[static_cast<std::size_t>(position % kChunkSize)];
+        }
+
+        template <typename Visitor>
+        void forEach(Visitor &&visit) const
+        {
+            for (const auto &chunk : m_chunks)
+            {
+                for (const VaultEntry &entry : *chunk)
+                {
+                    visit(entry);
+                }
+            }
+        }
+
+        std::vector<VaultEntry> toVector() const
+        {
+            std::vector<VaultEntry> entries;
+            entries.reserve(static_cast<std::size_t>(m_size));
+            forEach([&](const VaultEntry &entry) { entries.push_back(entry); });
+            return entries;
+        }
+
+    private:
+        friend class VaultManager;
+
+        // Chunks are only written while the snapshot that created them is being built.
+        using Chunk = std::vector<VaultEntry>;
+
+        static EntrySnapshot fromIndex(const VaultIndex &index, quint64 version)
+        {
+            EntrySnapshot snapshot;
+            snapshot.m_version = version;
+            for (qsizetype i = 0; i < index.size(); ++i)
+            {
+                snapshot.append(index.entryAt(i));
+            }
+            return snapshot;
+        }
+
+        // Copy with the entry at position replaced, or appended when position == size().
+        EntrySnapshot withEntry(qsizetype position, VaultEntry entry, quint64 version) const
+        {
+            EntrySnapshot next(*this);
+            next.m_version = version;
+            if (position == m_size && m_size % kChunkSize == 0)
+            {
+                next.append(std::move(entry));
+                return next;
+            }
+            const auto chunk = static_cast<std::size_t>(position / kChunkSize);
+            auto copy = std::make_shared<Chunk>(*m_chunks[chunk]);
+            if (position == m_size)
+            {
+                copy->reserve(kChunkSize);
+                copy->push_back(std::move(entry));
+                ++next.m_size;
+            }
+            else
+            {
+                (*copy)[static_cast<std::size_t>(position % kChunkSize)] = std::move(entry);
+            }
+            next.m_chunks[chunk] = std::move(copy);
+            return next;
+        }
+
+        // withEntry() applied for each (position, entry) change in order, copying each touched chunk once.
+        EntrySnapshot withEntries(std::vector<std::pair<qsizetype, VaultEntry>> changes, quint64 version) const
+        {
+            EntrySnapshot next(*this);
+            next.m_version = version;
+            std::vector<bool> copied(m_chunks.size(), false);
+            auto own = [&](std::size_t chunk) -> Chunk &
+            {
+                // Chunks past the original table were created by append() below and are ours already.
+                if (chunk < copied.size() && !copied[chunk])
+                {
+                    auto copy = std::make_shared<Chunk>(*m_chunks[chunk]);
+                    copy->reserve(kChunkSize);
+                    next.m_chunks[chunk] = std::move(copy);
+                    copied[chunk] = true;
+                }
+                return *next.m_chunks[chunk];
+            };
+            for (auto &[position, entry] : changes)
+            {
+                if (position == next.m_size)
+                {
+                    if (next.m_size % kChunkSize != 0)
+                    {
+                        own(next.m_chunks.size() - 1);
+                    }
+                    next.append(std::move(entry));
+                }
+                else
+                {
+                    own(static_cast<std::size_t>(position / kChunkSize))[static_cast<std::size_t>(position % kChunkSize)] =
+                        std::move(entry);
+                }
+            }
+            return next;
+        }
+
+        // Copy without the entry at position; chunks before it are shared, later ones are rebuilt.
+        EntrySnapshot without(qsizetype position, quint64 version) const
+        {
+            EntrySnapshot next;
+            next.m_version = version;
+            const qsizetype first = position / kChunkSize;
+            next.m_chunks.assign(m_chunks.begin(), m_chunks.begin() + first);
+            next.m_size = first * kChunkSize;
+            for (qsizetype i = next.m_size; i < m_size; ++i)
+            {
+                if (i != position)
+                {
+                    next.append(at(i));
+                }
+            }
+            return next;
+        }
+
+        // Only valid while the tail chunk belongs to this snapshot alone.
+        void append(VaultEntry entry)
+        {
+            if (m_size % kChunkSize == 0)
+            {
+                m_chunks.push_back(std::make_shared<Chunk>());
+                m_chunks.back()->reserve(kChunkSize);
+            }
+            m_chunks.back()->push_back(std::move(entry));
+            ++m_size;
+        }
+
+        std::vector<std::shared_ptr<Chunk>> m_chunks;
+        qsizetype m_size{0};
+        quint64 m_version{0};
+    };
+
+} // namespace dynamicencrypt::core
@@ -1,12 +1,12 @@
 #pragma once
 
+#include "SecureRandom.h"
 #include "ZeroizingBuffer.h"
 
 #include <QCryptographicHash>
 #include <QFile>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QRandomGenerator>
 #include <QString>
 
 #include <ostream>
@@ -51,7 +51,8 @@ namespace dynamicencrypt::core
         }
 
         const QByteArray &raw() const noexcept { return m_buffer.bytes(); }
-        QByteArray materialize() const { return QByteArray(m_buffer.bytes()); }
+        // A deep copy on the regular heap; raw() only views arena memory that is wiped with the key.
+        QByteArray materialize() const { return QByteArray(raw().constData(), raw().size()); }
 
         int size() const noexcept { return m_buffer.bytes().size(); }
         const QString &label() const noexcept { return m_label; }
@@ -88,13 +89,7 @@ namespace dynamicencrypt::core
         {
             throw std::invalid_argument("sizeBits must be positive and a multiple of 8");
         }
-        QByteArray material(sizeBits / 8, Qt::Uninitialized);
-        auto *rng = QRandomGenerator::system();
-        for (int i = 0; i < material.size(); ++i)
-        {
-            material[i] = static_cast<char>(rng->generate());
-        }
-        return Key<SymmetricKeyTag>(material, QStringLiteral("generated"));
+        return Key<SymmetricKeyTag>(SecureRandom::bytes(sizeBits / 8), QStringLiteral("generated"));
     }
 
     inline Key<SymmetricKeyTag> importSymmetricKey(const QString &path)
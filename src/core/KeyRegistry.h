@@ -0,0 +1,85 @@
+#pragma once
+
+#include "CryptoDriver.h"
+
+#include <QHash>
+#include <QtGlobal>
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <utility>
+
+namespace dynamicencrypt::core
+{
+
+    // Names a prepared key held by a KeyRegistry; the default-constructed handle is never valid.
+    struct KeyHandle
+    {
+        quint64 id{0};
+
+        bool isValid() const noexcept { return id != 0; }
+        friend bool operator==(KeyHandle, KeyHandle) = default;
+    };
+
+    // Prepared keys by handle, each bound to the driver that prepared it. Lookups hand out shared
+    // ownership, so a key released while a call is still using it is wiped once that call returns.
+    // find() takes a shared lock, so concurrent operations on prepared keys do not serialize on it.
+    class KeyRegistry
+    {
+    public:
+        struct Entry
+        {
+            CryptoDriver *driver{nullptr};
+            std::shared_ptr<const PreparedKey> key;
+        };
+
+        KeyHandle add(CryptoDriver *driver, std::unique_ptr<PreparedKey> key)
+        {
+            if (!driver || !key)
+            {
+                throw std::invalid_argument("a prepared key needs its driver");
+            }
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            const KeyHandle handle{++m_lastId};
+            m_entries.insert(handle.id, Entry{driver, std::shared_ptr<const PreparedKey>(std::move(key))});
+            return handle;
+        }
+
+        Entry find(KeyHandle handle) const
+        {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            const auto it = m_entries.constFind(handle.id);
+            if (it == m_entries.cend())
+            {
+                throw std::invalid_argument("unknown or released key handle");
+            }
+            return *it;
+        }
+
+        bool remove(KeyHandle handle)
+        {
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            return m_entries.remove(handle.id) > 0;
+        }
+
+        void clear()
+        {
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            m_entries.clear();
+        }
+
+        qsizetype size() const
+        {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            return m_entries.size();
+        }
+
+    private:
+        mutable std::shared_mutex m_mutex;
+        QHash<quint64, Entry> m_entries;
+        quint64 m_lastId{0};
+    };
+
+} // namespace dynamicencrypt::core
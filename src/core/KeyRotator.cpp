@@ -0,0 +1,107 @@
+#include "KeyRotator.h"
+
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace dynamicencrypt::core
+{
+
+    KeyRotator::KeyRotator(VaultManager &manager, qsizetype batchSize)
+        : m_manager(manager), m_batchSize(batchSize)
+    {
+        if (m_batchSize < 1)
+        {
+            throw std::invalid_argument("batch size must be positive");
+        }
+    }
+
+    KeyRotationResult KeyRotator::rotate(const Key<SymmetricKeyTag> &oldKey, const Key<SymmetricKeyTag> &newKey,
+                                         const JobControl &control)
+    {
+        if (oldKey.raw() == newKey.raw())
+        {
+            throw std::invalid_argument("the new master key must differ from the old one");
+        }
+        // Rewrapped keys that could not be written back would be lost along with the old master key.
+        m_manager.requireWritableIndex();
+        KeyRotationResult result;
+        ChangeCache &cache = m_manager.changeCache();
+        const QByteArray oldCheck = ChangeCache::keyCheckOf(oldKey.raw());
+        const QByteArray newCheck = ChangeCache::keyCheckOf(newKey.raw());
+        std::vector<VaultEntry> batch;
+        auto flush = [&]()
+        {
+            for (const VaultEntry &entry : batch)
+            {
+                // Directory passes compare the master key too; without this they would re-encrypt everything.
+                std::optional<ChangeCache::Record> record = cache.lookup(entry.originalPath);
+                if (record && record->storedPath == entry.storedPath && record->keyCheck == oldCheck)
+                {
+                    record->keyCheck = newCheck;
+                    cache.update(entry.originalPath, std::move(*record));
+                }
+            }
+            m_manager.addEntries(std::exchange(batch, {}));
+            cache.save();
+        };
+
+        const std::shared_ptr<const EntrySnapshot> entries = m_manager.snapshot();
+        const qint64 total = entries->size();
+        for (qsizetype i = 0; i < entries->size(); ++i)
+        {
+            if (control.isCancelled())
+            {
+                flush();
+                m_manager.compactIndex();
+                throw OperationCancelled();
+            }
+            VaultEntry entry = entries->at(i);
+            if (entry.wrappedKey.isEmpty())
+            {
+                ++result.direct;
+            }
+            else if (VaultManager::isWrappedUnder(entry.wrappedKey, newKey))
+            {
+                ++result.current;
+            }
+            else
+            {
+                try
+                {
+                    CryptoDriver *driver = m_manager.driverNamed(entry.algorithm);
+                    if (!driver)
+                    {
+                        throw std::runtime_error(QStringLiteral("No driver named %1").arg(entry.algorithm).toStdString());
+                    }
+                    const Key<SymmetricKeyTag> dataKey = VaultManager::unwrapDataKey(driver, entry.wrappedKey, oldKey);
+                    entry.wrappedKey = VaultManager::wrapDataKey(driver, dataKey, newKey);
+                    batch.push_back(std::move(entry));
+                    ++result.rewrapped;
+                }
+                catch (const std::exception &ex)
+                {
+                    result.failures.push_back({entry.storedPath, QString::fromUtf8(ex.what())});
+                }
+                if (static_cast<qsizetype>(batch.size()) >= m_batchSize)
+                {
+                    flush();
+                }
+            }
+            if (control.progress)
+            {
+                control.progress(i + 1, total);
+            }
+        }
+        flush();
+        if (result.rewrapped > 0)
+        {
+            // The replaced records still hold every data key wrapped under the old master key.
+            m_manager.compactIndex();
+        }
+        return result;
+    }
+
+} // namespace dynamicencrypt::core
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "VaultManager.h"
+
+#include <QString>
+
+#include <vector>
+
+namespace dynamicencrypt::core
+{
+
+    struct KeyRotationResult
+    {
+        struct Failure
+        {
+            QString storedPath;
+            QString error;
+        };
+
+        qint64 rewrapped{0};
+        qint64 current{0}; // already wrapped under the new key, e.g. by an interrupted rotation
+        qint64 direct{0};  // encrypted with the master key itself; only re-encrypting them rotates their key
+        std::vector<Failure> failures;
+    };
+
+    // Moves the vault from one master key to another by rewrapping each entry's data key. The cost is a
+    // few dozen bytes of cipher work and one index record per entry, whatever the payload sizes, and no
+    // .vault file is opened. The index is compacted afterwards so no key wrapped under the old master
+    // key remains in it.
+    //
+    // Safe to interrupt: entries are written back in batches, and running again with the same keys skips
+    // the ones already rotated. Entries added or replaced while a rotation runs may be overwritten with
+    // their earlier contents, so it should not overlap with jobs that write the vault.
+    class KeyRotator
+    {
+    public:
+        explicit KeyRotator(VaultManager &manager, qsizetype batchSize = 256);
+
+        // control.progress receives (entries visited, entries). On cancellation the batches already
+        // rewrapped stay rewrapped, then OperationCancelled is thrown. Throws before rewrapping anything
+        // when the vault index is not writable.
+        KeyRotationResult rotate(const Key<SymmetricKeyTag> &oldKey, const Key<SymmetricKeyTag> &newKey,
+                                 const JobControl &control = {});
+
+    private:
+        VaultManager &m_manager;
+        qsizetype m_batchSize;
+    };
+
+} // namespace dynamicencrypt::core
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "CryptoDriver.h"
+#include "PluginDescriptor.h"
+
+#include <QObject>
+#include <QPluginLoader>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+namespace dynamicencrypt::core
+{
+
+    // Stands in for a plugin's driver until it is needed: name(), version() and capabilities() come
+    // from the descriptor, and the library is loaded on the first call that needs the real driver.
+    // Loading is thread-safe; a failed load throws and is retried on the next call.
+    class LazyDriver final : public CryptoDriver
+    {
+    public:
+        explicit LazyDriver(PluginDescriptor descriptor)
+            : m_descriptor(std::move(descriptor))
+        {
+        }
+
+        const PluginDescriptor &descriptor() const noexcept { return m_descriptor; }
+        bool isLoaded() const noexcept { return m_instance.load(std::memory_order_acquire) != nullptr; }
+
+        CryptoDriver &instance() const
+        {
+            if (CryptoDriver *driver = m_instance.load(std::memory_order_acquire))
+            {
+                return *driver;
+            }
+            std::lock_guard<std::mutex> lock(m_loadMutex);
+            if (CryptoDriver *driver = m_instance.load(std::memory_order_relaxed))
+            {
+                return *driver;
+            }
+            auto loader = std::make_unique<QPluginLoader>(m_descriptor.filePath);
+            QObject *object = loader->instance();
+            if (!object)
+            {
+                throw std::runtime_error(QStringLiteral("Failed to load plugin %1: %2")
+                                             .arg(m_descriptor.filePath, loader->errorString())
+                                             .toStdString());
+            }
+            auto *driver = qobject_cast<CryptoDriver *>(object);
+            if (!driver)
+            {
+                loader->unload();
+                throw std::runtime_error(QStringLiteral("Plugin %1 does not implement CryptoDriver")
+                                             .arg(m_descriptor.filePath)
+                                             .toStdString());
+            }
+            m_loader = std::move(loader);
+            m_instance.store(driver, std::memory_order_release);
+            return *driver;
+        }
+
+        // Plugins whose plugin.json predates the name/version fields are loaded to ask them directly.
+        void resolveIdentity()
+        {
+            if (!m_descriptor.hasIdentity())
+            {
+                m_descriptor.name = instance().name();
+                m_descriptor.version = instance().version();
+            }
+        }
+
+        QByteArray encrypt(const QByteArray &plaintext, const QByteArray &key) override
+        {
+            return instance().encrypt(plaintext, key);
+        }
+
+        QByteArray decrypt(const QByteArray &ciphertext, const QByteArray &key) override
+        {
+            return instance().decrypt(ciphertext, key);
+        }
+
+        QByteArray encrypt(const QByteArray &plaintext, const QString &keyMetadata) override
+        {
+            return instance().encrypt(plaintext, keyMetadata);
+        }
+
+        QByteArray decrypt(const QByteArray &ciphertext, const QString &keyMetadata) override
+        {
+            return instance().decrypt(ciphertext, keyMetadata);
+        }
+
+        CiphertextLayout ciphertextLayout() const override { return instance().ciphertextLayout(); }
+
+        qsizetype encrypt(std::span<const std::byte> plaintext, std::span<std::byte> out, const QByteArray &key) override
+        {
+            return instance().encrypt(plaintext, out, key);
+        }
+
+        qsizetype decrypt(std::span<const std::byte> ciphertext, std::span<std::byte> out, const QByteArray &key) override
+        {
+            return instance().decrypt(ciphertext, out, key);
+        }
+
+        void encryptInPlace(std::span<std::byte> buffer, const QByteArray &key) override
+        {
+            instance().encryptInPlace(buffer, key);
+        }
+
+        std::span<std::byte> decryptInPlace(std::span<std::byte> buffer, const QByteArray &key) override
+        {
+            return instance().decryptInPlace(buffer, key);
+        }
+
+        qsizetype segmentNonceSize() const override { return instance().segmentNonceSize(); }
+        qsizetype segmentOverhead() const override { return instance().segmentOverhead(); }
+
+        void encryptSegment(std::span<const std::byte> in, std::span<std::byte> out, const QByteArray &key,
+                            std::span<const std::byte> nonce) override
+        {
+            instance().encryptSegment(in, out, key, nonce);
+        }
+
+        void decryptSegment(std::span<const std::byte> in, std::span<std::byte> out, const QByteArray &key,
+                            std::span<const std::byte> nonce) override
+        {
+            instance().decryptSegment(in, out, key, nonce);
+        }
+
+        std::unique_ptr<PreparedKey> prepareKey(const QByteArray &key) override { return instance().prepareKey(key); }
+
+        qsizetype encrypt(std::span<const std::byte> plaintext, std::span<std::byte> out, const PreparedKey &key) override
+        {
+            return instance().encrypt(plaintext, out, key);
+        }
+
+        qsizetype decrypt(std::span<const std::byte> ciphertext, std::span<std::byte> out, const PreparedKey &key) override
+        {
+            return instance().decrypt(ciphertext, out, key);
+        }
+
+        void encryptSegment(std::span<const std::byte> in, std::span<std::byte> out, const PreparedKey &key,
+                            std::span<const std::byte> nonce) override
+        {
+            instance().encryptSegment(in, out, key, nonce);
+        }
+
+        void decryptSegment(std::span<const std::byte> in, std::span<std::byte> out, const PreparedKey &key,
+                            std::span<const std::byte> nonce) override
+        {
+            instance().decryptSegment(in, out, key, nonce);
+        }
+
+        std::unique_ptr<CipherContext> createEncryptContext(const QByteArray &key) override
+        {
+            return instance().createEncryptContext(key);
+        }
+
+        std::unique_ptr<CipherContext> createDecryptContext(const QByteArray &key) override
+        {
+            return instance().createDecryptContext(key);
+        }
+
+        QString name() const override { return m_descriptor.name; }
+        QString version() const override { return m_descriptor.version; }
+        DriverCapabilities capabilities() const override { return m_descriptor.capabilities; }
+
+    private:
+        PluginDescriptor m_descriptor;
+        mutable std::mutex m_loadMutex;
+        mutable std::unique_ptr<QPluginLoader> m_loader;
+        mutable std::atomic<CryptoDriver *> m_instance{nullptr};
+    };
+
+} // namespace dynamicencrypt::core
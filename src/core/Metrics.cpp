@@ -0,0 +1,243 @@
+#include "Metrics.h"
+
+#include "CryptoDriver.h"
+
+#include <QJsonArray>
+
+#include <algorithm>
+#include <cmath>
+
+namespace dynamicencrypt::core
+{
+
+    namespace
+    {
+        QJsonObject storageJson(const StorageMetrics &storage, qint64 elapsedNanos)
+        {
+            QJsonObject json;
+            json.insert(QStringLiteral("reads"), static_cast<qint64>(storage.reads));
+            json.insert(QStringLiteral("writes"), static_cast<qint64>(storage.writes));
+            json.insert(QStringLiteral("bytesRead"), static_cast<qint64>(storage.bytesRead));
+            json.insert(QStringLiteral("bytesWritten"), static_cast<qint64>(storage.bytesWritten));
+            json.insert(QStringLiteral("ioNanos"), storage.nanos);
+            json.insert(QStringLiteral("operationsPerSecond"),
+                        MetricsSnapshot::perSecond(storage.reads + storage.writes, elapsedNanos));
+            return json;
+        }
+    }
+
+    qint64 LatencyHistogram::percentile(const Counts &counts, double q) noexcept
+    {
+        quint64 total = 0;
+        for (const quint64 count : counts)
+        {
+            total += count;
+        }
+        if (total == 0)
+        {
+            return 0;
+        }
+        // Rank of the sample at q, counting from 1.
+        const auto rank = static_cast<quint64>(qMax(1.0, std::ceil(q * static_cast<double>(total))));
+        quint64 seen = 0;
+        for (int i = 0; i < kBuckets; ++i)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+            {
+                return valueOf(i);
+            }
+        }
+        return valueOf(kBuckets - 1);
+    }
+
+    OperationMetrics OperationMetrics::minus(const OperationMetrics &earlier) const noexcept
+    {
+        OperationMetrics delta;
+        delta.operations = operations - earlier.operations;
+        delta.bytesIn = bytesIn - earlier.bytesIn;
+        delta.bytesOut = bytesOut - earlier.bytesOut;
+        delta.cipherNanos = cipherNanos - earlier.cipherNanos;
+        delta.ioNanos = ioNanos - earlier.ioNanos;
+        for (int i = 0; i < LatencyHistogram::kBuckets; ++i)
+        {
+            delta.latency[i] = latency[i] - earlier.latency[i];
+        }
+        return delta;
+    }
+
+    QJsonObject OperationMetrics::toJson(qint64 elapsedNanos) const
+    {
+        QJsonObject json;
+        json.insert(QStringLiteral("operations"), static_cast<qint64>(operations));
+        json.insert(QStringLiteral("bytesIn"), static_cast<qint64>(bytesIn));
+        json.insert(QStringLiteral("bytesOut"), static_cast<qint64>(bytesOut));
+        json.insert(QStringLiteral("cipherNanos"), cipherNanos);
+        json.insert(QStringLiteral("ioNanos"), ioNanos);
+        json.insert(QStringLiteral("operationsPerSecond"), MetricsSnapshot::perSecond(operations, elapsedNanos));
+        json.insert(QStringLiteral("cipherBytesPerSecond"), cipherBytesPerSecond());
+        json.insert(QStringLiteral("p50Nanos"), p50Nanos());
+        json.insert(QStringLiteral("p99Nanos"), p99Nanos());
+        // Non-empty buckets only, as [bucket midpoint in ns, count] pairs.
+        QJsonArray histogram;
+        for (int i = 0; i < LatencyHistogram::kBuckets; ++i)
+        {
+            if (latency[i] > 0)
+            {
+                histogram.append(QJsonArray{LatencyHistogram::valueOf(i), static_cast<qint64>(latency[i])});
+            }
+        }
+        json.insert(QStringLiteral("latencyHistogram"), histogram);
+        return json;
+    }
+
+    MetricsSnapshot MetricsSnapshot::since(const MetricsSnapshot &earlier) const
+    {
+        if (earlier.elapsedNanos > elapsedNanos)
+        {
+            return *this;
+        }
+        MetricsSnapshot delta;
+        delta.elapsedNanos = elapsedNanos - earlier.elapsedNanos;
+        for (const DriverMetrics &current : drivers)
+        {
+            DriverMetrics entry = current;
+            const auto previous = std::find_if(earlier.drivers.cbegin(), earlier.drivers.cend(),
+                                               [&](const DriverMetrics &d) { return d.driver == current.driver; });
+            if (previous != earlier.drivers.cend())
+            {
+                entry.encrypt = current.encrypt.minus(previous->encrypt);
+                entry.decrypt = current.decrypt.minus(previous->decrypt);
+            }
+            delta.drivers.push_back(std::move(entry));
+        }
+        delta.storage.reads = storage.reads - earlier.storage.reads;
+        delta.storage.writes = storage.writes - earlier.storage.writes;
+        delta.storage.bytesRead = storage.bytesRead - earlier.storage.bytesRead;
+        delta.storage.bytesWritten = storage.bytesWritten - earlier.storage.bytesWritten;
+        delta.storage.nanos = storage.nanos - earlier.storage.nanos;
+        return delta;
+    }
+
+    QJsonObject MetricsSnapshot::toJson() const
+    {
+        QJsonObject drivers;
+        for (const DriverMetrics &driver : this->drivers)
+        {
+            drivers.insert(driver.driver, QJsonObject{{QStringLiteral("encrypt"), driver.encrypt.toJson(elapsedNanos)},
+                                                      {QStringLiteral("decrypt"), driver.decrypt.toJson(elapsedNanos)}});
+        }
+        QJsonObject json;
+        json.insert(QStringLiteral("elapsedNanos"), elapsedNanos);
+        json.insert(QStringLiteral("drivers"), drivers);
+        json.insert(QStringLiteral("storage"), storageJson(storage, elapsedNanos));
+        return json;
+    }
+
+    OperationMetrics VaultMetrics::Counters::snapshot() const noexcept
+    {
+        OperationMetrics metrics;
+        metrics.operations = operations.load(std::memory_order_relaxed);
+        metrics.bytesIn = bytesIn.load(std::memory_order_relaxed);
+        metrics.bytesOut = bytesOut.load(std::memory_order_relaxed);
+        metrics.cipherNanos = cipherNanos.load(std::memory_order_relaxed);
+        metrics.ioNanos = ioNanos.load(std::memory_order_relaxed);
+        metrics.latency = latency.counts();
+        return metrics;
+    }
+
+    void VaultMetrics::Counters::reset() noexcept
+    {
+        operations.store(0, std::memory_order_relaxed);
+        bytesIn.store(0, std::memory_order_relaxed);
+        bytesOut.store(0, std::memory_order_relaxed);
+        cipherNanos.store(0, std::memory_order_relaxed);
+        ioNanos.store(0, std::memory_order_relaxed);
+        latency.reset();
+    }
+
+    void VaultMetrics::record(const CryptoDriver *driver, Direction direction, qint64 bytesIn, qint64 bytesOut,
+                              qint64 latencyNanos, qint64 ioNanos)
+    {
+        Slot &slot = slotFor(driver);
+        Counters &counters = direction == Direction::Encrypt ? slot.encrypt : slot.decrypt;
+        counters.operations.fetch_add(1, std::memory_order_relaxed);
+        counters.bytesIn.fetch_add(static_cast<quint64>(qMax<qint64>(bytesIn, 0)), std::memory_order_relaxed);
+        counters.bytesOut.fetch_add(static_cast<quint64>(qMax<qint64>(bytesOut, 0)), std::memory_order_relaxed);
+        counters.cipherNanos.fetch_add(latencyNanos - ioNanos, std::memory_order_relaxed);
+        counters.ioNanos.fetch_add(ioNanos, std::memory_order_relaxed);
+        counters.latency.record(latencyNanos);
+    }
+
+    MetricsSnapshot VaultMetrics::snapshot() const
+    {
+        MetricsSnapshot snapshot;
+        const MetricsClock::time_point started{MetricsClock::duration(m_started.load(std::memory_order_relaxed))};
+        snapshot.elapsedNanos = nanosSince(started);
+        if (const Table *table = m_table.load(std::memory_order_acquire))
+        {
+            for (const Slot *slot : *table)
+            {
+                snapshot.drivers.push_back({slot->name, slot->encrypt.snapshot(), slot->decrypt.snapshot()});
+            }
+        }
+        return snapshot;
+    }
+
+    void VaultMetrics::reset()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto &slot : m_slots)
+        {
+            slot->encrypt.reset();
+            slot->decrypt.reset();
+        }
+        m_started.store(MetricsClock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    void VaultMetrics::unbindDrivers()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto &slot : m_slots)
+        {
+            slot->driver.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    VaultMetrics::Slot &VaultMetrics::slotFor(const CryptoDriver *driver)
+    {
+        if (const Table *table = m_table.load(std::memory_order_acquire))
+        {
+            for (Slot *slot : *table)
+            {
+                if (slot->driver.load(std::memory_order_relaxed) == driver)
+                {
+                    return *slot;
+                }
+            }
+        }
+
+        const QString name = driver ? driver->name() : QStringLiteral("unknown");
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Table *current = m_table.load(std::memory_order_relaxed);
+        for (const auto &slot : m_slots)
+        {
+            const CryptoDriver *bound = slot->driver.load(std::memory_order_relaxed);
+            if (bound == driver || (!bound && slot->name == name))
+            {
+                slot->driver.store(driver, std::memory_order_relaxed);
+                return *slot;
+            }
+        }
+        auto slot = std::make_unique<Slot>();
+        slot->driver.store(driver, std::memory_order_relaxed);
+        slot->name = name;
+        auto next = std::make_unique<Table>(current ? *current : Table());
+        next->push_back(slot.get());
+        m_slots.push_back(std::move(slot));
+        m_table.store(next.get(), std::memory_order_release);
+        m_tables.push_back(std::move(next));
+        return *m_slots.back();
+    }
+
+} // namespace dynamicencrypt::core
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QString>
+#include <QtGlobal>
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dynamicencrypt::core
+{
+
+    class CryptoDriver;
+
+    using MetricsClock = std::chrono::steady_clock;
+
+    inline qint64 nanosSince(MetricsClock::time_point start) noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(MetricsClock::now() - start).count();
+    }
+
+    // Log-linear latency histogram: 8 buckets per power of two, so a reported percentile is within
+    // about 6% of the true value. Recording is one relaxed increment.
+    class LatencyHistogram
+    {
+    public:
+        static constexpr int kSubBuckets = 8;
+        static constexpr int kBuckets = (64 - 2) * kSubBuckets;
+
+        using Counts = std::array<quint64, kBuckets>;
+
+        void record(qint64 nanos) noexcept
+        {
+            m_counts[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void reset() noexcept
+        {
+            for (std::atomic<quint64> &count : m_counts)
+            {
+                count.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        Counts counts() const noexcept
+        {
+            Counts counts{};
+            for (int i = 0; i < kBuckets; ++i)
+            {
+                counts[i] = m_counts[i].load(std::memory_order_relaxed);
+            }
+            return counts;
+        }
+
+        static int bucketOf(qint64 nanos) noexcept
+        {
+            const auto value = static_cast<quint64>(qMax<qint64>(nanos, 0));
+            if (value < kSubBuckets)
+            {
+                return static_cast<int>(value);
+            }
+            const int msb = std::bit_width(value) - 1;
+            const auto sub = static_cast<int>((value >> (msb - 3)) & (kSubBuckets - 1));
+            return (msb - 2) * kSubBuckets + sub;
+        }
+
+        // Midpoint of the values that land in bucket.
+        static qint64 valueOf(int bucket) noexcept
+        {
+            if (bucket < kSubBuckets)
+            {
+                return bucket;
+            }
+            const int msb = bucket / kSubBuckets + 2;
+            const quint64 width = quint64{1} << (msb - 3);
+            const quint64 lower = (kSubBuckets + static_cast<quint64>(bucket % kSubBuckets)) * width;
+            return static_cast<qint64>(lower + width / 2);
+        }
+
+        // Value at quantile q (0..1) of counts, or 0 when there are none.
+        static qint64 percentile(const Counts &counts, double q) noexcept;
+
+    private:
+        std::array<std::atomic<quint64>, kBuckets> m_counts{};
+    };
+
+    // Totals for one direction of one driver, as copied out by VaultMetrics::snapshot().
+    struct OperationMetrics
+    {
+        quint64 operations{0};
+        quint64 bytesIn{0};
+        quint64 bytesOut{0};
+        qint64 cipherNanos{0};
+        qint64 ioNanos{0};
+        LatencyHistogram::Counts latency{};
+
+        qint64 p50Nanos() const noexcept { return LatencyHistogram::percentile(latency, 0.50); }
+        qint64 p99Nanos() const noexcept { return LatencyHistogram::percentile(latency, 0.99); }
+        // Input bytes per second of cipher time, excluding I/O.
+        double cipherBytesPerSecond() const noexcept { return cipherNanos > 0 ? bytesIn * 1e9 / cipherNanos : 0.0; }
+
+        OperationMetrics minus(const OperationMetrics &earlier) const noexcept;
+        QJsonObject toJson(qint64 elapsedNanos) const;
+    };
+
+    struct DriverMetrics
+    {
+        QString driver;
+        OperationMetrics encrypt;
+        OperationMetrics decrypt;
+    };
+
+    struct StorageMetrics
+    {
+        quint64 reads{0};
+        quint64 writes{0};
+        quint64 bytesRead{0};
+        quint64 bytesWritten{0};
+        qint64 nanos{0};
+    };
+
+    struct MetricsSnapshot
+    {
+        // Time covered by the counters: since the VaultMetrics was created or reset, or the interval
+        // passed to since().
+        qint64 elapsedNanos{0};
+        std::vector<DriverMetrics> drivers;
+        StorageMetrics storage;
+
+        // Activity between earlier and this snapshot, e.g. for a live rate over a refresh interval; *this
+        // as is if the metrics were reset in between.
+        MetricsSnapshot since(const MetricsSnapshot &earlier) const;
+        static double perSecond(quint64 count, qint64 nanos) noexcept { return nanos > 0 ? count * 1e9 / nanos : 0.0; }
+        QJsonObject toJson() const;
+    };
+
+    // Storage I/O counters. Updated once per call, never per byte.
+    class IoCounters
+    {
+    public:
+        void recordRead(qint64 bytes, qint64 nanos) noexcept
+        {
+            m_reads.fetch_add(1, std::memory_order_relaxed);
+            m_bytesRead.fetch_add(static_cast<quint64>(qMax<qint64>(bytes, 0)), std::memory_order_relaxed);
+            m_nanos.fetch_add(nanos, std::memory_order_relaxed);
+        }
+
+        void recordWrite(qint64 bytes, qint64 nanos) noexcept
+        {
+            m_writes.fetch_add(1, std::memory_order_relaxed);
+            m_bytesWritten.fetch_add(static_cast<quint64>(qMax<qint64>(bytes, 0)), std::memory_order_relaxed);
+            m_nanos.fetch_add(nanos, std::memory_order_relaxed);
+        }
+
+        void reset() noexcept
+        {
+            m_reads.store(0, std::memory_order_relaxed);
+            m_writes.store(0, std::memory_order_relaxed);
+            m_bytesRead.store(0, std::memory_order_relaxed);
+            m_bytesWritten.store(0, std::memory_order_relaxed);
+            m_nanos.store(0, std::memory_order_relaxed);
+        }
+
+        StorageMetrics snapshot() const noexcept
+        {
+            return {m_reads.load(std::memory_order_relaxed), m_writes.load(std::memory_order_relaxed),
+                    m_bytesRead.load(std::memory_order_relaxed), m_bytesWritten.load(std::memory_order_relaxed),
+                    m_nanos.load(std::memory_order_relaxed)};
+        }
+
+    private:
+        std::atomic<quint64> m_reads{0};
+        std::atomic<quint64> m_writes{0};
+        std::atomic<quint64> m_bytesRead{0};
+        std::atomic<quint64> m_bytesWritten{0};
+        std::atomic<qint64> m_nanos{0};
+    };
+
+    // Per-driver throughput and latency for VaultManager operations. Recording finds the driver's
+    // counters in an immutable table with one atomic load and increments them with relaxed atomics;
+    // only a driver's first sample takes the lock.
+    class VaultMetrics
+    {
+    public:
+        enum class Direction
+        {
+            Encrypt,
+            Decrypt,
+        };
+
+        VaultMetrics() = default;
+        VaultMetrics(const VaultMetrics &) = delete;
+        VaultMetrics &operator=(const VaultMetrics &) = delete;
+
+        // latencyNanos covers the whole operation; ioNanos is the part of it spent on file I/O.
+        void record(const CryptoDriver *driver, Direction direction, qint64 bytesIn, qint64 bytesOut,
+                    qint64 latencyNanos, qint64 ioNanos = 0);
+
+        MetricsSnapshot snapshot() const;
+        // Zeroes every counter and restarts the elapsed-time clock.
+        void reset();
+        // Call before the drivers are destroyed. Counters are kept by driver name, and a new driver with
+        // the same name continues them.
+        void unbindDrivers();
+
+    private:
+        struct Counters
+        {
+            std::atomic<quint64> operations{0};
+            std::atomic<quint64> bytesIn{0};
+            std::atomic<quint64> bytesOut{0};
+            std::atomic<qint64> cipherNanos{0};
+            std::atomic<qint64> ioNanos{0};
+            LatencyHistogram latency;
+
+            OperationMetrics snapshot() const noexcept;
+            void reset() noexcept;
+        };
+
+        struct Slot
+        {
+            std::atomic<const CryptoDriver *> driver{nullptr};
+            QString name;
+            Counters encrypt;
+            Counters decrypt;
+        };
+
+        // Tables only grow; superseded ones are kept so readers never see a freed table.
+        using Table = std::vector<Slot *>;
+
+        Slot &slotFor(const CryptoDriver *driver);
+
+        std::mutex m_mutex;
+        std::vector<std::unique_ptr<Slot>> m_slots;
+        std::vector<std::unique_ptr<const Table>> m_tables;
+        std::atomic<const Table *> m_table{nullptr};
+        std::atomic<MetricsClock::rep> m_started{MetricsClock::now().time_since_epoch().count()};
+    };
+
+} // namespace dynamicencrypt::core
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPluginLoader>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QString>
+
+#include <utility>
+
+namespace dynamicencrypt::core
+{
+
+    // Persistent copy of QPluginLoader::metaData() per library, keyed by path and invalidated when the
+    // file's mtime or size changes. A warm cache lets discovery skip opening plugin files altogether.
+    class PluginCache
+    {
+    public:
+        static constexpr int kFormatVersion = 1;
+
+        explicit PluginCache(QString filePath = defaultFilePath())
+            : m_filePath(std::move(filePath))
+        {
+        }
+
+        static QString defaultFilePath()
+        {
+            return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+                .filePath(QStringLiteral("plugin-cache.json"));
+        }
+
+        const QString &filePath() const noexcept { return m_filePath; }
+
+        void setFilePath(QString filePath)
+        {
+            m_filePath = std::move(filePath);
+            m_entries.clear();
+            m_loaded = false;
+            m_dirty = false;
+            m_misses = 0;
+        }
+
+        // Returns the loader metadata for the library, reading the file only on a cache miss.
+        QJsonObject metaData(const QFileInfo &library)
+        {
+            ensureLoaded();
+            const QString path = library.absoluteFilePath();
+            const qint64 modified = library.lastModified().toMSecsSinceEpoch();
+            const qint64 size = library.size();
+            const auto it = m_entries.constFind(path);
+            if (it != m_entries.cend() && it->modified == modified && it->size == size)
+            {
+                return it->metaData;
+            }
+            ++m_misses;
+            Entry entry{modified, size, QPluginLoader(path).metaData()};
+            m_entries.insert(path, entry);
+            m_dirty = true;
+            return entry.metaData;
+        }
+
+        // Libraries whose metadata had to be read from disk since the cache file was last set.
+        int misses() const noexcept { return m_misses; }
+
+        // Writes the cache back if anything changed, dropping entries for files that no longer exist.
+        // A cache that cannot be written only costs the next startup a rescan, so failures are ignored.
+        void save()
+        {
+            if (!m_dirty || m_filePath.isEmpty())
+            {
+                return;
+            }
+            QJsonArray plugins;
+            for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+            {
+                if (!QFileInfo::exists(it.key()))
+                {
+                    continue;
+                }
+                plugins.append(QJsonObject{{QStringLiteral("path"), it.key()},
+                                           {QStringLiteral("modified"), QString::number(it->modified)},
+                                           {QStringLiteral("size"), QString::number(it->size)},
+                                           {QStringLiteral("metaData"), it->metaData}});
+            }
+            const QJsonObject root{{QStringLiteral("version"), kFormatVersion}, {QStringLiteral("plugins"), plugins}};
+
+            QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+            QSaveFile file(m_filePath);
+            if (file.open(QIODevice::WriteOnly) && file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) >= 0 &&
+                file.commit())
+            {
+                m_dirty = false;
+            }
+        }
+
+    private:
+        struct Entry
+        {
+            qint64 modified{0};
+            qint64 size{0};
+            QJsonObject metaData;
+        };
+
+        void ensureLoaded()
+        {
+            if (m_loaded)
+            {
+                return;
+            }
+            m_loaded = true;
+            QFile file(m_filePath);
+            if (m_filePath.isEmpty() || !file.open(QIODevice::ReadOnly))
+            {
+                return;
+            }
+            const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+            if (root.value(QStringLiteral("version")).toInt() != kFormatVersion)
+            {
+                return;
+            }
+            for (const QJsonValue &value : root.value(QStringLiteral("plugins")).toArray())
+            {
+                const QJsonObject plugin = value.toObject();
+                m_entries.insert(plugin.value(QStringLiteral("path")).toString(),
+                                 Entry{plugin.value(QStringLiteral("modified")).toString().toLongLong(),
+                                       plugin.value(QStringLiteral("size")).toString().toLongLong(),
+                                       plugin.value(QStringLiteral("metaData")).toObject()});
+            }
+        }
+
+        QString m_filePath;
+        QHash<QString, Entry> m_entries;
+        bool m_loaded{false};
+        bool m_dirty{false};
+        int m_misses{0};
+    };
+
+} // namespace dynamicencrypt::core
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include "CryptoDriver.h"
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+namespace dynamicencrypt::core
+{
+
+    // What a plugin declares about itself in plugin.json, readable without loading the library.
+    struct PluginDescriptor
+    {
+        QString filePath;
+        QString name;
+        QString version;
+        QString description;
+        DriverCapabilities capabilities;
+        // The whole "MetaData" object, for fields not modelled above.
+        QJsonObject metaData;
+
+        bool hasIdentity() const noexcept { return !name.isEmpty(); }
+
+        // True when a QPluginLoader::metaData() object belongs to a CryptoDriver plugin.
+        static bool isCryptoDriver(const QJsonObject &loaderMetaData)
+        {
+            return loaderMetaData.value(QStringLiteral("IID")).toString() == QLatin1String(CryptoDriver_iid);
+        }
+
+        static PluginDescriptor fromMetaData(const QString &filePath, const QJsonObject &loaderMetaData)
+        {
+            PluginDescriptor descriptor;
+            descriptor.filePath = filePath;
+            descriptor.metaData = loaderMetaData.value(QStringLiteral("MetaData")).toObject();
+            descriptor.name = descriptor.metaData.value(QStringLiteral("name")).toString();
+            descriptor.version = descriptor.metaData.value(QStringLiteral("version")).toString();
+            descriptor.description = descriptor.metaData.value(QStringLiteral("description")).toString();
+            descriptor.capabilities = parseCapabilities(descriptor.metaData);
+            return descriptor;
+        }
+
+        // "simd" lists the tiers a plugin was built with, best first; the first one whose "requires"
+        // features the CPU has is the tier the plugin will pick at runtime, and supplies the speed rank.
+        static DriverCapabilities parseCapabilities(const QJsonObject &metaData,
+                                                    const CpuFeatures &cpu = CpuFeatures::current())
+        {
+            DriverCapabilities capabilities;
+            capabilities.threadSafe = metaData.value(QStringLiteral("threadSafe")).toBool();
+            capabilities.streaming = metaData.value(QStringLiteral("streaming")).toBool();
+            capabilities.segments = metaData.value(QStringLiteral("segments")).toBool();
+            capabilities.chunkSize = qMax<qint64>(0, metaData.value(QStringLiteral("chunkSize")).toInteger());
+            capabilities.chunkAlignment = qMax<qint64>(1, metaData.value(QStringLiteral("chunkAlignment")).toInteger(1));
+            capabilities.speedRank = metaData.value(QStringLiteral("speedRank")).toInt();
+            for (const QJsonValue &value : metaData.value(QStringLiteral("capabilities")).toArray())
+            {
+                capabilities.tags << value.toString();
+            }
+            for (const QJsonValue &value : metaData.value(QStringLiteral("simd")).toArray())
+            {
+                const QJsonObject tier = value.toObject();
+                bool runnable = true;
+                for (const QJsonValue &feature : tier.value(QStringLiteral("requires")).toArray())
+                {
+                    runnable = runnable && cpu.has(feature.toString().toStdString());
+                }
+                if (runnable)
+                {
+                    capabilities.simdTier = tier.value(QStringLiteral("tier")).toString();
+                    capabilities.speedRank = tier.value(QStringLiteral("speedRank")).toInt(capabilities.speedRank);
+                    break;
+                }
+            }
+            return capabilities;
+        }
+    };
+
+} // namespace dynamicencrypt::core
@@ -0,0 +1,482 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define DE_ARENA_POSIX 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace dynamicencrypt::core
+{
+
+    // Page-locked memory for secrets. Blocks up to kLargestClass bytes come from power-of-two size
+    // classes carved out of slabs; a slab is a run of locked pages between two inaccessible guard pages
+    // and is excluded from core dumps where the OS allows it. Released blocks are wiped and kept on
+    // their class's free list, so once the pools are warm allocation and release are O(1) and make no
+    // system calls. Each thread keeps a few free blocks per class in front of the pools, so a thread
+    // that allocates and wipes in a loop touches no shared lock or counter. Larger blocks get a
+    // guard-paged mapping of their own, placed so that an overrun faults on the trailing guard page.
+    //
+    // Each block records its owner, so blocks may be released from any thread or module. Locking is
+    // best effort: past RLIMIT_MEMLOCK (or the working-set quota) memory is still used and wiped, and
+    // stats().lockFailures counts the shortfall.
+    class SecureArena
+    {
+    public:
+        static constexpr std::size_t kAlignment = 16;
+        static constexpr std::size_t kSmallestClass = 16;
+        static constexpr std::size_t kLargestClass = 64 << 10;
+
+        struct Stats
+        {
+            std::size_t slabs{0};
+            std::size_t mappedBytes{0};
+            std::size_t lockedBytes{0};
+            std::size_t lockFailures{0};
+            std::size_t liveBlocks{0};
+        };
+
+        // Zero-filled and kAlignment-aligned; throws std::bad_alloc when the OS refuses a mapping.
+        static void *allocate(std::size_t size)
+        {
+            SecureArena &arena = instance();
+            Header *header = nullptr;
+            if (size > kLargestClass)
+            {
+                header = mapDedicated(size);
+            }
+            else
+            {
+                const std::size_t index = classIndex(size);
+                ThreadCache *cache = threadCache();
+                header = cache && cache->counts[index] > 0 ? cache->blocks[index][--cache->counts[index]]
+                                                            : arena.m_pools[index].take();
+            }
+            arena.countLive(1);
+            return header + 1;
+        }
+
+        // Wipes the block and returns it to the arena; null is ignored.
+        static void release(void *block) noexcept
+        {
+            if (block)
+            {
+                wipe(block, headerOf(block)->size);
+                releaseWiped(block);
+            }
+        }
+
+        // For callers that have already wiped the whole block, e.g. to report the zeroed bytes first.
+        static void releaseWiped(void *block) noexcept
+        {
+            if (!block)
+            {
+                return;
+            }
+            Header *header = headerOf(block);
+            SecureArena &arena = instance();
+            arena.countLive(-1);
+            if (!header->pool)
+            {
+                unmapDedicated(header);
+                return;
+            }
+            // Blocks from another module's arena go straight back to their own pool.
+            const std::size_t index = classIndex(header->size);
+            ThreadCache *cache = threadCache();
+            if (cache && header->pool == &arena.m_pools[index] && cache->counts[index] < ThreadCache::kDepth)
+            {
+                cache->blocks[index][cache->counts[index]++] = header;
+                return;
+            }
+            header->pool->give(header);
+        }
+
+        // Usable bytes of a block, at least the size it was allocated with.
+        static std::size_t capacity(const void *block) noexcept { return headerOf(block)->size; }
+
+        // Zeroes memory in a way the optimizer may not drop as a dead store.
+        static void wipe(void *data, std::size_t size) noexcept
+        {
+            if (size == 0)
+            {
+                return;
+            }
+#if defined(_WIN32)
+            SecureZeroMemory(data, size);
+#elif defined(__GNUC__) || defined(__clang__)
+            std::memset(data, 0, size);
+            __asm__ __volatile__("" : : "r"(data) : "memory");
+#else
+            volatile unsigned char *bytes = static_cast<unsigned char *>(data);
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                bytes[i] = 0;
+            }
+#endif
+        }
+
+        static Stats stats()
+        {
+            SecureArena &arena = instance();
+            Stats stats;
+            stats.slabs = arena.m_slabs.load(std::memory_order_relaxed);
+            stats.mappedBytes = arena.m_mappedBytes.load(std::memory_order_relaxed);
+            stats.lockedBytes = arena.m_lockedBytes.load(std::memory_order_relaxed);
+            stats.lockFailures = arena.m_lockFailures.load(std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(arena.m_cachesMutex);
+            std::ptrdiff_t live = arena.m_retiredLive.load(std::memory_order_relaxed);
+            for (const ThreadCache *cache : arena.m_caches)
+            {
+                live += cache->live.load(std::memory_order_relaxed);
+            }
+            stats.liveBlocks = static_cast<std::size_t>(live);
+            return stats;
+        }
+
+    private:
+        static constexpr std::size_t kClassCount = 13; // 16, 32, ... 64 KiB
+        static constexpr std::size_t kSlabPages = 16;
+        static constexpr std::size_t kMinBlocksPerSlab = 4;
+
+        class Pool;
+
+        struct alignas(kAlignment) Header
+        {
+            Pool *pool{nullptr};        // owning size class; null for a dedicated mapping
+            Header *nextFree{nullptr};  // free-list link while the block is pooled
+            std::size_t size{0};        // usable bytes
+            std::size_t mappingSize{0}; // dedicated mappings only, guard pages included
+            bool locked{false};         // dedicated mappings only
+        };
+
+        static_assert(sizeof(Header) % kAlignment == 0, "blocks must stay aligned after their header");
+
+        // The payload of a block on a free list is all zeroes; the link lives in the header.
+        class Pool
+        {
+        public:
+            void setBlockSize(std::size_t size) noexcept { m_blockSize = size; }
+
+            Header *take()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_free)
+                {
+                    grow();
+                }
+                Header *header = m_free;
+                m_free = header->nextFree;
+                header->nextFree = nullptr;
+                return header;
+            }
+
+            void give(Header *header) noexcept
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                header->nextFree = m_free;
+                m_free = header;
+            }
+
+        private:
+            void grow()
+            {
+                const std::size_t stride = sizeof(Header) + m_blockSize;
+                const std::size_t bodySize = std::max(kSlabPages * pageSize(), roundUp(kMinBlocksPerSlab * stride, pageSize()));
+                bool locked = false;
+                auto *body = static_cast<unsigned char *>(mapRegion(bodySize, locked));
+                instance().m_slabs.fetch_add(1, std::memory_order_relaxed);
+                for (std::size_t offset = 0; offset + stride <= bodySize; offset += stride)
+                {
+                    auto *header = new (body + offset) Header;
+                    header->pool = this;
+                    header->size = m_blockSize;
+                    header->nextFree = m_free;
+                    m_free = header;
+                }
+            }
+
+            std::mutex m_mutex;
+            Header *m_free{nullptr};
+            std::size_t m_blockSize{0};
+        };
+
+        // A thread's free blocks per class and its share of the live block count. Only the owning thread
+        // writes them; on thread exit the blocks go back to their pools and the count is retired.
+        struct ThreadCache
+        {
+            static constexpr std::size_t kDepth = 16;
+
+            Header *blocks[kClassCount][kDepth]{};
+            std::size_t counts[kClassCount]{};
+            std::atomic<std::ptrdiff_t> live{0};
+
+            ThreadCache()
+            {
+                SecureArena &arena = instance();
+                std::lock_guard<std::mutex> lock(arena.m_cachesMutex);
+                arena.m_caches.push_back(this);
+            }
+
+            ~ThreadCache()
+            {
+                SecureArena &arena = instance();
+                for (std::size_t index = 0; index < kClassCount; ++index)
+                {
+                    for (std::size_t i = 0; i < counts[index]; ++i)
+                    {
+                        arena.m_pools[index].give(blocks[index][i]);
+                    }
+                }
+                std::lock_guard<std::mutex> lock(arena.m_cachesMutex);
+                arena.m_retiredLive.fetch_add(live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                std::erase(arena.m_caches, this);
+                t_cacheDestroyed = true;
+            }
+        };
+
+        // Null once the thread's cache is gone, e.g. for other thread_local destructors run after it.
+        static ThreadCache *threadCache() noexcept
+        {
+            if (t_cacheDestroyed)
+            {
+                return nullptr;
+            }
+            thread_local ThreadCache cache;
+            return &cache;
+        }
+
+        void countLive(std::ptrdiff_t delta) noexcept
+        {
+            if (ThreadCache *cache = threadCache())
+            {
+                cache->live.store(cache->live.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+            }
+            else
+            {
+                m_retiredLive.fetch_add(delta, std::memory_order_relaxed);
+            }
+        }
+
+        SecureArena()
+        {
+            for (std::size_t i = 0; i < kClassCount; ++i)
+            {
+                m_pools[i].setBlockSize(kSmallestClass << i);
+            }
+        }
+
+        // Never destroyed: blocks may outlive static destruction in the module that created the arena.
+        static SecureArena &instance()
+        {
+            static SecureArena *arena = new SecureArena;
+            return *arena;
+        }
+
+        static std::size_t classIndex(std::size_t size) noexcept
+        {
+            std::size_t index = 0;
+            while ((kSmallestClass << index) < size)
+            {
+                ++index;
+            }
+            return index;
+        }
+
+        static Header *headerOf(const void *block) noexcept
+        {
+            return const_cast<Header *>(static_cast<const Header *>(block) - 1);
+        }
+
+        static std::size_t pageSize() noexcept
+        {
+            static const std::size_t size = []() -> std::size_t
+            {
+#if defined(_WIN32)
+                SYSTEM_INFO info;
+                GetSystemInfo(&info);
+                return info.dwPageSize;
+#elif defined(DE_ARENA_POSIX)
+                return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#else
+                return 4096;
+#endif
+            }();
+            return size;
+        }
+
+        static std::size_t roundUp(std::size_t size, std::size_t multiple) noexcept
+        {
+            return (size + multiple - 1) / multiple * multiple;
+        }
+
+        // Maps bodySize bytes (a multiple of the page size) between two guard pages and returns the body.
+        static void *mapRegion(std::size_t bodySize, bool &locked)
+        {
+            const std::size_t page = pageSize();
+            const std::size_t total = bodySize + 2 * page;
+            SecureArena &arena = instance();
+#if defined(_WIN32)
+            auto *base = static_cast<unsigned char *>(VirtualAlloc(nullptr, total, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+            if (!base)
+            {
+                throw std::bad_alloc();
+            }
+            DWORD previous = 0;
+            VirtualProtect(base, page, PAGE_NOACCESS, &previous);
+            VirtualProtect(base + page + bodySize, page, PAGE_NOACCESS, &previous);
+            locked = VirtualLock(base + page, bodySize) != 0;
+#elif defined(DE_ARENA_POSIX)
+            void *mapping = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapping == MAP_FAILED)
+            {
+                throw std::bad_alloc();
+            }
+            auto *base = static_cast<unsigned char *>(mapping);
+            mprotect(base, page, PROT_NONE);
+            mprotect(base + page + bodySize, page, PROT_NONE);
+            locked = mlock(base + page, bodySize) == 0;
+#if defined(MADV_DONTDUMP)
+            madvise(base + page, bodySize, MADV_DONTDUMP);
+#endif
+#else
+            auto *base = static_cast<unsigned char *>(::operator new(total, std::align_val_t{kAlignment}));
+            std::memset(base, 0, total);
+            locked = false;
+#endif
+            arena.m_mappedBytes.fetch_add(total, std::memory_order_relaxed);
+            if (locked)
+            {
+                arena.m_lockedBytes.fetch_add(bodySize, std::memory_order_relaxed);
+            }
+            else
+            {
+                arena.m_lockFailures.fetch_add(1, std::memory_order_relaxed);
+            }
+            return base + page;
+        }
+
+        static void unmapRegion(void *body, std::size_t bodySize, bool locked) noexcept
+        {
+            const std::size_t page = pageSize();
+            auto *base = static_cast<unsigned char *>(body) - page;
+            SecureArena &arena = instance();
+#if defined(_WIN32)
+            if (locked)
+            {
+                VirtualUnlock(body, bodySize);
+            }
+            VirtualFree(base, 0, MEM_RELEASE);
+#elif defined(DE_ARENA_POSIX)
+            if (locked)
+            {
+                munlock(body, bodySize);
+            }
+            munmap(base, bodySize + 2 * page);
+#else
+            ::operator delete(base, std::align_val_t{kAlignment});
+#endif
+            arena.m_mappedBytes.fetch_sub(bodySize + 2 * page, std::memory_order_relaxed);
+            if (locked)
+            {
+                arena.m_lockedBytes.fetch_sub(bodySize, std::memory_order_relaxed);
+            }
+        }
+
+        // The block ends exactly at the trailing guard page; its header sits just before it.
+        static Header *mapDedicated(std::size_t size)
+        {
+            if (size > std::numeric_limits<std::size_t>::max() / 2)
+            {
+                throw std::bad_alloc();
+            }
+            const std::size_t payload = roundUp(size, kAlignment);
+            const std::size_t bodySize = roundUp(sizeof(Header) + payload, pageSize());
+            bool locked = false;
+            auto *body = static_cast<unsigned char *>(mapRegion(bodySize, locked));
+            auto *header = new (body + bodySize - payload - sizeof(Header)) Header;
+            header->size = payload;
+            header->mappingSize = bodySize;
+            header->locked = locked;
+            return header;
+        }
+
+        static void unmapDedicated(Header *header) noexcept
+        {
+            auto *end = reinterpret_cast<unsigned char *>(header + 1) + header->size;
+            unmapRegion(end - header->mappingSize, header->mappingSize, header->locked);
+        }
+
+        Pool m_pools[kClassCount];
+        std::atomic<std::size_t> m_slabs{0};
+        std::atomic<std::size_t> m_mappedBytes{0};
+        std::atomic<std::size_t> m_lockedBytes{0};
+        std::atomic<std::size_t> m_lockFailures{0};
+        std::mutex m_cachesMutex;
+        std::vector<const ThreadCache *> m_caches;
+        std::atomic<std::ptrdiff_t> m_retiredLive{0};
+
+        inline static thread_local bool t_cacheDestroyed = false;
+    };
+
+    // Allocator for containers holding secrets, such as key copies and expanded masks.
+    template <typename T>
+    struct SecureAllocator
+    {
+        using value_type = T;
+
+        SecureAllocator() noexcept = default;
+
+        template <typename U>
+        SecureAllocator(const SecureAllocator<U> &) noexcept
+        {
+        }
+
+        T *allocate(std::size_t count)
+        {
+            if (count > std::numeric_limits<std::size_t>::max() / sizeof(T))
+            {
+                throw std::bad_array_new_length();
+            }
+            return static_cast<T *>(SecureArena::allocate(count * sizeof(T)));
+        }
+
+        void deallocate(T *block, std::size_t) noexcept { SecureArena::release(block); }
+
+        template <typename U>
+        bool operator==(const SecureAllocator<U> &) const noexcept
+        {
+            return true;
+        }
+    };
+
+    template <typename T>
+    using SecureVector = std::vector<T, SecureAllocator<T>>;
+
+    // Base for classes holding key material: instances created with new live in the arena and are
+    // wiped when deleted. Stack instances are unaffected and must wipe themselves.
+    struct SecureAllocated
+    {
+        static void *operator new(std::size_t size) { return SecureArena::allocate(size); }
+        static void operator delete(void *block) noexcept { SecureArena::release(block); }
+    };
+
+} // namespace dynamicencrypt::core
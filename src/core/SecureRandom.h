@@ -0,0 +1,120 @@
+#pragma once
+
+#include "SecureArena.h"
+
+#include <QByteArray>
+#include <QRandomGenerator>
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <span>
+
+#if defined(Q_OS_UNIX)
+#include <pthread.h>
+#endif
+
+namespace dynamicencrypt::core
+{
+
+    // Cryptographic randomness for keys and nonces. Each thread refills a private buffer from
+    // QRandomGenerator::system() in one bulk call instead of one system call per byte.
+    //
+    // The buffer lives in the SecureArena. Bytes are wiped from it as they are handed out and the
+    // remainder is wiped when the thread exits. A fork bumps a generation counter so the child
+    // discards the buffer inherited from its parent rather than replaying the same bytes.
+    class SecureRandom
+    {
+    public:
+        static void fill(std::span<std::byte> out)
+        {
+            fill(out.data(), out.size());
+        }
+
+        static void fill(void *out, std::size_t size)
+        {
+            auto *dst = static_cast<unsigned char *>(out);
+            Pool &pool = threadPool();
+            const unsigned generation = forkGeneration().load(std::memory_order_acquire);
+            if (pool.generation != generation)
+            {
+                pool.discard();
+                pool.generation = generation;
+            }
+            while (size > 0)
+            {
+                if (pool.position == kPoolBytes)
+                {
+                    pool.refill();
+                }
+                const std::size_t take = qMin(size, kPoolBytes - pool.position);
+                unsigned char *src = pool.bytes() + pool.position;
+                std::memcpy(dst, src, take);
+                SecureArena::wipe(src, take);
+                pool.position += take;
+                dst += take;
+                size -= take;
+            }
+        }
+
+        static QByteArray bytes(qsizetype size)
+        {
+            QByteArray out(size, Qt::Uninitialized);
+            fill(out.data(), static_cast<std::size_t>(size));
+            return out;
+        }
+
+    private:
+        static constexpr std::size_t kPoolWords = 1024;
+        static constexpr std::size_t kPoolBytes = kPoolWords * sizeof(quint32);
+
+        struct Pool
+        {
+            quint32 *words{static_cast<quint32 *>(SecureArena::allocate(kPoolBytes))};
+            std::size_t position{kPoolBytes};
+            unsigned generation{0};
+
+            Pool() = default;
+            Pool(const Pool &) = delete;
+            Pool &operator=(const Pool &) = delete;
+
+            unsigned char *bytes() noexcept { return reinterpret_cast<unsigned char *>(words); }
+
+            void refill()
+            {
+                QRandomGenerator::system()->fillRange(words, static_cast<qsizetype>(kPoolWords));
+                position = 0;
+            }
+
+            void discard() noexcept
+            {
+                SecureArena::wipe(words, kPoolBytes);
+                position = kPoolBytes;
+            }
+
+            ~Pool() { SecureArena::release(words); }
+        };
+
+        static Pool &threadPool()
+        {
+            thread_local Pool pool;
+            return pool;
+        }
+
+        static std::atomic<unsigned> &forkGeneration()
+        {
+            static std::atomic<unsigned> generation{0};
+#if defined(Q_OS_UNIX)
+            static const bool registered = []()
+            {
+                pthread_atfork(nullptr, nullptr, []() { forkGeneration().fetch_add(1, std::memory_order_acq_rel); });
+                return true;
+            }();
+            Q_UNUSED(registered);
+#endif
+            return generation;
+        }
+    };
+
+} // namespace dynamicencrypt::core
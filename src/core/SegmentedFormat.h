@@ -0,0 +1,125 @@
+#pragma once
+
+#include <QByteArray>
+#include <QtEndian>
+#include <QtGlobal>
+
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+
+namespace dynamicencrypt::core
+{
+
+    // Header of a segmented vault blob:
+    //   "DESG" | u8 version | u8 nonceSize | u16 segmentOverhead | u32 segmentSize | u64 plaintextSize | base nonce
+    // followed by max(1, ceil(plaintextSize / segmentSize)) segments, each its plaintext length + segmentOverhead
+    // bytes. Segment i is sealed under deriveNonce(i), so any segment can be processed on its own. As in the
+    // STREAM construction, the last segment's nonce also carries a final flag: a blob cut back to a segment
+    // boundary, with plaintextSize lowered to match, then ends in a segment that fails authentication.
+    struct SegmentedHeader
+    {
+        static constexpr char kMagic[4] = {'D', 'E', 'S', 'G'};
+        // Version 1 had no final flag, so it is not read: rewriting a header's version would bring truncation back.
+        static constexpr quint8 kVersion = 2;
+        static constexpr qsizetype kFixedSize = 20;
+
+        quint32 segmentSize{0};
+        quint16 segmentOverhead{0};
+        quint64 plaintextSize{0};
+        QByteArray baseNonce;
+
+        qsizetype encodedSize() const noexcept { return kFixedSize + baseNonce.size(); }
+
+        // An empty plaintext still gets one empty final segment, so its blob cannot be forged from a header alone.
+        qint64 segmentCount() const noexcept
+        {
+            if (segmentSize == 0)
+            {
+                return 0;
+            }
+            return qMax<qint64>(1, static_cast<qint64>((plaintextSize + segmentSize - 1) / segmentSize));
+        }
+
+        qint64 ciphertextSize() const noexcept
+        {
+            return encodedSize() + static_cast<qint64>(plaintextSize) + segmentCount() * segmentOverhead;
+        }
+
+        // Plaintext [offset, offset + length) of segment index.
+        qint64 plainOffset(qint64 index) const noexcept { return index * static_cast<qint64>(segmentSize); }
+        qint64 plainLength(qint64 index) const noexcept
+        {
+            return qMin<qint64>(segmentSize, static_cast<qint64>(plaintextSize) - plainOffset(index));
+        }
+        qint64 cipherOffset(qint64 index) const noexcept
+        {
+            return encodedSize() + index * (static_cast<qint64>(segmentSize) + segmentOverhead);
+        }
+
+        // The base nonce with the final flag folded into its last byte, for the last segment only, and the
+        // big-endian segment index into the bytes before it.
+        QByteArray deriveNonce(qint64 index) const
+        {
+            QByteArray nonce = baseNonce;
+            if (nonce.isEmpty())
+            {
+                return nonce;
+            }
+            const qsizetype last = nonce.size() - 1;
+            if (index == segmentCount() - 1)
+            {
+                nonce[last] = static_cast<char>(nonce.at(last) ^ 0x01);
+            }
+            const quint64 counter = static_cast<quint64>(index);
+            const qsizetype width = qMin<qsizetype>(8, last);
+            for (qsizetype i = 0; i < width; ++i)
+            {
+                nonce[last - 1 - i] = static_cast<char>(nonce.at(last - 1 - i) ^ static_cast<char>(counter >> (8 * i)));
+            }
+            return nonce;
+        }
+
+        void write(std::span<std::byte> out) const
+        {
+            if (out.size() < static_cast<std::size_t>(encodedSize()))
+            {
+                throw std::length_error("output buffer too small for segmented header");
+            }
+            auto *ptr = reinterpret_cast<uchar *>(out.data());
+            std::memcpy(ptr, kMagic, sizeof(kMagic));
+            ptr[4] = kVersion;
+            ptr[5] = static_cast<uchar>(baseNonce.size());
+            qToLittleEndian<quint16>(segmentOverhead, ptr + 6);
+            qToLittleEndian<quint32>(segmentSize, ptr + 8);
+            qToLittleEndian<quint64>(plaintextSize, ptr + 12);
+            std::memcpy(ptr + kFixedSize, baseNonce.constData(), static_cast<std::size_t>(baseNonce.size()));
+        }
+
+        static SegmentedHeader read(std::span<const std::byte> in)
+        {
+            const auto *ptr = reinterpret_cast<const uchar *>(in.data());
+            if (in.size() < static_cast<std::size_t>(kFixedSize) || std::memcmp(ptr, kMagic, sizeof(kMagic)) != 0)
+            {
+                throw std::invalid_argument("not a segmented vault blob");
+            }
+            if (ptr[4] != kVersion)
+            {
+                throw std::invalid_argument("unsupported segmented vault version");
+            }
+            SegmentedHeader header;
+            const qsizetype nonceSize = ptr[5];
+            header.segmentOverhead = qFromLittleEndian<quint16>(ptr + 6);
+            header.segmentSize = qFromLittleEndian<quint32>(ptr + 8);
+            header.plaintextSize = qFromLittleEndian<quint64>(ptr + 12);
+            if (header.segmentSize == 0 || in.size() < static_cast<std::size_t>(kFixedSize + nonceSize))
+            {
+                throw std::invalid_argument("corrupt segmented vault header");
+            }
+            header.baseNonce = QByteArray(reinterpret_cast<const char *>(ptr + kFixedSize), nonceSize);
+            return header;
+        }
+    };
+
+} // namespace dynamicencrypt::core
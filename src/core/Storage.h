@@ -1,21 +1,93 @@
 #pragma once
 
+#include "Metrics.h"
+
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QRandomGenerator>
 #include <QSaveFile>
 #include <QString>
 #include <QtGlobal>
 
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
 #include <stdexcept>
+#include <system_error>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <io.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace dynamicencrypt::core
 {
 
+    // Read-only memory mapping of a file; the view stays valid for the lifetime of the object.
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const QString &path)
+            : m_file(std::make_unique<QFile>(path))
+        {
+            if (!m_file->open(QIODevice::ReadOnly))
+            {
+                throw std::runtime_error(QStringLiteral("Failed to open path for reading: %1").arg(path).toStdString());
+            }
+            m_size = m_file->size();
+            if (m_size > 0)
+            {
+                m_data = m_file->map(0, m_size);
+                if (!m_data)
+                {
+                    throw std::runtime_error(QStringLiteral("Failed to map %1: %2").arg(path, m_file->errorString()).toStdString());
+                }
+            }
+        }
+
+        MappedFile(MappedFile &&) noexcept = default;
+        MappedFile &operator=(MappedFile &&) noexcept = default;
+
+        ~MappedFile()
+        {
+            if (m_file && m_data)
+            {
+                m_file->unmap(m_data);
+            }
+        }
+
+        std::span<const std::byte> bytes() const noexcept
+        {
+            return {reinterpret_cast<const std::byte *>(m_data), static_cast<std::size_t>(m_size)};
+        }
+
+        qint64 size() const noexcept { return m_size; }
+
+    private:
+        std::unique_ptr<QFile> m_file;
+        uchar *m_data{nullptr};
+        qint64 m_size{0};
+    };
+
+    // Every call is counted in io(); storeMapped() leaves the time spent in its fill callback out.
     class Storage
     {
     public:
         void store(const QString &path, const QByteArray &blob)
         {
+            const auto started = MetricsClock::now();
             QSaveFile file(path);
             if (!file.open(QIODevice::WriteOnly))
             {
@@ -29,10 +101,12 @@ namespace dynamicencrypt::core
             {
                 throw std::runtime_error("Failed to commit save file atomically");
             }
+            m_io.recordWrite(blob.size(), nanosSince(started));
         }
 
         void store(QFile *file, const QByteArray &blob)
         {
+            const auto started = MetricsClock::now();
             if (!file)
             {
                 throw std::invalid_argument("QFile pointer is null");
@@ -46,17 +120,161 @@ namespace dynamicencrypt::core
                 throw std::runtime_error("Failed to write blob via QFile");
             }
             file->flush();
+            m_io.recordWrite(blob.size(), nanosSince(started));
         }
 
         QByteArray load(const QString &path)
         {
+            const auto started = MetricsClock::now();
             QFile file(path);
             if (!file.open(QIODevice::ReadOnly))
             {
                 throw std::runtime_error(QStringLiteral("Failed to open path for reading: %1").arg(path).toStdString());
             }
-            return file.readAll();
+            QByteArray bytes = file.readAll();
+            m_io.recordRead(bytes.size(), nanosSince(started));
+            return bytes;
+        }
+
+        // Counts the whole file as read, though pages are only faulted in as the mapping is touched.
+        MappedFile map(const QString &path)
+        {
+            const auto started = MetricsClock::now();
+            MappedFile mapped(path);
+            m_io.recordRead(mapped.size(), nanosSince(started));
+            return mapped;
+        }
+
+        // Pre-sizes a temporary file next to path, lets fill write straight into its mapping, syncs it to
+        // disk and atomically renames it over path. Like QSaveFile, the result keeps the permissions of
+        // the file it replaces, or gets the umask-filtered defaults of a new file. Nothing is left behind
+        // if fill throws.
+        void storeMapped(const QString &path, qint64 size, const std::function<void(std::span<std::byte>)> &fill)
+        {
+            const auto started = MetricsClock::now();
+            qint64 fillNanos = 0;
+            const QFileInfo target(path);
+            QFile file;
+            openTemporarySibling(file, target);
+            // Removes the temporary file unless it was renamed over path.
+            struct Discard
+            {
+                QFile &file;
+                bool committed{false};
+                ~Discard()
+                {
+                    if (!committed)
+                    {
+                        file.remove();
+                    }
+                }
+            } discard{file};
+
+            if (target.exists() && !file.setPermissions(target.permissions()))
+            {
+                throw std::runtime_error("Failed to copy permissions to mapped output");
+            }
+            if (size > 0)
+            {
+                if (!file.resize(size))
+                {
+                    throw std::runtime_error("Failed to pre-size mapped output");
+                }
+                uchar *data = file.map(0, size);
+                if (!data)
+                {
+                    throw std::runtime_error(QStringLiteral("Failed to map output: %1").arg(file.errorString()).toStdString());
+                }
+                const auto filling = MetricsClock::now();
+                try
+                {
+                    fill({reinterpret_cast<std::byte *>(data), static_cast<std::size_t>(size)});
+                }
+                catch (...)
+                {
+                    file.unmap(data);
+                    throw;
+                }
+                fillNanos = nanosSince(filling);
+                const bool flushed = flushMapping(data, size);
+                file.unmap(data);
+                if (!flushed)
+                {
+                    throw std::runtime_error("Failed to flush mapped output");
+                }
+            }
+            else
+            {
+                fill({});
+            }
+            if (!syncFile(file))
+            {
+                throw std::runtime_error("Failed to sync mapped output to disk");
+            }
+            file.close();
+
+            std::error_code error;
+            std::filesystem::rename(std::filesystem::path(file.fileName().toStdU16String()),
+                                    std::filesystem::path(target.absoluteFilePath().toStdU16String()), error);
+            if (error)
+            {
+                throw std::runtime_error("Failed to commit mapped file atomically: " + error.message());
+            }
+            discard.committed = true;
+            m_io.recordWrite(size, nanosSince(started) - fillNanos);
         }
+
+        IoCounters &io() noexcept { return m_io; }
+        const IoCounters &io() const noexcept { return m_io; }
+
+    private:
+        // A new hidden file next to target, created with the same 0666-less-umask mode QSaveFile uses.
+        static void openTemporarySibling(QFile &file, const QFileInfo &target)
+        {
+            constexpr QFileDevice::Permissions kNewFilePermissions =
+                QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ReadGroup | QFileDevice::WriteGroup |
+                QFileDevice::ReadOther | QFileDevice::WriteOther;
+            const QDir dir = target.absoluteDir();
+            for (int attempt = 0; attempt < 16; ++attempt)
+            {
+                const QString suffix = QString::number(QRandomGenerator::global()->generate64(), 36);
+                file.setFileName(dir.filePath(QStringLiteral(".%1.%2").arg(target.fileName(), suffix)));
+                if (file.open(QIODevice::ReadWrite | QIODevice::NewOnly, kNewFilePermissions))
+                {
+                    return;
+                }
+                if (!file.exists())
+                {
+                    break;
+                }
+            }
+            throw std::runtime_error(QStringLiteral("Failed to open path for writing: %1").arg(target.filePath()).toStdString());
+        }
+
+        static bool flushMapping(uchar *data, qint64 size)
+        {
+#if defined(_WIN32)
+            return FlushViewOfFile(data, static_cast<SIZE_T>(size)) != 0;
+#else
+            return ::msync(data, static_cast<std::size_t>(size), MS_SYNC) == 0;
+#endif
+        }
+
+        // What QSaveFile::commit() does before its rename, so a crash cannot leave a renamed but empty file.
+        static bool syncFile(QFile &file)
+        {
+            if (!file.flush())
+            {
+                return false;
+            }
+#if defined(_WIN32)
+            return FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()))) != 0;
+#else
+            return ::fsync(file.handle()) == 0;
+#endif
+        }
+
+        IoCounters m_io;
     };
 
 } // namespace dynamicencrypt::core
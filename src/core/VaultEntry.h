@@ -14,6 +14,12 @@ namespace dynamicencrypt::core
         QString algorithm;
         QByteArray nonce;
         QDateTime timestamp;
+        // Envelope encryption: the payload's own data key, wrapped by VaultManager::wrapDataKey(). Empty
+        // when the payload was encrypted with the master key directly.
+        QByteArray wrappedKey;
+        // VaultManager::kDigestAlgorithm hash of the stored file as written, checked by VaultScrubber. Empty
+        // for entries recorded before digests.
+        QByteArray digest;
     };
 
 } 
@@ -0,0 +1,625 @@
+#include "VaultIndex.h"
+
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTimeZone>
+#include <QtEndian>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace dynamicencrypt::core
+{
+
+    namespace
+    {
+        // File header: "DEIX" | u32 version | u64 snapshotEnd | u64 snapshotRecords | u32 crc | u32 reserved
+        constexpr char kMagic[4] = {'D', 'E', 'I', 'X'};
+        constexpr quint32 kVersion = 1;
+        constexpr qint64 kFileHeaderSize = 32;
+
+        // Record header: u32 payloadLength | u32 crc | u8 type | 7 reserved | u64 keyHash, then the payload.
+        // The CRC covers everything after itself. Records before snapshotEnd were written by a compaction
+        // committed through QSaveFile and are trusted; appended records are verified on load.
+        constexpr qint64 kRecordHeaderSize = 24;
+        constexpr quint8 kPutRecord = 1;
+        constexpr quint8 kRemoveRecord = 2;
+
+        // Payload fields are u8 tag | u32 length | bytes; unknown tags are skipped so fields can be added.
+        enum FieldTag : quint8
+        {
+            OriginalPathField = 1,
+            StoredPathField = 2,
+            AlgorithmField = 3,
+            NonceField = 4,
+            TimestampField = 5,
+            WrappedKeyField = 6,
+            DigestField = 7,
+        };
+
+        constexpr char kLockSuffix[] = ".lock";
+
+        constexpr qint64 kCompactionMinDead = 4096;
+        // Appended records are CRC-checked on every open; fold them into the snapshot past this many.
+        constexpr qint64 kCompactionMaxTail = 65536;
+
+        constexpr std::array<quint32, 256> makeCrcTable()
+        {
+            std::array<quint32, 256> table{};
+            for (quint32 i = 0; i < 256; ++i)
+            {
+                quint32 crc = i;
+                for (int bit = 0; bit < 8; ++bit)
+                {
+                    crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+                }
+                table[i] = crc;
+            }
+            return table;
+        }
+
+        constexpr std::array<quint32, 256> kCrcTable = makeCrcTable();
+
+        quint32 crc32(const uchar *data, qint64 size)
+        {
+            quint32 crc = 0xFFFFFFFFu;
+            for (qint64 i = 0; i < size; ++i)
+            {
+                crc = kCrcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+            return crc ^ 0xFFFFFFFFu;
+        }
+
+        // FNV-1a over the UTF-8 path; stable across runs and Qt versions, unlike qHash.
+        quint64 keyHashOf(const QString &storedPath)
+        {
+            const QByteArray utf8 = storedPath.toUtf8();
+            quint64 hash = 14695981039346656037ull;
+            for (const char c : utf8)
+            {
+                hash ^= static_cast<uchar>(c);
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        void appendField(QByteArray &payload, FieldTag tag, const QByteArray &value)
+        {
+            uchar header[5];
+            header[0] = tag;
+            qToLittleEndian<quint32>(static_cast<quint32>(value.size()), header + 1);
+            payload.append(reinterpret_cast<const char *>(header), sizeof(header));
+            payload.append(value);
+        }
+
+        QByteArray encodePayload(const VaultEntry &entry)
+        {
+            QByteArray payload;
+            appendField(payload, OriginalPathField, entry.originalPath.toUtf8());
+            appendField(payload, StoredPathField, entry.storedPath.toUtf8());
+            appendField(payload, AlgorithmField, entry.algorithm.toUtf8());
+            appendField(payload, NonceField, entry.nonce);
+            QByteArray timestamp(8, Qt::Uninitialized);
+            const qint64 msecs = entry.timestamp.isValid() ? entry.timestamp.toMSecsSinceEpoch()
+                                                           : std::numeric_limits<qint64>::min();
+            qToLittleEndian<qint64>(msecs, timestamp.data());
+            appendField(payload, TimestampField, timestamp);
+            if (!entry.wrappedKey.isEmpty())
+            {
+                appendField(payload, WrappedKeyField, entry.wrappedKey);
+            }
+            if (!entry.digest.isEmpty())
+            {
+                appendField(payload, DigestField, entry.digest);
+            }
+            return payload;
+        }
+
+        QByteArray encodeRecord(quint8 type, quint64 keyHash, const QByteArray &payload)
+        {
+            QByteArray record(kRecordHeaderSize, '\0');
+            auto *header = reinterpret_cast<uchar *>(record.data());
+            qToLittleEndian<quint32>(static_cast<quint32>(payload.size()), header);
+            header[8] = type;
+            qToLittleEndian<quint64>(keyHash, header + 16);
+            record.append(payload);
+            const auto *bytes = reinterpret_cast<const uchar *>(record.constData());
+            qToLittleEndian<quint32>(crc32(bytes + 8, record.size() - 8), reinterpret_cast<uchar *>(record.data()) + 4);
+            return record;
+        }
+
+        QByteArray encodeFileHeader(qint64 snapshotEnd, qint64 snapshotRecords)
+        {
+            QByteArray header(kFileHeaderSize, '\0');
+            auto *bytes = reinterpret_cast<uchar *>(header.data());
+            std::memcpy(bytes, kMagic, sizeof(kMagic));
+            qToLittleEndian<quint32>(kVersion, bytes + 4);
+            qToLittleEndian<quint64>(static_cast<quint64>(snapshotEnd), bytes + 8);
+            qToLittleEndian<quint64>(static_cast<quint64>(snapshotRecords), bytes + 16);
+            qToLittleEndian<quint32>(crc32(bytes, 24), bytes + 24);
+            return header;
+        }
+
+        // Calls visit(tag, data, size) for each payload field; stops quietly at a malformed field.
+        template <typename Visitor>
+        void forEachField(const uchar *payload, quint32 size, Visitor &&visit)
+        {
+            quint32 offset = 0;
+            while (size - offset >= 5)
+            {
+                const quint8 tag = payload[offset];
+                const quint32 length = qFromLittleEndian<quint32>(payload + offset + 1);
+                offset += 5;
+                if (length > size - offset)
+                {
+                    return;
+                }
+                if (!visit(tag, payload + offset, length))
+                {
+                    return;
+                }
+                offset += length;
+            }
+        }
+
+        QString utf8Field(const uchar *data, quint32 size)
+        {
+            return QString::fromUtf8(reinterpret_cast<const char *>(data), static_cast<qsizetype>(size));
+        }
+    }
+
+    VaultIndex::~VaultIndex()
+    {
+        releaseFile();
+    }
+
+    QString VaultIndex::lockPath(const QString &indexPath)
+    {
+        return indexPath + QLatin1String(kLockSuffix);
+    }
+
+    void VaultIndex::open(const QString &path)
+    {
+        close();
+        m_path = path;
+        m_lock = std::make_unique<QLockFile>(lockPath(path));
+        // Held for the whole session, so only an owner that is no longer running makes it stale.
+        m_lock->setStaleLockTime(0);
+        if (!m_lock->tryLock(0))
+        {
+            m_lock.reset();
+            m_readOnly = true;
+        }
+        try
+        {
+            load(!m_readOnly);
+        }
+        catch (...)
+        {
+            close();
+            throw;
+        }
+        maybeCompact();
+    }
+
+    void VaultIndex::close()
+    {
+        releaseFile();
+        m_lock.reset();
+        m_readOnly = false;
+        m_path.clear();
+        m_live.clear();
+        m_positions.clear();
+        m_pending.clear();
+        m_deadRecords = 0;
+        m_tailRecords = 0;
+    }
+
+    void VaultIndex::releaseFile() noexcept
+    {
+        m_log.reset();
+        if (m_mapFile && m_map)
+        {
+            m_mapFile->unmap(const_cast<uchar *>(m_map));
+        }
+        m_map = nullptr;
+        m_mapSize = 0;
+        m_mapFile.reset();
+    }
+
+    void VaultIndex::load(bool writable)
+    {
+        if (QFileInfo(m_path).size() == 0)
+        {
+            if (!writable)
+            {
+                return;
+            }
+            QSaveFile fresh(m_path);
+            if (!fresh.open(QIODevice::WriteOnly) || fresh.write(encodeFileHeader(kFileHeaderSize, 0)) != kFileHeaderSize ||
+                !fresh.commit())
+            {
+                throw std::runtime_error(QStringLiteral("Failed to create vault index: %1").arg(m_path).toStdString());
+            }
+        }
+
+        auto mapWhole = [this]()
+        {
+            m_mapFile = std::make_unique<QFile>(m_path);
+            if (!m_mapFile->open(QIODevice::ReadOnly))
+            {
+                throw std::runtime_error(QStringLiteral("Failed to open vault index: %1").arg(m_path).toStdString());
+            }
+            m_mapSize = m_mapFile->size();
+            m_map = m_mapSize > 0 ? m_mapFile->map(0, m_mapSize) : nullptr;
+            if (!m_map)
+            {
+                throw std::runtime_error(QStringLiteral("Failed to map vault index: %1").arg(m_path).toStdString());
+            }
+        };
+        mapWhole();
+
+        if (m_mapSize < kFileHeaderSize || std::memcmp(m_map, kMagic, sizeof(kMagic)) != 0 ||
+            qFromLittleEndian<quint32>(m_map + 4) != kVersion || qFromLittleEndian<quint32>(m_map + 24) != crc32(m_map, 24))
+        {
+            throw std::runtime_error(QStringLiteral("Not a vault index: %1").arg(m_path).toStdString());
+        }
+        const qint64 snapshotEnd = static_cast<qint64>(qFromLittleEndian<quint64>(m_map + 8));
+        if (snapshotEnd < kFileHeaderSize || snapshotEnd > m_mapSize)
+        {
+            throw std::runtime_error(QStringLiteral("Corrupt vault index header: %1").arg(m_path).toStdString());
+        }
+
+        qint64 offset = kFileHeaderSize;
+        while (offset + kRecordHeaderSize <= m_mapSize)
+        {
+            const uchar *record = m_map + offset;
+            const quint32 length = qFromLittleEndian<quint32>(record);
+            const qint64 end = offset + kRecordHeaderSize + length;
+            if (end > m_mapSize)
+            {
+                break;
+            }
+            if (offset >= snapshotEnd && crc32(record + 8, end - offset - 8) != qFromLittleEndian<quint32>(record + 4))
+            {
+                break;
+            }
+
+            const quint8 type = record[8];
+            const quint64 keyHash = qFromLittleEndian<quint64>(record + 16);
+            const Slot slot{offset, -1, keyHash};
+            // Paths are only decoded when hashes meet, so a load touches record headers alone.
+            const qsizetype existing = m_positions.count(keyHash) != 0 ? findSlot(keyHash, decodeStoredPath(slot)) : -1;
+            if (offset >= snapshotEnd)
+            {
+                ++m_tailRecords;
+            }
+            if (type == kPutRecord)
+            {
+                if (existing >= 0)
+                {
+                    m_live[existing] = slot;
+                    ++m_deadRecords;
+                }
+                else
+                {
+                    m_positions.emplace(keyHash, size());
+                    m_live.push_back(slot);
+                }
+            }
+            else if (type == kRemoveRecord)
+            {
+                if (existing >= 0)
+                {
+                    erasePosition(existing);
+                    ++m_deadRecords;
+                }
+                ++m_deadRecords;
+            }
+            offset = end;
+        }
+
+        if (!writable)
+        {
+            // The tail past offset may be an append the lock holder has not finished; leave it alone.
+            return;
+        }
+        if (offset < m_mapSize)
+        {
+            // Torn or corrupt tail from an interrupted append: cut it so new records follow a clean boundary.
+            releaseFile();
+            if (!QFile::resize(m_path, offset))
+            {
+                throw std::runtime_error(QStringLiteral("Failed to truncate vault index: %1").arg(m_path).toStdString());
+            }
+            mapWhole();
+        }
+
+        m_log = std::make_unique<QFile>(m_path);
+        if (!m_log->open(QIODevice::WriteOnly | QIODevice::Append))
+        {
+            m_log.reset();
+            throw std::runtime_error(QStringLiteral("Failed to open vault index for append: %1").arg(m_path).toStdString());
+        }
+    }
+
+    VaultEntry VaultIndex::entryAt(qsizetype position) const
+    {
+        if (position < 0 || position >= size())
+        {
+            throw std::out_of_range("vault index position out of range");
+        }
+        return decode(m_live[static_cast<std::size_t>(position)]);
+    }
+
+    QString VaultIndex::storedPathAt(qsizetype position) const
+    {
+        if (position < 0 || position >= size())
+        {
+            throw std::out_of_range("vault index position out of range");
+        }
+        return decodeStoredPath(m_live[static_cast<std::size_t>(position)]);
+    }
+
+    qsizetype VaultIndex::indexOf(const QString &storedPath) const
+    {
+        return findSlot(keyHashOf(storedPath), storedPath);
+    }
+
+    VaultIndex::PutResult VaultIndex::put(const VaultEntry &entry)
+    {
+        const quint64 keyHash = keyHashOf(entry.storedPath);
+        if (m_log)
+        {
+            appendRecord(encodeRecord(kPutRecord, keyHash, encodePayload(entry)));
+            ++m_tailRecords;
+        }
+        const PutResult result = place(entry, keyHash);
+        maybeCompact();
+        return result;
+    }
+
+    std::vector<VaultIndex::PutResult> VaultIndex::put(const std::vector<VaultEntry> &entries)
+    {
+        std::vector<quint64> keyHashes;
+        keyHashes.reserve(entries.size());
+        for (const VaultEntry &entry : entries)
+        {
+            keyHashes.push_back(keyHashOf(entry.storedPath));
+        }
+        if (m_log)
+        {
+            QByteArray records;
+            for (std::size_t i = 0; i < entries.size(); ++i)
+            {
+                records += encodeRecord(kPutRecord, keyHashes[i], encodePayload(entries[i]));
+            }
+            appendRecord(records);
+            m_tailRecords += static_cast<qint64>(entries.size());
+        }
+        std::vector<PutResult> results;
+        results.reserve(entries.size());
+        for (std::size_t i = 0; i < entries.size(); ++i)
+        {
+            results.push_back(place(entries[i], keyHashes[i]));
+        }
+        maybeCompact();
+        return results;
+    }
+
+    VaultIndex::PutResult VaultIndex::place(const VaultEntry &entry, quint64 keyHash)
+    {
+        m_pending.push_back(entry);
+        const Slot slot{-1, static_cast<qsizetype>(m_pending.size()) - 1, keyHash};
+
+        const qsizetype existing = findSlot(keyHash, entry.storedPath);
+        if (existing >= 0)
+        {
+            m_live[static_cast<std::size_t>(existing)] = slot;
+            ++m_deadRecords;
+            return {existing, true};
+        }
+        m_positions.emplace(keyHash, size());
+        m_live.push_back(slot);
+        return {size() - 1, false};
+    }
+
+    qsizetype VaultIndex::remove(const QString &storedPath)
+    {
+        const quint64 keyHash = keyHashOf(storedPath);
+        const qsizetype existing = findSlot(keyHash, storedPath);
+        if (existing < 0)
+        {
+            return -1;
+        }
+        if (m_log)
+        {
+            QByteArray payload;
+            appendField(payload, StoredPathField, storedPath.toUtf8());
+            appendRecord(encodeRecord(kRemoveRecord, keyHash, payload));
+            ++m_tailRecords;
+        }
+        erasePosition(existing);
+        m_deadRecords += 2;
+        maybeCompact();
+        return existing;
+    }
+
+    void VaultIndex::compact()
+    {
+        if (!isOpen())
+        {
+            return;
+        }
+        QSaveFile out(m_path);
+        if (!out.open(QIODevice::WriteOnly) || out.write(encodeFileHeader(kFileHeaderSize, 0)) != kFileHeaderSize)
+        {
+            throw std::runtime_error(QStringLiteral("Failed to rewrite vault index: %1").arg(m_path).toStdString());
+        }
+        qint64 offset = kFileHeaderSize;
+        for (const Slot &slot : m_live)
+        {
+            QByteArray record;
+            if (slot.offset >= 0)
+            {
+                const qint64 length = kRecordHeaderSize + qFromLittleEndian<quint32>(m_map + slot.offset);
+                record = QByteArray::fromRawData(reinterpret_cast<const char *>(m_map + slot.offset), length);
+            }
+            else
+            {
+                record = encodeRecord(kPutRecord, slot.keyHash, encodePayload(m_pending[static_cast<std::size_t>(slot.pending)]));
+            }
+            if (out.write(record) != record.size())
+            {
+                throw std::runtime_error("Failed to write compacted vault index");
+            }
+            offset += record.size();
+        }
+        if (!out.seek(0) || out.write(encodeFileHeader(offset, size())) != kFileHeaderSize)
+        {
+            throw std::runtime_error("Failed to finalize compacted vault index");
+        }
+
+        // The mapping must be gone before the rename can replace the file on every platform.
+        releaseFile();
+        const bool committed = out.commit();
+        m_live.clear();
+        m_positions.clear();
+        m_pending.clear();
+        m_deadRecords = 0;
+        m_tailRecords = 0;
+        load(true);
+        if (!committed)
+        {
+            throw std::runtime_error("Failed to commit compacted vault index");
+        }
+    }
+
+    void VaultIndex::appendRecord(const QByteArray &record)
+    {
+        if (m_log->write(record) != record.size() || !m_log->flush())
+        {
+            throw std::runtime_error(QStringLiteral("Failed to append to vault index: %1").arg(m_path).toStdString());
+        }
+    }
+
+    void VaultIndex::maybeCompact()
+    {
+        if (!isOpen())
+        {
+            return;
+        }
+        if ((m_deadRecords >= kCompactionMinDead && m_deadRecords > size()) || m_tailRecords > kCompactionMaxTail)
+        {
+            compact();
+        }
+    }
+
+    VaultEntry VaultIndex::decode(const Slot &slot) const
+    {
+        if (slot.offset < 0)
+        {
+            return m_pending[static_cast<std::size_t>(slot.pending)];
+        }
+        VaultEntry entry;
+        const uchar *record = m_map + slot.offset;
+        forEachField(record + kRecordHeaderSize, qFromLittleEndian<quint32>(record), [&](quint8 tag, const uchar *data, quint32 length)
+                     {
+            switch (tag)
+            {
+            case OriginalPathField:
+                entry.originalPath = utf8Field(data, length);
+                break;
+            case StoredPathField:
+                entry.storedPath = utf8Field(data, length);
+                break;
+            case AlgorithmField:
+                entry.algorithm = utf8Field(data, length);
+                break;
+            case NonceField:
+                entry.nonce = QByteArray(reinterpret_cast<const char *>(data), static_cast<qsizetype>(length));
+                break;
+            case TimestampField:
+                if (length == 8)
+                {
+                    const qint64 msecs = qFromLittleEndian<qint64>(data);
+                    if (msecs != std::numeric_limits<qint64>::min())
+                    {
+                        entry.timestamp = QDateTime::fromMSecsSinceEpoch(msecs, QTimeZone::UTC);
+                    }
+                }
+                break;
+            case WrappedKeyField:
+                entry.wrappedKey = QByteArray(reinterpret_cast<const char *>(data), static_cast<qsizetype>(length));
+                break;
+            case DigestField:
+                entry.digest = QByteArray(reinterpret_cast<const char *>(data), static_cast<qsizetype>(length));
+                break;
+            default:
+                break;
+            }
+            return true; });
+        return entry;
+    }
+
+    QString VaultIndex::decodeStoredPath(const Slot &slot) const
+    {
+        if (slot.offset < 0)
+        {
+            return m_pending[static_cast<std::size_t>(slot.pending)].storedPath;
+        }
+        QString storedPath;
+        const uchar *record = m_map + slot.offset;
+        forEachField(record + kRecordHeaderSize, qFromLittleEndian<quint32>(record), [&](quint8 tag, const uchar *data, quint32 length)
+                     {
+            if (tag != StoredPathField)
+            {
+                return true;
+            }
+            storedPath = utf8Field(data, length);
+            return false; });
+        return storedPath;
+    }
+
+    qsizetype VaultIndex::findSlot(quint64 keyHash, const QString &storedPath) const
+    {
+        const auto [first, last] = m_positions.equal_range(keyHash);
+        for (auto it = first; it != last; ++it)
+        {
+            if (decodeStoredPath(m_live[static_cast<std::size_t>(it->second)]) == storedPath)
+            {
+                return it->second;
+            }
+        }
+        return -1;
+    }
+
+    std::unordered_multimap<quint64, qsizetype>::iterator VaultIndex::positionEntry(quint64 keyHash, qsizetype position)
+    {
+        const auto [first, last] = m_positions.equal_range(keyHash);
+        const auto it = std::find_if(first, last, [position](const auto &item) { return item.second == position; });
+        return it != last ? it : m_positions.end();
+    }
+
+    void VaultIndex::erasePosition(qsizetype position)
+    {
+        const auto it = positionEntry(m_live[static_cast<std::size_t>(position)].keyHash, position);
+        if (it != m_positions.end())
+        {
+            m_positions.erase(it);
+        }
+        m_live.erase(m_live.begin() + position);
+        for (qsizetype i = position; i < size(); ++i)
+        {
+            const auto moved = positionEntry(m_live[static_cast<std::size_t>(i)].keyHash, i + 1);
+            if (moved != m_positions.end())
+            {
+                moved->second = i;
+            }
+        }
+    }
+
+} // namespace dynamicencrypt::core
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "VaultEntry.h"
+
+#include <QFile>
+#include <QLockFile>
+#include <QString>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace dynamicencrypt::core
+{
+
+    // Persistent store of VaultEntry records, keyed by storedPath.
+    //
+    // On disk it is a compacted snapshot followed by an append-only log of put/remove records. Every
+    // record carries a CRC and a hash of its storedPath, so opening maps the file and walks record
+    // headers only; a torn tail left by a crash is cut off instead of forcing a rescan of the vault.
+    // Entry fields are decoded from the mapping when they are accessed.
+    //
+    // One process at a time appends: open() takes an advisory lock file next to the index and holds it
+    // until close(). A process that finds the lock held opens the index read-only instead, so it never
+    // truncates a tail another process is still writing or compacts the file under it.
+    class VaultIndex
+    {
+    public:
+        VaultIndex() = default;
+        ~VaultIndex();
+
+        VaultIndex(const VaultIndex &) = delete;
+        VaultIndex &operator=(const VaultIndex &) = delete;
+
+        // Opens or creates the index at path. Throws if the file exists but is not an index. When another
+        // process holds the index, its entries are loaded read-only and puts are kept in memory only.
+        void open(const QString &path);
+        // Detaches from the file, releases the lock and forgets all entries; later puts are kept in memory only.
+        void close();
+
+        // True while this instance holds the lock and appends to the file.
+        bool isOpen() const noexcept { return m_log != nullptr; }
+        bool isReadOnly() const noexcept { return m_readOnly; }
+        const QString &path() const noexcept { return m_path; }
+        // The lock file open() keeps next to the index at indexPath.
+        static QString lockPath(const QString &indexPath);
+
+        qsizetype size() const noexcept { return static_cast<qsizetype>(m_live.size()); }
+        VaultEntry entryAt(qsizetype position) const;
+        QString storedPathAt(qsizetype position) const;
+        qsizetype indexOf(const QString &storedPath) const;
+
+        struct PutResult
+        {
+            qsizetype position{-1};
+            bool replaced{false};
+        };
+
+        // Appends entry, replacing the live entry with the same storedPath in place if there is one.
+        PutResult put(const VaultEntry &entry);
+        // Same as put() for each entry in order, with one log write and flush for the whole batch.
+        std::vector<PutResult> put(const std::vector<VaultEntry> &entries);
+        // Returns the position the entry occupied, or -1 if it was not present.
+        qsizetype remove(const QString &storedPath);
+
+        // Rewrites the file with live entries only. Runs automatically once dead records dominate.
+        void compact();
+        qint64 deadRecords() const noexcept { return m_deadRecords; }
+
+    private:
+        struct Slot
+        {
+            qint64 offset{-1};  // record offset in the mapping, or -1 for an entry appended this session
+            qsizetype pending{-1};
+            quint64 keyHash{0};
+        };
+
+        void load(bool writable);
+        void releaseFile() noexcept;
+        void appendRecord(const QByteArray &record);
+        void maybeCompact();
+        PutResult place(const VaultEntry &entry, quint64 keyHash);
+        VaultEntry decode(const Slot &slot) const;
+        QString decodeStoredPath(const Slot &slot) const;
+        qsizetype findSlot(quint64 keyHash, const QString &storedPath) const;
+        std::unordered_multimap<quint64, qsizetype>::iterator positionEntry(quint64 keyHash, qsizetype position);
+        void erasePosition(qsizetype position);
+
+        QString m_path;
+        std::unique_ptr<QLockFile> m_lock;
+        bool m_readOnly{false};
+        std::unique_ptr<QFile> m_mapFile;
+        std::unique_ptr<QFile> m_log;
+        const uchar *m_map{nullptr};
+        qint64 m_mapSize{0};
+
+        std::vector<Slot> m_live;
+        // Distinct paths can share a hash, so each hash maps to every live position carrying it.
+        std::unordered_multimap<quint64, qsizetype> m_positions;
+        std::vector<VaultEntry> m_pending;
+        qint64 m_deadRecords{0};
+        qint64 m_tailRecords{0};
+    };
+
+} // namespace dynamicencrypt::core
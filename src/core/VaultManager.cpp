@@ -1,13 +1,25 @@
 #include "VaultManager.h"
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QDir>
 #include <QFileInfo>
+#include <QJsonObject>
 #include <QLibrary>
+#include <QSaveFile>
 #include <QStandardPaths>
+#include <QThread>
 
 #include <QDebug>
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <latch>
+#include <limits>
+#include <mutex>
+
 namespace dynamicencrypt::core
 {
 
@@ -21,13 +33,329 @@ namespace dynamicencrypt::core
             paths << QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + QStringLiteral("/DynamicEncrypt/plugins");
             return paths;
         }
+
+        // Runs body(i) for every i in [0, count) on up to `threads` workers; the calling thread takes part
+        // and indices are handed out dynamically so uneven segments still keep every core busy.
+        void parallelFor(QThreadPool &pool, qint64 count, int threads, const std::function<void(qint64)> &body)
+        {
+            threads = static_cast<int>(qMin<qint64>(qMax(threads, 1), count));
+            if (threads <= 1)
+            {
+                for (qint64 i = 0; i < count; ++i)
+                {
+                    body(i);
+                }
+                return;
+            }
+            if (pool.maxThreadCount() < threads - 1)
+            {
+                pool.setMaxThreadCount(threads - 1);
+            }
+
+            std::atomic<qint64> next{0};
+            std::atomic<bool> failed{false};
+            std::exception_ptr error;
+            std::mutex errorMutex;
+            auto drain = [&]()
+            {
+                try
+                {
+                    for (qint64 i = next.fetch_add(1); i < count && !failed.load(std::memory_order_relaxed);
+                         i = next.fetch_add(1))
+                    {
+                        body(i);
+                    }
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error)
+                    {
+                        error = std::current_exception();
+                    }
+                    failed = true;
+                }
+            };
+
+            // Shared ownership keeps the latch alive until the last worker has finished signalling it.
+            auto done = std::make_shared<std::latch>(threads - 1);
+            for (int worker = 1; worker < threads; ++worker)
+            {
+                pool.start([&drain, done]()
+                           {
+                    drain();
+                    done->count_down(); });
+            }
+            drain();
+            done->wait();
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+        // Times one public operation for VaultMetrics. An operation running inside another one on the
+        // same thread (a QByteArray overload, the cipher pass of a file operation) records nothing, so
+        // each call is counted once.
+        class OperationTimer
+        {
+        public:
+            OperationTimer(VaultMetrics &metrics, const CryptoDriver *driver, VaultMetrics::Direction direction)
+                : m_metrics(metrics), m_driver(driver), m_direction(direction), m_nested(t_depth++ > 0)
+            {
+            }
+
+            ~OperationTimer() { --t_depth; }
+
+            OperationTimer(const OperationTimer &) = delete;
+            OperationTimer &operator=(const OperationTimer &) = delete;
+
+            // For operations that also do I/O: the rest of the latency is counted as I/O time.
+            void addCipherNanos(qint64 nanos) noexcept
+            {
+                m_cipherNanos += nanos;
+                m_doesIo = true;
+            }
+
+            void finish(qint64 bytesIn, qint64 bytesOut)
+            {
+                if (m_nested)
+                {
+                    return;
+                }
+                const qint64 latency = nanosSince(m_started);
+                m_metrics.record(m_driver, m_direction, bytesIn, bytesOut, latency,
+                                 m_doesIo ? qMax<qint64>(latency - m_cipherNanos, 0) : 0);
+            }
+
+        private:
+            static inline thread_local int t_depth = 0;
+
+            VaultMetrics &m_metrics;
+            const CryptoDriver *m_driver;
+            VaultMetrics::Direction m_direction;
+            bool m_nested;
+            bool m_doesIo{false};
+            qint64 m_cipherNanos{0};
+            MetricsClock::time_point m_started{MetricsClock::now()};
+        };
+
+        // The nonce leads the ciphertext as its layout header; drivers without a fixed layout report none.
+        qsizetype nonceSizeOf(const CryptoDriver *driver)
+        {
+            const CiphertextLayout layout = driver->ciphertextLayout();
+            return layout.known() ? layout.header : 0;
+        }
+
+        void copyNonce(QByteArray *nonceOut, std::span<const std::byte> cipher, qsizetype nonceSize)
+        {
+            if (!nonceOut)
+            {
+                return;
+            }
+            nonceOut->clear();
+            if (nonceSize > 0 && static_cast<qsizetype>(cipher.size()) >= nonceSize)
+            {
+                nonceOut->append(reinterpret_cast<const char *>(cipher.data()), nonceSize);
+            }
+        }
+
+        void requireOpen(const VaultIndex &index)
+        {
+            if (index.isOpen())
+            {
+                return;
+            }
+            if (index.isReadOnly())
+            {
+                throw std::runtime_error(
+                    QStringLiteral("Vault index is in use by another process: %1").arg(index.path()).toStdString());
+            }
+            throw std::runtime_error("No vault index is open for writing");
+        }
+
+        int resolveThreadCount(const CryptoDriver *driver, const VaultManager::SegmentOptions &options)
+        {
+            if (!driver->capabilities().threadSafe)
+            {
+                return 1;
+            }
+            return options.threadCount > 0 ? options.threadCount : QThread::idealThreadCount();
+        }
+
+        void requireSegmentSupport(CryptoDriver *driver)
+        {
+            if (!driver)
+            {
+                throw std::invalid_argument("driver is null");
+            }
+            if (driver->segmentNonceSize() <= 0 || driver->segmentNonceSize() > 255)
+            {
+                throw std::runtime_error("driver does not support segmented encryption");
+            }
+        }
+
+        SegmentedHeader planSegments(CryptoDriver *driver, qint64 plaintextSize, const VaultManager::SegmentOptions &options)
+        {
+            requireSegmentSupport(driver);
+            if (options.segmentSize <= 0 || options.segmentSize > std::numeric_limits<quint32>::max())
+            {
+                throw std::invalid_argument("segmentSize must be positive and fit in 32 bits");
+            }
+            if (driver->segmentOverhead() < 0 || driver->segmentOverhead() > std::numeric_limits<quint16>::max())
+            {
+                throw std::runtime_error("driver reports an unsupported segment overhead");
+            }
+            SegmentedHeader header;
+            header.segmentSize = static_cast<quint32>(options.segmentSize);
+            header.segmentOverhead = static_cast<quint16>(driver->segmentOverhead());
+            header.plaintextSize = static_cast<quint64>(plaintextSize);
+            header.baseNonce.resize(driver->segmentNonceSize());
+            return header;
+        }
+
+        SegmentedHeader readSegments(CryptoDriver *driver, std::span<const std::byte> ciphertext)
+        {
+            requireSegmentSupport(driver);
+            const SegmentedHeader header = SegmentedHeader::read(ciphertext);
+            if (header.baseNonce.size() != driver->segmentNonceSize() || header.segmentOverhead != driver->segmentOverhead())
+            {
+                throw std::invalid_argument("segmented blob was not produced by this driver");
+            }
+            // Checked in this order so a crafted plaintextSize cannot wrap the sums in ciphertextSize().
+            const quint64 body = ciphertext.size() - static_cast<std::size_t>(header.encodedSize());
+            if (header.plaintextSize > body ||
+                static_cast<quint64>(header.segmentCount()) * header.segmentOverhead != body - header.plaintextSize)
+            {
+                throw std::invalid_argument("segmented blob is truncated or has trailing data");
+            }
+            return header;
+        }
+
+        constexpr qsizetype kFingerprintSize = 8;
+
+        // Identifies the master key a data key was wrapped under without revealing anything useful about it.
+        QByteArray masterKeyFingerprint(const Key<SymmetricKeyTag> &masterKey)
+        {
+            QCryptographicHash hash(QCryptographicHash::Sha256);
+            hash.addData(QByteArrayLiteral("dynamicencrypt key wrap"));
+            hash.addData(masterKey.raw());
+            return hash.result().left(kFingerprintSize);
+        }
+
+        void writeAll(QSaveFile &file, const QByteArray &bytes)
+        {
+            if (!bytes.isEmpty() && file.write(bytes) != bytes.size())
+            {
+                throw std::runtime_error("Failed to write streamed chunk");
+            }
+        }
+
+        // Drives a cipher context over inputPath in fixed-size chunks and commits outputPath atomically.
+        // Cancelling leaves outputPath untouched because the QSaveFile is never committed.
+        void pumpFile(CipherContext &context, const QString &inputPath, const QString &outputPath, qsizetype chunkSize,
+                      QByteArray *headOut, qsizetype headSize, const JobControl &control, OperationTimer &timer,
+                      IoCounters &io, QCryptographicHash *digest = nullptr)
+        {
+            if (chunkSize <= 0)
+            {
+                throw std::invalid_argument("chunkSize must be positive");
+            }
+            QFile input(inputPath);
+            if (!input.open(QIODevice::ReadOnly))
+            {
+                throw std::runtime_error(QStringLiteral("Failed to open path for reading: %1").arg(inputPath).toStdString());
+            }
+            QSaveFile output(outputPath);
+            if (!output.open(QIODevice::WriteOnly))
+            {
+                throw std::runtime_error(QStringLiteral("Failed to open path for writing: %1").arg(outputPath).toStdString());
+            }
+
+            // A file smaller than a chunk gets a buffer of its own size, so small files are served from the
+            // arena's pooled classes instead of a dedicated locked mapping each. ZeroizingBuffer sizes are
+            // ints, so larger chunks are read in pieces of at most INT_MAX bytes rather than truncated.
+            const qint64 total = input.size();
+            const qint64 bufferSize = std::min<qint64>({static_cast<qint64>(chunkSize), qMax<qint64>(total, 1),
+                                                        std::numeric_limits<int>::max()});
+            ZeroizingBuffer chunk(static_cast<int>(bufferSize));
+            char *buffer = chunk.data();
+            qint64 written = 0;
+            auto forward = [&](const QByteArray &bytes)
+            {
+                if (headOut && headOut->size() < headSize)
+                {
+                    headOut->append(bytes.left(headSize - headOut->size()));
+                }
+                if (digest)
+                {
+                    digest->addData(bytes);
+                }
+                const auto writing = MetricsClock::now();
+                writeAll(output, bytes);
+                io.recordWrite(bytes.size(), nanosSince(writing));
+                written += bytes.size();
+            };
+            auto cipher = [&](auto step)
+            {
+                const auto started = MetricsClock::now();
+                QByteArray bytes = step();
+                timer.addCipherNanos(nanosSince(started));
+                return bytes;
+            };
+
+            qint64 done = 0;
+            if (control.progress)
+            {
+                control.progress(done, total);
+            }
+            while (true)
+            {
+                if (control.isCancelled())
+                {
+                    throw OperationCancelled();
+                }
+                const auto reading = MetricsClock::now();
+                const qint64 read = input.read(buffer, bufferSize);
+                io.recordRead(read, nanosSince(reading));
+                if (read < 0)
+                {
+                    throw std::runtime_error(QStringLiteral("Failed to read from %1").arg(inputPath).toStdString());
+                }
+                if (read == 0)
+                {
+                    break;
+                }
+                forward(cipher([&]() { return context.update(QByteArray::fromRawData(buffer, static_cast<qsizetype>(read))); }));
+                done += read;
+                if (control.progress)
+                {
+                    control.progress(done, total);
+                }
+            }
+            forward(cipher([&]() { return context.finalize(); }));
+
+            if (!output.commit())
+            {
+                throw std::runtime_error("Failed to commit save file atomically");
+            }
+            timer.finish(total, written);
+        }
     }
 
     VaultManager::VaultManager(QObject *parent)
+        : VaultManager(InitialVault::Default, parent)
+    {
+    }
+
+    VaultManager::VaultManager(InitialVault vault, QObject *parent)
         : QObject(parent)
     {
-        const QString defaultVaultDir = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) + QStringLiteral("/DynamicEncryptVault");
-        setStorageDirectory(defaultVaultDir);
+        if (vault == InitialVault::Default)
+        {
+            const QString defaultVaultDir = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) + QStringLiteral("/DynamicEncryptVault");
+            setStorageDirectory(defaultVaultDir);
+        }
         discoverPlugins(defaultPluginPaths());
     }
 
@@ -35,6 +363,9 @@ namespace dynamicencrypt::core
 
     void VaultManager::discoverPlugins(const QStringList &searchPaths)
     {
+        // Prepared keys are bound to the drivers being replaced.
+        m_keys.clear();
+        m_metrics.unbindDrivers();
         m_plugins.clear();
         for (const QString &path : searchPaths)
         {
@@ -50,44 +381,106 @@ namespace dynamicencrypt::core
                 {
                     continue;
                 }
-                auto loader = std::make_unique<QPluginLoader>(info.absoluteFilePath());
-                if (!loader->load())
+                const QJsonObject metaData = m_pluginCache.metaData(info);
+                if (!PluginDescriptor::isCryptoDriver(metaData))
                 {
-                    qWarning() << "Failed to load plugin" << info.fileName() << loader->errorString();
+                    if (metaData.isEmpty())
+                    {
+                        qWarning() << "No plugin metadata in" << info.fileName();
+                    }
                     continue;
                 }
-                QObject *object = loader->instance();
-                if (!object)
+                auto driver = std::make_unique<LazyDriver>(PluginDescriptor::fromMetaData(info.absoluteFilePath(), metaData));
+                try
                 {
-                    qWarning() << "Plugin instance null for" << info.fileName();
-                    continue;
+                    driver->resolveIdentity();
                 }
-                auto *driver = qobject_cast<CryptoDriver *>(object);
-                if (!driver)
+                catch (const std::exception &ex)
                 {
-                    qWarning() << "Plugin" << info.fileName() << "does not implement CryptoDriver";
-                    loader->unload();
+                    qWarning() << "Failed to load plugin" << info.fileName() << ex.what();
                     continue;
                 }
-                PluginHolder holder;
-                holder.loader = std::move(loader);
-                holder.instance = driver;
-                m_plugins.push_back(std::move(holder));
+                m_plugins.push_back(std::move(driver));
             }
         }
+        m_pluginCache.save();
     }
 
     std::vector<CryptoDriver *> VaultManager::drivers() const
     {
         std::vector<CryptoDriver *> result;
         result.reserve(m_plugins.size());
-        for (const auto &holder : m_plugins)
+        for (const auto &plugin : m_plugins)
+        {
+            result.push_back(plugin.get());
+        }
+        return result;
+    }
+
+    std::vector<PluginDescriptor> VaultManager::pluginDescriptors() const
+    {
+        std::vector<PluginDescriptor> result;
+        result.reserve(m_plugins.size());
+        for (const auto &plugin : m_plugins)
         {
-            result.push_back(holder.instance);
+            result.push_back(plugin->descriptor());
         }
         return result;
     }
 
+    CryptoDriver *VaultManager::preferredDriver(const DriverRequirements &requirements) const
+    {
+        CryptoDriver *best = nullptr;
+        int bestRank = 0;
+        for (const auto &plugin : m_plugins)
+        {
+            const DriverCapabilities &capabilities = plugin->descriptor().capabilities;
+            if (requirements.satisfiedBy(capabilities) && (!best || capabilities.speedRank > bestRank))
+            {
+                best = plugin.get();
+                bestRank = capabilities.speedRank;
+            }
+        }
+        return best;
+    }
+
+    CryptoDriver *VaultManager::driverNamed(const QString &name) const
+    {
+        for (const auto &plugin : m_plugins)
+        {
+            if (plugin->name() == name)
+            {
+                return plugin.get();
+            }
+        }
+        return nullptr;
+    }
+
+    qsizetype VaultManager::chunkSizeFor(const CryptoDriver *driver, qsizetype requested)
+    {
+        if (requested != kAutoChunkSize)
+        {
+            return requested;
+        }
+        const DriverCapabilities capabilities = driver->capabilities();
+        const qsizetype size = capabilities.chunkSize > 0 ? capabilities.chunkSize : kDefaultChunkSize;
+        const qsizetype alignment = capabilities.chunkAlignment;
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    MetricsSnapshot VaultManager::metrics() const
+    {
+        MetricsSnapshot snapshot = m_metrics.snapshot();
+        snapshot.storage = m_storage.io().snapshot();
+        return snapshot;
+    }
+
+    void VaultManager::resetMetrics()
+    {
+        m_metrics.reset();
+        m_storage.io().reset();
+    }
+
     void VaultManager::setStorageDirectory(QString path)
     {
         QDir dir(std::move(path));
@@ -96,28 +489,662 @@ namespace dynamicencrypt::core
             dir.mkpath(QStringLiteral("."));
         }
         m_storageDir = dir.absolutePath();
+        m_changeCache.open(dir.filePath(QString::fromLatin1(ChangeCache::kFileName)));
+
+        {
+            std::lock_guard<std::mutex> lock(m_entriesMutex);
+            m_snapshot.store(nullptr);
+            {
+                std::unique_lock<std::shared_mutex> queryLock(m_queryMutex);
+                m_queryIndexes.reset();
+            }
+            ++m_version;
+            try
+            {
+                m_index.open(dir.filePath(QString::fromLatin1(kIndexFileName)));
+                if (m_index.isReadOnly())
+                {
+                    qWarning() << "Vault index is in use by another process, new entries are refused:" << m_index.path();
+                }
+            }
+            catch (const std::exception &ex)
+            {
+                qWarning() << "Vault index unavailable, new entries are refused:" << ex.what();
+                m_index.close();
+            }
+        }
+        emit entriesReset();
     }
 
     QByteArray VaultManager::encryptSymmetric(CryptoDriver *driver, const QByteArray &plaintext,
                                               const Key<SymmetricKeyTag> &key, QByteArray *nonceOut)
     {
+        if (!driver)
+        {
+            throw std::invalid_argument("driver is null");
+        }
+        OperationTimer timer(m_metrics, driver, VaultMetrics::Direction::Encrypt);
+        const CiphertextLayout layout = driver->ciphertextLayout();
+        if (layout.known())
+        {
+            QByteArray cipher(plaintext.size() + layout.overhead(), Qt::Uninitialized);
+            const qsizetype written = encryptSymmetric(driver, asBytes(plaintext), asWritableBytes(cipher), key, nonceOut);
+            cipher.truncate(written);
+            timer.finish(plaintext.size(), cipher.size());
+            return cipher;
+        }
         QByteArray cipher = encryptWith(driver, plaintext, key);
-        if (nonceOut && cipher.size() > 12)
+        if (nonceOut)
         {
-            *nonceOut = cipher.left(12);
+            nonceOut->clear();
         }
+        timer.finish(plaintext.size(), cipher.size());
         return cipher;
     }
 
     QByteArray VaultManager::decryptSymmetric(CryptoDriver *driver, const QByteArray &ciphertext,
                                               const Key<SymmetricKeyTag> &key)
     {
-        return decryptWith(driver, ciphertext, key);
+        if (!driver)
+        {
+            throw std::invalid_argument("driver is null");
+        }
+        OperationTimer timer(m_metrics, driver, VaultMetrics::Direction::Decrypt);
+        const CiphertextLayout layout = driver->ciphertextLayout();
+        QByteArray plain;
+        if (layout.known() && ciphertext.size() >= layout.overhead())
+        {
+            plain = QByteArray(ciphertext.size() - layout.overhead(), Qt::Uninitialized);
+            plain.truncate(decryptSymmetric(driver, asBytes(ciphertext), asWritableBytes(plain), key));
+        }
+        else
+        {
+            plain = decryptWith(driver, ciphertext, key);
+        }
+        timer.finish(ciphertext.size(), plain.size());
+        return plain;
+    }
+
+    qsizetype VaultManager::encryptSymmetric(CryptoDriver *driver, std::span<const std::byte> plaintext,
+                                             std::span<std::byte> out, const Key<SymmetricKeyTag> &key,
+                                             QByteArray *nonceOut)
+    {
+        if (!driver)
+        {
+            throw std::invalid_argument("driver is null");
+        }
+        OperationTimer timer(m_metrics, driver, VaultMetrics::Direction::Encrypt);
+        const qsizetype written = driver->encrypt(plaintext, out, key.raw());
+        copyNonce(nonceOut, out.first(static_cast<std::size_t>(written)), nonceSizeOf(driver));
+        timer.finish(static_cast<qint64>(plaintext.size()), written);
+        return written;
+    }
+
+    qsizetype VaultManager::decryptSymmetric(CryptoDriver *driver, std::span<const std::byte> ciphertext,
+                                             std::span<std::byte> out, const Key<SymmetricKeyTag> &key)
+    {
+        if (!driver)
+        {
+            throw std::invalid_argument("driver is null");
+        }
+        OperationTimer timer(m_metrics, driver, VaultMetrics::Direction::Decrypt);
+        const qsizetype written = driver->decrypt(ciphertext, out, key.raw());
+        timer.finish(static_cast<qint64>(ciphertext.size()), written);
+        return written;
+    }
+
+    KeyHandle VaultManager::prepareKey(CryptoDriver *driver, const Key<SymmetricKeyTag> &key)
+    {
+        if (!driver)
+        {
+            throw std::invalid_argument("driver is null");
+        }
+        return m_keys.add(driver, driver->prepareKey(key.raw()));
+    }
+
+    QByteArray VaultManager::encryptSymmetric(KeyHandle key, const QByteArray &plaintext, QByteArray *nonceOut)
+    {
+        const KeyRegistry::Entry entry = m_keys.find(key);
+        const CiphertextLayout layout = entry.driver->ciphertextLayout();
+        if (!layout.known())
+        {
+            throw std::runtime_error("prepared keys require a fixed ciphertext layout");
+        }
+        OperationTimer timer(m_metrics, entry.driver, VaultMetrics::Direction::Encrypt);
+        QByteArray cipher(plaintext.size() + layout.overhead(), Qt::Uninitialized);
+        cipher.truncate(encryptPrepared(entry, asBytes(plaintext), asWritableBytes(cipher), nonceOut));
+        timer.finish(plaintext.size(), cipher.size());
+        return cipher;
+    }
+
+    QByteArray VaultManager::decryptSymmetric(KeyHandle key, const QByteArray &ciphertext)
+    {
+        const KeyRegistry::Entry entry = m_keys.find(key);
+        const CiphertextLayout layout = entry.driver->ciphertextLayout();
+        if (!layout.known())
+        {
+            throw std::runtime_error("prepared keys require a fixed ciphertext layout");
+        }
+        if (ciphertext.size() < layout.overhead())
+        {
+            throw std::invalid_argument("Ciphertext too short");
+        }
+        OperationTimer timer(m_metrics, entry.driver, VaultMetrics::Direction::Decrypt);
+        QByteArray plain(ciphertext.size() - layout.overhead(), Qt::Uninitialized);
+        plain.truncate(decryptPrepared(entry, asBytes(ciphertext), asWritableBytes(plain)));
+        timer.finish(ciphertext.size(), plain.size());
+        return plain;
+    }
+
+    qsizetype VaultManager::encryptSymmetric(KeyHandle key, std::span<const std::byte> plaintext,
+                                             std::span<std::byte> out, QByteArray *nonceOut)
+    {
+        return encryptPrepared(m_keys.find(key), plaintext, out, nonceOut);
+    }
+
+    qsizetype VaultManager::decryptSymmetric(KeyHandle key, std::span<const std::byte> ciphertext,
+                                             std::span<std::byte> out)
+    {
+        return decryptPrepared(m_keys.find(key), ciphertext, out);
+    }
+
+    qsizetype VaultManager::encryptPrepared(const KeyRegistry::Entry &entry, std::span<const std::byte> plaintext,
+                                            std::span<std::byte> out, QByteArray *nonceOut)
+    {
+        OperationTimer timer(m_metrics, entry.driver, VaultMetrics::Direction::Encrypt);
+        const qsizetype written = entry.driver->encrypt(plaintext, out, *entry.key);
+        copyNonce(nonceOut, out.first(static_cast<std::size_t>(written)), nonceSizeOf(entry.driver));
+        timer.finish(static_cast<qint64>(plaintext.size()), written);
+        return written;
+    }
+
+    qsizetype VaultManager::decryptPrepared(const KeyRegistry::Entry &entry, std::span<const std::byte> ciphertext,
+                                            std::span<std::byte> out)
+    {
+        OperationTimer timer(m_metrics, entry.driver, VaultMetrics::Direction::Decrypt);
+        const qsizetype written = entry.driver->decrypt(ciphertext, out, *entry.key);
+        timer.finish(static_cast<qint64>(ciphertext.size()), written);
+        return written;
+    }
+
+    void VaultManager::encryptFile(CryptoDriver *driver, const QString &inputPath, const QString &outputPath,
+                                   const Key<SymmetricKeyTag> &key, QByteArray *nonceOut, qsizetype chunkSize,
+                                   const JobControl &control, QByteArray *digestOut)
+    {
+        if (!driver)
+        {
+            throw std::invalid_argument("driver is null");
+        }
+        OperationTimer timer(m_metrics, driver, VaultMetrics::Direction::Encrypt);
+        std::unique_ptr<CipherContext> context = driver->createEncryptContext(key.raw());
+        if (nonceOut)
+        {
+            nonceOut->clear();
+        }
+        std::optional<QCryptographicHash> digest;
+        if (digestOut)
+        {
+            digest.emplace(kDigestAlgorithm);
+        }
+        pumpFile(*context, inputPath, outputPath, chunkSizeFor(driver, chunkSize), nonceOut, nonceSizeOf(driver), control,
+                 timer, m_storage.io(), digest ? &*digest : nullptr);
+        if (digestOut)
+        {
+            *digestOut = digest->result();
+        }
+    }
+
+    void VaultManager::decryptFile(CryptoDriver *driver, const QString &inputPath, const QString &outputPath,
+                                   const Key<SymmetricKeyTag> &key, qsizetype chunkSize, const JobControl &control)
+    {
+        if (!driver)
+        {
+            throw std::invalid_argument("driver is null");
+        }
+        OperationTimer timer(m_metrics, driver, VaultMetrics::Direction::Decrypt);
+        std::unique_ptr<CipherContext> context = driver->createDecryptContext(key.raw());
+        pumpFile(*context, inputPath, outputPath, chunkSizeFor(driver, chunkSize), nullptr, 0, control, timer,
+                 m_storage.io());
+    }
+
+    void VaultManager::encryptMappedFile(CryptoDriver *driver, const QString &inputPath, const QString &outputPath,
+                                         const Key<SymmetricKeyTag> &key, QByteArray *nonceOut)
+    {
+        if (!driver)
+        {
+            throw std::invalid_argument("driver is null");
+        }
+        const CiphertextLayout layout = driver->ciphertextLayout();
+        if (!layout.known())
+        {
+            throw std::runtime_error("mapped encryption requires a fixed ciphertext layout");
+        }
+        OperationTimer timer(m_metrics, driver, VaultMetrics::Direction::Encrypt);
+        const MappedFile input = m_storage.map(inputPath);
+        m_storage.storeMapped(outputPath, input.size() + layout.overhead(), [&](std::span<std::byte> out)
+                              {
+            const auto started = MetricsClock::now();
+            encryptSymmetric(driver, input.bytes(), out, key, nonceOut);
+            timer.addCipherNanos(nanosSince(started)); });
+        timer.finish(input.size(), input.size() + layout.overhead());
+    }
+
+    void VaultManager::decryptMappedFile(CryptoDriver *driver, const QString &inputPath, const QString &outputPath,
+                                         const Key<SymmetricKeyTag> &key)
+    {
+        if (!driver)
+        {
+            throw std::invalid_argument("driver is null");
+        }
+        const CiphertextLayout layout = driver->ciphertextLayout();
+        if (!layout.known())
+        {
+            throw std::runtime_error("mapped decryption requires a fixed ciphertext layout");
+        }
+        OperationTimer timer(m_metrics, driver, VaultMetrics::Direction::Decrypt);
+        const MappedFile input = m_storage.map(inputPath);
+        if (input.size() < layout.overhead())
+        {
+            throw std::invalid_argument("Ciphertext too short");
+        }
+        m_storage.storeMapped(outputPath, input.size() - layout.overhead(), [&](std::span<std::byte> out)
+                              {
+            const auto started = MetricsClock::now();
+            decryptSymmetric(driver, input.bytes(), out, key);
+            timer.addCipherNanos(nanosSince(started)); });
+        timer.finish(input.size(), input.size() - layout.overhead());
+    }
+
+    qint64 VaultManager::segmentedCiphertextSize(CryptoDriver *driver, qint64 plaintextSize,
+                                                 const SegmentOptions &options) const
+    {
+        return planSegments(driver, plaintextSize, options).ciphertextSize();
+    }
+
+    qsizetype VaultManager::encryptSegmented(CryptoDriver *driver, std::span<const std::byte> plaintext,
+                                             std::span<std::byte> out, const Key<SymmetricKeyTag> &key,
+                                             const SegmentOptions &options)
+    {
+        SegmentedHeader header = planSegments(driver, static_cast<qint64>(plaintext.size()), options);
+        OperationTimer timer(m_metrics, driver, VaultMetrics::Direction::Encrypt);
+        SecureRandom::fill(asWritableBytes(header.baseNonce));
+        if (out.size() < static_cast<std::size_t>(header.ciphertextSize()))
+        {
+            throw std::length_error("output buffer too small");
+        }
+        header.write(out);
+        // Expanded once and shared by every segment instead of per segment.
+        const std::unique_ptr<PreparedKey> prepared = driver->prepareKey(key.raw());
+        parallelFor(m_segmentPool, header.segmentCount(), resolveThreadCount(driver, options), [&](qint64 index)
+                    {
+            const QByteArray nonce = header.deriveNonce(index);
+            const auto length = static_cast<std::size_t>(header.plainLength(index));
+            driver->encryptSegment(plaintext.subspan(static_cast<std::size_t>(header.plainOffset(index)), length),
+                                   out.subspan(static_cast<std::size_t>(header.cipherOffset(index)), length + header.segmentOverhead),
+                                   *prepared, asBytes(nonce)); });
+        timer.finish(static_cast<qint64>(plaintext.size()), header.ciphertextSize());
+        return static_cast<qsizetype>(header.ciphertextSize());
+    }
+
+    qsizetype VaultManager::decryptSegmented(CryptoDriver *driver, std::span<const std::byte> ciphertext,
+                                             std::span<std::byte> out, const Key<SymmetricKeyTag> &key,
+                                             const SegmentOptions &options)
+    {
+        const SegmentedHeader header = readSegments(driver, ciphertext);
+        OperationTimer timer(m_metrics, driver, VaultMetrics::Direction::Decrypt);
+        if (out.size() < header.plaintextSize)
+        {
+            throw std::length_error("output buffer too small");
+        }
+        const std::unique_ptr<PreparedKey> prepared = driver->prepareKey(key.raw());
+        parallelFor(m_segmentPool, header.segmentCount(), resolveThreadCount(driver, options), [&](qint64 index)
+                    {
+            const QByteArray nonce = header.deriveNonce(index);
+            const auto length = static_cast<std::size_t>(header.plainLength(index));
+            driver->decryptSegment(ciphertext.subspan(static_cast<std::size_t>(header.cipherOffset(index)), length + header.segmentOverhead),
+                                   out.subspan(static_cast<std::size_t>(header.plainOffset(index)), length),
+                                   *prepared, asBytes(nonce)); });
+        timer.finish(static_cast<qint64>(ciphertext.size()), static_cast<qint64>(header.plaintextSize));
+        return static_cast<qsizetype>(header.plaintextSize);
+    }
+
+    QByteArray VaultManager::encryptSegmented(CryptoDriver *driver, const QByteArray &plaintext,
+                                              const Key<SymmetricKeyTag> &key, const SegmentOptions &options)
+    {
+        QByteArray cipher(segmentedCiphertextSize(driver, plaintext.size(), options), Qt::Uninitialized);
+        encryptSegmented(driver, asBytes(plaintext), asWritableBytes(cipher), key, options);
+        return cipher;
+    }
+
+    QByteArray VaultManager::decryptSegmented(CryptoDriver *driver, const QByteArray &ciphertext,
+                                              const Key<SymmetricKeyTag> &key, const SegmentOptions &options)
+    {
+        const SegmentedHeader header = readSegments(driver, asBytes(ciphertext));
+        QByteArray plain(static_cast<qsizetype>(header.plaintextSize), Qt::Uninitialized);
+        decryptSegmented(driver, asBytes(ciphertext), asWritableBytes(plain), key, options);
+        return plain;
+    }
+
+    void VaultManager::encryptSegmentedFile(CryptoDriver *driver, const QString &inputPath, const QString &outputPath,
+                                            const Key<SymmetricKeyTag> &key, const SegmentOptions &options)
+    {
+        OperationTimer timer(m_metrics, driver, VaultMetrics::Direction::Encrypt);
+        const MappedFile input = m_storage.map(inputPath);
+        const qint64 outputSize = segmentedCiphertextSize(driver, input.size(), options);
+        m_storage.storeMapped(outputPath, outputSize, [&](std::span<std::byte> out)
+                              {
+            const auto started = MetricsClock::now();
+            encryptSegmented(driver, input.bytes(), out, key, options);
+            timer.addCipherNanos(nanosSince(started)); });
+        timer.finish(input.size(), outputSize);
+    }
+
+    void VaultManager::decryptSegmentedFile(CryptoDriver *driver, const QString &inputPath, const QString &outputPath,
+                                            const Key<SymmetricKeyTag> &key, const SegmentOptions &options)
+    {
+        OperationTimer timer(m_metrics, driver, VaultMetrics::Direction::Decrypt);
+        const MappedFile input = m_storage.map(inputPath);
+        const SegmentedHeader header = readSegments(driver, input.bytes());
+        m_storage.storeMapped(outputPath, static_cast<qint64>(header.plaintextSize), [&](std::span<std::byte> out)
+                              {
+            const auto started = MetricsClock::now();
+            decryptSegmented(driver, input.bytes(), out, key, options);
+            timer.addCipherNanos(nanosSince(started)); });
+        timer.finish(input.size(), static_cast<qint64>(header.plaintextSize));
+    }
+
+    Key<SymmetricKeyTag> VaultManager::createDataKey(CryptoDriver *driver, const Key<SymmetricKeyTag> &masterKey,
+                                                     QByteArray *wrappedOut)
+    {
+        if (masterKey.size() <= 0)
+        {
+            throw std::invalid_argument("master key is empty");
+        }
+        Key<SymmetricKeyTag> dataKey(SecureRandom::bytes(masterKey.size()), QStringLiteral("data"));
+        if (wrappedOut)
+        {
+            *wrappedOut = wrapDataKey(driver, dataKey, masterKey);
+        }
+        return dataKey;
+    }
+
+    QByteArray VaultManager::wrapDataKey(CryptoDriver *driver, const Key<SymmetricKeyTag> &dataKey,
+                                         const Key<SymmetricKeyTag> &masterKey)
+    {
+        if (!driver)
+        {
+            throw std::invalid_argument("driver is null");
+        }
+        // Straight to the driver: a few dozen bytes of key material should not show up in the payload metrics.
+        return masterKeyFingerprint(masterKey) + driver->encrypt(dataKey.raw(), masterKey.raw());
+    }
+
+    Key<SymmetricKeyTag> VaultManager::unwrapDataKey(CryptoDriver *driver, const QByteArray &wrappedKey,
+                                                     const Key<SymmetricKeyTag> &masterKey)
+    {
+        if (!driver)
+        {
+            throw std::invalid_argument("driver is null");
+        }
+        if (!isWrappedUnder(wrappedKey, masterKey))
+        {
+            throw std::runtime_error("data key is wrapped under a different master key");
+        }
+        QByteArray dataKey = driver->decrypt(wrappedKey.mid(kFingerprintSize), masterKey.raw());
+        if (dataKey.isEmpty())
+        {
+            throw std::runtime_error("wrapped data key is empty");
+        }
+        return Key<SymmetricKeyTag>(std::move(dataKey), QStringLiteral("data"));
+    }
+
+    bool VaultManager::isWrappedUnder(const QByteArray &wrappedKey, const Key<SymmetricKeyTag> &masterKey)
+    {
+        return wrappedKey.size() > kFingerprintSize && wrappedKey.startsWith(masterKeyFingerprint(masterKey));
+    }
+
+    Key<SymmetricKeyTag> VaultManager::payloadKey(CryptoDriver *driver, const VaultEntry &entry,
+                                                  const Key<SymmetricKeyTag> &masterKey)
+    {
+        if (entry.wrappedKey.isEmpty())
+        {
+            return Key<SymmetricKeyTag>(masterKey.materialize(), masterKey.label());
+        }
+        return unwrapDataKey(driver, entry.wrappedKey, masterKey);
+    }
+
+    void VaultManager::decryptEntry(const VaultEntry &entry, const QString &outputPath,
+                                    const Key<SymmetricKeyTag> &masterKey, const JobControl &control)
+    {
+        CryptoDriver *driver = driverNamed(entry.algorithm);
+        if (!driver)
+        {
+            throw std::runtime_error(QStringLiteral("No driver named %1 for %2").arg(entry.algorithm, entry.storedPath).toStdString());
+        }
+        decryptFile(driver, entry.storedPath, outputPath, payloadKey(driver, entry, masterKey), kAutoChunkSize, control);
+    }
+
+    void VaultManager::requireWritableIndex() const
+    {
+        std::lock_guard<std::mutex> lock(m_entriesMutex);
+        requireOpen(m_index);
     }
 
     void VaultManager::addEntry(VaultEntry entry)
     {
-        m_entries.push_back(std::move(entry));
+        VaultIndex::PutResult result;
+        quint64 version = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_entriesMutex);
+            requireOpen(m_index);
+            result = m_index.put(entry);
+            version = ++m_version;
+            if (m_queryIndexes)
+            {
+                std::unique_lock<std::shared_mutex> queryLock(m_queryMutex);
+                m_queryIndexes->insert(entry);
+            }
+            if (const auto current = m_snapshot.load())
+            {
+                m_snapshot.store(std::make_shared<const EntrySnapshot>(current->withEntry(result.position, std::move(entry), m_version)));
+            }
+        }
+        if (result.replaced)
+        {
+            emit entryChanged(result.position, version);
+        }
+        else
+        {
+            emit entryInserted(result.position, version);
+        }
+    }
+
+    void VaultManager::addEntries(std::vector<VaultEntry> entries)
+    {
+        if (entries.size() <= 1)
+        {
+            if (!entries.empty())
+            {
+                addEntry(std::move(entries.front()));
+            }
+            return;
+        }
+        std::vector<VaultIndex::PutResult> results;
+        quint64 version = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_entriesMutex);
+            requireOpen(m_index);
+            results = m_index.put(entries);
+            version = ++m_version;
+            if (m_queryIndexes)
+            {
+                std::unique_lock<std::shared_mutex> queryLock(m_queryMutex);
+                for (const VaultEntry &entry : entries)
+                {
+                    m_queryIndexes->insert(entry);
+                }
+            }
+            if (const auto current = m_snapshot.load())
+            {
+                std::vector<std::pair<qsizetype, VaultEntry>> changes;
+                changes.reserve(entries.size());
+                for (std::size_t i = 0; i < entries.size(); ++i)
+                {
+                    changes.emplace_back(results[i].position, std::move(entries[i]));
+                }
+                m_snapshot.store(std::make_shared<const EntrySnapshot>(current->withEntries(std::move(changes), m_version)));
+            }
+        }
+        const bool appendedOnly = std::none_of(results.cbegin(), results.cend(),
+                                               [](const VaultIndex::PutResult &result) { return result.replaced; });
+        if (appendedOnly)
+        {
+            emit entriesInserted(results.front().position, results.back().position, version);
+        }
+        else
+        {
+            emit entriesReset();
+        }
+    }
+
+    bool VaultManager::removeEntry(const QString &storedPath)
+    {
+        qsizetype position = -1;
+        quint64 version = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_entriesMutex);
+            position = m_index.remove(storedPath);
+            if (position < 0)
+            {
+                return false;
+            }
+            version = ++m_version;
+            if (m_queryIndexes)
+            {
+                std::unique_lock<std::shared_mutex> queryLock(m_queryMutex);
+                m_queryIndexes->remove(storedPath);
+            }
+            if (const auto current = m_snapshot.load())
+            {
+                m_snapshot.store(std::make_shared<const EntrySnapshot>(current->without(position, m_version)));
+            }
+        }
+        emit entryRemoved(position, version);
+        return true;
+    }
+
+    void VaultManager::compactIndex()
+    {
+        std::lock_guard<std::mutex> lock(m_entriesMutex);
+        requireOpen(m_index);
+        m_index.compact();
+    }
+
+    std::shared_ptr<const EntrySnapshot> VaultManager::snapshot() const
+    {
+        if (auto current = m_snapshot.load())
+        {
+            return current;
+        }
+        std::lock_guard<std::mutex> lock(m_entriesMutex);
+        if (auto current = m_snapshot.load())
+        {
+            return current;
+        }
+        auto built = std::make_shared<const EntrySnapshot>(EntrySnapshot::fromIndex(m_index, m_version));
+        m_snapshot.store(built);
+        return built;
+    }
+
+    qsizetype VaultManager::entryCount() const
+    {
+        if (const auto current = m_snapshot.load())
+        {
+            return current->size();
+        }
+        std::lock_guard<std::mutex> lock(m_entriesMutex);
+        return m_index.size();
+    }
+
+    std::pair<qsizetype, quint64> VaultManager::versionedEntryCount() const
+    {
+        if (const auto current = m_snapshot.load())
+        {
+            return {current->size(), current->version()};
+        }
+        std::lock_guard<std::mutex> lock(m_entriesMutex);
+        return {m_index.size(), m_version};
+    }
+
+    VaultEntry VaultManager::entryAt(qsizetype position) const
+    {
+        if (const auto current = m_snapshot.load())
+        {
+            return current->at(position);
+        }
+        std::lock_guard<std::mutex> lock(m_entriesMutex);
+        return m_index.entryAt(position);
+    }
+
+    template <typename Read>
+    auto VaultManager::readQueryIndexes(Read &&read) const
+    {
+        {
+            std::shared_lock<std::shared_mutex> lock(m_queryMutex);
+            if (m_queryIndexes)
+            {
+                return read(*m_queryIndexes);
+            }
+        }
+        // Built under the writer lock so that no write slips in between reading the entries and
+        // publishing the indexes. The snapshot, when there is one, shares its strings with them.
+        std::lock_guard<std::mutex> lock(m_entriesMutex);
+        if (!m_queryIndexes)
+        {
+            auto built = std::make_unique<EntryIndexes>();
+            if (const auto current = m_snapshot.load())
+            {
+                current->forEach([&](const VaultEntry &entry) { built->insert(entry); });
+            }
+            else
+            {
+                for (qsizetype i = 0; i < m_index.size(); ++i)
+                {
+                    built->insert(m_index.entryAt(i));
+                }
+            }
+            std::unique_lock<std::shared_mutex> queryLock(m_queryMutex);
+            m_queryIndexes = std::move(built);
+        }
+        std::shared_lock<std::shared_mutex> queryLock(m_queryMutex);
+        return read(*m_queryIndexes);
+    }
+
+    std::optional<VaultEntry> VaultManager::findEntry(const QString &storedPath) const
+    {
+        return readQueryIndexes([&](const EntryIndexes &indexes) -> std::optional<VaultEntry>
+                                {
+            if (const VaultEntry *entry = indexes.find(storedPath))
+            {
+                return *entry;
+            }
+            return std::nullopt; });
+    }
+
+    std::vector<VaultEntry> VaultManager::findEntries(const EntryQuery &query) const
+    {
+        return readQueryIndexes([&](const EntryIndexes &indexes) { return indexes.query(query); });
+    }
+
+    QHash<QString, qsizetype> VaultManager::algorithmCounts() const
+    {
+        return readQueryIndexes([](const EntryIndexes &indexes) { return indexes.algorithmCounts(); });
+    }
+
+    qsizetype VaultManager::positionOf(const QString &storedPath) const
+    {
+        std::lock_guard<std::mutex> lock(m_entriesMutex);
+        return m_index.indexOf(storedPath);
     }
 
 } // namespace dynamicencrypt::core
@@ -1,31 +1,107 @@
 #pragma once
 
+#include "ChangeCache.h"
 #include "CryptoDriver.h"
+#include "EntryIndexes.h"
+#include "EntrySnapshot.h"
 #include "Key.h"
+#include "KeyRegistry.h"
+#include "LazyDriver.h"
+#include "Metrics.h"
+#include "PluginCache.h"
+#include "PluginDescriptor.h"
+#include "SegmentedFormat.h"
 #include "Storage.h"
 #include "VaultEntry.h"
+#include "VaultIndex.h"
 
+#include <QCryptographicHash>
 #include <QDir>
 #include <QObject>
-#include <QPluginLoader>
+#include <QThreadPool>
 
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
 #include <stdexcept>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace dynamicencrypt::core
 {
 
+    // Thrown when a long-running job observes its cancellation flag.
+    class OperationCancelled : public std::runtime_error
+    {
+    public:
+        OperationCancelled() : std::runtime_error("operation cancelled") {}
+    };
+
+    // Optional hooks for long-running jobs; both may be left empty.
+    struct JobControl
+    {
+        std::function<void(qint64 done, qint64 total)> progress;
+        const std::atomic_bool *cancelled{nullptr};
+
+        bool isCancelled() const noexcept { return cancelled && cancelled->load(std::memory_order_relaxed); }
+    };
+
+    // What a caller needs from a driver; preferredDriver() picks the fastest driver that qualifies.
+    struct DriverRequirements
+    {
+        QStringList tags; // every tag must be declared, e.g. "aead"
+        bool streaming{false};
+        bool segments{false};
+        bool threadSafe{false};
+
+        bool satisfiedBy(const DriverCapabilities &capabilities) const
+        {
+            for (const QString &tag : tags)
+            {
+                if (!capabilities.tags.contains(tag))
+                {
+                    return false;
+                }
+            }
+            return (!streaming || capabilities.streaming) && (!segments || capabilities.segments) &&
+                   (!threadSafe || capabilities.threadSafe);
+        }
+    };
+
     class VaultManager : public QObject
     {
         Q_OBJECT
     public:
+        enum class InitialVault
+        {
+            Default, // ~/Documents/DynamicEncryptVault, created if missing
+            None,    // no storage directory and no index until setStorageDirectory()
+        };
+
         explicit VaultManager(QObject *parent = nullptr);
+        explicit VaultManager(InitialVault vault, QObject *parent = nullptr);
         ~VaultManager() override;
 
+        // Reads plugin.json metadata (through pluginCache()) for every library on the search paths.
+        // Libraries are not loaded here; each driver loads its library on first use.
         void discoverPlugins(const QStringList &searchPaths);
         std::vector<CryptoDriver *> drivers() const;
+        std::vector<PluginDescriptor> pluginDescriptors() const;
+        PluginCache &pluginCache() noexcept { return m_pluginCache; }
+
+        // Highest speedRank among the discovered drivers meeting the requirements, earliest on a tie;
+        // nullptr when none qualifies. Uses declared capabilities only, so no plugin is loaded.
+        CryptoDriver *preferredDriver(const DriverRequirements &requirements = {}) const;
+
+        // Per-driver bytes, operation counts, latency percentiles and cipher versus I/O time for the
+        // operations below, plus storage() I/O totals. Safe to call while operations run.
+        MetricsSnapshot metrics() const;
+        void resetMetrics();
 
         void setStorageDirectory(QString path);
         const QString &storageDirectory() const noexcept { return m_storageDir; }
@@ -76,7 +152,8 @@ namespace dynamicencrypt::core
             return driver->encrypt(plaintext, key.raw());
         }
 
-       ptoDriver *driver, const QByteArray &ciphertext, const Key<KeyTag> &key)
+        template <typename KeyTag>
+        QByteArray decryptWith(CryptoDriver *driver, const QByteArray &ciphertext, const Key<KeyTag> &key)
         {
             static_assert(std::is_same_v<KeyTag, SymmetricKeyTag>, "decryptWith currently accepts symmetric keys");
             if (!driver)
@@ -86,26 +163,179 @@ namespace dynamicencrypt::core
             return driver->decrypt(ciphertext, key.raw());
         }
 
+        // nonceOut receives the ciphertext's leading ciphertextLayout().header bytes; it is left empty
+        // for drivers without a fixed layout.
         QByteArray encryptSymmetric(CryptoDriver *driver, const QByteArray &plaintext, const Key<SymmetricKeyTag> &key,
                                     QByteArray *nonceOut = nullptr);
         QByteArray decryptSymmetric(CryptoDriver *driver, const QByteArray &ciphertext, const Key<SymmetricKeyTag> &key);
 
+        // Span overloads write into caller-owned buffers sized via CryptoDriver::ciphertextLayout().
+        qsizetype encryptSymmetric(CryptoDriver *driver, std::span<const std::byte> plaintext, std::span<std::byte> out,
+                                   const Key<SymmetricKeyTag> &key, QByteArray *nonceOut = nullptr);
+        qsizetype decryptSymmetric(CryptoDriver *driver, std::span<const std::byte> ciphertext, std::span<std::byte> out,
+                                   const Key<SymmetricKeyTag> &key);
+
+        // Prepared keys: the driver expands the key once, so calls through the handle skip key setup.
+        // Handles stay valid until releaseKey() or the next discoverPlugins(); the handle overloads need
+        // a driver with a fixed ciphertext layout.
+        KeyHandle prepareKey(CryptoDriver *driver, const Key<SymmetricKeyTag> &key);
+        bool releaseKey(KeyHandle handle) { return m_keys.remove(handle); }
+        KeyRegistry &keyRegistry() noexcept { return m_keys; }
+
+        QByteArray encryptSymmetric(KeyHandle key, const QByteArray &plaintext, QByteArray *nonceOut = nullptr);
+        QByteArray decryptSymmetric(KeyHandle key, const QByteArray &ciphertext);
+        qsizetype encryptSymmetric(KeyHandle key, std::span<const std::byte> plaintext, std::span<std::byte> out,
+                                   QByteArray *nonceOut = nullptr);
+        qsizetype decryptSymmetric(KeyHandle key, std::span<const std::byte> ciphertext, std::span<std::byte> out);
+
+        // Chunked file paths; peak memory is bounded by chunkSize instead of the file size.
+        // kAutoChunkSize uses the driver's declared chunk size, rounded up to its alignment.
+        static constexpr qsizetype kDefaultChunkSize = 1 << 20;
+        static constexpr qsizetype kAutoChunkSize = 0;
+
+        static qsizetype chunkSizeFor(const CryptoDriver *driver, qsizetype requested = kAutoChunkSize);
+
+        // digestOut receives the kDigestAlgorithm hash of the output, taken as it is written, for VaultEntry::digest.
+        void encryptFile(CryptoDriver *driver, const QString &inputPath, const QString &outputPath,
+                         const Key<SymmetricKeyTag> &key, QByteArray *nonceOut = nullptr,
+                         qsizetype chunkSize = kAutoChunkSize, const JobControl &control = {},
+                         QByteArray *digestOut = nullptr);
+        void decryptFile(CryptoDriver *driver, const QString &inputPath, const QString &outputPath,
+                         const Key<SymmetricKeyTag> &key, qsizetype chunkSize = kAutoChunkSize,
+                         const JobControl &control = {});
+
+        // Memory-mapped paths: the cipher reads from a read-only mapping of the input and writes
+        // straight into a pre-sized mapping of the output, which is renamed into place afterwards.
+        void encryptMappedFile(CryptoDriver *driver, const QString &inputPath, const QString &outputPath,
+                               const Key<SymmetricKeyTag> &key, QByteArray *nonceOut = nullptr);
+        void decryptMappedFile(CryptoDriver *driver, const QString &inputPath, const QString &outputPath,
+                               const Key<SymmetricKeyTag> &key);
+
+        // Segmented format (see SegmentedHeader): segments are sealed independently across a thread pool.
+        static constexpr qsizetype kDefaultSegmentSize = 4 << 20;
+
+        struct SegmentOptions
+        {
+            qsizetype segmentSize{kDefaultSegmentSize};
+            // 0 uses QThread::idealThreadCount(); drivers not declared thread-safe always get one thread.
+            int threadCount{0};
+        };
+
+        qint64 segmentedCiphertextSize(CryptoDriver *driver, qint64 plaintextSize,
+                                       const SegmentOptions &options = {}) const;
+        qsizetype encryptSegmented(CryptoDriver *driver, std::span<const std::byte> plaintext, std::span<std::byte> out,
+                                   const Key<SymmetricKeyTag> &key, const SegmentOptions &options = {});
+        qsizetype decryptSegmented(CryptoDriver *driver, std::span<const std::byte> ciphertext, std::span<std::byte> out,
+                                   const Key<SymmetricKeyTag> &key, const SegmentOptions &options = {});
+        QByteArray encryptSegmented(CryptoDriver *driver, const QByteArray &plaintext, const Key<SymmetricKeyTag> &key,
+                                    const SegmentOptions &options = {});
+        QByteArray decryptSegmented(CryptoDriver *driver, const QByteArray &ciphertext, const Key<SymmetricKeyTag> &key,
+                                    const SegmentOptions &options = {});
+        void encryptSegmentedFile(CryptoDriver *driver, const QString &inputPath, const QString &outputPath,
+                                  const Key<SymmetricKeyTag> &key, const SegmentOptions &options = {});
+        void decryptSegmentedFile(CryptoDriver *driver, const QString &inputPath, const QString &outputPath,
+                                  const Key<SymmetricKeyTag> &key, const SegmentOptions &options = {});
+
+        // Envelope encryption: each vault payload is encrypted with its own random data key, and only that
+        // key is encrypted ("wrapped") with the master key and kept in VaultEntry::wrappedKey. Rotating the
+        // master key then rewraps data keys (see KeyRotator) and never touches the payloads.
+        //
+        // A wrapped key is a fingerprint of the master key followed by the driver's ciphertext of the data
+        // key, so the wrong master key is reported as such even by drivers without an authentication tag.
+        static Key<SymmetricKeyTag> createDataKey(CryptoDriver *driver, const Key<SymmetricKeyTag> &masterKey,
+                                                  QByteArray *wrappedOut);
+        static QByteArray wrapDataKey(CryptoDriver *driver, const Key<SymmetricKeyTag> &dataKey,
+                                      const Key<SymmetricKeyTag> &masterKey);
+        static Key<SymmetricKeyTag> unwrapDataKey(CryptoDriver *driver, const QByteArray &wrappedKey,
+                                                  const Key<SymmetricKeyTag> &masterKey);
+        static bool isWrappedUnder(const QByteArray &wrappedKey, const Key<SymmetricKeyTag> &masterKey);
+        // The key entry's payload was encrypted with: its unwrapped data key, or a copy of masterKey for an
+        // entry without one.
+        static Key<SymmetricKeyTag> payloadKey(CryptoDriver *driver, const VaultEntry &entry,
+                                               const Key<SymmetricKeyTag> &masterKey);
+        // Decrypts entry's stored file to outputPath with the driver named by entry.algorithm.
+        void decryptEntry(const VaultEntry &entry, const QString &outputPath, const Key<SymmetricKeyTag> &masterKey,
+                          const JobControl &control = {});
+        // The discovered driver with this name, or nullptr.
+        CryptoDriver *driverNamed(const QString &name) const;
+
+        // Entries persist in storageDirectory()/vault.index. Adding an entry whose storedPath is already
+        // known replaces it in place, since the vault file on disk was overwritten.
+        //
+        // Entry methods may be called from any thread. Writers are serialized among themselves; readers
+        // of snapshot() never wait for them and see either all or none of a write.
+        static constexpr const char *kIndexFileName = "vault.index";
+        static constexpr QCryptographicHash::Algorithm kDigestAlgorithm = QCryptographicHash::Sha256;
+
+        // Adding entries or compacting throws std::runtime_error unless vault.index is open for writing:
+        // an entry holds the only wrapped copy of its data key, so it must never live in memory alone.
+        void requireWritableIndex() const;
         void addEntry(VaultEntry entry);
-        const std::vector<VaultEntry> &entries() const noexcept { return m_entries; }
+        // addEntry() for each entry as one write: one index flush, one snapshot and one signal.
+        void addEntries(std::vector<VaultEntry> entries);
+        bool removeEntry(const QString &storedPath);
+        // Decodes every entry on first use, then is kept current by each write.
+        std::shared_ptr<const EntrySnapshot> snapshot() const;
+        // snapshot() if one has been built, otherwise null; never decodes entries itself.
+        std::shared_ptr<const EntrySnapshot> existingSnapshot() const { return m_snapshot.load(); }
+        // Served from the snapshot once there is one, otherwise decoded from the index under the write lock.
+        qsizetype entryCount() const;
+        // entryCount() with the version of the state it was read from, as EntrySnapshot::version() reports it.
+        std::pair<qsizetype, quint64> versionedEntryCount() const;
+        VaultEntry entryAt(qsizetype position) const;
+        std::vector<VaultEntry> entries() const { return snapshot()->toVector(); }
+        // Indexed lookups that never scan the vault. The indexes are built on first use and then updated by
+        // each write; writers hold their lock only for that in-memory update, not for index file I/O.
+        std::optional<VaultEntry> findEntry(const QString &storedPath) const;
+        std::vector<VaultEntry> findEntries(const EntryQuery &query) const;
+        QHash<QString, qsizetype> algorithmCounts() const;
+        // Current position of storedPath in entryAt() order, or -1.
+        qsizetype positionOf(const QString &storedPath) const;
+        // Rewrites vault.index with live entries only, so replaced records no longer exist in the file.
+        void compactIndex();
+        // Not synchronized with writers; only use it while no other thread adds or removes entries.
+        const VaultIndex &index() const noexcept { return m_index; }
 
         Storage &storage() noexcept { return m_storage; }
+        // Source file signatures from earlier directory passes, in storageDirectory()/change.cache.
+        ChangeCache &changeCache() noexcept { return m_changeCache; }
+
+    signals:
+        // Row-level change notifications for views over entryAt(). version is the EntrySnapshot::version()
+        // the change produced, so a receiver can tell whether it applies to the snapshot it holds.
+        void entryInserted(qsizetype position, quint64 version);
+        // From addEntries() when every entry was new; a batch that replaced any entries emits entriesReset().
+        void entriesInserted(qsizetype first, qsizetype last, quint64 version);
+        void entryChanged(qsizetype position, quint64 version);
+        void entryRemoved(qsizetype position, quint64 version);
+        void entriesReset();
 
     private:
-        struct PluginHolder
-        {
-            std::unique_ptr<QPluginLoader> loader;
-            CryptoDriver *instance{nullptr};
-        };
+        template <typename Read>
+        auto readQueryIndexes(Read &&read) const;
+        // The KeyHandle overloads resolve the handle once and run on the registry entry from there.
+        qsizetype encryptPrepared(const KeyRegistry::Entry &entry, std::span<const std::byte> plaintext,
+                                  std::span<std::byte> out, QByteArray *nonceOut);
+        qsizetype decryptPrepared(const KeyRegistry::Entry &entry, std::span<const std::byte> ciphertext,
+                                  std::span<std::byte> out);
 
-        std::vector<PluginHolder> m_plugins;
-        std::vector<VaultEntry> m_entries;
+        PluginCache m_pluginCache;
+        std::vector<std::unique_ptr<LazyDriver>> m_plugins;
+        KeyRegistry m_keys;
+        VaultMetrics m_metrics;
+        // Guards m_index and m_version and orders snapshot publication; readers of m_snapshot never take it.
+        mutable std::mutex m_entriesMutex;
+        VaultIndex m_index;
+        quint64 m_version{0};
+        mutable std::atomic<std::shared_ptr<const EntrySnapshot>> m_snapshot;
+        // Guards m_queryIndexes for readers. Writers also hold m_entriesMutex, taken first, so under that
+        // lock the pointer itself may be read without this one.
+        mutable std::shared_mutex m_queryMutex;
+        mutable std::unique_ptr<EntryIndexes> m_queryIndexes;
         QString m_storageDir;
         Storage m_storage;
+        ChangeCache m_changeCache;
+        QThreadPool m_segmentPool;
     };
 
 } // namespace dynamicencrypt::core
@@ -0,0 +1,278 @@
+#include "VaultScrubber.h"
+
+#include "WorkStealingPool.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <semaphore>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+
+namespace dynamicencrypt::core
+{
+
+    namespace
+    {
+        using Problem = ScrubResult::Problem;
+
+        QString normalized(const QString &path)
+        {
+            return QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+        }
+
+        // State shared by the tasks of one scrub() call.
+        class ScrubRun
+        {
+        public:
+            ScrubRun(VaultManager &manager, const ScrubOptions &options, const JobControl &control, int threads)
+                : m_manager(manager),
+                  m_options(options),
+                  m_control(control),
+                  m_reads(options.maxConcurrentReads),
+                  m_buffers(static_cast<std::size_t>(threads)),
+                  m_pool(threads)
+            {
+            }
+
+            ScrubResult run()
+            {
+                const auto started = MetricsClock::now();
+                const std::vector<VaultEntry> entries = m_manager.snapshot()->toVector();
+                m_sizes.assign(entries.size(), -1);
+                // Sizes first, so progress can be reported against the total.
+                for (std::size_t i = 0; i < entries.size(); ++i)
+                {
+                    m_pool.submit([this, &entries, i]()
+                                  {
+                        const QFileInfo info(entries[i].storedPath);
+                        if (info.isFile())
+                        {
+                            m_sizes[i] = info.size();
+                        } });
+                }
+                m_pool.submit([this, &entries]() { findUntracked(entries); });
+                m_pool.wait();
+                throwIfCancelled();
+                for (const qint64 size : m_sizes)
+                {
+                    m_total += qMax<qint64>(size, 0);
+                }
+
+                for (std::size_t i = 0; i < entries.size(); ++i)
+                {
+                    m_pool.submit([this, &entries, i]() { verify(entries[i], m_sizes[i]); });
+                }
+                m_pool.wait();
+                throwIfCancelled();
+                m_manager.addEntries(currentBackfill());
+
+                std::sort(m_result.issues.begin(), m_result.issues.end(),
+                          [](const ScrubResult::Issue &a, const ScrubResult::Issue &b) { return a.path < b.path; });
+                m_result.files = static_cast<qint64>(entries.size());
+                m_result.verified = m_verified.load();
+                m_result.unverified = m_unverified.load();
+                m_result.bytes = m_read.load();
+                m_result.elapsedNanos = nanosSince(started);
+                return std::move(m_result);
+            }
+
+        private:
+            void verify(const VaultEntry &entry, qint64 size)
+            {
+                if (m_control.isCancelled())
+                {
+                    return;
+                }
+                if (size < 0)
+                {
+                    report(entry.storedPath, Problem::Missing, QStringLiteral("not found"));
+                    return;
+                }
+                QFile file(entry.storedPath);
+                if (!file.open(QIODevice::ReadOnly))
+                {
+                    report(entry.storedPath, Problem::Unreadable, file.errorString());
+                    return;
+                }
+                QByteArray &buffer = m_buffers[static_cast<std::size_t>(m_pool.currentWorker())];
+                buffer.resize(m_options.readSize);
+                QCryptographicHash hash(VaultManager::kDigestAlgorithm);
+                while (true)
+                {
+                    if (m_control.isCancelled())
+                    {
+                        return;
+                    }
+                    // Only the read holds a slot; hashing runs on every worker at once.
+                    m_reads.acquire();
+                    const auto reading = MetricsClock::now();
+                    const qint64 read = file.read(buffer.data(), buffer.size());
+                    m_manager.storage().io().recordRead(read, nanosSince(reading));
+                    m_reads.release();
+                    if (read < 0)
+                    {
+                        report(entry.storedPath, Problem::Unreadable, file.errorString());
+                        return;
+                    }
+                    if (read == 0)
+                    {
+                        break;
+                    }
+                    hash.addData(QByteArray::fromRawData(buffer.constData(), static_cast<qsizetype>(read)));
+                    m_read += read;
+                    reportProgress();
+                }
+
+                const QByteArray digest = hash.result();
+                if (entry.digest.isEmpty())
+                {
+                    ++m_unverified;
+                    if (m_options.recordMissingDigests)
+                    {
+                        VaultEntry updated = entry;
+                        updated.digest = digest;
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        m_backfill.push_back(std::move(updated));
+                    }
+                }
+                else if (digest == entry.digest)
+                {
+                    ++m_verified;
+                }
+                else
+                {
+                    report(entry.storedPath, Problem::Corrupt, QStringLiteral("content does not match the recorded digest"));
+                }
+            }
+
+            // The backfilled digests whose entries still hold the payload that was hashed. The list above was
+            // read when the scrub started, so an entry re-encrypted or rewrapped since then is left alone
+            // rather than written back with its old nonce and wrapped key.
+            std::vector<VaultEntry> currentBackfill()
+            {
+                std::vector<VaultEntry> current;
+                current.reserve(m_backfill.size());
+                for (VaultEntry &scrubbed : m_backfill)
+                {
+                    std::optional<VaultEntry> entry = m_manager.findEntry(scrubbed.storedPath);
+                    if (entry && entry->digest.isEmpty() && entry->wrappedKey == scrubbed.wrappedKey
+                        && entry->nonce == scrubbed.nonce && entry->timestamp == scrubbed.timestamp)
+                    {
+                        entry->digest = std::move(scrubbed.digest);
+                        current.push_back(std::move(*entry));
+                    }
+                }
+                return current;
+            }
+
+            void findUntracked(const std::vector<VaultEntry> &entries)
+            {
+                const QString root = m_manager.storageDirectory();
+                if (root.isEmpty())
+                {
+                    return;
+                }
+                std::unordered_set<QString> tracked;
+                tracked.reserve(entries.size() + 3);
+                for (const VaultEntry &entry : entries)
+                {
+                    tracked.insert(normalized(entry.storedPath));
+                }
+                // The vault's own bookkeeping.
+                const QString indexPath = QDir(root).filePath(QString::fromLatin1(VaultManager::kIndexFileName));
+                tracked.insert(normalized(indexPath));
+                tracked.insert(normalized(VaultIndex::lockPath(indexPath)));
+                tracked.insert(normalized(QDir(root).filePath(QString::fromLatin1(ChangeCache::kFileName))));
+                QDirIterator it(root, QDir::Files | QDir::Hidden | QDir::NoSymLinks, QDirIterator::Subdirectories);
+                while (it.hasNext() && !m_control.isCancelled())
+                {
+                    const QString path = normalized(it.next());
+                    if (!tracked.contains(path))
+                    {
+                        report(path, Problem::Untracked, QStringLiteral("no vault entry refers to this file"));
+                    }
+                }
+            }
+
+            void report(const QString &path, Problem problem, const QString &detail)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_result.issues.push_back({path, problem, detail});
+            }
+
+            void reportProgress()
+            {
+                if (m_control.progress)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_control.progress(m_read.load(), m_total);
+                }
+            }
+
+            void throwIfCancelled() const
+            {
+                if (m_control.isCancelled())
+                {
+                    throw OperationCancelled();
+                }
+            }
+
+            VaultManager &m_manager;
+            const ScrubOptions &m_options;
+            const JobControl &m_control;
+            std::counting_semaphore<> m_reads;
+            std::vector<qint64> m_sizes; // -1 where the stored file is missing
+            qint64 m_total{0};
+            std::atomic<qint64> m_read{0};
+            std::atomic<qint64> m_verified{0};
+            std::atomic<qint64> m_unverified{0};
+            // Guards m_result.issues and m_backfill, and serializes progress callbacks.
+            std::mutex m_mutex;
+            ScrubResult m_result;
+            std::vector<VaultEntry> m_backfill;
+            // One read buffer per worker, indexed by WorkStealingPool::currentWorker().
+            std::vector<QByteArray> m_buffers;
+            // Last member: its destructor joins the workers before the state above goes away.
+            WorkStealingPool m_pool;
+        };
+    }
+
+    bool ScrubResult::clean() const noexcept
+    {
+        return std::none_of(issues.cbegin(), issues.cend(), [](const Issue &issue) { return issue.problem != Problem::Untracked; });
+    }
+
+    VaultScrubber::VaultScrubber(VaultManager &manager, ScrubOptions options)
+        : m_manager(manager), m_options(std::move(options))
+    {
+        if (m_options.maxConcurrentReads < 1)
+        {
+            throw std::invalid_argument("maxConcurrentReads must be positive");
+        }
+        if (m_options.readSize < 1)
+        {
+            throw std::invalid_argument("readSize must be positive");
+        }
+    }
+
+    ScrubResult VaultScrubber::scrub(const JobControl &control)
+    {
+        if (m_options.recordMissingDigests)
+        {
+            m_manager.requireWritableIndex();
+        }
+        const int threads = m_options.threadCount > 0 ? m_options.threadCount : QThread::idealThreadCount();
+        ScrubRun run(m_manager, m_options, control, threads);
+        return run.run();
+    }
+
+} // namespace dynamicencrypt::core
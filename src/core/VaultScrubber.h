@@ -0,0 +1,70 @@
+#pragma once
+
+#include "VaultManager.h"
+
+#include <QString>
+
+#include <vector>
+
+namespace dynamicencrypt::core
+{
+
+    struct ScrubOptions
+    {
+        int threadCount{0};             // hashing workers; 0: one per core
+        int maxConcurrentReads{4};      // reads in flight at once, however many workers there are
+        qsizetype readSize{1 << 20};    // bytes per read
+        // Give entries without a digest the one of their current content. Entries whose nonce, wrapped key or
+        // timestamp changed during the scrub are skipped; a write landing between that check and the
+        // backfill can still be overwritten, so this should not overlap with jobs that write the vault.
+        bool recordMissingDigests{false};
+    };
+
+    struct ScrubResult
+    {
+        enum class Problem
+        {
+            Missing,    // the entry's stored file does not exist
+            Unreadable, // it exists but could not be read
+            Corrupt,    // its content no longer matches the entry's digest
+            Untracked,  // a file in the storage directory that no entry refers to; informational
+        };
+
+        struct Issue
+        {
+            QString path;
+            Problem problem;
+            QString detail;
+        };
+
+        qint64 files{0};      // entries checked
+        qint64 verified{0};   // whose digest matched
+        qint64 unverified{0}; // read fine but had no digest to compare with
+        qint64 bytes{0};      // bytes read
+        qint64 elapsedNanos{0};
+        std::vector<Issue> issues;
+
+        double bytesPerSecond() const noexcept { return MetricsSnapshot::perSecond(static_cast<quint64>(bytes), elapsedNanos); }
+        // No entry is missing, unreadable or corrupt.
+        bool clean() const noexcept;
+    };
+
+    // Verifies every vault entry's stored file against VaultEntry::digest without decrypting it, and lists
+    // the files in storageDirectory() that no entry refers to. Files are hashed on a WorkStealingPool, while
+    // a semaphore caps the reads in flight at options.maxConcurrentReads so a scrub can run next to other
+    // work on spinning disks or network storage. Reads are counted in VaultManager::metrics().storage.
+    class VaultScrubber
+    {
+    public:
+        explicit VaultScrubber(VaultManager &manager, ScrubOptions options = {});
+
+        // control.progress receives (bytes read, bytes to read) from worker threads, one call at a time. On
+        // cancellation OperationCancelled is thrown and nothing is recorded.
+        ScrubResult scrub(const JobControl &control = {});
+
+    private:
+        VaultManager &m_manager;
+        ScrubOptions m_options;
+    };
+
+} // namespace dynamicencrypt::core
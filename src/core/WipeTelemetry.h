@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace dynamicencrypt::core
+{
+
+    // Counts secret wipes without shared state on the wipe path. Each thread bumps counters only it
+    // writes, so wipes on different threads never touch the same cache line; totals() sums the live
+    // threads plus those that have exited, taking a lock that only thread start/exit also takes.
+    //
+    // An optional observer sees every wiped span, which lets tests check that bytes are zeroed. With
+    // no observer installed the wipe path reads one flag; the observer itself is swapped without
+    // locking out wipes, and setObserver() waits for calls to the old one to finish before freeing it.
+    class WipeTelemetry
+    {
+    public:
+        struct Totals
+        {
+            std::uint64_t wipes{0};
+            std::uint64_t bytes{0};
+        };
+
+        // Called from any thread, possibly concurrently; the span is only valid during the call.
+        using Observer = std::function<void(std::span<const std::byte> wiped)>;
+
+        static void record(std::span<const std::byte> wiped) noexcept
+        {
+            Counters &counters = local();
+            // Single writer, so a relaxed load/store pair suffices and avoids a locked instruction.
+            counters.wipes.store(counters.wipes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            counters.bytes.store(counters.bytes.load(std::memory_order_relaxed) + wiped.size(), std::memory_order_relaxed);
+            State &s = state();
+            if (s.observed.load(std::memory_order_relaxed))
+            {
+                s.inFlight.fetch_add(1);
+                if (Observer *observer = s.observer.load())
+                {
+                    (*observer)(wiped);
+                }
+                s.inFlight.fetch_sub(1);
+            }
+        }
+
+        static Totals totals()
+        {
+            State &s = state();
+            std::lock_guard<std::mutex> lock(s.registryMutex);
+            Totals totals = s.retired;
+            for (const Counters *counters : s.live)
+            {
+                totals.wipes += counters->wipes.load(std::memory_order_relaxed);
+                totals.bytes += counters->bytes.load(std::memory_order_relaxed);
+            }
+            return totals;
+        }
+
+        // Installs observer, or removes the current one when it is empty.
+        static void setObserver(Observer observer)
+        {
+            State &s = state();
+            std::lock_guard<std::mutex> lock(s.observerMutex);
+            Observer *next = observer ? new Observer(std::move(observer)) : nullptr;
+            Observer *previous = s.observer.exchange(next);
+            s.observed.store(next != nullptr, std::memory_order_relaxed);
+            // A wipe that loaded the previous observer incremented inFlight first, so it is seen here.
+            while (s.inFlight.load() != 0)
+            {
+                std::this_thread::yield();
+            }
+            delete previous;
+        }
+
+    private:
+        struct alignas(64) Counters
+        {
+            std::atomic<std::uint64_t> wipes{0};
+            std::atomic<std::uint64_t> bytes{0};
+        };
+
+        struct State
+        {
+            std::mutex registryMutex;
+            std::vector<const Counters *> live;
+            Totals retired;
+
+            std::mutex observerMutex;
+            std::atomic<bool> observed{false};
+            std::atomic<Observer *> observer{nullptr};
+            std::atomic<int> inFlight{0};
+        };
+
+        // Registers the thread's counters on first use and folds them into the retired totals on exit.
+        struct Registration
+        {
+            Counters counters;
+
+            Registration()
+            {
+                State &s = state();
+                std::lock_guard<std::mutex> lock(s.registryMutex);
+                s.live.push_back(&counters);
+            }
+
+            ~Registration()
+            {
+                State &s = state();
+                std::lock_guard<std::mutex> lock(s.registryMutex);
+                s.retired.wipes += counters.wipes.load(std::memory_order_relaxed);
+                s.retired.bytes += counters.bytes.load(std::memory_order_relaxed);
+                std::erase(s.live, &counters);
+            }
+        };
+
+        // Never destroyed: threads may still exit, and wipe, after static destruction has begun.
+        static State &state()
+        {
+            static State *s = new State;
+            return *s;
+        }
+
+        static Counters &local()
+        {
+            thread_local Registration registration;
+            return registration.counters;
+        }
+    };
+
+} // namespace dynamicencrypt::core
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace dynamicencrypt::core
+{
+
+    // Fixed set of worker threads, each with its own task deque. A worker runs its newest task first and
+    // steals the oldest task of another worker once its own deque is empty, so the tasks a task spawns
+    // spread over the pool and a long task delays nothing queued behind it for longer than it takes an
+    // idle worker to steal it. Each deque has its own lock; idle workers sleep until work is submitted.
+    class WorkStealingPool
+    {
+    public:
+        using Task = std::function<void()>;
+
+        explicit WorkStealingPool(int threads)
+        {
+            const int count = qMax(threads, 1);
+            for (int i = 0; i < count; ++i)
+            {
+                m_workers.push_back(std::make_unique<Worker>());
+            }
+            for (int i = 0; i < count; ++i)
+            {
+                m_threads.emplace_back([this, i]() { run(static_cast<std::size_t>(i)); });
+            }
+        }
+
+        // Stops the workers; tasks that have not started are dropped.
+        ~WorkStealingPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_parkMutex);
+                m_stopping = true;
+            }
+            m_parked.notify_all();
+            for (std::thread &thread : m_threads)
+            {
+                thread.join();
+            }
+        }
+
+        WorkStealingPool(const WorkStealingPool &) = delete;
+        WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+        int threadCount() const noexcept { return static_cast<int>(m_workers.size()); }
+
+        // Index of the calling worker in this pool, or -1 on any other thread.
+        int currentWorker() const noexcept { return t_pool == this ? static_cast<int>(t_worker) : -1; }
+
+        // A worker pushes onto its own deque; other threads spread tasks round-robin.
+        void submit(Task task)
+        {
+            m_outstanding.fetch_add(1);
+            const std::size_t target =
+                t_pool == this ? t_worker : m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+            {
+                Worker &worker = *m_workers[target];
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                worker.tasks.push_back(std::move(task));
+            }
+            m_queued.fetch_add(1);
+            // Pairs with the sleeper count taken under m_parkMutex: either the sleeper sees m_queued or we
+            // see the sleeper.
+            if (m_sleepers.load() > 0)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_parkMutex);
+                }
+                m_parked.notify_one();
+            }
+        }
+
+        // Blocks until every task submitted so far, and every task those submit, has finished, then
+        // rethrows the first exception a task let escape. Must not be called from a worker.
+        void wait()
+        {
+            if (t_pool == this)
+            {
+                throw std::logic_error("WorkStealingPool::wait() called from one of its workers");
+            }
+            std::unique_lock<std::mutex> lock(m_parkMutex);
+            m_idle.wait(lock, [this]() { return m_outstanding.load() == 0; });
+            if (m_error)
+            {
+                std::rethrow_exception(std::exchange(m_error, nullptr));
+            }
+        }
+
+        // Tasks taken from another worker's deque since construction.
+        qint64 steals() const noexcept { return m_steals.load(std::memory_order_relaxed); }
+
+    private:
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        bool popOwn(std::size_t self, Task &task)
+        {
+            Worker &worker = *m_workers[self];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if (worker.tasks.empty())
+            {
+                return false;
+            }
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+            return true;
+        }
+
+        bool steal(std::size_t self, Task &task)
+        {
+            const std::size_t count = m_workers.size();
+            for (std::size_t offset = 1; offset < count; ++offset)
+            {
+                Worker &victim = *m_workers[(self + offset) % count];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty())
+                {
+                    task = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    m_steals.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void run(std::size_t self)
+        {
+            t_pool = this;
+            t_worker = self;
+            for (;;)
+            {
+                Task task;
+                if (popOwn(self, task) || steal(self, task))
+                {
+                    m_queued.fetch_sub(1);
+                    try
+                    {
+                        task();
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(m_parkMutex);
+                        if (!m_error)
+                        {
+                            m_error = std::current_exception();
+                        }
+                    }
+                    task = nullptr;
+                    if (m_outstanding.fetch_sub(1) == 1)
+                    {
+                        {
+                            std::lock_guard<std::mutex> lock(m_parkMutex);
+                        }
+                        m_idle.notify_all();
+                    }
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(m_parkMutex);
+                m_sleepers.fetch_add(1);
+                m_parked.wait(lock, [this]() { return m_stopping || m_queued.load() > 0; });
+                m_sleepers.fetch_sub(1);
+                if (m_stopping)
+                {
+                    return;
+                }
+            }
+        }
+
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        std::vector<std::thread> m_threads;
+        std::atomic<std::size_t> m_nextWorker{0};
+        // Tasks sitting in a deque, and tasks submitted but not yet finished.
+        std::atomic<qint64> m_queued{0};
+        std::atomic<qint64> m_outstanding{0};
+        std::atomic<int> m_sleepers{0};
+        std::atomic<qint64> m_steals{0};
+
+        std::mutex m_parkMutex;
+        std::condition_variable m_parked;
+        std::condition_variable m_idle;
+        bool m_stopping{false};
+        std::exception_ptr m_error;
+
+        inline static thread_local const WorkStealingPool *t_pool = nullptr;
+        inline static thread_local std::size_t t_worker = 0;
+    };
+
+} // namespace dynamicencrypt::core
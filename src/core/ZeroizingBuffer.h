@@ -1,27 +1,50 @@
 #pragma once
 
+#include "SecureArena.h"
+#include "WipeTelemetry.h"
+
 #include <QByteArray>
 #include <QtGlobal>
 
 #include <algorithm>
+#include <cstring>
 #include <functional>
-#include <mutex>
+#include <span>
+#include <utility>
 
 namespace dynamicencrypt::core
 {
+    // Secret bytes held in the SecureArena. bytes() is a QByteArray::fromRawData() view of that memory,
+    // so a copy of it must not outlive the buffer; deep-copy (see Key::materialize()) to keep the bytes.
     class ZeroizingBuffer
     {
     public:
         ZeroizingBuffer() = default;
-        explicit ZeroizingBuffer(int size) : m_bytes(size, Qt::Uninitialized) {}
-        explicit ZeroizingBuffer(QByteArray bytes) : m_bytes(std::move(bytes)) {}
+        explicit ZeroizingBuffer(int size) { allocate(size); }
+
+        // Copies bytes into the arena and wipes the source when this buffer held its only reference.
+        explicit ZeroizingBuffer(QByteArray bytes)
+        {
+            allocate(bytes.size());
+            if (bytes.isEmpty())
+            {
+                return;
+            }
+            std::memcpy(m_data, bytes.constData(), static_cast<std::size_t>(bytes.size()));
+            if (bytes.isDetached())
+            {
+                SecureArena::wipe(bytes.data(), static_cast<std::size_t>(bytes.size()));
+            }
+        }
 
         ZeroizingBuffer(const ZeroizingBuffer &) = delete;
         ZeroizingBuffer &operator=(const ZeroizingBuffer &) = delete;
 
         ZeroizingBuffer(ZeroizingBuffer &&other) noexcept
-            : m_bytes(std::move(other.m_bytes)), m_wiped(other.m_wiped)
+            : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)),
+              m_view(std::move(other.m_view)), m_wiped(other.m_wiped)
         {
+            other.m_view = QByteArray();
             other.m_wiped = true;
         }
 
@@ -30,7 +53,10 @@ namespace dynamicencrypt::core
             if (this != &other)
             {
                 secureWipe();
-                m_bytes = std::move(other.m_bytes);
+                m_data = std::exchange(other.m_data, nullptr);
+                m_size = std::exchange(other.m_size, 0);
+                m_view = std::move(other.m_view);
+                other.m_view = QByteArray();
                 m_wiped = other.m_wiped;
                 other.m_wiped = true;
             }
@@ -42,8 +68,9 @@ namespace dynamicencrypt::core
             secureWipe();
         }
 
-        QByteArray &writable() noexcept { return m_bytes; }
-        const QByteArray &bytes() const noexcept { return m_bytes; }
+        const QByteArray &bytes() const noexcept { return m_view; }
+        char *data() noexcept { return m_data; }
+        int size() const noexcept { return m_size; }
 
         void secureWipe() noexcept
         {
@@ -51,34 +78,45 @@ namespace dynamicencrypt::core
             {
                 return;
             }
-            const int size = m_bytes.size();
-            volatile unsigned char *ptr = reinterpret_cast<volatile unsigned char *>(m_bytes.data());
-            for (int i = 0; i < size; ++i)
-            {
-                ptr[i] = 0;
-            }
-            QByteArray proof(size, 0);
-            m_bytes.clear();
             m_wiped = true;
-            std::lock_guard<std::mutex> lock(s_mutex);
-            if (s_onWipe)
-            {
-                s_onWipe(proof);
-            }
+            SecureArena::wipe(m_data, static_cast<std::size_t>(m_size));
+            // Reports the zeroed arena bytes themselves, so the wipe allocates nothing and takes no lock.
+            WipeTelemetry::record(std::as_bytes(std::span<const char>(m_data, static_cast<std::size_t>(m_size))));
+            m_view = QByteArray();
+            SecureArena::releaseWiped(std::exchange(m_data, nullptr));
+            m_size = 0;
         }
 
+        // Test hook over WipeTelemetry::setObserver(); the callback sees the zeroed bytes, may run on any
+        // thread and must not keep a reference to them.
         static void setOnWipe(std::function<void(const QByteArray &)> callback)
         {
-            std::lock_guard<std::mutex> lock(s_mutex);
-            s_onWipe = std::move(callback);
+            if (!callback)
+            {
+                WipeTelemetry::setObserver({});
+                return;
+            }
+            WipeTelemetry::setObserver([callback = std::move(callback)](std::span<const std::byte> wiped)
+                                       { callback(QByteArray::fromRawData(reinterpret_cast<const char *>(wiped.data()),
+                                                                          static_cast<qsizetype>(wiped.size()))); });
         }
 
     private:
-        QByteArray m_bytes;
-        bool m_wiped{false};
+        void allocate(int size)
+        {
+            if (size <= 0)
+            {
+                return;
+            }
+            m_data = static_cast<char *>(SecureArena::allocate(static_cast<std::size_t>(size)));
+            m_size = size;
+            m_view = QByteArray::fromRawData(m_data, size);
+        }
 
-        inline static std::mutex s_mutex;
-        inline static std::function<void(const QByteArray &)> s_onWipe;
+        char *m_data{nullptr};
+        int m_size{0};
+        QByteArray m_view;
+        bool m_wiped{false};
     };
 
 } // namespace dynamicencrypt::core
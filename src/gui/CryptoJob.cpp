@@ -0,0 +1,120 @@
+#include "CryptoJob.h"
+
+#include "core/DirectoryEncryptor.h"
+
+#include <QDateTime>
+
+#include <exception>
+#include <optional>
+
+using dynamicencrypt::core::CryptoDriver;
+using dynamicencrypt::core::DirectoryEncryptor;
+using dynamicencrypt::core::DirectoryJobResult;
+using dynamicencrypt::core::JobControl;
+using dynamicencrypt::core::Key;
+using dynamicencrypt::core::OperationCancelled;
+using dynamicencrypt::core::SymmetricKeyTag;
+using dynamicencrypt::core::VaultEntry;
+using dynamicencrypt::core::VaultManager;
+
+namespace dynamicencrypt::gui
+{
+
+    CryptoJob::CryptoJob(VaultManager *manager, CryptoDriver *driver, Key<SymmetricKeyTag> key, Mode mode,
+                         QString inputPath, QString outputPath, QObject *parent)
+        : QObject(parent),
+          m_manager(manager),
+          m_driver(driver),
+          m_key(std::move(key)),
+          m_mode(mode),
+          m_inputPath(std::move(inputPath)),
+          m_outputPath(std::move(outputPath))
+    {
+        // Lifetime is owned by the window, which deletes the job once finished() is handled.
+        setAutoDelete(false);
+    }
+
+    void CryptoJob::run()
+    {
+        JobControl control;
+        control.cancelled = &m_cancelled;
+        control.progress = [this](qint64 done, qint64 total)
+        {
+            const int percent = total > 0 ? static_cast<int>(done * 100 / total) : 100;
+            if (percent != m_lastPercent)
+            {
+                m_lastPercent = percent;
+                emit progressChanged(percent);
+            }
+        };
+
+        bool ok = true;
+        QString message;
+        try
+        {
+            if (m_mode == Mode::Encrypt)
+            {
+                m_manager->requireWritableIndex();
+                QByteArray nonce;
+                const Key<SymmetricKeyTag> dataKey = VaultManager::createDataKey(m_driver, m_key, &m_entry.wrappedKey);
+                m_manager->encryptFile(m_driver, m_inputPath, m_outputPath, dataKey, &nonce,
+                                       VaultManager::kAutoChunkSize, control, &m_entry.digest);
+                m_entry.originalPath = m_inputPath;
+                m_entry.storedPath = m_outputPath;
+                m_entry.algorithm = m_driver->name();
+                m_entry.nonce = nonce;
+                m_entry.timestamp = QDateTime::currentDateTimeUtc();
+                // Recorded here rather than by the window: the entry holds the only wrapped copy of the data
+                // key, and the window may close before it handles finished().
+                m_manager->addEntry(m_entry);
+                message = QStringLiteral("Encrypted %1 using %2 -> %3").arg(m_inputPath, m_driver->name(), m_outputPath);
+            }
+            else if (m_mode == Mode::EncryptTree)
+            {
+                const DirectoryJobResult result =
+                    DirectoryEncryptor(*m_manager).encryptTree(m_driver, m_inputPath, m_outputPath, m_key, control);
+                message = QStringLiteral("Encrypted %1 files from %2 using %3 -> %4")
+                              .arg(result.files)
+                              .arg(m_inputPath, m_driver->name(), m_outputPath);
+                if (result.unchanged > 0)
+                {
+                    message += QStringLiteral(" (%1 unchanged)").arg(result.unchanged);
+                }
+                for (const DirectoryJobResult::Failure &failure : result.failures)
+                {
+                    message += QStringLiteral("\nFailed %1: %2").arg(failure.path, failure.error);
+                }
+                ok = result.failures.empty();
+            }
+            else
+            {
+                // Vault entries carry their own wrapped data key and name the driver that wrapped it; anything
+                // else was encrypted with m_key itself.
+                if (const std::optional<VaultEntry> entry = m_manager->findEntry(m_inputPath))
+                {
+                    m_manager->decryptEntry(*entry, m_outputPath, m_key, control);
+                }
+                else
+                {
+                    m_manager->decryptFile(m_driver, m_inputPath, m_outputPath, m_key, VaultManager::kAutoChunkSize,
+                                           control);
+                }
+                message = QStringLiteral("Decrypted %1 -> %2").arg(m_inputPath, m_outputPath);
+            }
+        }
+        catch (const OperationCancelled &)
+        {
+            ok = false;
+            message = QStringLiteral("Cancelled %1").arg(m_inputPath);
+        }
+        catch (const std::exception &ex)
+        {
+            ok = false;
+            message = QString::fromUtf8(ex.what());
+        }
+        m_key.secureWipe();
+        // Last statement: the receiver may delete this job as soon as it sees the signal.
+        emit finished(ok, message);
+    }
+
+} // namespace dynamicencrypt::gui
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "core/Key.h"
+#include "core/VaultManager.h"
+
+#include <QObject>
+#include <QRunnable>
+#include <QString>
+
+#include <atomic>
+
+namespace dynamicencrypt::gui
+{
+
+    // One file encrypt/decrypt, or one directory tree encrypt, running on a worker thread. Signals are
+    // delivered queued to the GUI thread.
+    class CryptoJob : public QObject, public QRunnable
+    {
+        Q_OBJECT
+    public:
+        enum class Mode
+        {
+            Encrypt,
+            Decrypt,
+            EncryptTree, // inputPath is a directory; its entries are added to the vault as the job runs
+        };
+
+        CryptoJob(dynamicencrypt::core::VaultManager *manager, dynamicencrypt::core::CryptoDriver *driver,
+                  dynamicencrypt::core::Key<dynamicencrypt::core::SymmetricKeyTag> key, Mode mode, QString inputPath,
+                  QString outputPath, QObject *parent = nullptr);
+
+        void run() override;
+        void cancel() noexcept { m_cancelled.store(true); }
+        bool wasCancelled() const noexcept { return m_cancelled.load(); }
+
+        Mode mode() const noexcept { return m_mode; }
+        const QString &inputPath() const noexcept { return m_inputPath; }
+        const QString &outputPath() const noexcept { return m_outputPath; }
+
+        // Vault record a finished encrypt job added from its worker; only meaningful after finished(true, ...).
+        const dynamicencrypt::core::VaultEntry &entry() const noexcept { return m_entry; }
+
+    signals:
+        void progressChanged(int percent);
+        void finished(bool ok, const QString &message);
+
+    private:
+        dynamicencrypt::core::VaultManager *m_manager{nullptr};
+        dynamicencrypt::core::CryptoDriver *m_driver{nullptr};
+        dynamicencrypt::core::Key<dynamicencrypt::core::SymmetricKeyTag> m_key;
+        Mode m_mode;
+        QString m_inputPath;
+        QString m_outputPath;
+        dynamicencrypt::core::VaultEntry m_entry;
+        std::atomic_bool m_cancelled{false};
+        int m_lastPercent{-1};
+    };
+
+} // namespace dynamicencrypt::gui
@@ -1,6 +1,8 @@
 #include "MainWindow.h"
 
+#include "CryptoJob.h"
 #include "KeyDialog.h"
+#include "VaultListModel.h"
 
 #include <QDateTime>
 #include <QDir>
@@ -8,18 +10,25 @@
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QHBoxLayout>
+#include <QJsonDocument>
 #include <QLabel>
 #include <QMessageBox>
 #include <QStatusBar>
 #include <QVBoxLayout>
 
+#include <algorithm>
 #include <exception>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 
 using dynamicencrypt::core::CryptoDriver;
+using dynamicencrypt::core::DriverMetrics;
 using dynamicencrypt::core::importSymmetricKey;
 using dynamicencrypt::core::Key;
+using dynamicencrypt::core::MetricsSnapshot;
+using dynamicencrypt::core::OperationMetrics;
+using dynamicencrypt::core::PluginDescriptor;
 using dynamicencrypt::core::Storage;
 using dynamicencrypt::core::SymmetricKeyTag;
 using dynamicencrypt::core::VaultEntry;
@@ -28,16 +37,44 @@ using dynamicencrypt::core::VaultManager;
 namespace dynamicencrypt::gui
 {
 
+    namespace
+    {
+        QString formatNanos(qint64 nanos)
+        {
+            if (nanos >= 1000000)
+            {
+                return QStringLiteral("%1 ms").arg(nanos / 1e6, 0, 'f', 1);
+            }
+            return QStringLiteral("%1 us").arg(nanos / 1e3, 0, 'f', 1);
+        }
+
+        // e.g. "enc 12 op/s 850.3 MB/s p50 1.2 ms p99 4.0 ms io 35%"
+        QString formatOperation(const char *label, const OperationMetrics &operation, qint64 elapsedNanos)
+        {
+            const qint64 busy = operation.cipherNanos + operation.ioNanos;
+            return QStringLiteral("%1 %2 op/s %3 MB/s p50 %4 p99 %5 io %6%")
+                .arg(QLatin1String(label))
+                .arg(MetricsSnapshot::perSecond(operation.operations, elapsedNanos), 0, 'f', 0)
+                .arg(MetricsSnapshot::perSecond(operation.bytesIn, elapsedNanos) / 1e6, 0, 'f', 1)
+                .arg(formatNanos(operation.p50Nanos()), formatNanos(operation.p99Nanos()))
+                .arg(busy > 0 ? operation.ioNanos * 100 / busy : 0);
+        }
+    }
+
     MainWindow::MainWindow(VaultManager *manager, QWidget *parent)
         : QMainWindow(parent), m_manager(manager)
     {
         buildUi();
         populatePlugins();
-        refreshVaultList();
+    }
 
-        m_refreshTimer = new QTimer(this);
-        connect(m_refreshTimer, &QTimer::timeout, this, &MainWindow::refreshVaultList);
-        m_refreshTimer->start(5000);
+    MainWindow::~MainWindow()
+    {
+        for (auto it = m_jobItems.cbegin(); it != m_jobItems.cend(); ++it)
+        {
+            it.key()->cancel();
+        }
+        m_jobPool.waitForDone();
     }
 
     void MainWindow::buildUi()
@@ -56,11 +93,35 @@ namespace dynamicencrypt::gui
 
         m_addButton = new QPushButton(QStringLiteral("Add File"), this);
         leftLayout->addWidget(m_addButton);
+        m_addFolderButton = new QPushButton(QStringLiteral("Add Folder"), this);
+        leftLayout->addWidget(m_addFolderButton);
 
         auto *rightLayout = new QVBoxLayout();
         rightLayout->addWidget(new QLabel(QStringLiteral("Vault Entries"), this));
-        m_vaultList = new QListWidget(this);
-        rightLayout->addWidget(m_vaultList);
+        m_vaultFilterEdit = new QLineEdit(this);
+        m_vaultFilterEdit->setPlaceholderText(QStringLiteral("Filter entries"));
+        m_vaultFilterEdit->setClearButtonEnabled(true);
+        rightLayout->addWidget(m_vaultFilterEdit);
+
+        // The view asks the model only for visible rows, and uniform item sizes spare it from
+        // measuring every row, so large vaults scroll without materializing their entries.
+        m_vaultModel = new VaultListModel(m_manager, this);
+        m_vaultFilter = new QSortFilterProxyModel(this);
+        m_vaultFilter->setSourceModel(m_vaultModel);
+        m_vaultFilter->setFilterCaseSensitivity(Qt::CaseInsensitive);
+        m_vaultView = new QListView(this);
+        m_vaultView->setUniformItemSizes(true);
+        m_vaultView->setSelectionMode(QAbstractItemView::SingleSelection);
+        m_vaultView->setModel(m_vaultFilter);
+        rightLayout->addWidget(m_vaultView);
+
+        // Refiltering walks every row, so wait for a pause in typing.
+        m_filterDebounce = new QTimer(this);
+        m_filterDebounce->setSingleShot(true);
+        m_filterDebounce->setInterval(150);
+        connect(m_vaultFilterEdit, &QLineEdit::textChanged, m_filterDebounce, qOverload<>(&QTimer::start));
+        connect(m_filterDebounce, &QTimer::timeout, this,
+                [this]() { m_vaultFilter->setFilterFixedString(m_vaultFilterEdit->text()); });
 
         auto *buttonRow = new QHBoxLayout();
         m_encryptButton = new QPushButton(QStringLiteral("Encrypt"), this);
@@ -72,9 +133,17 @@ namespace dynamicencrypt::gui
         buttonRow->addWidget(m_decryptButton);
         buttonRow->addWidget(m_generateKeyButton);
         buttonRow->addWidget(m_importKeyButton);
+        m_exportMetricsButton = new QPushButton(QStringLiteral("Export Metrics"), this);
+        buttonRow->addWidget(m_exportMetricsButton);
 
         rightLayout->addLayout(buttonRow);
 
+        rightLayout->addWidget(new QLabel(QStringLiteral("Jobs"), this));
+        m_jobList = new QListWidget(this);
+        rightLayout->addWidget(m_jobList);
+        m_cancelJobButton = new QPushButton(QStringLiteral("Cancel Job"), this);
+        rightLayout->addWidget(m_cancelJobButton);
+
         m_log = new QPlainTextEdit(this);
         m_log->setReadOnly(true);
         rightLayout->addWidget(new QLabel(QStringLiteral("Log"), this));
@@ -85,38 +154,51 @@ namespace dynamicencrypt::gui
 
         setCentralWidget(central);
 
+        m_metricsLabel = new QLabel(this);
+        statusBar()->addPermanentWidget(m_metricsLabel);
+        m_lastMetrics = m_manager->metrics();
+        m_metricsTimer = new QTimer(this);
+        m_metricsTimer->setInterval(1000);
+        connect(m_metricsTimer, &QTimer::timeout, this, &MainWindow::refreshMetrics);
+        m_metricsTimer->start();
+
         connect(m_addButton, &QPushButton::clicked, this, &MainWindow::onAddFile);
+        connect(m_addFolderButton, &QPushButton::clicked, this, &MainWindow::onAddFolder);
         connect(m_encryptButton, &QPushButton::clicked, this, &MainWindow::onEncrypt);
         connect(m_decryptButton, &QPushButton::clicked, this, &MainWindow::onDecrypt);
         connect(m_generateKeyButton, &QPushButton::clicked, this, &MainWindow::onGenerateKey);
         connect(m_importKeyButton, &QPushButton::clicked, this, &MainWindow::onImportKey);
+        connect(m_cancelJobButton, &QPushButton::clicked, this, &MainWindow::onCancelJob);
+        connect(m_exportMetricsButton, &QPushButton::clicked, this, &MainWindow::onExportMetrics);
     }
 
     void MainWindow::populatePlugins()
     {
+        // Listing works from plugin.json descriptors, so no plugin library is loaded until it is used.
         m_pluginList->clear();
         m_cachedDrivers = m_manager->drivers();
-        for (CryptoDriver *driver : m_cachedDrivers)
+        for (const PluginDescriptor &descriptor : m_manager->pluginDescriptors())
         {
             QListWidgetItem *item = new QListWidgetItem(QStringLiteral("%1 (%2)")
-                                                            .arg(driver->name(), driver->version()));
+                                                            .arg(descriptor.name, descriptor.version));
+            item->setToolTip(QStringLiteral("%1\n%2").arg(descriptor.description,
+                                                            descriptor.capabilities.tags.join(QStringLiteral(", "))));
             m_pluginList->addItem(item);
         }
-        statusBar()->showMessage(QStringLiteral("Loaded %1 plugins").arg(m_cachedDrivers.size()));
-    }
 
-    void MainWindow::refreshVaultList()
-    {
-        m_vaultList->clear();
-        const auto &entries = m_manager->entries();
-        for (const VaultEntry &entry : entries)
+        // Preselect the fastest authenticated streaming driver this CPU can run rather than the first listed.
+        CryptoDriver *preferred = m_manager->preferredDriver({{QStringLiteral("aead")}, true});
+        const auto it = std::find(m_cachedDrivers.cbegin(), m_cachedDrivers.cend(), preferred);
+        if (it == m_cachedDrivers.cend())
         {
-            const QString display = QStringLiteral("%1 | %2 | %3")
-                                        .arg(QFileInfo(entry.storedPath).fileName())
-                                        .arg(entry.algorithm)
-                                        .arg(entry.timestamp.toString(Qt::ISODate));
-            m_vaultList->addItem(display);
+            statusBar()->showMessage(QStringLiteral("Loaded %1 plugins").arg(m_cachedDrivers.size()));
+            return;
         }
+        m_pluginList->setCurrentRow(static_cast<int>(it - m_cachedDrivers.cbegin()));
+        const QString tier = preferred->capabilities().simdTier;
+        statusBar()->showMessage(QStringLiteral("Loaded %1 plugins; preferred: %2%3")
+                                     .arg(m_cachedDrivers.size())
+                                     .arg(preferred->name(), tier.isEmpty() ? QString() : QStringLiteral(" (%1)").arg(tier)));
     }
 
     void MainWindow::logMessage(const QString &message)
@@ -126,6 +208,31 @@ namespace dynamicencrypt::gui
                                    .arg(message));
     }
 
+    void MainWindow::refreshMetrics()
+    {
+        const MetricsSnapshot current = m_manager->metrics();
+        const MetricsSnapshot interval = current.since(m_lastMetrics);
+        m_lastMetrics = current;
+        QStringList parts;
+        for (const DriverMetrics &driver : interval.drivers)
+        {
+            QStringList directions;
+            if (driver.encrypt.operations > 0)
+            {
+                directions << formatOperation("enc", driver.encrypt, interval.elapsedNanos);
+            }
+            if (driver.decrypt.operations > 0)
+            {
+                directions << formatOperation("dec", driver.decrypt, interval.elapsedNanos);
+            }
+            if (!directions.isEmpty())
+            {
+                parts << QStringLiteral("%1: %2").arg(driver.driver, directions.join(QStringLiteral(", ")));
+            }
+        }
+        m_metricsLabel->setText(parts.join(QStringLiteral(" | ")));
+    }
+
     CryptoDriver *MainWindow::selectedDriver() const
     {
         const int row = m_pluginList->currentRow();
@@ -147,6 +254,17 @@ namespace dynamicencrypt::gui
         logMessage(QStringLiteral("Queued file %1").arg(file));
     }
 
+    void MainWindow::onAddFolder()
+    {
+        const QString folder = QFileDialog::getExistingDirectory(this, QStringLiteral("Select folder to encrypt"));
+        if (folder.isEmpty())
+        {
+            return;
+        }
+        m_pendingList->addItem(folder);
+        logMessage(QStringLiteral("Queued folder %1").arg(folder));
+    }
+
     void MainWindow::onEncrypt()
     {
         CryptoDriver *driver = selectedDriver();
@@ -170,78 +288,113 @@ namespace dynamicencrypt::gui
             return;
         }
         const QString inputPath = item->text();
-        try
-        {
-            QByteArray blob = m_manager->storage().load(inputPath);
-            QByteArray nonce;
-            QByteArray cipher = m_manager->encryptSymmetric(driver, blob, *m_activeKey, &nonce);
-            const QString vaultFileName = QFileInfo(inputPath).fileName() + QStringLiteral(".vault");
-            const QString outputPath = QDir(m_manager->storageDirectory()).filePath(vaultFileName);
-            m_manager->storage().store(outputPath, cipher);
-
-            VaultEntry entry;
-            entry.originalPath = inputPath;
-            entry.storedPath = outputPath;
-            entry.algorithm = driver->name();
-            entry.nonce = nonce;
-            entry.timestamp = QDateTime::currentDateTimeUtc();
-            m_manager->addEntry(entry);
-            delete m_pendingList->takeItem(m_pendingList->row(item));
-            refreshVaultList();
-            logMessage(QStringLiteral("Encrypted %1 using %2 -> %3")
-                           .arg(inputPath, driver->name(), outputPath));
-        }
-        catch (const std::exception &ex)
-        {
-            QMessageBox::critical(this, QStringLiteral("Encryption failed"), QString::fromUtf8(ex.what()));
-        }
+        // A folder keeps its layout under a directory of the same name in the vault.
+        const bool folder = QFileInfo(inputPath).isDir();
+        const QString vaultFileName = QFileInfo(inputPath).fileName() + (folder ? QString() : QStringLiteral(".vault"));
+        const QString outputPath = QDir(m_manager->storageDirectory()).filePath(vaultFileName);
+        auto *job = new CryptoJob(m_manager, driver, Key<SymmetricKeyTag>(m_activeKey->materialize(), m_activeKey->label()),
+                                  folder ? CryptoJob::Mode::EncryptTree : CryptoJob::Mode::Encrypt, inputPath,
+                                  outputPath, this);
+        delete m_pendingList->takeItem(m_pendingList->row(item));
+        startJob(job, QStringLiteral("Encrypt %1").arg(QFileInfo(inputPath).fileName()));
     }
 
     void MainWindow::onDecrypt()
     {
-        const int row = m_vaultList->currentRow();
-        if (row < 0 || row >= static_cast<int>(m_manager->entries().size()))
+        const QModelIndex current = m_vaultFilter->mapToSource(m_vaultView->currentIndex());
+        if (!current.isValid())
         {
             QMessageBox::information(this, QStringLiteral("Select entry"),
                                      QStringLiteral("Choose a vault entry to decrypt."));
             return;
         }
-        CryptoDriver *driver = selectedDriver();
-        if (!driver)
-        {
-            QMessageBox::warning(this, QStringLiteral("No plugin"),
-                                 QStringLiteral("Select the plugin used for encryption."));
-            return;
-        }
         if (!m_activeKey)
         {
             QMessageBox::warning(this, QStringLiteral("No key"),
                                  QStringLiteral("Load the symmetric key before decrypting."));
             return;
         }
-        const VaultEntry &entry = m_manager->entries().at(row);
+        const std::optional<VaultEntry> shown = m_vaultModel->entryAt(current.row());
+        if (!shown)
+        {
+            QMessageBox::information(this, QStringLiteral("Entry removed"),
+                                     QStringLiteral("The selected entry is no longer in the vault."));
+            return;
+        }
+        const VaultEntry &entry = *shown;
+        // The entry's data key is wrapped by the driver that encrypted it, whichever plugin is selected now.
+        CryptoDriver *driver = m_manager->driverNamed(entry.algorithm);
+        if (!driver)
+        {
+            QMessageBox::warning(this, QStringLiteral("No plugin"),
+                                 QStringLiteral("The plugin %1 used for this entry is not loaded.").arg(entry.algorithm));
+            return;
+        }
         const QString savePath = QFileDialog::getSaveFileName(this, QStringLiteral("Save decrypted file"),
                                                               QFileInfo(entry.originalPath).fileName());
         if (savePath.isEmpty())
         {
             return;
         }
-        try
+        auto *job = new CryptoJob(m_manager, driver, Key<SymmetricKeyTag>(m_activeKey->materialize(), m_activeKey->label()),
+                                  CryptoJob::Mode::Decrypt, entry.storedPath, savePath, this);
+        startJob(job, QStringLiteral("Decrypt %1").arg(QFileInfo(entry.storedPath).fileName()));
+    }
+
+    void MainWindow::startJob(CryptoJob *job, const QString &label)
+    {
+        auto *item = new QListWidgetItem(QStringLiteral("%1 - queued").arg(label));
+        m_jobList->addItem(item);
+        m_jobItems.insert(job, item);
+        connect(job, &CryptoJob::progressChanged, this, [item, label](int percent)
+                { item->setText(QStringLiteral("%1 - %2%").arg(label).arg(percent)); });
+        connect(job, &CryptoJob::finished, this, [this, job](bool ok, const QString &message)
+                { onJobFinished(job, ok, message); });
+        logMessage(QStringLiteral("Started job: %1").arg(label));
+        m_jobPool.start(job);
+    }
+
+    void MainWindow::onJobFinished(CryptoJob *job, bool ok, const QString &message)
+    {
+        if (ok && job->mode() == CryptoJob::Mode::Encrypt)
         {
-            QByteArray blob = m_manager->storage().load(entry.storedPath);
-            QByteArray plain = m_manager->decryptSymmetric(driver, blob, *m_activeKey);
-            QFile out(savePath);
-            if (!out.open(QIODevice::WriteOnly))
+            // The model may still lag behind writes queued from other threads, so check the row it shows.
+            const qsizetype row = m_manager->positionOf(job->entry().storedPath);
+            const std::optional<VaultEntry> shown = m_vaultModel->entryAt(static_cast<int>(row));
+            if (shown && shown->storedPath == job->entry().storedPath)
             {
-                throw std::runtime_error("Failed to open output file");
+                m_vaultView->setCurrentIndex(m_vaultFilter->mapFromSource(m_vaultModel->index(static_cast<int>(row))));
             }
-            out.write(plain);
-            out.flush();
-            logMessage(QStringLiteral("Decrypted %1 -> %2").arg(entry.storedPath, savePath));
         }
-        catch (const std::exception &ex)
+        logMessage(message);
+        if (!ok && !job->wasCancelled())
         {
-            QMessageBox::critical(this, QStringLiteral("Decryption failed"), QString::fromUtf8(ex.what()));
+            QMessageBox::critical(this, job->mode() == CryptoJob::Mode::Decrypt ? QStringLiteral("Decryption failed")
+                                                                                : QStringLiteral("Encryption failed"),
+                                  message);
+        }
+        delete m_jobItems.take(job);
+        job->deleteLater();
+    }
+
+    void MainWindow::onCancelJob()
+    {
+        QListWidgetItem *item = m_jobList->currentItem();
+        if (!item)
+        {
+            QMessageBox::information(this, QStringLiteral("Select job"),
+                                     QStringLiteral("Choose a running job to cancel."));
+            return;
+        }
+        for (auto it = m_jobItems.cbegin(); it != m_jobItems.cend(); ++it)
+        {
+            if (it.value() == item)
+            {
+                it.key()->cancel();
+                item->setText(item->text() + QStringLiteral(" (cancelling)"));
+                logMessage(QStringLiteral("Cancellation requested"));
+                return;
+            }
         }
     }
 
@@ -284,4 +437,24 @@ namespace dynamicencrypt::gui
         }
     }
 
+    void MainWindow::onExportMetrics()
+    {
+        const QString path = QFileDialog::getSaveFileName(this, QStringLiteral("Export metrics"),
+                                                          QStringLiteral("dynamicencrypt-metrics.json"),
+                                                          QStringLiteral("JSON (*.json)"));
+        if (path.isEmpty())
+        {
+            return;
+        }
+        try
+        {
+            m_manager->storage().store(path, QJsonDocument(m_manager->metrics().toJson()).toJson(QJsonDocument::Indented));
+            logMessage(QStringLiteral("Exported metrics to %1").arg(path));
+        }
+        catch (const std::exception &ex)
+        {
+            QMessageBox::critical(this, QStringLiteral("Export failed"), QString::fromUtf8(ex.what()));
+        }
+    }
+
 } // namespace dynamicencrypt::gui
@@ -3,11 +3,17 @@
 #include "core/Key.h"
 #include "core/VaultManager.h"
 
+#include <QHash>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListView>
 #include <QMainWindow>
 #include <QPlainTextEdit>
 #include <QPushButton>
 #include <QSplitter>
 #include <QListWidget>
+#include <QSortFilterProxyModel>
+#include <QThreadPool>
 #include <QTimer>
 
 #include <memory>
@@ -15,40 +21,60 @@
 namespace dynamicencrypt::gui
 {
 
+    class CryptoJob;
     class KeyDialog;
+    class VaultListModel;
 
     class MainWindow : public QMainWindow
     {
         Q_OBJECT
     public:
         explicit MainWindow(dynamicencrypt::core::VaultManager *manager, QWidget *parent = nullptr);
-        ~MainWindow() override = default;
+        ~MainWindow() override;
 
     private slots:
         void onAddFile();
+        void onAddFolder();
         void onEncrypt();
         void onDecrypt();
         void onGenerateKey();
         void onImportKey();
+        void onCancelJob();
+        void onExportMetrics();
 
     private:
         void buildUi();
         void populatePlugins();
-        void refreshVaultList();
         void logMessage(const QString &message);
+        void refreshMetrics();
         dynamicencrypt::core::CryptoDriver *selectedDriver() const;
+        void startJob(CryptoJob *job, const QString &label);
+        void onJobFinished(CryptoJob *job, bool ok, const QString &message);
 
         dynamicencrypt::core::VaultManager *m_manager{nullptr};
         QListWidget *m_pluginList{nullptr};
-        QListWidget *m_vaultList{nullptr};
+        QListView *m_vaultView{nullptr};
+        VaultListModel *m_vaultModel{nullptr};
+        QSortFilterProxyModel *m_vaultFilter{nullptr};
+        QLineEdit *m_vaultFilterEdit{nullptr};
+        QTimer *m_filterDebounce{nullptr};
         QListWidget *m_pendingList{nullptr};
+        QListWidget *m_jobList{nullptr};
         QPlainTextEdit *m_log{nullptr};
         QPushButton *m_encryptButton{nullptr};
         QPushButton *m_decryptButton{nullptr};
         QPushButton *m_addButton{nullptr};
+        QPushButton *m_addFolderButton{nullptr};
         QPushButton *m_generateKeyButton{nullptr};
         QPushButton *m_importKeyButton{nullptr};
-        QTimer *m_refreshTimer{nullptr};
+        QPushButton *m_cancelJobButton{nullptr};
+        QPushButton *m_exportMetricsButton{nullptr};
+        // Live summary of the last refresh interval, computed as the difference from m_lastMetrics.
+        QLabel *m_metricsLabel{nullptr};
+        QTimer *m_metricsTimer{nullptr};
+        dynamicencrypt::core::MetricsSnapshot m_lastMetrics;
+        QThreadPool m_jobPool;
+        QHash<CryptoJob *, QListWidgetItem *> m_jobItems;
 
         std::unique_ptr<dynamicencrypt::core::Key<dynamicencrypt::core::SymmetricKeyTag>> m_activeKey;
         mutable std::vector<dynamicencrypt::core::CryptoDriver *> m_cachedDrivers;
@@ -0,0 +1,180 @@
+#include "VaultListModel.h"
+
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+using dynamicencrypt::core::EntrySnapshot;
+using dynamicencrypt::core::VaultEntry;
+using dynamicencrypt::core::VaultManager;
+
+namespace dynamicencrypt::gui
+{
+
+    namespace
+    {
+        QString fileNameOf(const QString &path)
+        {
+            const qsizetype slash = qMax(path.lastIndexOf(QLatin1Char('/')), path.lastIndexOf(QLatin1Char('\\')));
+            return path.mid(slash + 1);
+        }
+    }
+
+    VaultListModel::VaultListModel(VaultManager *manager, QObject *parent)
+        : QAbstractListModel(parent), m_manager(manager)
+    {
+        // Adopts a snapshot only if one exists: building it here would decode every entry at startup.
+        m_snapshot = m_manager->existingSnapshot();
+        std::tie(m_rows, m_version) = m_snapshot ? std::pair(m_snapshot->size(), m_snapshot->version())
+                                                 : m_manager->versionedEntryCount();
+        connect(m_manager, &VaultManager::entryInserted, this, &VaultListModel::onEntryInserted);
+        connect(m_manager, &VaultManager::entriesInserted, this, &VaultListModel::onEntriesInserted);
+        connect(m_manager, &VaultManager::entryChanged, this, &VaultListModel::onEntryChanged);
+        connect(m_manager, &VaultManager::entryRemoved, this, &VaultListModel::onEntryRemoved);
+        connect(m_manager, &VaultManager::entriesReset, this, &VaultListModel::onEntriesReset);
+    }
+
+    int VaultListModel::rowCount(const QModelIndex &parent) const
+    {
+        return parent.isValid() ? 0 : static_cast<int>(m_rows);
+    }
+
+    std::optional<VaultEntry> VaultListModel::entryAt(int row) const
+    {
+        if (row < 0 || row >= m_rows)
+        {
+            return std::nullopt;
+        }
+        if (m_snapshot)
+        {
+            return m_snapshot->at(row);
+        }
+        try
+        {
+            return m_manager->entryAt(row);
+        }
+        catch (const std::out_of_range &)
+        {
+            return std::nullopt;
+        }
+    }
+
+    QVariant VaultListModel::data(const QModelIndex &index, int role) const
+    {
+        if (!index.isValid())
+        {
+            return {};
+        }
+        const std::optional<VaultEntry> entry = entryAt(index.row());
+        if (!entry)
+        {
+            return {};
+        }
+        switch (role)
+        {
+        case Qt::DisplayRole:
+            return QStringLiteral("%1 | %2 | %3")
+                .arg(fileNameOf(entry->storedPath), entry->algorithm, entry->timestamp.toString(Qt::ISODate));
+        case Qt::ToolTipRole:
+            return QStringLiteral("%1\n-> %2").arg(entry->originalPath, entry->storedPath);
+        case StoredPathRole:
+            return entry->storedPath;
+        case OriginalPathRole:
+            return entry->originalPath;
+        case AlgorithmRole:
+            return entry->algorithm;
+        case TimestampRole:
+            return entry->timestamp;
+        default:
+            return {};
+        }
+    }
+
+    bool VaultListModel::follows(quint64 version, std::shared_ptr<const EntrySnapshot> &next)
+    {
+        std::shared_ptr<const EntrySnapshot> latest = m_manager->existingSnapshot();
+        if (version == m_version + 1 && (!latest || latest->version() == version))
+        {
+            next = std::move(latest);
+            return true;
+        }
+        resetToLatest(false);
+        return false;
+    }
+
+    void VaultListModel::adopt(std::shared_ptr<const EntrySnapshot> next, qsizetype rows, quint64 version)
+    {
+        m_rows = next ? next->size() : rows;
+        m_version = version;
+        m_snapshot = std::move(next);
+    }
+
+    void VaultListModel::resetToLatest(bool always)
+    {
+        std::shared_ptr<const EntrySnapshot> latest = m_manager->existingSnapshot();
+        const auto [rows, version] = latest ? std::pair(latest->size(), latest->version()) : m_manager->versionedEntryCount();
+        if (!always && version <= m_version)
+        {
+            return;
+        }
+        beginResetModel();
+        adopt(std::move(latest), rows, version);
+        endResetModel();
+    }
+
+    void VaultListModel::onEntryInserted(qsizetype position, quint64 version)
+    {
+        std::shared_ptr<const EntrySnapshot> next;
+        if (!follows(version, next))
+        {
+            return;
+        }
+        const int row = static_cast<int>(position);
+        beginInsertRows(QModelIndex(), row, row);
+        adopt(std::move(next), m_rows + 1, version);
+        endInsertRows();
+    }
+
+    void VaultListModel::onEntriesInserted(qsizetype first, qsizetype last, quint64 version)
+    {
+        std::shared_ptr<const EntrySnapshot> next;
+        if (!follows(version, next))
+        {
+            return;
+        }
+        beginInsertRows(QModelIndex(), static_cast<int>(first), static_cast<int>(last));
+        adopt(std::move(next), m_rows + (last - first + 1), version);
+        endInsertRows();
+    }
+
+    void VaultListModel::onEntryChanged(qsizetype position, quint64 version)
+    {
+        std::shared_ptr<const EntrySnapshot> next;
+        if (!follows(version, next))
+        {
+            return;
+        }
+        adopt(std::move(next), m_rows, version);
+        const int row = static_cast<int>(position);
+        emit dataChanged(index(row), index(row));
+    }
+
+    void VaultListModel::onEntryRemoved(qsizetype position, quint64 version)
+    {
+        std::shared_ptr<const EntrySnapshot> next;
+        if (!follows(version, next))
+        {
+            return;
+        }
+        const int row = static_cast<int>(position);
+        beginRemoveRows(QModelIndex(), row, row);
+        adopt(std::move(next), m_rows - 1, version);
+        endRemoveRows();
+    }
+
+    void VaultListModel::onEntriesReset()
+    {
+        resetToLatest(true);
+    }
+
+} // namespace dynamicencrypt::gui
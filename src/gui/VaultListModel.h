@@ -0,0 +1,61 @@
+#pragma once
+
+#include "core/VaultManager.h"
+
+#include <QAbstractListModel>
+
+#include <memory>
+#include <optional>
+
+namespace dynamicencrypt::gui
+{
+
+    // List model over the vault entries. Until something else has built a VaultManager::snapshot(), rows
+    // are read one at a time through VaultManager::entryAt(), so opening a large vault decodes only the
+    // rows the view shows; once a snapshot exists the model follows it. A change signal is applied row by
+    // row only when it produced the version right after the one the model holds (and, with a snapshot,
+    // the manager's snapshot is still at that version). Signals queued from writer threads may arrive
+    // after several changes; the model then resets to the manager's newest state, and signals for
+    // versions it already holds are ignored.
+    class VaultListModel : public QAbstractListModel
+    {
+        Q_OBJECT
+    public:
+        enum Roles
+        {
+            StoredPathRole = Qt::UserRole + 1,
+            OriginalPathRole,
+            AlgorithmRole,
+            TimestampRole,
+        };
+
+        explicit VaultListModel(dynamicencrypt::core::VaultManager *manager, QObject *parent = nullptr);
+
+        int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+        QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+        // The entry the view shows at row. Without a snapshot the row is read from the manager, which may
+        // have dropped it before the model hears of the removal; the result is then empty.
+        std::optional<dynamicencrypt::core::VaultEntry> entryAt(int row) const;
+
+    private:
+        // True when the change that produced version can be applied row by row; next is then the snapshot
+        // it led to, or null while rows are read through the manager. Otherwise resets to the manager's
+        // newest state if the model is behind it.
+        bool follows(quint64 version, std::shared_ptr<const dynamicencrypt::core::EntrySnapshot> &next);
+        void adopt(std::shared_ptr<const dynamicencrypt::core::EntrySnapshot> next, qsizetype rows, quint64 version);
+        // Resets to the manager's newest state; unless always, only when the model is behind it.
+        void resetToLatest(bool always);
+        void onEntryInserted(qsizetype position, quint64 version);
+        void onEntriesInserted(qsizetype first, qsizetype last, quint64 version);
+        void onEntryChanged(qsizetype position, quint64 version);
+        void onEntryRemoved(qsizetype position, quint64 version);
+        void onEntriesReset();
+
+        dynamicencrypt::core::VaultManager *m_manager{nullptr};
+        std::shared_ptr<const dynamicencrypt::core::EntrySnapshot> m_snapshot; // null until the manager has one
+        qsizetype m_rows{0};
+        quint64 m_version{0};
+    };
+
+} // namespace dynamicencrypt::gui
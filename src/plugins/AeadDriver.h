@@ -0,0 +1,368 @@
+#pragma once
+
+#include "core/CryptoDriver.h"
+#include "core/SecureRandom.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace dynamicencrypt::plugins
+{
+
+    // CryptoDriver plumbing shared by the AEAD plugins. Cipher provides kName, kKeySize, kNonceSize,
+    // kTagSize, a constructor from key bytes, seal()/open() and a Stream with update()/finish()/verify().
+    // Ciphertext layout: random nonce | ciphertext | tag. Decryption throws std::runtime_error when the
+    // tag does not verify. The plugin class adds QObject, the plugin metadata, name() and version().
+    template <typename Cipher>
+    class AeadDriver : public dynamicencrypt::core::CryptoDriver
+    {
+    public:
+        static constexpr qsizetype kNonceSize = static_cast<qsizetype>(Cipher::kNonceSize);
+        static constexpr qsizetype kTagSize = static_cast<qsizetype>(Cipher::kTagSize);
+
+        QByteArray encrypt(const QByteArray &plaintext, const QByteArray &key) override
+        {
+            QByteArray output(plaintext.size() + kNonceSize + kTagSize, Qt::Uninitialized);
+            encrypt(dynamicencrypt::core::asBytes(plaintext), dynamicencrypt::core::asWritableBytes(output), key);
+            return output;
+        }
+
+        QByteArray decrypt(const QByteArray &ciphertext, const QByteArray &key) override
+        {
+            if (ciphertext.size() < kNonceSize + kTagSize)
+            {
+                throw std::invalid_argument("Ciphertext too short");
+            }
+            QByteArray output(ciphertext.size() - kNonceSize - kTagSize, Qt::Uninitialized);
+            decrypt(dynamicencrypt::core::asBytes(ciphertext), dynamicencrypt::core::asWritableBytes(output), key);
+            return output;
+        }
+
+        dynamicencrypt::core::CiphertextLayout ciphertextLayout() const override
+        {
+            return {kNonceSize, kTagSize};
+        }
+
+        qsizetype encrypt(std::span<const std::byte> plaintext, std::span<std::byte> out, const QByteArray &key) override
+        {
+            return sealInto(Cipher(requireKey(key)), plaintext, out);
+        }
+
+        qsizetype decrypt(std::span<const std::byte> ciphertext, std::span<std::byte> out, const QByteArray &key) override
+        {
+            return openInto(Cipher(requireKey(key)), ciphertext, out);
+        }
+
+        void encryptInPlace(std::span<std::byte> buffer, const QByteArray &key) override
+        {
+            const Cipher cipher(requireKey(key));
+            if (buffer.size() < static_cast<std::size_t>(kNonceSize + kTagSize))
+            {
+                throw std::invalid_argument("buffer smaller than ciphertext overhead");
+            }
+            const std::size_t size = buffer.size() - kNonceSize - kTagSize;
+            unsigned char *nonce = bytesOf(buffer);
+            dynamicencrypt::core::SecureRandom::fill(nonce, kNonceSize);
+            cipher.seal(nonce, nonce + kNonceSize, nonce + kNonceSize, size, nonce + kNonceSize + size);
+        }
+
+        std::span<std::byte> decryptInPlace(std::span<std::byte> buffer, const QByteArray &key) override
+        {
+            const Cipher cipher(requireKey(key));
+            if (buffer.size() < static_cast<std::size_t>(kNonceSize + kTagSize))
+            {
+                throw std::invalid_argument("Ciphertext too short");
+            }
+            const std::size_t size = buffer.size() - kNonceSize - kTagSize;
+            unsigned char *nonce = bytesOf(buffer);
+            requireAuthentic(cipher.open(nonce, nonce + kNonceSize, nonce + kNonceSize, size, nonce + kNonceSize + size));
+            return buffer.subspan(kNonceSize, size);
+        }
+
+        qsizetype segmentNonceSize() const override { return kNonceSize; }
+        qsizetype segmentOverhead() const override { return kTagSize; }
+
+        void encryptSegment(std::span<const std::byte> in, std::span<std::byte> out, const QByteArray &key,
+                            std::span<const std::byte> nonce) override
+        {
+            sealSegment(Cipher(requireKey(key)), in, out, nonce);
+        }
+
+        void decryptSegment(std::span<const std::byte> in, std::span<std::byte> out, const QByteArray &key,
+                            std::span<const std::byte> nonce) override
+        {
+            openSegment(Cipher(requireKey(key)), in, out, nonce);
+        }
+
+        // Prepared keys hold the constructed cipher, so these skip per-call key setup.
+        std::unique_ptr<dynamicencrypt::core::PreparedKey> prepareKey(const QByteArray &key) override
+        {
+            return std::make_unique<CipherKey>(key);
+        }
+
+        qsizetype encrypt(std::span<const std::byte> plaintext, std::span<std::byte> out,
+                          const dynamicencrypt::core::PreparedKey &key) override
+        {
+            return sealInto(preparedAs<CipherKey>(key).cipher(), plaintext, out);
+        }
+
+        qsizetype decrypt(std::span<const std::byte> ciphertext, std::span<std::byte> out,
+                          const dynamicencrypt::core::PreparedKey &key) override
+        {
+            return openInto(preparedAs<CipherKey>(key).cipher(), ciphertext, out);
+        }
+
+        void encryptSegment(std::span<const std::byte> in, std::span<std::byte> out,
+                            const dynamicencrypt::core::PreparedKey &key, std::span<const std::byte> nonce) override
+        {
+            sealSegment(preparedAs<CipherKey>(key).cipher(), in, out, nonce);
+        }
+
+        void decryptSegment(std::span<const std::byte> in, std::span<std::byte> out,
+                            const dynamicencrypt::core::PreparedKey &key, std::span<const std::byte> nonce) override
+        {
+            openSegment(preparedAs<CipherKey>(key).cipher(), in, out, nonce);
+        }
+
+        std::unique_ptr<dynamicencrypt::core::CipherContext> createEncryptContext(const QByteArray &key) override
+        {
+            return std::make_unique<EncryptContext>(key);
+        }
+
+        std::unique_ptr<dynamicencrypt::core::CipherContext> createDecryptContext(const QByteArray &key) override
+        {
+            return std::make_unique<DecryptContext>(key);
+        }
+
+    private:
+        static const unsigned char *bytesOf(const QByteArray &bytes)
+        {
+            return reinterpret_cast<const unsigned char *>(bytes.constData());
+        }
+
+        static const unsigned char *bytesOf(std::span<const std::byte> bytes)
+        {
+            return reinterpret_cast<const unsigned char *>(bytes.data());
+        }
+
+        static unsigned char *bytesOf(std::span<std::byte> bytes)
+        {
+            return reinterpret_cast<unsigned char *>(bytes.data());
+        }
+
+        static const unsigned char *requireKey(const QByteArray &key)
+        {
+            if (key.size() != static_cast<qsizetype>(Cipher::kKeySize))
+            {
+                throw std::invalid_argument(std::string(Cipher::kName) + " requires a " +
+                                            std::to_string(Cipher::kKeySize) + "-byte key");
+            }
+            return bytesOf(key);
+        }
+
+        static void requireAuthentic(bool ok)
+        {
+            if (!ok)
+            {
+                throw std::runtime_error(std::string(Cipher::kName) + " authentication failed");
+            }
+        }
+
+        // The cipher's key schedule, built once per key. Each instantiation is its own type, so a key
+        // prepared by one AEAD driver is rejected by another.
+        class CipherKey final : public dynamicencrypt::core::PreparedKey
+        {
+        public:
+            explicit CipherKey(const QByteArray &key)
+                : m_cipher(requireKey(key))
+            {
+            }
+
+            const Cipher &cipher() const noexcept { return m_cipher; }
+
+        private:
+            Cipher m_cipher;
+        };
+
+        // nonce | ciphertext | tag into out.
+        static qsizetype sealInto(const Cipher &cipher, std::span<const std::byte> plaintext, std::span<std::byte> out)
+        {
+            const std::size_t size = plaintext.size();
+            if (out.size() < size + kNonceSize + kTagSize)
+            {
+                throw std::length_error("output buffer too small");
+            }
+            unsigned char *nonce = bytesOf(out);
+            dynamicencrypt::core::SecureRandom::fill(nonce, kNonceSize);
+            cipher.seal(nonce, bytesOf(plaintext), nonce + kNonceSize, size, nonce + kNonceSize + size);
+            return static_cast<qsizetype>(size) + kNonceSize + kTagSize;
+        }
+
+        static qsizetype openInto(const Cipher &cipher, std::span<const std::byte> ciphertext, std::span<std::byte> out)
+        {
+            if (ciphertext.size() < static_cast<std::size_t>(kNonceSize + kTagSize))
+            {
+                throw std::invalid_argument("Ciphertext too short");
+            }
+            const std::size_t size = ciphertext.size() - kNonceSize - kTagSize;
+            if (out.size() < size)
+            {
+                throw std::length_error("output buffer too small");
+            }
+            const unsigned char *nonce = bytesOf(ciphertext);
+            requireAuthentic(cipher.open(nonce, nonce + kNonceSize, bytesOf(out), size, nonce + kNonceSize + size));
+            return static_cast<qsizetype>(size);
+        }
+
+        static void requireSegmentNonce(std::span<const std::byte> nonce)
+        {
+            if (nonce.size() != static_cast<std::size_t>(kNonceSize))
+            {
+                throw std::invalid_argument("Segment requires a " + std::to_string(kNonceSize) + "-byte nonce");
+            }
+        }
+
+        static void sealSegment(const Cipher &cipher, std::span<const std::byte> in, std::span<std::byte> out,
+                                std::span<const std::byte> nonce)
+        {
+            requireSegmentNonce(nonce);
+            if (out.size() < in.size() + kTagSize)
+            {
+                throw std::length_error("output buffer too small");
+            }
+            cipher.seal(bytesOf(nonce), bytesOf(in), bytesOf(out), in.size(), bytesOf(out) + in.size());
+        }
+
+        static void openSegment(const Cipher &cipher, std::span<const std::byte> in, std::span<std::byte> out,
+                                std::span<const std::byte> nonce)
+        {
+            requireSegmentNonce(nonce);
+            if (in.size() < static_cast<std::size_t>(kTagSize))
+            {
+                throw std::invalid_argument("Segment shorter than its tag");
+            }
+            const std::size_t size = in.size() - kTagSize;
+            if (out.size() < size)
+            {
+                throw std::length_error("output buffer too small");
+            }
+            requireAuthentic(cipher.open(bytesOf(nonce), bytesOf(in), bytesOf(out), size, bytesOf(in) + size));
+        }
+
+        class EncryptContext : public dynamicencrypt::core::CipherContext
+        {
+        public:
+            explicit EncryptContext(const QByteArray &key)
+                : m_cipher(std::make_unique<Cipher>(requireKey(key))),
+                  m_nonce(dynamicencrypt::core::SecureRandom::bytes(kNonceSize)),
+                  m_stream(std::make_unique<typename Cipher::Stream>(*m_cipher, bytesOf(m_nonce), true))
+            {
+            }
+
+            QByteArray update(const QByteArray &chunk) override
+            {
+                QByteArray out = takeHeader();
+                const qsizetype offset = out.size();
+                out.resize(offset + chunk.size());
+                m_stream->update(bytesOf(chunk), reinterpret_cast<unsigned char *>(out.data()) + offset,
+                                 static_cast<std::size_t>(chunk.size()));
+                return out;
+            }
+
+            QByteArray finalize() override
+            {
+                QByteArray out = takeHeader();
+                const qsizetype offset = out.size();
+                out.resize(offset + kTagSize);
+                m_stream->finish(reinterpret_cast<unsigned char *>(out.data()) + offset);
+                return out;
+            }
+
+        private:
+            QByteArray takeHeader()
+            {
+                if (m_headerWritten)
+                {
+                    return {};
+                }
+                m_headerWritten = true;
+                return m_nonce;
+            }
+
+            std::unique_ptr<Cipher> m_cipher;
+            QByteArray m_nonce;
+            std::unique_ptr<typename Cipher::Stream> m_stream;
+            bool m_headerWritten{false};
+        };
+
+        // Holds back the trailing tag bytes until finalize(). Plaintext is released before the tag is
+        // checked, so callers must discard their output if finalize() throws (decryptFile only commits
+        // its QSaveFile after a successful finalize()).
+        class DecryptContext : public dynamicencrypt::core::CipherContext
+        {
+        public:
+            explicit DecryptContext(const QByteArray &key)
+                : m_cipher(std::make_unique<Cipher>(requireKey(key)))
+            {
+                m_nonce.reserve(kNonceSize);
+                m_tail.reserve(kTagSize);
+            }
+
+            QByteArray update(const QByteArray &chunk) override
+            {
+                qsizetype consumed = 0;
+                if (!m_stream)
+                {
+                    consumed = std::min<qsizetype>(kNonceSize - m_nonce.size(), chunk.size());
+                    m_nonce.append(chunk.constData(), consumed);
+                    if (m_nonce.size() < kNonceSize)
+                    {
+                        return {};
+                    }
+                    m_stream = std::make_unique<typename Cipher::Stream>(*m_cipher, bytesOf(m_nonce), false);
+                }
+                const char *body = chunk.constData() + consumed;
+                const qsizetype bodySize = chunk.size() - consumed;
+                const qsizetype ready = m_tail.size() + bodySize - kTagSize;
+                if (ready <= 0)
+                {
+                    m_tail.append(body, bodySize);
+                    return {};
+                }
+
+                QByteArray plain(ready, Qt::Uninitialized);
+                auto *out = reinterpret_cast<unsigned char *>(plain.data());
+                const qsizetype fromTail = std::min(m_tail.size(), ready);
+                m_stream->update(bytesOf(m_tail), out, static_cast<std::size_t>(fromTail));
+                const qsizetype fromBody = ready - fromTail;
+                m_stream->update(reinterpret_cast<const unsigned char *>(body), out + fromTail,
+                                 static_cast<std::size_t>(fromBody));
+                QByteArray tail;
+                tail.reserve(kTagSize);
+                tail.append(m_tail.constData() + fromTail, m_tail.size() - fromTail);
+                tail.append(body + fromBody, bodySize - fromBody);
+                m_tail = tail;
+                return plain;
+            }
+
+            QByteArray finalize() override
+            {
+                if (!m_stream || m_tail.size() != kTagSize)
+                {
+                    throw std::invalid_argument("Ciphertext too short");
+                }
+                requireAuthentic(m_stream->verify(bytesOf(m_tail)));
+                return {};
+            }
+
+        private:
+            std::unique_ptr<Cipher> m_cipher;
+            QByteArray m_nonce;
+            std::unique_ptr<typename Cipher::Stream> m_stream;
+            QByteArray m_tail;
+        };
+    };
+
+} // namespace dynamicencrypt::plugins
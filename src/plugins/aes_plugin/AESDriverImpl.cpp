@@ -1,11 +1,15 @@
 #include "AESDriverImpl.h"
 
+#include "XorKernels.h"
+
+#include "core/SecureRandom.h"
+
 #include <QCryptographicHash>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QLatin1Char>
-#include <QRandomGenerator>
 
+#include <algorithm>
 #include <stdexcept>
 
 namespace dynamicencrypt::plugins
@@ -14,25 +18,128 @@ namespace dynamicencrypt::plugins
     namespace
     {
         constexpr int kNonceSize = 12;
-    }
 
-    QByteArray AESDriverImpl::encrypt(const QByteArray &plaintext, const QByteArray &key)
-    {
-        if (key.isEmpty())
+        const unsigned char *bytesOf(const QByteArray &bytes)
         {
-            throw std::invalid_argument("Key must not be empty");
+            return reinterpret_cast<const unsigned char *>(bytes.constData());
         }
-        QByteArray nonce(kNonceSize, Qt::Uninitialized);
-        auto *rng = QRandomGenerator::system();
-        for (int i = 0; i < nonce.size(); ++i)
+
+        std::unique_ptr<XorMask> makeMask(const QByteArray &key, const QByteArray &nonce)
         {
-            nonce[i] = static_cast<char>(rng->generate());
+            return std::make_unique<XorMask>(bytesOf(key), static_cast<std::size_t>(key.size()), bytesOf(nonce),
+                                             static_cast<std::size_t>(nonce.size()));
         }
-        QByteArray cipher = xorSeal(plaintext, key, nonce);
-        QByteArray output;
-        output.reserve(nonce.size() + cipher.size());
-        output.append(nonce);
-        output.append(cipher);
+
+        QByteArray applyMask(const XorMask &mask, const QByteArray &input, qint64 offset)
+        {
+            QByteArray result(input.size(), Qt::Uninitialized);
+            mask.apply(bytesOf(input), reinterpret_cast<unsigned char *>(result.data()),
+                       static_cast<std::size_t>(input.size()), static_cast<std::uint64_t>(offset));
+            return result;
+        }
+
+        void fillNonce(unsigned char *nonce)
+        {
+            dynamicencrypt::core::SecureRandom::fill(nonce, kNonceSize);
+        }
+
+        QByteArray randomNonce()
+        {
+            QByteArray nonce(kNonceSize, Qt::Uninitialized);
+            fillNonce(reinterpret_cast<unsigned char *>(nonce.data()));
+            return nonce;
+        }
+
+        class XorEncryptContext : public dynamicencrypt::core::CipherContext
+        {
+        public:
+            explicit XorEncryptContext(const QByteArray &key)
+                : m_nonce(randomNonce()), m_mask(makeMask(key, m_nonce))
+            {
+            }
+
+            QByteArray update(const QByteArray &chunk) override
+            {
+                QByteArray cipher = applyMask(*m_mask, chunk, m_offset);
+                m_offset += chunk.size();
+                if (m_headerWritten)
+                {
+                    return cipher;
+                }
+                m_headerWritten = true;
+                return m_nonce + cipher;
+            }
+
+            QByteArray finalize() override
+            {
+                if (m_headerWritten)
+                {
+                    return {};
+                }
+                m_headerWritten = true;
+                return m_nonce;
+            }
+
+        private:
+            QByteArray m_nonce;
+            std::unique_ptr<XorMask> m_mask;
+            qint64 m_offset{0};
+            bool m_headerWritten{false};
+        };
+
+        class XorDecryptContext : public dynamicencrypt::core::CipherContext
+        {
+        public:
+            explicit XorDecryptContext(const QByteArray &key)
+                : m_key(QByteArray(key))
+            {
+                m_nonce.reserve(kNonceSize);
+            }
+
+            QByteArray update(const QByteArray &chunk) override
+            {
+                qsizetype consumed = 0;
+                if (m_nonce.size() < kNonceSize)
+                {
+                    consumed = std::min<qsizetype>(kNonceSize - m_nonce.size(), chunk.size());
+                    m_nonce.append(chunk.constData(), consumed);
+                    if (m_nonce.size() == kNonceSize)
+                    {
+                        m_mask = makeMask(m_key.bytes(), m_nonce);
+                        m_key.secureWipe();
+                    }
+                    if (consumed == chunk.size())
+                    {
+                        return {};
+                    }
+                }
+                const QByteArray body = QByteArray::fromRawData(chunk.constData() + consumed, chunk.size() - consumed);
+                QByteArray plain = applyMask(*m_mask, body, m_offset);
+                m_offset += body.size();
+                return plain;
+            }
+
+            QByteArray finalize() override
+            {
+                if (m_nonce.size() < kNonceSize)
+                {
+                    throw std::invalid_argument("Ciphertext too short");
+                }
+                return {};
+            }
+
+        private:
+            dynamicencrypt::core::ZeroizingBuffer m_key;
+            QByteArray m_nonce;
+            std::unique_ptr<XorMask> m_mask;
+            qint64 m_offset{0};
+        };
+    }
+
+    QByteArray AESDriverImpl::encrypt(const QByteArray &plaintext, const QByteArray &key)
+    {
+        QByteArray output(plaintext.size() + kNonceSize, Qt::Uninitialized);
+        encrypt(dynamicencrypt::core::asBytes(plaintext), dynamicencrypt::core::asWritableBytes(output), key);
 
         // TODO: Replace xorSeal with AES-GCM/ChaCha20-Poly1305 when linking real crypto library.
         //       Nonce rules: never reuse the same nonce + key pair.
@@ -46,9 +153,115 @@ namespace dynamicencrypt::plugins
         {
             throw std::invalid_argument("Ciphertext too short");
         }
-        QByteArray nonce = ciphertext.left(kNonceSize);
-        QByteArray body = ciphertext.mid(kNonceSize);
-        return xorSeal(body, key, nonce);
+        QByteArray output(ciphertext.size() - kNonceSize, Qt::Uninitialized);
+        decrypt(dynamicencrypt::core::asBytes(ciphertext), dynamicencrypt::core::asWritableBytes(output), key);
+        return output;
+    }
+
+    dynamicencrypt::core::CiphertextLayout AESDriverImpl::ciphertextLayout() const
+    {
+        return {kNonceSize, 0};
+    }
+
+    qsizetype AESDriverImpl::encrypt(std::span<const std::byte> plaintext, std::span<std::byte> out,
+                                     const QByteArray &key)
+    {
+        if (key.isEmpty())
+        {
+            throw std::invalid_argument("Key must not be empty");
+        }
+        if (out.size() < plaintext.size() + kNonceSize)
+        {
+            throw std::length_error("output buffer too small");
+        }
+        auto *nonce = reinterpret_cast<unsigned char *>(out.data());
+        fillNonce(nonce);
+        const XorMask mask(bytesOf(key), static_cast<std::size_t>(key.size()), nonce, kNonceSize);
+        mask.apply(reinterpret_cast<const unsigned char *>(plaintext.data()), nonce + kNonceSize, plaintext.size(), 0);
+        return static_cast<qsizetype>(plaintext.size()) + kNonceSize;
+    }
+
+    qsizetype AESDriverImpl::decrypt(std::span<const std::byte> ciphertext, std::span<std::byte> out,
+                                     const QByteArray &key)
+    {
+        if (key.isEmpty())
+        {
+            throw std::invalid_argument("Key must not be empty");
+        }
+        if (ciphertext.size() < kNonceSize)
+        {
+            throw std::invalid_argument("Ciphertext too short");
+        }
+        const std::size_t bodySize = ciphertext.size() - kNonceSize;
+        if (out.size() < bodySize)
+        {
+            throw std::length_error("output buffer too small");
+        }
+        const auto *nonce = reinterpret_cast<const unsigned char *>(ciphertext.data());
+        const XorMask mask(bytesOf(key), static_cast<std::size_t>(key.size()), nonce, kNonceSize);
+        mask.apply(nonce + kNonceSize, reinterpret_cast<unsigned char *>(out.data()), bodySize, 0);
+        return static_cast<qsizetype>(bodySize);
+    }
+
+    void AESDriverImpl::encryptInPlace(std::span<std::byte> buffer, const QByteArray &key)
+    {
+        if (key.isEmpty())
+        {
+            throw std::invalid_argument("Key must not be empty");
+        }
+        if (buffer.size() < kNonceSize)
+        {
+            throw std::invalid_argument("buffer smaller than ciphertext overhead");
+        }
+        auto *nonce = reinterpret_cast<unsigned char *>(buffer.data());
+        fillNonce(nonce);
+        const XorMask mask(bytesOf(key), static_cast<std::size_t>(key.size()), nonce, kNonceSize);
+        mask.apply(nonce + kNonceSize, nonce + kNonceSize, buffer.size() - kNonceSize, 0);
+    }
+
+    std::span<std::byte> AESDriverImpl::decryptInPlace(std::span<std::byte> buffer, const QByteArray &key)
+    {
+        if (key.isEmpty())
+        {
+            throw std::invalid_argument("Key must not be empty");
+        }
+        if (buffer.size() < kNonceSize)
+        {
+            throw std::invalid_argument("Ciphertext too short");
+        }
+        auto *nonce = reinterpret_cast<unsigned char *>(buffer.data());
+        const XorMask mask(bytesOf(key), static_cast<std::size_t>(key.size()), nonce, kNonceSize);
+        mask.apply(nonce + kNonceSize, nonce + kNonceSize, buffer.size() - kNonceSize, 0);
+        return buffer.subspan(kNonceSize);
+    }
+
+    qsizetype AESDriverImpl::segmentNonceSize() const
+    {
+        return kNonceSize;
+    }
+
+    void AESDriverImpl::encryptSegment(std::span<const std::byte> in, std::span<std::byte> out, const QByteArray &key,
+                                       std::span<const std::byte> nonce)
+    {
+        if (key.isEmpty() || nonce.size() != kNonceSize)
+        {
+            throw std::invalid_argument("Segment requires a key and a 12-byte nonce");
+        }
+        if (out.size() < in.size())
+        {
+            throw std::length_error("output buffer too small");
+        }
+        const XorMask mask(bytesOf(key), static_cast<std::size_t>(key.size()),
+                           reinterpret_cast<const unsigned char *>(nonce.data()), kNonceSize);
+        mask.apply(reinterpret_cast<const unsigned char *>(in.data()), reinterpret_cast<unsigned char *>(out.data()),
+                   in.size(), 0);
+    }
+
+    void AESDriverImpl::decryptSegment(std::span<const std::byte> in, std::span<std::byte> out, const QByteArray &key,
+                                       std::span<const std::byte> nonce)
+    {
+        // The XOR keystream is its own inverse.
+        encryptSegment(in, out, key, nonce);
     }
 
     QByteArray AESDriverImpl::encrypt(const QByteArray &plaintext, const QString &keyMetadata)
@@ -63,6 +276,24 @@ namespace dynamicencrypt::plugins
         return decrypt(ciphertext, key);
     }
 
+    std::unique_ptr<dynamicencrypt::core::CipherContext> AESDriverImpl::createEncryptContext(const QByteArray &key)
+    {
+        if (key.isEmpty())
+        {
+            throw std::invalid_argument("Key must not be empty");
+        }
+        return std::make_unique<XorEncryptContext>(key);
+    }
+
+    std::unique_ptr<dynamicencrypt::core::CipherContext> AESDriverImpl::createDecryptContext(const QByteArray &key)
+    {
+        if (key.isEmpty())
+        {
+            throw std::invalid_argument("Key must not be empty");
+        }
+        return std::make_unique<XorDecryptContext>(key);
+    }
+
     QString AESDriverImpl::name() const
     {
         return QStringLiteral("Demo AES (XOR placeholder)");
@@ -73,20 +304,14 @@ namespace dynamicencrypt::plugins
         return QStringLiteral("0.1-demo");
     }
 
-    QByteArray AESDriverImpl::xorSeal(const QByteArray &input, const QByteArray &key, const QByteArray &nonce) const
+    QByteArray AESDriverImpl::xorSeal(const QByteArray &input, const QByteArray &key, const QByteArray &nonce,
+                                      qint64 offset)
     {
-        QByteArray result(input.size(), Qt::Uninitialized);
-        dynamicencrypt::core::ZeroizingBuffer mask(input.size());
-        QByteArray &maskBytes = mask.writable();
-        maskBytes.resize(input.size());
-        for (int i = 0; i < input.size(); ++i)
+        if (key.isEmpty() || nonce.isEmpty())
         {
-            const unsigned char keyByte = static_cast<unsigned char>(key.at(i % key.size()));
-            const unsigned char nonceByte = static_cast<unsigned char>(nonce.at(i % nonce.size()));
-            maskBytes[i] = static_cast<char>(keyByte ^ nonceByte);
-            result[i] = static_cast<char>(static_cast<unsigned char>(input.at(i)) ^ static_cast<unsigned char>(maskBytes.at(i)));
+            throw std::invalid_argument("Key and nonce must not be empty");
         }
-        return result;
+        return applyMask(*makeMask(key, nonce), input, offset);
     }
 
     QByteArray AESDriverImpl::deriveKeyFromMetadata(const QString &metadata) const
@@ -25,11 +25,30 @@ namespace dynamicencrypt::plugins
         QByteArray encrypt(const QByteArray &plaintext, const QString &keyMetadata) override;
         QByteArray decrypt(const QByteArray &ciphertext, const QString &keyMetadata) override;
 
+        dynamicencrypt::core::CiphertextLayout ciphertextLayout() const override;
+        qsizetype encrypt(std::span<const std::byte> plaintext, std::span<std::byte> out, const QByteArray &key) override;
+        qsizetype decrypt(std::span<const std::byte> ciphertext, std::span<std::byte> out, const QByteArray &key) override;
+        void encryptInPlace(std::span<std::byte> buffer, const QByteArray &key) override;
+        std::span<std::byte> decryptInPlace(std::span<std::byte> buffer, const QByteArray &key) override;
+
+        qsizetype segmentNonceSize() const override;
+        void encryptSegment(std::span<const std::byte> in, std::span<std::byte> out, const QByteArray &key,
+                            std::span<const std::byte> nonce) override;
+        void decryptSegment(std::span<const std::byte> in, std::span<std::byte> out, const QByteArray &key,
+                            std::span<const std::byte> nonce) override;
+
+        std::unique_ptr<dynamicencrypt::core::CipherContext> createEncryptContext(const QByteArray &key) override;
+        std::unique_ptr<dynamicencrypt::core::CipherContext> createDecryptContext(const QByteArray &key) override;
+
         QString name() const override;
         QString version() const override;
 
+        // Keystream position is counted from the first byte after the nonce, so
+        // chunked callers pass the running offset to stay aligned with xorSeal().
+        static QByteArray xorSeal(const QByteArray &input, const QByteArray &key, const QByteArray &nonce,
+                                  qint64 offset = 0);
+
     private:
-        QByteArray xorSeal(const QByteArray &input, const QByteArray &key, const QByteArray &nonce) const;
         QByteArray deriveKeyFromMetadata(const QString &metadata) const;
     };
 
@@ -0,0 +1,280 @@
+#include "XorKernels.h"
+
+#include "core/CpuFeatures.h"
+
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DE_XOR_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define DE_TARGET(features)
+#else
+#define DE_TARGET(features) __attribute__((target(features)))
+#endif
+#endif
+
+namespace dynamicencrypt::plugins
+{
+
+    namespace
+    {
+        // Widest stride consumed per kernel iteration; the pattern is padded by this much so any
+        // window starting inside the period can be loaded without wrapping.
+        constexpr std::size_t kStride = 128;
+
+        // Periods above this fall back to index tracking instead of a materialized pattern.
+        constexpr std::size_t kMaxPeriod = std::size_t{1} << 16;
+
+        using Kernel = void (*)(const unsigned char *in, unsigned char *out, std::size_t size,
+                                const unsigned char *pattern, std::size_t period, std::size_t pos);
+
+        void tail(const unsigned char *in, unsigned char *out, std::size_t size, const unsigned char *pattern,
+                  std::size_t pos)
+        {
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                out[i] = static_cast<unsigned char>(in[i] ^ pattern[pos + i]);
+            }
+        }
+
+        void scalarKernel(const unsigned char *in, unsigned char *out, std::size_t size, const unsigned char *pattern,
+                          std::size_t period, std::size_t pos)
+        {
+            std::size_t i = 0;
+            for (; i + kStride <= size; i += kStride)
+            {
+                for (std::size_t lane = 0; lane < kStride; lane += sizeof(std::uint64_t))
+                {
+                    std::uint64_t data;
+                    std::uint64_t mask;
+                    std::memcpy(&data, in + i + lane, sizeof(data));
+                    std::memcpy(&mask, pattern + pos + lane, sizeof(mask));
+                    data ^= mask;
+                    std::memcpy(out + i + lane, &data, sizeof(data));
+                }
+                pos += kStride;
+                if (pos >= period)
+                {
+                    pos -= period;
+                }
+            }
+            tail(in + i, out + i, size - i, pattern, pos);
+        }
+
+#if defined(DE_XOR_X86)
+        DE_TARGET("sse2")
+        void sse2Kernel(const unsigned char *in, unsigned char *out, std::size_t size, const unsigned char *pattern,
+                        std::size_t period, std::size_t pos)
+        {
+            std::size_t i = 0;
+            for (; i + kStride <= size; i += kStride)
+            {
+                for (std::size_t lane = 0; lane < kStride; lane += 16)
+                {
+                    const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + lane));
+                    const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pattern + pos + lane));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + lane), _mm_xor_si128(data, mask));
+                }
+                pos += kStride;
+                if (pos >= period)
+                {
+                    pos -= period;
+                }
+            }
+            tail(in + i, out + i, size - i, pattern, pos);
+        }
+
+        DE_TARGET("avx2")
+        void avx2Kernel(const unsigned char *in, unsigned char *out, std::size_t size, const unsigned char *pattern,
+                        std::size_t period, std::size_t pos)
+        {
+            std::size_t i = 0;
+            for (; i + kStride <= size; i += kStride)
+            {
+                for (std::size_t lane = 0; lane < kStride; lane += 32)
+                {
+                    const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i + lane));
+                    const __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pattern + pos + lane));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + lane), _mm256_xor_si256(data, mask));
+                }
+                pos += kStride;
+                if (pos >= period)
+                {
+                    pos -= period;
+                }
+            }
+            tail(in + i, out + i, size - i, pattern, pos);
+        }
+
+        DE_TARGET("avx512f")
+        void avx512Kernel(const unsigned char *in, unsigned char *out, std::size_t size, const unsigned char *pattern,
+                          std::size_t period, std::size_t pos)
+        {
+            std::size_t i = 0;
+            for (; i + kStride <= size; i += kStride)
+            {
+                for (std::size_t lane = 0; lane < kStride; lane += 64)
+                {
+                    const __m512i data = _mm512_loadu_si512(in + i + lane);
+                    const __m512i mask = _mm512_loadu_si512(pattern + pos + lane);
+                    _mm512_storeu_si512(out + i + lane, _mm512_xor_si512(data, mask));
+                }
+                pos += kStride;
+                if (pos >= period)
+                {
+                    pos -= period;
+                }
+            }
+            tail(in + i, out + i, size - i, pattern, pos);
+        }
+
+#endif
+
+        Kernel kernelFor(XorMask::Tier tier) noexcept
+        {
+            switch (tier)
+            {
+#if defined(DE_XOR_X86)
+            case XorMask::Tier::AVX512:
+                return avx512Kernel;
+            case XorMask::Tier::AVX2:
+                return avx2Kernel;
+            case XorMask::Tier::SSE2:
+                return sse2Kernel;
+#endif
+            default:
+                return scalarKernel;
+            }
+        }
+    }
+
+    XorMask::XorMask(const unsigned char *key, std::size_t keySize, const unsigned char *nonce, std::size_t nonceSize)
+    {
+        if (keySize == 0 || nonceSize == 0)
+        {
+            throw std::invalid_argument("XorMask requires non-empty key and nonce");
+        }
+        const std::size_t period = std::lcm(keySize, nonceSize);
+        if (period > kMaxPeriod)
+        {
+            m_key.assign(key, key + keySize);
+            m_nonce.assign(nonce, nonce + nonceSize);
+            return;
+        }
+        // Round the period up to a multiple covering one stride so a single subtraction rewinds it.
+        m_period = period * ((kStride + period - 1) / period);
+        m_pattern.resize(m_period + kStride);
+        std::size_t keyIndex = 0;
+        std::size_t nonceIndex = 0;
+        for (std::size_t i = 0; i < m_pattern.size(); ++i)
+        {
+            m_pattern[i] = static_cast<unsigned char>(key[keyIndex] ^ nonce[nonceIndex]);
+            if (++keyIndex == keySize)
+            {
+                keyIndex = 0;
+            }
+            if (++nonceIndex == nonceSize)
+            {
+                nonceIndex = 0;
+            }
+        }
+    }
+
+    XorMask::~XorMask() = default;
+
+    void XorMask::apply(const unsigned char *in, unsigned char *out, std::size_t size, std::uint64_t offset) const
+    {
+        apply(in, out, size, offset, bestTier());
+    }
+
+    void XorMask::apply(const unsigned char *in, unsigned char *out, std::size_t size, std::uint64_t offset,
+                        Tier tier) const
+    {
+        if (size == 0)
+        {
+            return;
+        }
+        if (m_pattern.empty())
+        {
+            std::size_t keyIndex = static_cast<std::size_t>(offset % m_key.size());
+            std::size_t nonceIndex = static_cast<std::size_t>(offset % m_nonce.size());
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                out[i] = static_cast<unsigned char>(in[i] ^ m_key[keyIndex] ^ m_nonce[nonceIndex]);
+                if (++keyIndex == m_key.size())
+                {
+                    keyIndex = 0;
+                }
+                if (++nonceIndex == m_nonce.size())
+                {
+                    nonceIndex = 0;
+                }
+            }
+            return;
+        }
+        if (!supported(tier))
+        {
+            tier = bestTier();
+        }
+        kernelFor(tier)(in, out, size, m_pattern.data(), m_period, static_cast<std::size_t>(offset % m_period));
+    }
+
+    XorMask::Tier XorMask::bestTier() noexcept
+    {
+#if defined(DE_XOR_X86)
+        const auto &features = core::CpuFeatures::current();
+        if (features.avx512f)
+        {
+            return Tier::AVX512;
+        }
+        if (features.avx2)
+        {
+            return Tier::AVX2;
+        }
+        if (features.sse2)
+        {
+            return Tier::SSE2;
+        }
+#endif
+        return Tier::Scalar;
+    }
+
+    bool XorMask::supported(Tier tier) noexcept
+    {
+        switch (tier)
+        {
+        case Tier::Scalar:
+            return true;
+#if defined(DE_XOR_X86)
+        case Tier::SSE2:
+            return core::CpuFeatures::current().sse2;
+        case Tier::AVX2:
+            return core::CpuFeatures::current().avx2;
+        case Tier::AVX512:
+            return core::CpuFeatures::current().avx512f;
+#endif
+        default:
+            return false;
+        }
+    }
+
+    const char *XorMask::tierName(Tier tier) noexcept
+    {
+        switch (tier)
+        {
+        case Tier::SSE2:
+            return "sse2";
+        case Tier::AVX2:
+            return "avx2";
+        case Tier::AVX512:
+            return "avx512";
+        default:
+            return "scalar";
+        }
+    }
+
+} // namespace dynamicencrypt::plugins
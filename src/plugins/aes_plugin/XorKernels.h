@@ -0,0 +1,47 @@
+#pragma once
+
+#include "core/SecureArena.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dynamicencrypt::plugins
+{
+
+    // Precomputed mask key[i % keySize] ^ nonce[i % nonceSize], unrolled over its period so the
+    // vector kernels can stream it without per-byte modulo. Output is byte-identical for every tier.
+    class XorMask
+    {
+    public:
+        enum class Tier
+        {
+            Scalar,
+            SSE2,
+            AVX2,
+            AVX512
+        };
+
+        XorMask(const unsigned char *key, std::size_t keySize, const unsigned char *nonce, std::size_t nonceSize);
+        ~XorMask();
+
+        XorMask(const XorMask &) = delete;
+        XorMask &operator=(const XorMask &) = delete;
+
+        // Applies the mask starting at keystream position offset; out may alias in.
+        void apply(const unsigned char *in, unsigned char *out, std::size_t size, std::uint64_t offset) const;
+        void apply(const unsigned char *in, unsigned char *out, std::size_t size, std::uint64_t offset, Tier tier) const;
+
+        // Widest tier supported by the running CPU, detected once via CPUID.
+        static Tier bestTier() noexcept;
+        static bool supported(Tier tier) noexcept;
+        static const char *tierName(Tier tier) noexcept;
+
+    private:
+        // Arena-backed, so the mask is page-locked and wiped when the vectors release it.
+        dynamicencrypt::core::SecureVector<unsigned char> m_key;
+        dynamicencrypt::core::SecureVector<unsigned char> m_nonce;
+        dynamicencrypt::core::SecureVector<unsigned char> m_pattern;
+        std::size_t m_period{0};
+    };
+
+} // namespace dynamicencrypt::plugins
@@ -0,0 +1,897 @@
+#include "ChaCha20Poly1305.h"
+
+#include "core/CpuFeatures.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DE_CHACHA_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define DE_TARGET(features)
+#else
+#define DE_TARGET(features) __attribute__((target(features)))
+#endif
+#endif
+
+namespace dynamicencrypt::plugins
+{
+
+    namespace
+    {
+        constexpr std::uint32_t kSigma[4] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+        constexpr std::uint32_t kMask26 = 0x3ffffff;
+        // ChaCha20 and Poly1305 alternate in passes of this many blocks so the data stays in L1.
+        constexpr std::size_t kPassBlocks = 64;
+        // Below this many 16-byte blocks the vector Poly1305 does not pay for its final multiply.
+        constexpr std::size_t kPolyVectorMinBlocks = 16;
+
+        void wipe(void *ptr, std::size_t size) noexcept
+        {
+            volatile unsigned char *bytes = static_cast<unsigned char *>(ptr);
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                bytes[i] = 0;
+            }
+        }
+
+        std::uint32_t load32le(const unsigned char *p) noexcept
+        {
+            return std::uint32_t{p[0]} | (std::uint32_t{p[1]} << 8) | (std::uint32_t{p[2]} << 16) |
+                   (std::uint32_t{p[3]} << 24);
+        }
+
+        void store32le(unsigned char *p, std::uint32_t v) noexcept
+        {
+            p[0] = static_cast<unsigned char>(v);
+            p[1] = static_cast<unsigned char>(v >> 8);
+            p[2] = static_cast<unsigned char>(v >> 16);
+            p[3] = static_cast<unsigned char>(v >> 24);
+        }
+
+        void store64le(unsigned char *p, std::uint64_t v) noexcept
+        {
+            store32le(p, static_cast<std::uint32_t>(v));
+            store32le(p + 4, static_cast<std::uint32_t>(v >> 32));
+        }
+
+        // ---- ChaCha20, one block at a time ----
+
+        std::uint32_t rotl32(std::uint32_t v, int n) noexcept
+        {
+            return (v << n) | (v >> (32 - n));
+        }
+
+        void quarterRound(std::uint32_t &a, std::uint32_t &b, std::uint32_t &c, std::uint32_t &d) noexcept
+        {
+            a += b;
+            d = rotl32(d ^ a, 16);
+            c += d;
+            b = rotl32(b ^ c, 12);
+            a += b;
+            d = rotl32(d ^ a, 8);
+            c += d;
+            b = rotl32(b ^ c, 7);
+        }
+
+        void chachaBlock(const std::uint32_t *state, std::uint32_t counter, unsigned char *out) noexcept
+        {
+            std::uint32_t x[16];
+            std::memcpy(x, state, sizeof(x));
+            x[12] = counter;
+            for (int round = 0; round < 10; ++round)
+            {
+                quarterRound(x[0], x[4], x[8], x[12]);
+                quarterRound(x[1], x[5], x[9], x[13]);
+                quarterRound(x[2], x[6], x[10], x[14]);
+                quarterRound(x[3], x[7], x[11], x[15]);
+                quarterRound(x[0], x[5], x[10], x[15]);
+                quarterRound(x[1], x[6], x[11], x[12]);
+                quarterRound(x[2], x[7], x[8], x[13]);
+                quarterRound(x[3], x[4], x[9], x[14]);
+            }
+            for (int i = 0; i < 16; ++i)
+            {
+                store32le(out + 4 * i, x[i] + (i == 12 ? counter : state[i]));
+            }
+            wipe(x, sizeof(x));
+        }
+
+        void xorScalar(const std::uint32_t *state, std::uint32_t counter, const unsigned char *in, unsigned char *out,
+                       std::size_t blocks) noexcept
+        {
+            unsigned char keystream[64];
+            for (; blocks > 0; --blocks, ++counter, in += 64, out += 64)
+            {
+                chachaBlock(state, counter, keystream);
+                for (int i = 0; i < 64; ++i)
+                {
+                    out[i] = static_cast<unsigned char>(in[i] ^ keystream[i]);
+                }
+            }
+            wipe(keystream, sizeof(keystream));
+        }
+
+        // ---- Poly1305 with five 26-bit limbs ----
+
+        // h = h * r mod 2^130 - 5, leaving every limb below 2^26 except h1, which may carry a few bits over.
+        void polyMultiply(std::uint32_t *h, const std::uint32_t *r) noexcept
+        {
+            const std::uint64_t r0 = r[0], r1 = r[1], r2 = r[2], r3 = r[3], r4 = r[4];
+            const std::uint64_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+            const std::uint64_t h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4];
+
+            const std::uint64_t d0 = h0 * r0 + h1 * s4 + h2 * s3 + h3 * s2 + h4 * s1;
+            std::uint64_t d1 = h0 * r1 + h1 * r0 + h2 * s4 + h3 * s3 + h4 * s2;
+            std::uint64_t d2 = h0 * r2 + h1 * r1 + h2 * r0 + h3 * s4 + h4 * s3;
+            std::uint64_t d3 = h0 * r3 + h1 * r2 + h2 * r1 + h3 * r0 + h4 * s4;
+            std::uint64_t d4 = h0 * r4 + h1 * r3 + h2 * r2 + h3 * r1 + h4 * r0;
+
+            d1 += d0 >> 26;
+            d2 += d1 >> 26;
+            d3 += d2 >> 26;
+            d4 += d3 >> 26;
+            std::uint64_t c = d4 >> 26;
+            std::uint64_t l0 = (d0 & kMask26) + c * 5;
+            h[1] = static_cast<std::uint32_t>((d1 & kMask26) + (l0 >> 26));
+            h[0] = static_cast<std::uint32_t>(l0 & kMask26);
+            h[2] = static_cast<std::uint32_t>(d2 & kMask26);
+            h[3] = static_cast<std::uint32_t>(d3 & kMask26);
+            h[4] = static_cast<std::uint32_t>(d4 & kMask26);
+        }
+
+        void polyBlocksScalar(std::uint32_t *h, const std::uint32_t *r, const unsigned char *m,
+                              std::size_t blocks) noexcept
+        {
+            for (; blocks > 0; --blocks, m += 16)
+            {
+                h[0] += load32le(m) & kMask26;
+                h[1] += (load32le(m + 3) >> 2) & kMask26;
+                h[2] += (load32le(m + 6) >> 4) & kMask26;
+                h[3] += (load32le(m + 9) >> 6) & kMask26;
+                h[4] += (load32le(m + 12) >> 8) | (1u << 24);
+                polyMultiply(h, r);
+            }
+        }
+
+        void polyKey(const unsigned char *key, std::uint32_t r[4][5], std::uint32_t *pad) noexcept
+        {
+            const std::uint32_t t0 = load32le(key), t1 = load32le(key + 4), t2 = load32le(key + 8),
+                                t3 = load32le(key + 12);
+            r[0][0] = t0 & 0x3ffffff;
+            r[0][1] = ((t0 >> 26) | (t1 << 6)) & 0x3ffff03;
+            r[0][2] = ((t1 >> 20) | (t2 << 12)) & 0x3ffc0ff;
+            r[0][3] = ((t2 >> 14) | (t3 << 18)) & 0x3f03fff;
+            r[0][4] = (t3 >> 8) & 0x00fffff;
+            for (int power = 1; power < 4; ++power)
+            {
+                std::memcpy(r[power], r[power - 1], sizeof(r[power]));
+                polyMultiply(r[power], r[0]);
+            }
+            for (int i = 0; i < 4; ++i)
+            {
+                pad[i] = load32le(key + 16 + 4 * i);
+            }
+        }
+
+        void polyFinish(std::uint32_t *h, const std::uint32_t *pad, unsigned char *tag) noexcept
+        {
+            std::uint32_t h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4];
+            std::uint32_t c = h1 >> 26;
+            h1 &= kMask26;
+            h2 += c;
+            c = h2 >> 26;
+            h2 &= kMask26;
+            h3 += c;
+            c = h3 >> 26;
+            h3 &= kMask26;
+            h4 += c;
+            c = h4 >> 26;
+            h4 &= kMask26;
+            h0 += c * 5;
+            c = h0 >> 26;
+            h0 &= kMask26;
+            h1 += c;
+
+            // Select h - p when it does not borrow, without branching on h.
+            std::uint32_t g0 = h0 + 5;
+            c = g0 >> 26;
+            g0 &= kMask26;
+            std::uint32_t g1 = h1 + c;
+            c = g1 >> 26;
+            g1 &= kMask26;
+            std::uint32_t g2 = h2 + c;
+            c = g2 >> 26;
+            g2 &= kMask26;
+            std::uint32_t g3 = h3 + c;
+            c = g3 >> 26;
+            g3 &= kMask26;
+            const std::uint32_t g4 = h4 + c - (1u << 26);
+            const std::uint32_t keepG = (g4 >> 31) - 1;
+            h0 = (h0 & ~keepG) | (g0 & keepG);
+            h1 = (h1 & ~keepG) | (g1 & keepG);
+            h2 = (h2 & ~keepG) | (g2 & keepG);
+            h3 = (h3 & ~keepG) | (g3 & keepG);
+            h4 = (h4 & ~keepG) | (g4 & keepG);
+
+            const std::uint32_t w0 = h0 | (h1 << 26);
+            const std::uint32_t w1 = (h1 >> 6) | (h2 << 20);
+            const std::uint32_t w2 = (h2 >> 12) | (h3 << 14);
+            const std::uint32_t w3 = (h3 >> 18) | (h4 << 8);
+            std::uint64_t f = std::uint64_t{w0} + pad[0];
+            store32le(tag, static_cast<std::uint32_t>(f));
+            f = std::uint64_t{w1} + pad[1] + (f >> 32);
+            store32le(tag + 4, static_cast<std::uint32_t>(f));
+            f = std::uint64_t{w2} + pad[2] + (f >> 32);
+            store32le(tag + 8, static_cast<std::uint32_t>(f));
+            f = std::uint64_t{w3} + pad[3] + (f >> 32);
+            store32le(tag + 12, static_cast<std::uint32_t>(f));
+        }
+
+#if defined(DE_CHACHA_X86)
+        // ---- SSE2: 4 blocks, word i of block j in lane j of x[i] ----
+
+        template <int N>
+        DE_TARGET("sse2")
+        __m128i rotlSse2(__m128i v)
+        {
+            return _mm_or_si128(_mm_slli_epi32(v, N), _mm_srli_epi32(v, 32 - N));
+        }
+
+        DE_TARGET("sse2")
+        void quarterSse2(__m128i &a, __m128i &b, __m128i &c, __m128i &d)
+        {
+            a = _mm_add_epi32(a, b);
+            d = rotlSse2<16>(_mm_xor_si128(d, a));
+            c = _mm_add_epi32(c, d);
+            b = rotlSse2<12>(_mm_xor_si128(b, c));
+            a = _mm_add_epi32(a, b);
+            d = rotlSse2<8>(_mm_xor_si128(d, a));
+            c = _mm_add_epi32(c, d);
+            b = rotlSse2<7>(_mm_xor_si128(b, c));
+        }
+
+        // Transposes words w..w+3 of the four blocks and XORs them into the 16 bytes at offset 4w of each.
+        DE_TARGET("sse2")
+        void xorWordsSse2(const __m128i *x, const unsigned char *in, unsigned char *out)
+        {
+            const __m128i a = _mm_unpacklo_epi32(x[0], x[1]);
+            const __m128i b = _mm_unpacklo_epi32(x[2], x[3]);
+            const __m128i c = _mm_unpackhi_epi32(x[0], x[1]);
+            const __m128i d = _mm_unpackhi_epi32(x[2], x[3]);
+            const __m128i rows[4] = {_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b), _mm_unpacklo_epi64(c, d),
+                                     _mm_unpackhi_epi64(c, d)};
+            for (int j = 0; j < 4; ++j)
+            {
+                const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 64 * j));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 64 * j), _mm_xor_si128(data, rows[j]));
+            }
+        }
+
+        DE_TARGET("sse2")
+        void xorSse2(const std::uint32_t *state, std::uint32_t counter, const unsigned char *in, unsigned char *out,
+                     std::size_t groups)
+        {
+            __m128i x[16];
+            for (; groups > 0; --groups, counter += 4, in += 256, out += 256)
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    x[i] = _mm_set1_epi32(static_cast<int>(state[i]));
+                }
+                const __m128i counters =
+                    _mm_add_epi32(_mm_set1_epi32(static_cast<int>(counter)), _mm_set_epi32(3, 2, 1, 0));
+                x[12] = counters;
+                for (int round = 0; round < 10; ++round)
+                {
+                    quarterSse2(x[0], x[4], x[8], x[12]);
+                    quarterSse2(x[1], x[5], x[9], x[13]);
+                    quarterSse2(x[2], x[6], x[10], x[14]);
+                    quarterSse2(x[3], x[7], x[11], x[15]);
+                    quarterSse2(x[0], x[5], x[10], x[15]);
+                    quarterSse2(x[1], x[6], x[11], x[12]);
+                    quarterSse2(x[2], x[7], x[8], x[13]);
+                    quarterSse2(x[3], x[4], x[9], x[14]);
+                }
+                for (int i = 0; i < 16; ++i)
+                {
+                    x[i] = _mm_add_epi32(x[i], i == 12 ? counters : _mm_set1_epi32(static_cast<int>(state[i])));
+                }
+                for (int w = 0; w < 16; w += 4)
+                {
+                    xorWordsSse2(x + w, in + 4 * w, out + 4 * w);
+                }
+            }
+            wipe(x, sizeof(x));
+        }
+
+        // ---- AVX2: 8 blocks ----
+
+        template <int N>
+        DE_TARGET("avx2")
+        __m256i rotlAvx2(__m256i v)
+        {
+            if constexpr (N == 16)
+            {
+                const __m256i rot16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13, 2, 3, 0,
+                                                       1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+                return _mm256_shuffle_epi8(v, rot16);
+            }
+            else if constexpr (N == 8)
+            {
+                const __m256i rot8 = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14, 3, 0, 1, 2,
+                                                      7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+                return _mm256_shuffle_epi8(v, rot8);
+            }
+            else
+            {
+                return _mm256_or_si256(_mm256_slli_epi32(v, N), _mm256_srli_epi32(v, 32 - N));
+            }
+        }
+
+        DE_TARGET("avx2")
+        void quarterAvx2(__m256i &a, __m256i &b, __m256i &c, __m256i &d)
+        {
+            a = _mm256_add_epi32(a, b);
+            d = rotlAvx2<16>(_mm256_xor_si256(d, a));
+            c = _mm256_add_epi32(c, d);
+            b = rotlAvx2<12>(_mm256_xor_si256(b, c));
+            a = _mm256_add_epi32(a, b);
+            d = rotlAvx2<8>(_mm256_xor_si256(d, a));
+            c = _mm256_add_epi32(c, d);
+            b = rotlAvx2<7>(_mm256_xor_si256(b, c));
+        }
+
+        // 4x4 transpose inside each 128-bit lane: rows[j] holds words w..w+3 of block j (low lane)
+        // and of block 4 + j (high lane).
+        DE_TARGET("avx2")
+        void transposeAvx2(const __m256i *x, __m256i *rows)
+        {
+            const __m256i a = _mm256_unpacklo_epi32(x[0], x[1]);
+            const __m256i b = _mm256_unpacklo_epi32(x[2], x[3]);
+            const __m256i c = _mm256_unpackhi_epi32(x[0], x[1]);
+            const __m256i d = _mm256_unpackhi_epi32(x[2], x[3]);
+            rows[0] = _mm256_unpacklo_epi64(a, b);
+            rows[1] = _mm256_unpackhi_epi64(a, b);
+            rows[2] = _mm256_unpacklo_epi64(c, d);
+            rows[3] = _mm256_unpackhi_epi64(c, d);
+        }
+
+        DE_TARGET("avx2")
+        void xorHalfAvx2(__m256i keystream, const unsigned char *in, unsigned char *out)
+        {
+            const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm256_xor_si256(data, keystream));
+        }
+
+        DE_TARGET("avx2")
+        void xorAvx2(const std::uint32_t *state, std::uint32_t counter, const unsigned char *in, unsigned char *out,
+                     std::size_t groups)
+        {
+            __m256i x[16];
+            __m256i lo[4];
+            __m256i hi[4];
+            for (; groups > 0; --groups, counter += 8, in += 512, out += 512)
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    x[i] = _mm256_set1_epi32(static_cast<int>(state[i]));
+                }
+                const __m256i counters = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(counter)),
+                                                          _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+                x[12] = counters;
+                for (int round = 0; round < 10; ++round)
+                {
+                    quarterAvx2(x[0], x[4], x[8], x[12]);
+                    quarterAvx2(x[1], x[5], x[9], x[13]);
+                    quarterAvx2(x[2], x[6], x[10], x[14]);
+                    quarterAvx2(x[3], x[7], x[11], x[15]);
+                    quarterAvx2(x[0], x[5], x[10], x[15]);
+                    quarterAvx2(x[1], x[6], x[11], x[12]);
+                    quarterAvx2(x[2], x[7], x[8], x[13]);
+                    quarterAvx2(x[3], x[4], x[9], x[14]);
+                }
+                for (int i = 0; i < 16; ++i)
+                {
+                    x[i] = _mm256_add_epi32(x[i], i == 12 ? counters : _mm256_set1_epi32(static_cast<int>(state[i])));
+                }
+                // Words 0..7 then 8..15: pairing the lanes of two transposes yields 32 contiguous bytes.
+                for (int w = 0; w < 16; w += 8)
+                {
+                    transposeAvx2(x + w, lo);
+                    transposeAvx2(x + w + 4, hi);
+                    for (int j = 0; j < 4; ++j)
+                    {
+                        xorHalfAvx2(_mm256_permute2x128_si256(lo[j], hi[j], 0x20), in + 64 * j + 4 * w,
+                                    out + 64 * j + 4 * w);
+                        xorHalfAvx2(_mm256_permute2x128_si256(lo[j], hi[j], 0x31), in + 64 * (4 + j) + 4 * w,
+                                    out + 64 * (4 + j) + 4 * w);
+                    }
+                }
+            }
+            wipe(x, sizeof(x));
+            wipe(lo, sizeof(lo));
+            wipe(hi, sizeof(hi));
+        }
+
+        // ---- AVX-512: 16 blocks ----
+
+        DE_TARGET("avx512f")
+        void quarterAvx512(__m512i &a, __m512i &b, __m512i &c, __m512i &d)
+        {
+            a = _mm512_add_epi32(a, b);
+            d = _mm512_rol_epi32(_mm512_xor_si512(d, a), 16);
+            c = _mm512_add_epi32(c, d);
+            b = _mm512_rol_epi32(_mm512_xor_si512(b, c), 12);
+            a = _mm512_add_epi32(a, b);
+            d = _mm512_rol_epi32(_mm512_xor_si512(d, a), 8);
+            c = _mm512_add_epi32(c, d);
+            b = _mm512_rol_epi32(_mm512_xor_si512(b, c), 7);
+        }
+
+        DE_TARGET("avx512f")
+        void transposeAvx512(const __m512i *x, __m512i *rows)
+        {
+            const __m512i a = _mm512_unpacklo_epi32(x[0], x[1]);
+            const __m512i b = _mm512_unpacklo_epi32(x[2], x[3]);
+            const __m512i c = _mm512_unpackhi_epi32(x[0], x[1]);
+            const __m512i d = _mm512_unpackhi_epi32(x[2], x[3]);
+            rows[0] = _mm512_unpacklo_epi64(a, b);
+            rows[1] = _mm512_unpackhi_epi64(a, b);
+            rows[2] = _mm512_unpacklo_epi64(c, d);
+            rows[3] = _mm512_unpackhi_epi64(c, d);
+        }
+
+        DE_TARGET("avx512f")
+        void xorAvx512(const std::uint32_t *state, std::uint32_t counter, const unsigned char *in, unsigned char *out,
+                       std::size_t groups)
+        {
+            __m512i x[16];
+            // rows[w / 4][j], lane c: words w..w+3 of block 4c + j.
+            __m512i rows[4][4];
+            for (; groups > 0; --groups, counter += 16, in += 1024, out += 1024)
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    x[i] = _mm512_set1_epi32(static_cast<int>(state[i]));
+                }
+                const __m512i counters =
+                    _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(counter)),
+                                     _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+                x[12] = counters;
+                for (int round = 0; round < 10; ++round)
+                {
+                    quarterAvx512(x[0], x[4], x[8], x[12]);
+                    quarterAvx512(x[1], x[5], x[9], x[13]);
+                    quarterAvx512(x[2], x[6], x[10], x[14]);
+                    quarterAvx512(x[3], x[7], x[11], x[15]);
+                    quarterAvx512(x[0], x[5], x[10], x[15]);
+                    quarterAvx512(x[1], x[6], x[11], x[12]);
+                    quarterAvx512(x[2], x[7], x[8], x[13]);
+                    quarterAvx512(x[3], x[4], x[9], x[14]);
+                }
+                for (int i = 0; i < 16; ++i)
+                {
+                    x[i] = _mm512_add_epi32(x[i],
+                                            i == 12 ? counters : _mm512_set1_epi32(static_cast<int>(state[i])));
+                }
+                for (int w = 0; w < 4; ++w)
+                {
+                    transposeAvx512(x + 4 * w, rows[w]);
+                }
+                // A 4x4 transpose of 128-bit lanes turns rows[0..3][j] into four whole blocks.
+                for (int j = 0; j < 4; ++j)
+                {
+                    const __m512i u0 = _mm512_shuffle_i32x4(rows[0][j], rows[1][j], 0x44);
+                    const __m512i u1 = _mm512_shuffle_i32x4(rows[0][j], rows[1][j], 0xee);
+                    const __m512i u2 = _mm512_shuffle_i32x4(rows[2][j], rows[3][j], 0x44);
+                    const __m512i u3 = _mm512_shuffle_i32x4(rows[2][j], rows[3][j], 0xee);
+                    const __m512i blocks[4] = {_mm512_shuffle_i32x4(u0, u2, 0x88), _mm512_shuffle_i32x4(u0, u2, 0xdd),
+                                               _mm512_shuffle_i32x4(u1, u3, 0x88), _mm512_shuffle_i32x4(u1, u3, 0xdd)};
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        const std::size_t offset = 64 * (4 * c + j);
+                        const __m512i data = _mm512_loadu_si512(in + offset);
+                        _mm512_storeu_si512(out + offset, _mm512_xor_si512(data, blocks[c]));
+                    }
+                }
+            }
+            wipe(x, sizeof(x));
+            wipe(rows, sizeof(rows));
+        }
+
+        // ---- AVX2 Poly1305: four interleaved accumulators ----
+
+        DE_TARGET("avx2")
+        __m256i mul(__m256i x, __m256i y)
+        {
+            return _mm256_mul_epu32(x, y);
+        }
+
+        DE_TARGET("avx2")
+        void polyMultiplyAvx2(__m256i *a, const __m256i *r, const __m256i *s)
+        {
+            const __m256i mask = _mm256_set1_epi64x(kMask26);
+            __m256i d0 = _mm256_add_epi64(
+                _mm256_add_epi64(_mm256_add_epi64(mul(a[0], r[0]), mul(a[1], s[4])),
+                                 _mm256_add_epi64(mul(a[2], s[3]), mul(a[3], s[2]))),
+                mul(a[4], s[1]));
+            __m256i d1 = _mm256_add_epi64(
+                _mm256_add_epi64(_mm256_add_epi64(mul(a[0], r[1]), mul(a[1], r[0])),
+                                 _mm256_add_epi64(mul(a[2], s[4]), mul(a[3], s[3]))),
+                mul(a[4], s[2]));
+            __m256i d2 = _mm256_add_epi64(
+                _mm256_add_epi64(_mm256_add_epi64(mul(a[0], r[2]), mul(a[1], r[1])),
+                                 _mm256_add_epi64(mul(a[2], r[0]), mul(a[3], s[4]))),
+                mul(a[4], s[3]));
+            __m256i d3 = _mm256_add_epi64(
+                _mm256_add_epi64(_mm256_add_epi64(mul(a[0], r[3]), mul(a[1], r[2])),
+                                 _mm256_add_epi64(mul(a[2], r[1]), mul(a[3], r[0]))),
+                mul(a[4], s[4]));
+            __m256i d4 = _mm256_add_epi64(
+                _mm256_add_epi64(_mm256_add_epi64(mul(a[0], r[4]), mul(a[1], r[3])),
+                                 _mm256_add_epi64(mul(a[2], r[2]), mul(a[3], r[1]))),
+                mul(a[4], r[0]));
+
+            d1 = _mm256_add_epi64(d1, _mm256_srli_epi64(d0, 26));
+            d2 = _mm256_add_epi64(d2, _mm256_srli_epi64(d1, 26));
+            d3 = _mm256_add_epi64(d3, _mm256_srli_epi64(d2, 26));
+            d4 = _mm256_add_epi64(d4, _mm256_srli_epi64(d3, 26));
+            const __m256i c = _mm256_srli_epi64(d4, 26);
+            const __m256i l0 =
+                _mm256_add_epi64(_mm256_and_si256(d0, mask), _mm256_add_epi64(c, _mm256_slli_epi64(c, 2)));
+            a[0] = _mm256_and_si256(l0, mask);
+            a[1] = _mm256_add_epi64(_mm256_and_si256(d1, mask), _mm256_srli_epi64(l0, 26));
+            a[2] = _mm256_and_si256(d2, mask);
+            a[3] = _mm256_and_si256(d3, mask);
+            a[4] = _mm256_and_si256(d4, mask);
+        }
+
+        // Absorbs 4 * groups blocks. Lane k accumulates every fourth block with r^4; the last group is
+        // multiplied by r^4, r^3, r^2, r^1 instead so the lanes sum to the serial Horner result.
+        DE_TARGET("avx2")
+        void polyBlocksAvx2(std::uint32_t *h, const std::uint32_t r[4][5], const unsigned char *m, std::size_t groups)
+        {
+            const __m256i mask = _mm256_set1_epi64x(kMask26);
+            const __m256i hibit = _mm256_set1_epi64x(1 << 24);
+            __m256i r4[5], s4[5], rLast[5], sLast[5], a[5];
+            for (int k = 0; k < 5; ++k)
+            {
+                r4[k] = _mm256_set1_epi64x(r[3][k]);
+                s4[k] = _mm256_set1_epi64x(std::uint64_t{r[3][k]} * 5);
+                // Unpacking two 32-byte loads leaves the lanes holding blocks 0, 2, 1, 3.
+                rLast[k] = _mm256_setr_epi64x(r[3][k], r[1][k], r[2][k], r[0][k]);
+                sLast[k] = _mm256_setr_epi64x(std::uint64_t{r[3][k]} * 5, std::uint64_t{r[1][k]} * 5,
+                                              std::uint64_t{r[2][k]} * 5, std::uint64_t{r[0][k]} * 5);
+                a[k] = _mm256_setr_epi64x(h[k], 0, 0, 0);
+            }
+            for (; groups > 0; --groups, m += 64)
+            {
+                const __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(m));
+                const __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(m + 32));
+                const __m256i lo = _mm256_unpacklo_epi64(v0, v1);
+                const __m256i hi = _mm256_unpackhi_epi64(v0, v1);
+                a[0] = _mm256_add_epi64(a[0], _mm256_and_si256(lo, mask));
+                a[1] = _mm256_add_epi64(a[1], _mm256_and_si256(_mm256_srli_epi64(lo, 26), mask));
+                a[2] = _mm256_add_epi64(
+                    a[2], _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi64(lo, 52), _mm256_slli_epi64(hi, 12)), mask));
+                a[3] = _mm256_add_epi64(a[3], _mm256_and_si256(_mm256_srli_epi64(hi, 14), mask));
+                a[4] = _mm256_add_epi64(a[4], _mm256_or_si256(_mm256_srli_epi64(hi, 40), hibit));
+                if (groups > 1)
+                {
+                    polyMultiplyAvx2(a, r4, s4);
+                }
+                else
+                {
+                    polyMultiplyAvx2(a, rLast, sLast);
+                }
+            }
+
+            std::uint64_t sum[5];
+            for (int k = 0; k < 5; ++k)
+            {
+                alignas(32) std::uint64_t lanes[4];
+                _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), a[k]);
+                sum[k] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            }
+            sum[1] += sum[0] >> 26;
+            sum[2] += sum[1] >> 26;
+            sum[3] += sum[2] >> 26;
+            sum[4] += sum[3] >> 26;
+            const std::uint64_t l0 = (sum[0] & kMask26) + (sum[4] >> 26) * 5;
+            h[0] = static_cast<std::uint32_t>(l0 & kMask26);
+            h[1] = static_cast<std::uint32_t>((sum[1] & kMask26) + (l0 >> 26));
+            h[2] = static_cast<std::uint32_t>(sum[2] & kMask26);
+            h[3] = static_cast<std::uint32_t>(sum[3] & kMask26);
+            h[4] = static_cast<std::uint32_t>(sum[4] & kMask26);
+        }
+#endif
+
+        void xorBlocks(ChaCha20Poly1305::Tier tier, const std::uint32_t *state, std::uint32_t counter,
+                       const unsigned char *in, unsigned char *out, std::size_t blocks)
+        {
+            using Tier = ChaCha20Poly1305::Tier;
+#if defined(DE_CHACHA_X86)
+            // Wider tiers hand their remainder down to the narrower ones.
+            if (tier >= Tier::AVX512 && blocks >= 16)
+            {
+                const std::size_t groups = blocks / 16;
+                xorAvx512(state, counter, in, out, groups);
+                counter += static_cast<std::uint32_t>(16 * groups);
+                in += 1024 * groups;
+                out += 1024 * groups;
+                blocks -= 16 * groups;
+            }
+            if (tier >= Tier::AVX2 && blocks >= 8)
+            {
+                const std::size_t groups = blocks / 8;
+                xorAvx2(state, counter, in, out, groups);
+                counter += static_cast<std::uint32_t>(8 * groups);
+                in += 512 * groups;
+                out += 512 * groups;
+                blocks -= 8 * groups;
+            }
+            if (tier >= Tier::SSE2 && blocks >= 4)
+            {
+                const std::size_t groups = blocks / 4;
+                xorSse2(state, counter, in, out, groups);
+                counter += static_cast<std::uint32_t>(4 * groups);
+                in += 256 * groups;
+                out += 256 * groups;
+                blocks -= 4 * groups;
+            }
+#else
+            (void)tier;
+#endif
+            xorScalar(state, counter, in, out, blocks);
+        }
+
+        void polyBlocks(ChaCha20Poly1305::Tier tier, std::uint32_t *h, const std::uint32_t r[4][5],
+                        const unsigned char *m, std::size_t blocks)
+        {
+#if defined(DE_CHACHA_X86)
+            if (tier >= ChaCha20Poly1305::Tier::AVX2 && blocks >= kPolyVectorMinBlocks)
+            {
+                const std::size_t groups = blocks / 4;
+                polyBlocksAvx2(h, r, m, groups);
+                m += 64 * groups;
+                blocks -= 4 * groups;
+            }
+#else
+            (void)tier;
+#endif
+            polyBlocksScalar(h, r[0], m, blocks);
+        }
+    }
+
+    ChaCha20Poly1305::ChaCha20Poly1305(const unsigned char *key)
+        : ChaCha20Poly1305(key, bestTier())
+    {
+    }
+
+    ChaCha20Poly1305::ChaCha20Poly1305(const unsigned char *key, Tier tier)
+        : m_tier(supported(tier) ? tier : bestTier())
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            m_key[i] = load32le(key + 4 * i);
+        }
+    }
+
+    ChaCha20Poly1305::~ChaCha20Poly1305()
+    {
+        wipe(m_key, sizeof(m_key));
+    }
+
+    void ChaCha20Poly1305::seal(const unsigned char *nonce, const unsigned char *in, unsigned char *out,
+                                std::size_t size, unsigned char *tag) const
+    {
+        Stream stream(*this, nonce, true);
+        stream.update(in, out, size);
+        stream.finish(tag);
+    }
+
+    bool ChaCha20Poly1305::open(const unsigned char *nonce, const unsigned char *in, unsigned char *out,
+                                std::size_t size, const unsigned char *tag) const
+    {
+        Stream stream(*this, nonce, false);
+        stream.update(in, out, size);
+        if (stream.verify(tag))
+        {
+            return true;
+        }
+        wipe(out, size);
+        return false;
+    }
+
+    ChaCha20Poly1305::Stream::Stream(const ChaCha20Poly1305 &cipher, const unsigned char *nonce, bool encrypting)
+        : m_cipher(cipher), m_encrypting(encrypting)
+    {
+        std::memcpy(m_state, kSigma, sizeof(kSigma));
+        std::memcpy(m_state + 4, cipher.m_key, sizeof(cipher.m_key));
+        m_state[12] = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            m_state[13 + i] = load32le(nonce + 4 * i);
+        }
+        // Block 0 keys Poly1305; payload starts at block 1.
+        chachaBlock(m_state, 0, m_block);
+        polyKey(m_block, m_r, m_pad);
+        wipe(m_block, sizeof(m_block));
+        std::memset(m_h, 0, sizeof(m_h));
+        m_state[12] = 1;
+    }
+
+    ChaCha20Poly1305::Stream::~Stream()
+    {
+        wipe(m_state, sizeof(m_state));
+        wipe(m_r, sizeof(m_r));
+        wipe(m_h, sizeof(m_h));
+        wipe(m_pad, sizeof(m_pad));
+        wipe(m_block, sizeof(m_block));
+        wipe(m_pending, sizeof(m_pending));
+    }
+
+    void ChaCha20Poly1305::Stream::absorb(const unsigned char *data, std::size_t size)
+    {
+        if (m_pendingSize > 0)
+        {
+            const std::size_t take = size < 16 - m_pendingSize ? size : 16 - m_pendingSize;
+            std::memcpy(m_pending + m_pendingSize, data, take);
+            m_pendingSize += take;
+            data += take;
+            size -= take;
+            if (m_pendingSize < 16)
+            {
+                return;
+            }
+            polyBlocks(m_cipher.m_tier, m_h, m_r, m_pending, 1);
+            m_pendingSize = 0;
+        }
+        const std::size_t blocks = size / 16;
+        polyBlocks(m_cipher.m_tier, m_h, m_r, data, blocks);
+        m_pendingSize = size - 16 * blocks;
+        std::memcpy(m_pending, data + 16 * blocks, m_pendingSize);
+    }
+
+    // XORs the rest of the buffered keystream block into the first size bytes.
+    void ChaCha20Poly1305::Stream::keystream(const unsigned char *in, unsigned char *out, std::size_t size)
+    {
+        if (!m_encrypting)
+        {
+            absorb(in, size);
+        }
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            out[i] = static_cast<unsigned char>(in[i] ^ m_block[m_blockUsed + i]);
+        }
+        m_blockUsed += size;
+        if (m_encrypting)
+        {
+            absorb(out, size);
+        }
+    }
+
+    void ChaCha20Poly1305::Stream::update(const unsigned char *in, unsigned char *out, std::size_t size)
+    {
+        if (size > kMaxMessageSize - m_total)
+        {
+            throw std::length_error("ChaCha20-Poly1305 message exceeds 2^32 - 1 blocks for one nonce");
+        }
+        m_total += size;
+
+        if (m_blockUsed < 64)
+        {
+            const std::size_t take = size < 64 - m_blockUsed ? size : 64 - m_blockUsed;
+            keystream(in, out, take);
+            in += take;
+            out += take;
+            size -= take;
+        }
+
+        // Poly1305 always covers ciphertext: absorb before decrypting and after encrypting, a pass at a time.
+        std::size_t blocks = size / 64;
+        while (blocks > 0)
+        {
+            const std::size_t pass = blocks < kPassBlocks ? blocks : kPassBlocks;
+            if (!m_encrypting)
+            {
+                absorb(in, 64 * pass);
+            }
+            xorBlocks(m_cipher.m_tier, m_state, m_state[12], in, out, pass);
+            m_state[12] += static_cast<std::uint32_t>(pass);
+            if (m_encrypting)
+            {
+                absorb(out, 64 * pass);
+            }
+            in += 64 * pass;
+            out += 64 * pass;
+            size -= 64 * pass;
+            blocks -= pass;
+        }
+
+        if (size > 0)
+        {
+            chachaBlock(m_state, m_state[12]++, m_block);
+            m_blockUsed = 0;
+            keystream(in, out, size);
+        }
+    }
+
+    void ChaCha20Poly1305::Stream::finish(unsigned char *tag)
+    {
+        if (m_pendingSize > 0)
+        {
+            std::memset(m_pending + m_pendingSize, 0, 16 - m_pendingSize);
+            polyBlocks(m_cipher.m_tier, m_h, m_r, m_pending, 1);
+            m_pendingSize = 0;
+        }
+        // No associated data: its length is zero and the ciphertext length follows.
+        unsigned char lengths[16] = {};
+        store64le(lengths + 8, m_total);
+        polyBlocks(m_cipher.m_tier, m_h, m_r, lengths, 1);
+        polyFinish(m_h, m_pad, tag);
+    }
+
+    bool ChaCha20Poly1305::Stream::verify(const unsigned char *tag)
+    {
+        unsigned char expected[kTagSize];
+        finish(expected);
+        unsigned char diff = 0;
+        for (std::size_t i = 0; i < kTagSize; ++i)
+        {
+            diff |= static_cast<unsigned char>(expected[i] ^ tag[i]);
+        }
+        wipe(expected, sizeof(expected));
+        return diff == 0;
+    }
+
+    ChaCha20Poly1305::Tier ChaCha20Poly1305::bestTier() noexcept
+    {
+        for (Tier tier : {Tier::AVX512, Tier::AVX2, Tier::SSE2})
+        {
+            if (supported(tier))
+            {
+                return tier;
+            }
+        }
+        return Tier::Scalar;
+    }
+
+    bool ChaCha20Poly1305::supported(Tier tier) noexcept
+    {
+        switch (tier)
+        {
+        case Tier::Scalar:
+            return true;
+#if defined(DE_CHACHA_X86)
+        case Tier::SSE2:
+            return core::CpuFeatures::current().sse2;
+        case Tier::AVX2:
+            return core::CpuFeatures::current().avx2;
+        case Tier::AVX512:
+            return core::CpuFeatures::current().avx512f;
+#endif
+        default:
+            return false;
+        }
+    }
+
+    const char *ChaCha20Poly1305::tierName(Tier tier) noexcept
+    {
+        switch (tier)
+        {
+        case Tier::SSE2:
+            return "sse2x4";
+        case Tier::AVX2:
+            return "avx2x8";
+        case Tier::AVX512:
+            return "avx512x16";
+        default:
+            return "scalar";
+        }
+    }
+
+} // namespace dynamicencrypt::plugins
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "core/SecureArena.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dynamicencrypt::plugins
+{
+
+    // ChaCha20-Poly1305 AEAD (RFC 8439) with a 96-bit nonce and 128-bit tag, no associated data.
+    //
+    // The ChaCha20 keystream is computed 4, 8 or 16 blocks at a time with SSE2, AVX2 or AVX-512,
+    // one lane per block. From the AVX2 tier up, Poly1305 absorbs four blocks per multiply with
+    // 26-bit limbs in 64-bit lanes. The scalar tier and Poly1305 tail are plain 32-bit code.
+    // Instances created with new live in the SecureArena, since they hold the key.
+    class ChaCha20Poly1305 : public dynamicencrypt::core::SecureAllocated
+    {
+    public:
+        enum class Tier
+        {
+            Scalar,
+            SSE2,
+            AVX2,
+            AVX512
+        };
+
+        static constexpr char kName[] = "ChaCha20-Poly1305";
+        static constexpr std::size_t kKeySize = 32;
+        static constexpr std::size_t kNonceSize = 12;
+        static constexpr std::size_t kTagSize = 16;
+        // The 32-bit block counter starts at 1 for payload data.
+        static constexpr std::uint64_t kMaxMessageSize = ((std::uint64_t{1} << 32) - 1) * 64;
+
+        explicit ChaCha20Poly1305(const unsigned char *key);
+        ChaCha20Poly1305(const unsigned char *key, Tier tier);
+        ~ChaCha20Poly1305();
+
+        ChaCha20Poly1305(const ChaCha20Poly1305 &) = delete;
+        ChaCha20Poly1305 &operator=(const ChaCha20Poly1305 &) = delete;
+
+        Tier tier() const noexcept { return m_tier; }
+
+        // One-shot helpers; out may alias in. open() verifies in constant time and leaves out zeroed
+        // when the tag does not match.
+        void seal(const unsigned char *nonce, const unsigned char *in, unsigned char *out, std::size_t size,
+                  unsigned char *tag) const;
+        bool open(const unsigned char *nonce, const unsigned char *in, unsigned char *out, std::size_t size,
+                  const unsigned char *tag) const;
+
+        // Incremental state for one message. Chunks may have any size; out may alias in.
+        class Stream : public dynamicencrypt::core::SecureAllocated
+        {
+        public:
+            Stream(const ChaCha20Poly1305 &cipher, const unsigned char *nonce, bool encrypting);
+            ~Stream();
+
+            Stream(const Stream &) = delete;
+            Stream &operator=(const Stream &) = delete;
+
+            void update(const unsigned char *in, unsigned char *out, std::size_t size);
+            void finish(unsigned char *tag);
+            bool verify(const unsigned char *tag);
+
+        private:
+            void absorb(const unsigned char *data, std::size_t size);
+            void keystream(const unsigned char *in, unsigned char *out, std::size_t size);
+
+            const ChaCha20Poly1305 &m_cipher;
+            bool m_encrypting;
+            std::uint32_t m_state[16];
+            // Poly1305: r and h in 26-bit limbs, r^2..r^4 for the vector path, s = the final pad.
+            std::uint32_t m_r[4][5];
+            std::uint32_t m_h[5];
+            std::uint32_t m_pad[4];
+            unsigned char m_block[64];
+            unsigned char m_pending[16];
+            std::size_t m_blockUsed{64};
+            std::size_t m_pendingSize{0};
+            std::uint64_t m_total{0};
+        };
+
+        static Tier bestTier() noexcept;
+        static bool supported(Tier tier) noexcept;
+        static const char *tierName(Tier tier) noexcept;
+
+    private:
+        Tier m_tier;
+        std::uint32_t m_key[8];
+    };
+
+} // namespace dynamicencrypt::plugins
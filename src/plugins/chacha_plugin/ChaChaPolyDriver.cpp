@@ -0,0 +1,16 @@
+#include "ChaChaPolyDriver.h"
+
+namespace dynamicencrypt::plugins
+{
+
+    QString ChaChaPolyDriver::name() const
+    {
+        return QLatin1String(ChaCha20Poly1305::kName);
+    }
+
+    QString ChaChaPolyDriver::version() const
+    {
+        return QStringLiteral("1.0 (%1)").arg(QLatin1String(ChaCha20Poly1305::tierName(ChaCha20Poly1305::bestTier())));
+    }
+
+} // namespace dynamicencrypt::plugins
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "ChaCha20Poly1305.h"
+
+#include "plugins/AeadDriver.h"
+
+#include <QObject>
+
+namespace dynamicencrypt::plugins
+{
+
+    // ChaCha20-Poly1305 driver. Ciphertext layout: 12-byte random nonce | ciphertext | 16-byte tag.
+    // Decryption throws std::runtime_error when the tag does not verify.
+    class ChaChaPolyDriver : public QObject, public AeadDriver<ChaCha20Poly1305>
+    {
+        Q_OBJECT
+        Q_PLUGIN_METADATA(IID CryptoDriver_iid FILE "plugin.json")
+        Q_INTERFACES(dynamicencrypt::core::CryptoDriver)
+
+    public:
+        ChaChaPolyDriver() = default;
+        ~ChaChaPolyDriver() override = default;
+
+        QString name() const override;
+        QString version() const override;
+    };
+
+} // namespace dynamicencrypt::plugins
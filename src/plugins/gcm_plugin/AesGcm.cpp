@@ -0,0 +1,873 @@
+#include "AesGcm.h"
+
+#include "core/CpuFeatures.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DE_GCM_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define DE_TARGET(features)
+#else
+#define DE_TARGET(features) __attribute__((target(features)))
+#endif
+#endif
+
+namespace dynamicencrypt::plugins
+{
+
+    namespace
+    {
+        constexpr int kRounds = 14;
+        // Blocks processed per bitsliced pass: 4 blocks fill the 64 lanes of a bit plane.
+        constexpr std::size_t kPortableBatch = 4;
+        // GHASH and CTR run in alternating passes of this many blocks so the data stays in L1.
+        constexpr std::size_t kPassBlocks = 256;
+
+        void wipe(void *ptr, std::size_t size) noexcept
+        {
+            volatile unsigned char *bytes = static_cast<unsigned char *>(ptr);
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                bytes[i] = 0;
+            }
+        }
+
+        std::uint32_t load32be(const unsigned char *p) noexcept
+        {
+            return (std::uint32_t{p[0]} << 24) | (std::uint32_t{p[1]} << 16) | (std::uint32_t{p[2]} << 8) | p[3];
+        }
+
+        void store32be(unsigned char *p, std::uint32_t v) noexcept
+        {
+            p[0] = static_cast<unsigned char>(v >> 24);
+            p[1] = static_cast<unsigned char>(v >> 16);
+            p[2] = static_cast<unsigned char>(v >> 8);
+            p[3] = static_cast<unsigned char>(v);
+        }
+
+        std::uint64_t load64be(const unsigned char *p) noexcept
+        {
+            return (std::uint64_t{load32be(p)} << 32) | load32be(p + 4);
+        }
+
+        void store64be(unsigned char *p, std::uint64_t v) noexcept
+        {
+            store32be(p, static_cast<std::uint32_t>(v >> 32));
+            store32be(p + 4, static_cast<std::uint32_t>(v));
+        }
+
+        std::uint64_t load64le(const unsigned char *p) noexcept
+        {
+            std::uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            v = __builtin_bswap64(v);
+#endif
+            return v;
+        }
+
+        void store64le(unsigned char *p, std::uint64_t v) noexcept
+        {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            v = __builtin_bswap64(v);
+#endif
+            std::memcpy(p, &v, sizeof(v));
+        }
+
+        void increment32(unsigned char *counter, std::uint32_t by) noexcept
+        {
+            store32be(counter + 12, load32be(counter + 12) + by);
+        }
+
+        // ---- Portable constant-time AES ------------------------------------------------------
+
+        // Transposes the 8x8 bit matrix held in x (row i = byte i).
+        std::uint64_t transpose8(std::uint64_t x) noexcept
+        {
+            std::uint64_t t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAull;
+            x ^= t ^ (t << 7);
+            t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull;
+            x ^= t ^ (t << 14);
+            t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull;
+            x ^= t ^ (t << 28);
+            return x;
+        }
+
+        // Transposes the 8x8 byte matrix held in rows (row k = rows[k], column b = byte b).
+        void transposeBytes(std::uint64_t *rows) noexcept
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                const std::uint64_t a = rows[k];
+                const std::uint64_t b = rows[k + 4];
+                rows[k] = (a & 0x00000000FFFFFFFFull) | (b << 32);
+                rows[k + 4] = (a >> 32) | (b & 0xFFFFFFFF00000000ull);
+            }
+            for (int k : {0, 1, 4, 5})
+            {
+                const std::uint64_t a = rows[k];
+                const std::uint64_t b = rows[k + 2];
+                rows[k] = (a & 0x0000FFFF0000FFFFull) | ((b & 0x0000FFFF0000FFFFull) << 16);
+                rows[k + 2] = ((a >> 16) & 0x0000FFFF0000FFFFull) | (b & 0xFFFF0000FFFF0000ull);
+            }
+            for (int k = 0; k < 8; k += 2)
+            {
+                const std::uint64_t a = rows[k];
+                const std::uint64_t b = rows[k + 1];
+                rows[k] = (a & 0x00FF00FF00FF00FFull) | ((b & 0x00FF00FF00FF00FFull) << 8);
+                rows[k + 1] = ((a >> 8) & 0x00FF00FF00FF00FFull) | (b & 0xFF00FF00FF00FF00ull);
+            }
+        }
+
+        // planes[b] bit j = bit b of state[j].
+        void toPlanes(const unsigned char *state, std::uint64_t *planes) noexcept
+        {
+            for (int k = 0; k < 8; ++k)
+            {
+                planes[k] = transpose8(load64le(state + 8 * k));
+            }
+            transposeBytes(planes);
+        }
+
+        void fromPlanes(const std::uint64_t *planes, unsigned char *state) noexcept
+        {
+            std::uint64_t rows[8];
+            std::memcpy(rows, planes, sizeof(rows));
+            transposeBytes(rows);
+            for (int k = 0; k < 8; ++k)
+            {
+                store64le(state + 8 * k, transpose8(rows[k]));
+            }
+        }
+
+        // AES S-box on 64 bytes at once using the Boyar-Peralta circuit (113 gates), so the cost is
+        // independent of the data. q[b] holds bit b of every byte.
+        void sboxPlanes(std::uint64_t *q) noexcept
+        {
+            using W = std::uint64_t;
+            const W x0 = q[7], x1 = q[6], x2 = q[5], x3 = q[4], x4 = q[3], x5 = q[2], x6 = q[1], x7 = q[0];
+
+            // Top linear transformation.
+            const W y14 = x3 ^ x5, y13 = x0 ^ x6, y9 = x0 ^ x3, y8 = x0 ^ x5, t0 = x1 ^ x2;
+            const W y1 = t0 ^ x7, y4 = y1 ^ x3, y12 = y13 ^ y14, y2 = y1 ^ x0, y5 = y1 ^ x6;
+            const W y3 = y5 ^ y8, t1 = x4 ^ y12, y15 = t1 ^ x5, y20 = t1 ^ x1, y6 = y15 ^ x7;
+            const W y10 = y15 ^ t0, y11 = y20 ^ y9, y7 = x7 ^ y11, y17 = y10 ^ y11, y19 = y10 ^ y8;
+            const W y16 = t0 ^ y11, y21 = y13 ^ y16, y18 = x0 ^ y16;
+
+            // Shared non-linear core (inversion in GF(2^4)^2).
+            const W t2 = y12 & y15, t3 = y3 & y6, t4 = t3 ^ t2, t5 = y4 & x7, t6 = t5 ^ t2;
+            const W t7 = y13 & y16, t8 = y5 & y1, t9 = t8 ^ t7, t10 = y2 & y7, t11 = t10 ^ t7;
+            const W t12 = y9 & y11, t13 = y14 & y17, t14 = t13 ^ t12, t15 = y8 & y10, t16 = t15 ^ t12;
+            const W t17 = t4 ^ t14, t18 = t6 ^ t16, t19 = t9 ^ t14, t20 = t11 ^ t16;
+            const W t21 = t17 ^ y20, t22 = t18 ^ y19, t23 = t19 ^ y21, t24 = t20 ^ y18;
+            const W t25 = t21 ^ t22, t26 = t21 & t23, t27 = t24 ^ t26, t28 = t25 & t27, t29 = t28 ^ t22;
+            const W t30 = t23 ^ t24, t31 = t22 ^ t26, t32 = t31 & t30, t33 = t32 ^ t24, t34 = t23 ^ t33;
+            const W t35 = t27 ^ t33, t36 = t24 & t35, t37 = t36 ^ t34, t38 = t27 ^ t36, t39 = t29 & t38;
+            const W t40 = t25 ^ t39, t41 = t40 ^ t37, t42 = t29 ^ t33, t43 = t29 ^ t40, t44 = t33 ^ t37;
+            const W t45 = t42 ^ t41;
+            const W z0 = t44 & y15, z1 = t37 & y6, z2 = t33 & x7, z3 = t43 & y16, z4 = t40 & y1;
+            const W z5 = t29 & y7, z6 = t42 & y11, z7 = t45 & y17, z8 = t41 & y10, z9 = t44 & y12;
+            const W z10 = t37 & y3, z11 = t33 & y4, z12 = t43 & y13, z13 = t40 & y5, z14 = t29 & y2;
+            const W z15 = t42 & y9, z16 = t45 & y14, z17 = t41 & y8;
+
+            // Bottom linear transformation, including the affine constant 0x63.
+            const W t46 = z15 ^ z16, t47 = z10 ^ z11, t48 = z5 ^ z13, t49 = z9 ^ z10, t50 = z2 ^ z12;
+            const W t51 = z2 ^ z5, t52 = z7 ^ z8, t53 = z0 ^ z3, t54 = z6 ^ z7, t55 = z16 ^ z17;
+            const W t56 = z12 ^ t48, t57 = t50 ^ t53, t58 = z4 ^ t46, t59 = z3 ^ t54, t60 = t46 ^ t57;
+            const W t61 = z14 ^ t57, t62 = t52 ^ t58, t63 = t49 ^ t58, t64 = z4 ^ t59, t65 = t61 ^ t62;
+            const W t66 = z1 ^ t63, t67 = t64 ^ t65;
+            const W s3 = t53 ^ t66;
+            q[7] = t59 ^ t63;
+            q[6] = t64 ^ ~s3;
+            q[5] = t55 ^ ~t67;
+            q[4] = s3;
+            q[3] = t51 ^ t66;
+            q[2] = t47 ^ t65;
+            q[1] = t56 ^ ~t62;
+            q[0] = t48 ^ ~t60;
+        }
+
+        void subBytes64(unsigned char *state) noexcept
+        {
+            std::uint64_t planes[8];
+            toPlanes(state, planes);
+            sboxPlanes(planes);
+            fromPlanes(planes, state);
+        }
+
+        unsigned char xtime(unsigned char b) noexcept
+        {
+            return static_cast<unsigned char>((b << 1) ^ (0x1B & (0u - (b >> 7))));
+        }
+
+        void shiftRows(unsigned char *block) noexcept
+        {
+            unsigned char tmp[16];
+            std::memcpy(tmp, block, sizeof(tmp));
+            for (int r = 1; r < 4; ++r)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    block[r + 4 * c] = tmp[r + 4 * ((c + r) & 3)];
+                }
+            }
+        }
+
+        void mixColumns(unsigned char *block) noexcept
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                unsigned char *col = block + 4 * c;
+                const unsigned char a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+                const unsigned char t = a0 ^ a1 ^ a2 ^ a3;
+                col[0] = static_cast<unsigned char>(a0 ^ t ^ xtime(a0 ^ a1));
+                col[1] = static_cast<unsigned char>(a1 ^ t ^ xtime(a1 ^ a2));
+                col[2] = static_cast<unsigned char>(a2 ^ t ^ xtime(a2 ^ a3));
+                col[3] = static_cast<unsigned char>(a3 ^ t ^ xtime(a3 ^ a0));
+            }
+        }
+
+        void addRoundKey(unsigned char *state, const unsigned char *roundKey) noexcept
+        {
+            for (std::size_t blk = 0; blk < kPortableBatch; ++blk)
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    state[16 * blk + i] ^= roundKey[i];
+                }
+            }
+        }
+
+        // Encrypts the four blocks in state in place.
+        void encryptPortable(const unsigned char *roundKeys, unsigned char *state) noexcept
+        {
+            addRoundKey(state, roundKeys);
+            for (int round = 1; round <= kRounds; ++round)
+            {
+                subBytes64(state);
+                for (std::size_t blk = 0; blk < kPortableBatch; ++blk)
+                {
+                    shiftRows(state + 16 * blk);
+                    if (round != kRounds)
+                    {
+                        mixColumns(state + 16 * blk);
+                    }
+                }
+                addRoundKey(state, roundKeys + 16 * round);
+            }
+        }
+
+        void expandKey(const unsigned char *key, unsigned char *roundKeys) noexcept
+        {
+            std::memcpy(roundKeys, key, AesGcm::kKeySize);
+            unsigned char rcon = 1;
+            unsigned char word[64] = {};
+            for (int i = 8; i < 4 * (kRounds + 1); ++i)
+            {
+                std::memcpy(word, roundKeys + 4 * (i - 1), 4);
+                if (i % 8 == 0)
+                {
+                    const unsigned char first = word[0];
+                    word[0] = word[1];
+                    word[1] = word[2];
+                    word[2] = word[3];
+                    word[3] = first;
+                    subBytes64(word);
+                    word[0] ^= rcon;
+                    rcon = xtime(rcon);
+                }
+                else if (i % 8 == 4)
+                {
+                    subBytes64(word);
+                }
+                for (int b = 0; b < 4; ++b)
+                {
+                    roundKeys[4 * i + b] = static_cast<unsigned char>(roundKeys[4 * (i - 8) + b] ^ word[b]);
+                }
+            }
+            wipe(word, sizeof(word));
+        }
+
+        void ctrPortable(const unsigned char *roundKeys, unsigned char *counter, const unsigned char *in,
+                         unsigned char *out, std::size_t blocks) noexcept
+        {
+            unsigned char state[16 * kPortableBatch];
+            while (blocks > 0)
+            {
+                const std::size_t batch = blocks < kPortableBatch ? blocks : kPortableBatch;
+                for (std::size_t blk = 0; blk < kPortableBatch; ++blk)
+                {
+                    std::memcpy(state + 16 * blk, counter, 16);
+                    increment32(state + 16 * blk, static_cast<std::uint32_t>(blk));
+                }
+                encryptPortable(roundKeys, state);
+                for (std::size_t i = 0; i < 16 * batch; ++i)
+                {
+                    out[i] = static_cast<unsigned char>(in[i] ^ state[i]);
+                }
+                increment32(counter, static_cast<std::uint32_t>(batch));
+                in += 16 * batch;
+                out += 16 * batch;
+                blocks -= batch;
+            }
+            wipe(state, sizeof(state));
+        }
+
+        // ---- Portable constant-time GHASH ----------------------------------------------------
+
+        // Low 64 bits of the carry-less product; the masks keep carries out of the data bits.
+        std::uint64_t bmul64(std::uint64_t x, std::uint64_t y) noexcept
+        {
+            const std::uint64_t x0 = x & 0x1111111111111111ull;
+            const std::uint64_t x1 = x & 0x2222222222222222ull;
+            const std::uint64_t x2 = x & 0x4444444444444444ull;
+            const std::uint64_t x3 = x & 0x8888888888888888ull;
+            const std::uint64_t y0 = y & 0x1111111111111111ull;
+            const std::uint64_t y1 = y & 0x2222222222222222ull;
+            const std::uint64_t y2 = y & 0x4444444444444444ull;
+            const std::uint64_t y3 = y & 0x8888888888888888ull;
+            std::uint64_t z0 = (x0 * y0) ^ (x1 * y3) ^ (x2 * y2) ^ (x3 * y1);
+            std::uint64_t z1 = (x0 * y1) ^ (x1 * y0) ^ (x2 * y3) ^ (x3 * y2);
+            std::uint64_t z2 = (x0 * y2) ^ (x1 * y1) ^ (x2 * y0) ^ (x3 * y3);
+            std::uint64_t z3 = (x0 * y3) ^ (x1 * y2) ^ (x2 * y1) ^ (x3 * y0);
+            z0 &= 0x1111111111111111ull;
+            z1 &= 0x2222222222222222ull;
+            z2 &= 0x4444444444444444ull;
+            z3 &= 0x8888888888888888ull;
+            return z0 | z1 | z2 | z3;
+        }
+
+        std::uint64_t rev64(std::uint64_t x) noexcept
+        {
+            x = ((x & 0x5555555555555555ull) << 1) | ((x >> 1) & 0x5555555555555555ull);
+            x = ((x & 0x3333333333333333ull) << 2) | ((x >> 2) & 0x3333333333333333ull);
+            x = ((x & 0x0F0F0F0F0F0F0F0Full) << 4) | ((x >> 4) & 0x0F0F0F0F0F0F0F0Full);
+            x = ((x & 0x00FF00FF00FF00FFull) << 8) | ((x >> 8) & 0x00FF00FF00FF00FFull);
+            x = ((x & 0x0000FFFF0000FFFFull) << 16) | ((x >> 16) & 0x0000FFFF0000FFFFull);
+            return (x << 32) | (x >> 32);
+        }
+
+        void ghashPortable(const unsigned char *hashKey, unsigned char *hash, const unsigned char *data,
+                           std::size_t blocks) noexcept
+        {
+            const std::uint64_t h1 = load64be(hashKey);
+            const std::uint64_t h0 = load64be(hashKey + 8);
+            const std::uint64_t h0r = rev64(h0);
+            const std::uint64_t h1r = rev64(h1);
+            const std::uint64_t h2 = h0 ^ h1;
+            const std::uint64_t h2r = h0r ^ h1r;
+            std::uint64_t y1 = load64be(hash);
+            std::uint64_t y0 = load64be(hash + 8);
+            for (std::size_t i = 0; i < blocks; ++i, data += 16)
+            {
+                y1 ^= load64be(data);
+                y0 ^= load64be(data + 8);
+                const std::uint64_t y0r = rev64(y0);
+                const std::uint64_t y1r = rev64(y1);
+                const std::uint64_t y2 = y0 ^ y1;
+                const std::uint64_t y2r = y0r ^ y1r;
+                const std::uint64_t z0 = bmul64(y0, h0);
+                const std::uint64_t z1 = bmul64(y1, h1);
+                std::uint64_t z2 = bmul64(y2, h2);
+                std::uint64_t z0h = bmul64(y0r, h0r);
+                std::uint64_t z1h = bmul64(y1r, h1r);
+                std::uint64_t z2h = bmul64(y2r, h2r);
+                z2 ^= z0 ^ z1;
+                z2h ^= z0h ^ z1h;
+                z0h = rev64(z0h) >> 1;
+                z1h = rev64(z1h) >> 1;
+                z2h = rev64(z2h) >> 1;
+
+                std::uint64_t v0 = z0;
+                std::uint64_t v1 = z0h ^ z2;
+                std::uint64_t v2 = z1 ^ z2h;
+                std::uint64_t v3 = z1h;
+                v3 = (v3 << 1) | (v2 >> 63);
+                v2 = (v2 << 1) | (v1 >> 63);
+                v1 = (v1 << 1) | (v0 >> 63);
+                v0 = v0 << 1;
+                v2 ^= v0 ^ (v0 >> 1) ^ (v0 >> 2) ^ (v0 >> 7);
+                v1 ^= (v0 << 63) ^ (v0 << 62) ^ (v0 << 57);
+                v3 ^= v1 ^ (v1 >> 1) ^ (v1 >> 2) ^ (v1 >> 7);
+                v2 ^= (v1 << 63) ^ (v1 << 62) ^ (v1 << 57);
+                y0 = v2;
+                y1 = v3;
+            }
+            store64be(hash, y1);
+            store64be(hash + 8, y0);
+        }
+
+        // ---- AES-NI / PCLMULQDQ --------------------------------------------------------------
+
+#if defined(DE_GCM_X86)
+        DE_TARGET("ssse3")
+        __m128i byteReverse(__m128i x)
+        {
+            return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+        }
+
+        DE_TARGET("pclmul,sse2")
+        void clmulAccumulate(__m128i a, __m128i b, __m128i &lo, __m128i &hi)
+        {
+            const __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+            lo = _mm_xor_si128(lo, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x00), _mm_slli_si128(mid, 8)));
+            hi = _mm_xor_si128(hi, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x11), _mm_srli_si128(mid, 8)));
+        }
+
+        // Shifts the 256-bit product left by one (GCM's reflected bit order) and reduces it
+        // modulo x^128 + x^7 + x^2 + x + 1.
+        DE_TARGET("sse2")
+        __m128i reduceProduct(__m128i lo, __m128i hi)
+        {
+            __m128i carryLo = _mm_srli_epi32(lo, 31);
+            __m128i carryHi = _mm_srli_epi32(hi, 31);
+            lo = _mm_slli_epi32(lo, 1);
+            hi = _mm_slli_epi32(hi, 1);
+            const __m128i crossing = _mm_srli_si128(carryLo, 12);
+            carryHi = _mm_slli_si128(carryHi, 4);
+            carryLo = _mm_slli_si128(carryLo, 4);
+            lo = _mm_or_si128(lo, carryLo);
+            hi = _mm_or_si128(_mm_or_si128(hi, carryHi), crossing);
+
+            __m128i a = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+            const __m128i spill = _mm_srli_si128(a, 4);
+            a = _mm_slli_si128(a, 12);
+            lo = _mm_xor_si128(lo, a);
+            __m128i b = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+            b = _mm_xor_si128(b, spill);
+            lo = _mm_xor_si128(lo, b);
+            return _mm_xor_si128(hi, lo);
+        }
+
+        DE_TARGET("pclmul,sse2")
+        __m128i gfMul128(__m128i a, __m128i b)
+        {
+            __m128i lo = _mm_setzero_si128();
+            __m128i hi = _mm_setzero_si128();
+            clmulAccumulate(a, b, lo, hi);
+            return reduceProduct(lo, hi);
+        }
+
+        DE_TARGET("pclmul,ssse3")
+        void hashKeysClmul(const unsigned char *h, unsigned char *keys)
+        {
+            const __m128i h1 = byteReverse(_mm_loadu_si128(reinterpret_cast<const __m128i *>(h)));
+            const __m128i h2 = gfMul128(h1, h1);
+            const __m128i h3 = gfMul128(h2, h1);
+            const __m128i h4 = gfMul128(h3, h1);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(keys), h1);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(keys + 16), h2);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(keys + 32), h3);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(keys + 48), h4);
+        }
+
+        // Four blocks per reduction: Y = (Y + X0)H^4 + X1 H^3 + X2 H^2 + X3 H.
+        DE_TARGET("pclmul,ssse3")
+        void ghashClmul(const unsigned char *keys, unsigned char *hash, const unsigned char *data, std::size_t blocks)
+        {
+            const auto *k = reinterpret_cast<const __m128i *>(keys);
+            const __m128i h1 = _mm_loadu_si128(k);
+            const __m128i h2 = _mm_loadu_si128(k + 1);
+            const __m128i h3 = _mm_loadu_si128(k + 2);
+            const __m128i h4 = _mm_loadu_si128(k + 3);
+            const auto *in = reinterpret_cast<const __m128i *>(data);
+            __m128i y = byteReverse(_mm_loadu_si128(reinterpret_cast<const __m128i *>(hash)));
+            for (; blocks >= 4; blocks -= 4, in += 4)
+            {
+                __m128i lo = _mm_setzero_si128();
+                __m128i hi = _mm_setzero_si128();
+                clmulAccumulate(_mm_xor_si128(y, byteReverse(_mm_loadu_si128(in))), h4, lo, hi);
+                clmulAccumulate(byteReverse(_mm_loadu_si128(in + 1)), h3, lo, hi);
+                clmulAccumulate(byteReverse(_mm_loadu_si128(in + 2)), h2, lo, hi);
+                clmulAccumulate(byteReverse(_mm_loadu_si128(in + 3)), h1, lo, hi);
+                y = reduceProduct(lo, hi);
+            }
+            for (; blocks > 0; --blocks, ++in)
+            {
+                y = gfMul128(_mm_xor_si128(y, byteReverse(_mm_loadu_si128(in))), h1);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(hash), byteReverse(y));
+        }
+
+        DE_TARGET("aes,sse2")
+        __m128i encryptAesni(const __m128i *keys, __m128i block)
+        {
+            block = _mm_xor_si128(block, keys[0]);
+            for (int round = 1; round < kRounds; ++round)
+            {
+                block = _mm_aesenc_si128(block, keys[round]);
+            }
+            return _mm_aesenclast_si128(block, keys[kRounds]);
+        }
+
+        DE_TARGET("sse2")
+        __m128i spreadWords(__m128i x)
+        {
+            x = _mm_xor_si128(x, _mm_slli_si128(x, 4));
+            x = _mm_xor_si128(x, _mm_slli_si128(x, 4));
+            return _mm_xor_si128(x, _mm_slli_si128(x, 4));
+        }
+
+        // One AES-256 schedule step: the even round key from the previous even one (RotWord,
+        // SubWord, Rcon), then the odd round key from the new even one (SubWord only).
+        template <int Rcon>
+        DE_TARGET("aes,sse2")
+        void expandStepAesni(__m128i &even, __m128i &odd, __m128i *keys, int index)
+        {
+            even = _mm_xor_si128(spreadWords(even), _mm_shuffle_epi32(_mm_aeskeygenassist_si128(odd, Rcon), 0xFF));
+            keys[index] = even;
+            if (index + 1 <= kRounds)
+            {
+                odd = _mm_xor_si128(spreadWords(odd), _mm_shuffle_epi32(_mm_aeskeygenassist_si128(even, 0), 0xAA));
+                keys[index + 1] = odd;
+            }
+        }
+
+        DE_TARGET("aes,sse2")
+        void expandKeyAesni(const unsigned char *key, unsigned char *roundKeys)
+        {
+            __m128i keys[kRounds + 1];
+            __m128i even = _mm_loadu_si128(reinterpret_cast<const __m128i *>(key));
+            __m128i odd = _mm_loadu_si128(reinterpret_cast<const __m128i *>(key + 16));
+            keys[0] = even;
+            keys[1] = odd;
+            expandStepAesni<0x01>(even, odd, keys, 2);
+            expandStepAesni<0x02>(even, odd, keys, 4);
+            expandStepAesni<0x04>(even, odd, keys, 6);
+            expandStepAesni<0x08>(even, odd, keys, 8);
+            expandStepAesni<0x10>(even, odd, keys, 10);
+            expandStepAesni<0x20>(even, odd, keys, 12);
+            expandStepAesni<0x40>(even, odd, keys, 14);
+            for (int i = 0; i <= kRounds; ++i)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(roundKeys + 16 * i), keys[i]);
+            }
+            wipe(keys, sizeof(keys));
+            wipe(&even, sizeof(even));
+            wipe(&odd, sizeof(odd));
+        }
+
+        DE_TARGET("sse4.1")
+        __m128i counterBlock(__m128i base, std::uint32_t counter)
+        {
+            const std::uint32_t bigEndian = ((counter & 0xFF) << 24) | ((counter & 0xFF00) << 8) |
+                                            ((counter >> 8) & 0xFF00) | (counter >> 24);
+            return _mm_insert_epi32(base, static_cast<int>(bigEndian), 3);
+        }
+
+        // Eight independent blocks per iteration keep the AES unit's pipeline full.
+        DE_TARGET("aes,sse4.1")
+        void ctrAesni(const unsigned char *roundKeys, unsigned char *counter, const unsigned char *in,
+                      unsigned char *out, std::size_t blocks)
+        {
+            __m128i keys[kRounds + 1];
+            for (int i = 0; i <= kRounds; ++i)
+            {
+                keys[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(roundKeys + 16 * i));
+            }
+            const __m128i base = _mm_loadu_si128(reinterpret_cast<const __m128i *>(counter));
+            std::uint32_t ctr = load32be(counter + 12);
+            const auto *src = reinterpret_cast<const __m128i *>(in);
+            auto *dst = reinterpret_cast<__m128i *>(out);
+            for (; blocks >= 8; blocks -= 8, src += 8, dst += 8, ctr += 8)
+            {
+                // Named registers rather than an array so the compiler keeps all eight in xmm.
+                __m128i b0 = _mm_xor_si128(counterBlock(base, ctr), keys[0]);
+                __m128i b1 = _mm_xor_si128(counterBlock(base, ctr + 1), keys[0]);
+                __m128i b2 = _mm_xor_si128(counterBlock(base, ctr + 2), keys[0]);
+                __m128i b3 = _mm_xor_si128(counterBlock(base, ctr + 3), keys[0]);
+                __m128i b4 = _mm_xor_si128(counterBlock(base, ctr + 4), keys[0]);
+                __m128i b5 = _mm_xor_si128(counterBlock(base, ctr + 5), keys[0]);
+                __m128i b6 = _mm_xor_si128(counterBlock(base, ctr + 6), keys[0]);
+                __m128i b7 = _mm_xor_si128(counterBlock(base, ctr + 7), keys[0]);
+                for (int round = 1; round < kRounds; ++round)
+                {
+                    const __m128i k = keys[round];
+                    b0 = _mm_aesenc_si128(b0, k);
+                    b1 = _mm_aesenc_si128(b1, k);
+                    b2 = _mm_aesenc_si128(b2, k);
+                    b3 = _mm_aesenc_si128(b3, k);
+                    b4 = _mm_aesenc_si128(b4, k);
+                    b5 = _mm_aesenc_si128(b5, k);
+                    b6 = _mm_aesenc_si128(b6, k);
+                    b7 = _mm_aesenc_si128(b7, k);
+                }
+                const __m128i last = keys[kRounds];
+                _mm_storeu_si128(dst, _mm_xor_si128(_mm_aesenclast_si128(b0, last), _mm_loadu_si128(src)));
+                _mm_storeu_si128(dst + 1, _mm_xor_si128(_mm_aesenclast_si128(b1, last), _mm_loadu_si128(src + 1)));
+                _mm_storeu_si128(dst + 2, _mm_xor_si128(_mm_aesenclast_si128(b2, last), _mm_loadu_si128(src + 2)));
+                _mm_storeu_si128(dst + 3, _mm_xor_si128(_mm_aesenclast_si128(b3, last), _mm_loadu_si128(src + 3)));
+                _mm_storeu_si128(dst + 4, _mm_xor_si128(_mm_aesenclast_si128(b4, last), _mm_loadu_si128(src + 4)));
+                _mm_storeu_si128(dst + 5, _mm_xor_si128(_mm_aesenclast_si128(b5, last), _mm_loadu_si128(src + 5)));
+                _mm_storeu_si128(dst + 6, _mm_xor_si128(_mm_aesenclast_si128(b6, last), _mm_loadu_si128(src + 6)));
+                _mm_storeu_si128(dst + 7, _mm_xor_si128(_mm_aesenclast_si128(b7, last), _mm_loadu_si128(src + 7)));
+            }
+            for (; blocks > 0; --blocks, ++src, ++dst, ++ctr)
+            {
+                const __m128i ks = encryptAesni(keys, counterBlock(base, ctr));
+                _mm_storeu_si128(dst, _mm_xor_si128(ks, _mm_loadu_si128(src)));
+            }
+            store32be(counter + 12, ctr);
+            wipe(keys, sizeof(keys));
+        }
+
+        DE_TARGET("aes,sse2")
+        void blockAesni(const unsigned char *roundKeys, const unsigned char *in, unsigned char *out)
+        {
+            __m128i keys[kRounds + 1];
+            for (int i = 0; i <= kRounds; ++i)
+            {
+                keys[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(roundKeys + 16 * i));
+            }
+            const __m128i block = encryptAesni(keys, _mm_loadu_si128(reinterpret_cast<const __m128i *>(in)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), block);
+            wipe(keys, sizeof(keys));
+        }
+#endif
+    }
+
+    AesGcm::AesGcm(const unsigned char *key)
+        : AesGcm(key, bestTier())
+    {
+    }
+
+    AesGcm::AesGcm(const unsigned char *key, Tier tier)
+        : m_tier(supported(tier) ? tier : bestTier())
+    {
+#if defined(DE_GCM_X86)
+        if (m_tier == Tier::AESNI)
+        {
+            expandKeyAesni(key, m_roundKeys);
+        }
+        else
+#endif
+        {
+            expandKey(key, m_roundKeys);
+        }
+        unsigned char h[16] = {};
+        encryptBlock(h, h);
+        std::memset(m_hashKeys, 0, sizeof(m_hashKeys));
+#if defined(DE_GCM_X86)
+        if (m_tier == Tier::AESNI)
+        {
+            hashKeysClmul(h, m_hashKeys);
+        }
+        else
+#endif
+        {
+            std::memcpy(m_hashKeys, h, sizeof(h));
+        }
+        wipe(h, sizeof(h));
+    }
+
+    AesGcm::~AesGcm()
+    {
+        wipe(m_roundKeys, sizeof(m_roundKeys));
+        wipe(m_hashKeys, sizeof(m_hashKeys));
+    }
+
+    void AesGcm::seal(const unsigned char *nonce, const unsigned char *in, unsigned char *out, std::size_t size,
+                      unsigned char *tag) const
+    {
+        Stream stream(*this, nonce, true);
+        stream.update(in, out, size);
+        stream.finish(tag);
+    }
+
+    bool AesGcm::open(const unsigned char *nonce, const unsigned char *in, unsigned char *out, std::size_t size,
+                      const unsigned char *tag) const
+    {
+        Stream stream(*this, nonce, false);
+        stream.update(in, out, size);
+        if (stream.verify(tag))
+        {
+            return true;
+        }
+        wipe(out, size);
+        return false;
+    }
+
+    void AesGcm::ctr(unsigned char *counter, const unsigned char *in, unsigned char *out, std::size_t blocks) const
+    {
+#if defined(DE_GCM_X86)
+        if (m_tier == Tier::AESNI)
+        {
+            ctrAesni(m_roundKeys, counter, in, out, blocks);
+            return;
+        }
+#endif
+        ctrPortable(m_roundKeys, counter, in, out, blocks);
+    }
+
+    void AesGcm::ghash(unsigned char *hash, const unsigned char *data, std::size_t blocks) const
+    {
+#if defined(DE_GCM_X86)
+        if (m_tier == Tier::AESNI)
+        {
+            ghashClmul(m_hashKeys, hash, data, blocks);
+            return;
+        }
+#endif
+        ghashPortable(m_hashKeys, hash, data, blocks);
+    }
+
+    void AesGcm::encryptBlock(const unsigned char *in, unsigned char *out) const
+    {
+#if defined(DE_GCM_X86)
+        if (m_tier == Tier::AESNI)
+        {
+            blockAesni(m_roundKeys, in, out);
+            return;
+        }
+#endif
+        unsigned char state[16 * kPortableBatch] = {};
+        std::memcpy(state, in, 16);
+        encryptPortable(m_roundKeys, state);
+        std::memcpy(out, state, 16);
+        wipe(state, sizeof(state));
+    }
+
+    AesGcm::Stream::Stream(const AesGcm &gcm, const unsigned char *nonce, bool encrypting)
+        : m_gcm(gcm), m_encrypting(encrypting)
+    {
+        std::memcpy(m_counter, nonce, kNonceSize);
+        store32be(m_counter + 12, 1);
+        m_gcm.encryptBlock(m_counter, m_tagMask);
+        increment32(m_counter, 1);
+        std::memset(m_hash, 0, sizeof(m_hash));
+    }
+
+    AesGcm::Stream::~Stream()
+    {
+        wipe(m_counter, sizeof(m_counter));
+        wipe(m_tagMask, sizeof(m_tagMask));
+        wipe(m_hash, sizeof(m_hash));
+        wipe(m_keystream, sizeof(m_keystream));
+        wipe(m_pending, sizeof(m_pending));
+    }
+
+    void AesGcm::Stream::ghashCiphertext(const unsigned char *data, std::size_t size)
+    {
+        m_gcm.ghash(m_hash, data, size / 16);
+    }
+
+    void AesGcm::Stream::update(const unsigned char *in, unsigned char *out, std::size_t size)
+    {
+        if (size > kMaxMessageSize - m_total)
+        {
+            throw std::length_error("AES-GCM message exceeds 2^32 - 2 blocks for one nonce");
+        }
+        m_total += size;
+
+        // Finish a keystream block left over from the previous call.
+        for (; size > 0 && m_keystreamUsed < 16; --size, ++in, ++out)
+        {
+            const unsigned char plain = *in;
+            const unsigned char mixed = static_cast<unsigned char>(plain ^ m_keystream[m_keystreamUsed++]);
+            *out = mixed;
+            m_pending[m_pendingSize++] = m_encrypting ? mixed : plain;
+            if (m_pendingSize == 16)
+            {
+                ghashCiphertext(m_pending, 16);
+                m_pendingSize = 0;
+            }
+        }
+
+        // GHASH always covers ciphertext: hash before decrypting and after encrypting, a pass at a time.
+        std::size_t blocks = size / 16;
+        while (blocks > 0)
+        {
+            const std::size_t pass = blocks < kPassBlocks ? blocks : kPassBlocks;
+            if (!m_encrypting)
+            {
+                ghashCiphertext(in, 16 * pass);
+            }
+            m_gcm.ctr(m_counter, in, out, pass);
+            if (m_encrypting)
+            {
+                ghashCiphertext(out, 16 * pass);
+            }
+            in += 16 * pass;
+            out += 16 * pass;
+            size -= 16 * pass;
+            blocks -= pass;
+        }
+
+        if (size > 0)
+        {
+            m_gcm.encryptBlock(m_counter, m_keystream);
+            increment32(m_counter, 1);
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                const unsigned char plain = in[i];
+                out[i] = static_cast<unsigned char>(plain ^ m_keystream[i]);
+                m_pending[i] = m_encrypting ? out[i] : plain;
+            }
+            m_keystreamUsed = size;
+            m_pendingSize = size;
+        }
+    }
+
+    void AesGcm::Stream::finish(unsigned char *tag)
+    {
+        if (m_pendingSize > 0)
+        {
+            std::memset(m_pending + m_pendingSize, 0, 16 - m_pendingSize);
+            ghashCiphertext(m_pending, 16);
+            m_pendingSize = 0;
+        }
+        unsigned char lengths[16] = {};
+        store64be(lengths + 8, m_total * 8);
+        ghashCiphertext(lengths, 16);
+        for (int i = 0; i < 16; ++i)
+        {
+            tag[i] = static_cast<unsigned char>(m_hash[i] ^ m_tagMask[i]);
+        }
+    }
+
+    bool AesGcm::Stream::verify(const unsigned char *tag)
+    {
+        unsigned char expected[kTagSize];
+        finish(expected);
+        unsigned char diff = 0;
+        for (std::size_t i = 0; i < kTagSize; ++i)
+        {
+            diff |= static_cast<unsigned char>(expected[i] ^ tag[i]);
+        }
+        wipe(expected, sizeof(expected));
+        return diff == 0;
+    }
+
+    AesGcm::Tier AesGcm::bestTier() noexcept
+    {
+        return supported(Tier::AESNI) ? Tier::AESNI : Tier::Portable;
+    }
+
+    bool AesGcm::supported(Tier tier) noexcept
+    {
+        switch (tier)
+        {
+        case Tier::Portable:
+            return true;
+#if defined(DE_GCM_X86)
+        case Tier::AESNI:
+        {
+            const auto &features = core::CpuFeatures::current();
+            return features.aes && features.pclmul && features.sse41 && features.ssse3;
+        }
+#endif
+        default:
+            return false;
+        }
+    }
+
+    const char *AesGcm::tierName(Tier tier) noexcept
+    {
+        return tier == Tier::AESNI ? "aesni-pclmul" : "portable";
+    }
+
+} // namespace dynamicencrypt::plugins
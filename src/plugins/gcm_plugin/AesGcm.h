@@ -0,0 +1,94 @@
+#pragma once
+
+#include "core/SecureArena.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dynamicencrypt::plugins
+{
+
+    // AES-256-GCM with a 96-bit nonce and 128-bit tag (NIST SP 800-38D), no associated data.
+    //
+    // The AESNI tier runs AES rounds with AES-NI and GHASH with PCLMULQDQ. The Portable tier is
+    // constant time: the S-box is a bitsliced boolean circuit evaluated over 64 bytes at once
+    // and GHASH uses masked integer multiplies, so no secret-dependent table lookups or branches.
+    // Instances created with new live in the SecureArena, since they hold the key schedule.
+    class AesGcm : public dynamicencrypt::core::SecureAllocated
+    {
+    public:
+        enum class Tier
+        {
+            Portable,
+            AESNI
+        };
+
+        static constexpr char kName[] = "AES-256-GCM";
+        static constexpr std::size_t kKeySize = 32;
+        static constexpr std::size_t kNonceSize = 12;
+        static constexpr std::size_t kTagSize = 16;
+        // 2^32 - 2 counter blocks are available per nonce.
+        static constexpr std::uint64_t kMaxMessageSize = ((std::uint64_t{1} << 32) - 2) * 16;
+
+        explicit AesGcm(const unsigned char *key);
+        AesGcm(const unsigned char *key, Tier tier);
+        ~AesGcm();
+
+        AesGcm(const AesGcm &) = delete;
+        AesGcm &operator=(const AesGcm &) = delete;
+
+        Tier tier() const noexcept { return m_tier; }
+
+        // One-shot helpers; out may alias in. open() verifies in constant time and leaves out zeroed
+        // when the tag does not match.
+        void seal(const unsigned char *nonce, const unsigned char *in, unsigned char *out, std::size_t size,
+                  unsigned char *tag) const;
+        bool open(const unsigned char *nonce, const unsigned char *in, unsigned char *out, std::size_t size,
+                  const unsigned char *tag) const;
+
+        // Incremental state for one message. Chunks may have any size; out may alias in.
+        class Stream : public dynamicencrypt::core::SecureAllocated
+        {
+        public:
+            Stream(const AesGcm &gcm, const unsigned char *nonce, bool encrypting);
+            ~Stream();
+
+            Stream(const Stream &) = delete;
+            Stream &operator=(const Stream &) = delete;
+
+            void update(const unsigned char *in, unsigned char *out, std::size_t size);
+            void finish(unsigned char *tag);
+            bool verify(const unsigned char *tag);
+
+        private:
+            void ghashCiphertext(const unsigned char *data, std::size_t size);
+
+            const AesGcm &m_gcm;
+            bool m_encrypting;
+            alignas(16) unsigned char m_counter[16];
+            alignas(16) unsigned char m_tagMask[16];
+            alignas(16) unsigned char m_hash[16];
+            alignas(16) unsigned char m_keystream[16];
+            alignas(16) unsigned char m_pending[16];
+            std::size_t m_keystreamUsed{16};
+            std::size_t m_pendingSize{0};
+            std::uint64_t m_total{0};
+        };
+
+        static Tier bestTier() noexcept;
+        static bool supported(Tier tier) noexcept;
+        static const char *tierName(Tier tier) noexcept;
+
+    private:
+        // Encrypts blocks counter, counter + 1, ... (low 32 bits, big-endian) and XORs them into in.
+        void ctr(unsigned char *counter, const unsigned char *in, unsigned char *out, std::size_t blocks) const;
+        void ghash(unsigned char *hash, const unsigned char *data, std::size_t blocks) const;
+        void encryptBlock(const unsigned char *in, unsigned char *out) const;
+
+        Tier m_tier;
+        alignas(16) unsigned char m_roundKeys[15 * 16];
+        // Tier-specific GHASH key material: H^1..H^4 byte-reversed for PCLMULQDQ, H alone otherwise.
+        alignas(16) unsigned char m_hashKeys[4 * 16];
+    };
+
+} // namespace dynamicencrypt::plugins
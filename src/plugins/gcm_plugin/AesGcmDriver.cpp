@@ -0,0 +1,16 @@
+#include "AesGcmDriver.h"
+
+namespace dynamicencrypt::plugins
+{
+
+    QString AesGcmDriver::name() const
+    {
+        return QLatin1String(AesGcm::kName);
+    }
+
+    QString AesGcmDriver::version() const
+    {
+        return QStringLiteral("1.0 (%1)").arg(QLatin1String(AesGcm::tierName(AesGcm::bestTier())));
+    }
+
+} // namespace dynamicencrypt::plugins
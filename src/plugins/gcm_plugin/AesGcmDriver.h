@@ -0,0 +1,28 @@
+#pragma once
+
+#include "AesGcm.h"
+
+#include "plugins/AeadDriver.h"
+
+#include <QObject>
+
+namespace dynamicencrypt::plugins
+{
+
+    // AES-256-GCM driver. Ciphertext layout: 12-byte random nonce | ciphertext | 16-byte tag.
+    // Decryption throws std::runtime_error when the tag does not verify.
+    class AesGcmDriver : public QObject, public AeadDriver<AesGcm>
+    {
+        Q_OBJECT
+        Q_PLUGIN_METADATA(IID CryptoDriver_iid FILE "plugin.json")
+        Q_INTERFACES(dynamicencrypt::core::CryptoDriver)
+
+    public:
+        AesGcmDriver() = default;
+        ~AesGcmDriver() override = default;
+
+        QString name() const override;
+        QString version() const override;
+    };
+
+} // namespace dynamicencrypt::plugins
@@ -0,0 +1,345 @@
+#define CATCH_CONFIG_RUNNER
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "core/EntryIndexes.h"
+#include "core/Key.h"
+#include "core/Storage.h"
+#include "core/VaultManager.h"
+#include "core/ZeroizingBuffer.h"
+#include "plugins/aes_plugin/AESDriverImpl.h"
+#include "plugins/chacha_plugin/ChaCha20Poly1305.h"
+#include "plugins/gcm_plugin/AesGcm.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QTemporaryDir>
+#include <QTimeZone>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+// Throughput benchmarks for the core hot paths. Run with a JSON reporter to track regressions:
+//   core_benchmarks --reporter JSON::out=benchmarks.json
+// or build the core_benchmarks_json target, which does the same into the build directory.
+
+using dynamicencrypt::core::generateSymmetricKey;
+using dynamicencrypt::core::Storage;
+using dynamicencrypt::core::VaultManager;
+using dynamicencrypt::core::ZeroizingBuffer;
+using dynamicencrypt::plugins::AESDriverImpl;
+using dynamicencrypt::plugins::AesGcm;
+using dynamicencrypt::plugins::ChaCha20Poly1305;
+
+namespace
+{
+    constexpr int kPayloadSizes[] = {64, 4 << 10, 64 << 10, 1 << 20, 16 << 20};
+
+    QByteArray payload(int size)
+    {
+        QByteArray bytes(size, Qt::Uninitialized);
+        for (int i = 0; i < size; ++i)
+        {
+            bytes[i] = static_cast<char>(i * 131 + 7);
+        }
+        return bytes;
+    }
+
+    std::string label(const char *operation, int size)
+    {
+        return std::string(operation) + " " + std::to_string(size) + " B";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    Catch::Session session;
+    return session.run(argc, argv);
+}
+
+TEST_CASE("xorSeal throughput", "[!benchmark][plugin]")
+{
+    const auto key = generateSymmetricKey(256);
+    const QByteArray nonce(12, '\x42');
+    for (int size : kPayloadSizes)
+    {
+        const QByteArray input = payload(size);
+        BENCHMARK(label("xorSeal", size))
+        {
+            return AESDriverImpl::xorSeal(input, key.raw(), nonce);
+        };
+    }
+}
+
+TEST_CASE("Driver encrypt/decrypt throughput", "[!benchmark][plugin]")
+{
+    AESDriverImpl driver;
+    const auto key = generateSymmetricKey(256);
+    for (int size : kPayloadSizes)
+    {
+        const QByteArray plaintext = payload(size);
+        const QByteArray ciphertext = driver.encrypt(plaintext, key.raw());
+        BENCHMARK(label("encrypt", size))
+        {
+            return driver.encrypt(plaintext, key.raw());
+        };
+        BENCHMARK(label("decrypt", size))
+        {
+            return driver.decrypt(ciphertext, key.raw());
+        };
+
+        QByteArray buffer(size + 12, Qt::Uninitialized);
+        BENCHMARK(label("encryptInPlace", size))
+        {
+            driver.encryptInPlace(dynamicencrypt::core::asWritableBytes(buffer), key.raw());
+        };
+    }
+}
+
+TEST_CASE("AES-256-GCM throughput per tier", "[!benchmark][gcm]")
+{
+    const auto key = generateSymmetricKey(256);
+    const auto *keyBytes = reinterpret_cast<const unsigned char *>(key.raw().constData());
+    const unsigned char nonce[AesGcm::kNonceSize] = {};
+    unsigned char tag[AesGcm::kTagSize];
+    for (AesGcm::Tier tier : {AesGcm::Tier::AESNI, AesGcm::Tier::Portable})
+    {
+        if (!AesGcm::supported(tier))
+        {
+            continue;
+        }
+        const AesGcm gcm(keyBytes, tier);
+        const std::string prefix = std::string("gcm seal ") + AesGcm::tierName(tier);
+        for (int size : kPayloadSizes)
+        {
+            // The portable tier is a fallback; keep its runs short.
+            if (tier == AesGcm::Tier::Portable && size > (1 << 20))
+            {
+                continue;
+            }
+            QByteArray buffer = payload(size);
+            auto *bytes = reinterpret_cast<unsigned char *>(buffer.data());
+            BENCHMARK(label(prefix.c_str(), size))
+            {
+                gcm.seal(nonce, bytes, bytes, static_cast<std::size_t>(size), tag);
+                return tag[0];
+            };
+        }
+        BENCHMARK(prefix + " key setup")
+        {
+            return AesGcm(keyBytes, tier).tier();
+        };
+    }
+}
+
+TEST_CASE("ChaCha20-Poly1305 throughput per tier", "[!benchmark][chacha]")
+{
+    const auto key = generateSymmetricKey(256);
+    const auto *keyBytes = reinterpret_cast<const unsigned char *>(key.raw().constData());
+    const unsigned char nonce[ChaCha20Poly1305::kNonceSize] = {};
+    unsigned char tag[ChaCha20Poly1305::kTagSize];
+    using Tier = ChaCha20Poly1305::Tier;
+    for (Tier tier : {Tier::AVX512, Tier::AVX2, Tier::SSE2, Tier::Scalar})
+    {
+        if (!ChaCha20Poly1305::supported(tier))
+        {
+            continue;
+        }
+        const ChaCha20Poly1305 aead(keyBytes, tier);
+        const std::string prefix = std::string("chacha20-poly1305 seal ") + ChaCha20Poly1305::tierName(tier);
+        for (int size : kPayloadSizes)
+        {
+            QByteArray buffer = payload(size);
+            auto *bytes = reinterpret_cast<unsigned char *>(buffer.data());
+            BENCHMARK(label(prefix.c_str(), size))
+            {
+                aead.seal(nonce, bytes, bytes, static_cast<std::size_t>(size), tag);
+                return tag[0];
+            };
+        }
+    }
+}
+
+TEST_CASE("Symmetric key generation", "[!benchmark][key]")
+{
+    for (int bits : {128, 256, 4096})
+    {
+        BENCHMARK("generateSymmetricKey " + std::to_string(bits) + " bit")
+        {
+            return generateSymmetricKey(bits);
+        };
+    }
+}
+
+TEST_CASE("Storage store/load throughput", "[!benchmark][storage]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    Storage storage;
+    const QString path = dir.filePath(QStringLiteral("bench.bin"));
+    for (int size : kPayloadSizes)
+    {
+        const QByteArray blob = payload(size);
+        BENCHMARK(label("store", size))
+        {
+            storage.store(path, blob);
+        };
+        storage.store(path, blob);
+        BENCHMARK(label("load", size))
+        {
+            return storage.load(path);
+        };
+        BENCHMARK(label("map", size))
+        {
+            return storage.map(path).size();
+        };
+    }
+}
+
+TEST_CASE("ZeroizingBuffer wipe cost", "[!benchmark][zeroize]")
+{
+    for (int size : {32, 4 << 10, 1 << 20})
+    {
+        // Buffers are allocated outside the measured region so only the wipe itself is timed.
+        BENCHMARK_ADVANCED(label("secureWipe", size))(Catch::Benchmark::Chronometer meter)
+        {
+            std::vector<ZeroizingBuffer> buffers;
+            buffers.reserve(static_cast<std::size_t>(meter.runs()));
+            for (int i = 0; i < meter.runs(); ++i)
+            {
+                buffers.emplace_back(payload(size));
+            }
+            meter.measure([&buffers](int i) { buffers[static_cast<std::size_t>(i)].secureWipe(); });
+        };
+        // A full secret lifetime: arena allocation, one write, wipe and release.
+        BENCHMARK(label("allocate+wipe", size))
+        {
+            ZeroizingBuffer buffer(size);
+            buffer.data()[0] = 1;
+            return buffer.size();
+        };
+        // Same on four threads at once; wipes share no lock, so this should scale with the cores.
+        BENCHMARK(label("allocate+wipe x4 threads, 1000 each", size))
+        {
+            std::vector<std::thread> threads;
+            for (int t = 0; t < 4; ++t)
+            {
+                threads.emplace_back([size]()
+                                     {
+                    for (int i = 0; i < 1000; ++i)
+                    {
+                        ZeroizingBuffer buffer(size);
+                        buffer.data()[0] = 1;
+                    } });
+            }
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+        };
+    }
+}
+
+TEST_CASE("Plugin dispatch overhead", "[!benchmark][vault]")
+{
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    // Compare against the plugin that wraps the same AESDriverImpl.
+    auto *driver = manager.driverNamed(QStringLiteral("Demo AES (XOR placeholder)"));
+    REQUIRE(driver);
+
+    AESDriverImpl direct;
+    const auto key = generateSymmetricKey(256);
+    // Small payloads so the call path, not the cipher, dominates.
+    for (int size : {16, 256})
+    {
+        const QByteArray plaintext = payload(size);
+        BENCHMARK(label("direct encrypt", size))
+        {
+            return direct.encrypt(plaintext, key.raw());
+        };
+        BENCHMARK(label("encryptWith plugin", size))
+        {
+            return manager.encryptWith(driver, plaintext, key);
+        };
+        BENCHMARK(label("encryptSymmetric plugin", size))
+        {
+            return manager.encryptSymmetric(driver, plaintext, key);
+        };
+    }
+}
+
+TEST_CASE("Prepared keys versus per-call key setup", "[!benchmark][vault]")
+{
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    const auto key = generateSymmetricKey(256);
+    for (auto *driver : manager.drivers())
+    {
+        const auto handle = manager.prepareKey(driver, key);
+        const std::string prefix = driver->name().toStdString();
+        // Small records, where key expansion is a large share of each call.
+        for (int size : {16, 256})
+        {
+            const QByteArray plaintext = payload(size);
+            BENCHMARK(prefix + " " + label("raw key", size))
+            {
+                return manager.encryptSymmetric(driver, plaintext, key);
+            };
+            BENCHMARK(prefix + " " + label("prepared key", size))
+            {
+                return manager.encryptSymmetric(handle, plaintext);
+            };
+        }
+    }
+}
+
+TEST_CASE("Indexed vault queries over a million entries", "[!benchmark][vault][query]")
+{
+    using dynamicencrypt::core::EntryIndexes;
+    using dynamicencrypt::core::EntryQuery;
+
+    constexpr int kEntries = 1000000;
+    const QDateTime epoch = QDateTime::fromMSecsSinceEpoch(1704067200000, QTimeZone::UTC);
+    const QString algorithms[] = {QStringLiteral("AES-GCM"), QStringLiteral("ChaCha20-Poly1305"), QStringLiteral("XOR")};
+    EntryIndexes indexes;
+    for (int i = 0; i < kEntries; ++i)
+    {
+        dynamicencrypt::core::VaultEntry entry;
+        entry.originalPath = QStringLiteral("/data/%1").arg(i % (kEntries / 4));
+        entry.storedPath = QStringLiteral("/vault/%1.vault").arg(i);
+        entry.algorithm = algorithms[i % 3];
+        entry.timestamp = epoch.addSecs((i * 7919LL) % kEntries);
+        indexes.insert(entry);
+    }
+
+    int probe = 0;
+    BENCHMARK("find by storedPath")
+    {
+        return indexes.find(QStringLiteral("/vault/%1.vault").arg(probe++ * 7 % kEntries));
+    };
+    BENCHMARK("query by originalPath")
+    {
+        EntryQuery query;
+        query.originalPath = QStringLiteral("/data/%1").arg(probe++ * 13 % (kEntries / 4));
+        return indexes.query(query);
+    };
+    BENCHMARK("query algorithm in a 100-second range")
+    {
+        EntryQuery query;
+        query.algorithm = algorithms[probe % 3];
+        query.from = epoch.addSecs(probe++ * 997 % kEntries);
+        query.until = query.from.addSecs(100);
+        return indexes.query(query);
+    };
+    BENCHMARK("newest 50 entries")
+    {
+        EntryQuery query;
+        query.newestFirst = true;
+        query.limit = 50;
+        return indexes.query(query);
+    };
+}
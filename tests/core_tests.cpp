@@ -2,17 +2,39 @@
 #include <catch2/catch_session.hpp>
 #include <catch2/catch_test_macros.hpp>
 
+#include "core/ChangeCache.h"
+#include "core/DirectoryEncryptor.h"
 #include "core/Key.h"
+#include "core/KeyRotator.h"
+#include "core/LazyDriver.h"
+#include "core/SegmentedFormat.h"
+#include "core/SecureRandom.h"
 #include "core/Storage.h"
 #include "core/VaultManager.h"
+#include "core/VaultScrubber.h"
+#include "core/WipeTelemetry.h"
+#include "core/WorkStealingPool.h"
 #include "core/ZeroizingBuffer.h"
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QDir>
+#include <QJsonDocument>
+#include <QProcess>
+#include <QStandardPaths>
 #include <QTemporaryDir>
+#include <QTimeZone>
 
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
 
 using dynamicencrypt::core::generateSymmetricKey;
 using dynamicencrypt::core::Key;
@@ -77,3 +99,1612 @@ TEST_CASE("VaultManager plugin discovery", "[vault]")
     manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
     REQUIRE(manager.drivers().size() >= 1);
 }
+
+TEST_CASE("Streaming file encrypt/decrypt roundtrip", "[plugin][stream]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    auto drivers = manager.drivers();
+    REQUIRE_FALSE(drivers.empty());
+
+    QByteArray plaintext;
+    for (int i = 0; i < 1000; ++i)
+    {
+        plaintext.append(static_cast<char>(i * 31));
+    }
+    Storage storage;
+    const QString plainPath = dir.filePath(QStringLiteral("plain.bin"));
+    const QString vaultPath = dir.filePath(QStringLiteral("plain.bin.vault"));
+    const QString restoredPath = dir.filePath(QStringLiteral("restored.bin"));
+    storage.store(plainPath, plaintext);
+
+    auto key = generateSymmetricKey(256);
+    QByteArray nonce;
+    manager.encryptFile(drivers.front(), plainPath, vaultPath, key, &nonce, 7);
+    const QByteArray cipher = storage.load(vaultPath);
+    REQUIRE(nonce.size() == drivers.front()->ciphertextLayout().header);
+    REQUIRE(nonce == cipher.left(nonce.size()));
+    REQUIRE(manager.decryptSymmetric(drivers.front(), cipher, key) == plaintext);
+
+    manager.decryptFile(drivers.front(), vaultPath, restoredPath, key, 5);
+    REQUIRE(storage.load(restoredPath) == plaintext);
+
+    // A file smaller than the driver's chunk reads through a pooled arena block: once warm, no pass maps
+    // a dedicated buffer.
+    using dynamicencrypt::core::SecureArena;
+    manager.encryptFile(drivers.front(), plainPath, vaultPath, key);
+    manager.decryptFile(drivers.front(), vaultPath, restoredPath, key);
+    const std::size_t warmed = SecureArena::stats().mappedBytes;
+    std::size_t peak = 0;
+    dynamicencrypt::core::JobControl control;
+    control.progress = [&](qint64, qint64) { peak = std::max(peak, SecureArena::stats().mappedBytes); };
+    REQUIRE(VaultManager::chunkSizeFor(drivers.front()) > static_cast<qsizetype>(SecureArena::kLargestClass));
+    for (int i = 0; i < 10; ++i)
+    {
+        manager.encryptFile(drivers.front(), plainPath, vaultPath, key, nullptr, VaultManager::kAutoChunkSize, control);
+        manager.decryptFile(drivers.front(), vaultPath, restoredPath, key, VaultManager::kAutoChunkSize, control);
+    }
+    REQUIRE(peak == warmed);
+    REQUIRE(storage.load(restoredPath) == plaintext);
+}
+
+TEST_CASE("Vectorized XOR output matches legacy layout", "[plugin][simd]")
+{
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    auto *driver = manager.driverNamed(QStringLiteral("Demo AES (XOR placeholder)"));
+    REQUIRE(driver);
+
+    for (int keyBits : {8, 128, 200, 256})
+    {
+        auto key = generateSymmetricKey(keyBits);
+        for (int size : {0, 1, 15, 127, 128, 129, 1000, 4099})
+        {
+            QByteArray plaintext(size, Qt::Uninitialized);
+            for (int i = 0; i < size; ++i)
+            {
+                plaintext[i] = static_cast<char>(i * 7 + keyBits);
+            }
+            const QByteArray cipher = manager.encryptSymmetric(driver, plaintext, key);
+            REQUIRE(cipher.size() == size + 12);
+            const QByteArray nonce = cipher.left(12);
+            const QByteArray &raw = key.raw();
+            for (int i = 0; i < size; ++i)
+            {
+                const char expected = static_cast<char>(plaintext.at(i) ^ raw.at(i % raw.size()) ^ nonce.at(i % 12));
+                REQUIRE(cipher.at(12 + i) == expected);
+            }
+            REQUIRE(manager.decryptSymmetric(driver, cipher, key) == plaintext);
+        }
+    }
+}
+
+TEST_CASE("Span and in-place encrypt/decrypt roundtrip", "[plugin][span]")
+{
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    auto drivers = manager.drivers();
+    REQUIRE_FALSE(drivers.empty());
+    auto *driver = drivers.front();
+    const auto layout = driver->ciphertextLayout();
+    REQUIRE(layout.known());
+
+    auto key = generateSymmetricKey(256);
+    const QByteArray plaintext("span payload that is longer than one nonce");
+    QByteArray cipher(plaintext.size() + layout.overhead(), Qt::Uninitialized);
+    QByteArray nonce;
+    const qsizetype written = manager.encryptSymmetric(driver, dynamicencrypt::core::asBytes(plaintext),
+                                                       dynamicencrypt::core::asWritableBytes(cipher), key, &nonce);
+    REQUIRE(written == cipher.size());
+    REQUIRE(nonce == cipher.left(layout.header));
+    REQUIRE(manager.decryptSymmetric(driver, cipher, key) == plaintext);
+
+    QByteArray buffer(layout.header, '\0');
+    buffer.append(plaintext);
+    buffer.append(QByteArray(layout.trailer, '\0'));
+    driver->encryptInPlace(dynamicencrypt::core::asWritableBytes(buffer), key.raw());
+    REQUIRE(manager.decryptSymmetric(driver, buffer, key) == plaintext);
+    const auto recovered = driver->decryptInPlace(dynamicencrypt::core::asWritableBytes(buffer), key.raw());
+    REQUIRE(QByteArray(reinterpret_cast<const char *>(recovered.data()), static_cast<qsizetype>(recovered.size())) == plaintext);
+}
+
+TEST_CASE("Segmented parallel encrypt/decrypt roundtrip", "[plugin][segmented]")
+{
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    auto drivers = manager.drivers();
+    REQUIRE_FALSE(drivers.empty());
+
+    QByteArray plaintext(10007, Qt::Uninitialized);
+    for (int i = 0; i < plaintext.size(); ++i)
+    {
+        plaintext[i] = static_cast<char>(i * 13);
+    }
+    auto key = generateSymmetricKey(256);
+    VaultManager::SegmentOptions options;
+    options.segmentSize = 1000;
+    options.threadCount = 4;
+
+    const QByteArray cipher = manager.encryptSegmented(drivers.front(), plaintext, key, options);
+    REQUIRE(cipher.size() == manager.segmentedCiphertextSize(drivers.front(), plaintext.size(), options));
+    REQUIRE(manager.decryptSegmented(drivers.front(), cipher, key, options) == plaintext);
+
+    options.threadCount = 1;
+    REQUIRE(manager.decryptSegmented(drivers.front(), cipher, key, options) == plaintext);
+    REQUIRE_THROWS(manager.decryptSegmented(drivers.front(), cipher.left(cipher.size() - 1), key, options));
+
+    // With an authenticating driver, a header cannot be rewritten to drop whole trailing segments.
+    using dynamicencrypt::core::SegmentedHeader;
+    auto *gcm = manager.driverNamed(QStringLiteral("AES-256-GCM"));
+    REQUIRE(gcm);
+    auto rewrite = [](QByteArray blob, const std::function<void(SegmentedHeader &)> &edit, qsizetype size)
+    {
+        SegmentedHeader header = SegmentedHeader::read(dynamicencrypt::core::asBytes(blob));
+        edit(header);
+        header.write(dynamicencrypt::core::asWritableBytes(blob));
+        blob.truncate(size);
+        return blob;
+    };
+    const QByteArray whole = plaintext.left(10000);
+    const QByteArray sealed = manager.encryptSegmented(gcm, whole, key, options);
+    REQUIRE(manager.decryptSegmented(gcm, sealed, key, options) == whole);
+    const SegmentedHeader original = SegmentedHeader::read(dynamicencrypt::core::asBytes(sealed));
+    const QByteArray cut = rewrite(sealed, [](SegmentedHeader &header) { header.plaintextSize = 5000; },
+                                   original.cipherOffset(5));
+    REQUIRE_THROWS_AS(manager.decryptSegmented(gcm, cut, key, options), std::runtime_error);
+    const QByteArray emptied = rewrite(sealed, [](SegmentedHeader &header) { header.plaintextSize = 0; },
+                                       original.encodedSize() + original.segmentOverhead);
+    REQUIRE_THROWS_AS(manager.decryptSegmented(gcm, emptied, key, options), std::runtime_error);
+    // An empty plaintext is one empty, authenticated segment, not a bare header.
+    const QByteArray empty = manager.encryptSegmented(gcm, QByteArray(), key, options);
+    REQUIRE(empty.size() == original.encodedSize() + original.segmentOverhead);
+    REQUIRE(manager.decryptSegmented(gcm, empty, key, options).isEmpty());
+    REQUIRE_THROWS_AS(manager.decryptSegmented(gcm, empty.left(original.encodedSize()), key, options),
+                      std::invalid_argument);
+
+    // A plaintextSize chosen so plaintextSize + segmentCount() * 16 wraps to the real body size is rejected
+    // before anything is sized from it: with one-byte segments that is the body size times 17^-1 mod 2^64.
+    quint64 inverse = 17;
+    for (int i = 0; i < 5; ++i)
+    {
+        inverse *= 2 - 17 * inverse;
+    }
+    const auto body = static_cast<quint64>(sealed.size() - original.encodedSize());
+    const QByteArray wrapped = rewrite(sealed, [&](SegmentedHeader &header)
+                                       {
+        header.segmentSize = 1;
+        header.plaintextSize = body * inverse; }, sealed.size());
+    REQUIRE_THROWS_AS(manager.decryptSegmented(gcm, wrapped, key, options), std::invalid_argument);
+}
+
+TEST_CASE("Mapped storage and mapped encryption roundtrip", "[storage][mmap]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    Storage storage;
+    const QByteArray expected("mapped vault-data");
+    const QString blobPath = dir.filePath(QStringLiteral("blob.bin"));
+    storage.storeMapped(blobPath, expected.size(), [&](std::span<std::byte> out)
+                        { std::memcpy(out.data(), expected.constData(), out.size()); });
+    const auto view = storage.map(blobPath);
+    REQUIRE(QByteArray(reinterpret_cast<const char *>(view.bytes().data()), view.size()) == expected);
+
+    // Mapped outputs get the permissions QSaveFile would give them, and a failed fill leaves nothing behind.
+    const QString savedPath = dir.filePath(QStringLiteral("saved.bin"));
+    storage.store(savedPath, expected);
+    REQUIRE(QFileInfo(blobPath).permissions() == QFileInfo(savedPath).permissions());
+#if !defined(Q_OS_WIN)
+    const QFileDevice::Permissions restricted = QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ReadGroup;
+    REQUIRE(QFile::setPermissions(blobPath, restricted));
+    storage.storeMapped(blobPath, expected.size(), [&](std::span<std::byte> out)
+                        { std::memcpy(out.data(), expected.constData(), out.size()); });
+    REQUIRE(QFileInfo(blobPath).permissions() == restricted);
+#endif
+    REQUIRE_THROWS_AS(storage.storeMapped(dir.filePath(QStringLiteral("failed.bin")), 16, [](std::span<std::byte>)
+                                          { throw std::runtime_error("fill failed"); }),
+                      std::runtime_error);
+    REQUIRE(QDir(dir.path()).entryList(QDir::Files | QDir::Hidden).size() == 2);
+
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    auto drivers = manager.drivers();
+    REQUIRE_FALSE(drivers.empty());
+    auto key = generateSymmetricKey(256);
+
+    const QString vaultPath = dir.filePath(QStringLiteral("blob.bin.vault"));
+    const QString restoredPath = dir.filePath(QStringLiteral("restored.bin"));
+    manager.encryptMappedFile(drivers.front(), blobPath, vaultPath, key);
+    REQUIRE(manager.decryptSymmetric(drivers.front(), storage.load(vaultPath), key) == expected);
+    manager.decryptMappedFile(drivers.front(), vaultPath, restoredPath, key);
+    REQUIRE(storage.load(restoredPath) == expected);
+
+    VaultManager::SegmentOptions options;
+    options.segmentSize = 4;
+    manager.encryptSegmentedFile(drivers.front(), blobPath, vaultPath, key, options);
+    manager.decryptSegmentedFile(drivers.front(), vaultPath, restoredPath, key, options);
+    REQUIRE(storage.load(restoredPath) == expected);
+}
+
+TEST_CASE("File jobs report progress and honour cancellation", "[stream][jobs]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    auto drivers = manager.drivers();
+    REQUIRE_FALSE(drivers.empty());
+
+    Storage storage;
+    const QString plainPath = dir.filePath(QStringLiteral("plain.bin"));
+    const QString vaultPath = dir.filePath(QStringLiteral("plain.bin.vault"));
+    storage.store(plainPath, QByteArray(4096, 'x'));
+    auto key = generateSymmetricKey(256);
+
+    std::atomic_bool cancelled{false};
+    qint64 lastDone = -1;
+    dynamicencrypt::core::JobControl control;
+    control.cancelled = &cancelled;
+    control.progress = [&](qint64 done, qint64 total)
+    {
+        REQUIRE(total == 4096);
+        lastDone = done;
+        if (done >= 1024)
+        {
+            cancelled = true;
+        }
+    };
+    REQUIRE_THROWS_AS(manager.encryptFile(drivers.front(), plainPath, vaultPath, key, nullptr, 512, control),
+                      dynamicencrypt::core::OperationCancelled);
+    REQUIRE(lastDone == 1024);
+    REQUIRE_FALSE(QFile::exists(vaultPath));
+
+    cancelled = false;
+    control.progress = [&](qint64 done, qint64) { lastDone = done; };
+    manager.encryptFile(drivers.front(), plainPath, vaultPath, key, nullptr, 512, control);
+    REQUIRE(lastDone == 4096);
+}
+
+TEST_CASE("Vault index persists entries and survives a torn tail", "[vault][index]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QDateTime stamp = QDateTime::fromMSecsSinceEpoch(1700000000000, QTimeZone::UTC);
+    {
+        VaultManager manager;
+        manager.setStorageDirectory(dir.path());
+        REQUIRE(manager.entryCount() == 0);
+        for (const char *name : {"a.vault", "b.vault"})
+        {
+            dynamicencrypt::core::VaultEntry entry;
+            entry.originalPath = QStringLiteral("/src/%1").arg(QLatin1String(name));
+            entry.storedPath = dir.filePath(QLatin1String(name));
+            entry.algorithm = QStringLiteral("demo");
+            entry.nonce = QByteArray(12, '\x5a');
+            entry.timestamp = stamp;
+            manager.addEntry(entry);
+        }
+        dynamicencrypt::core::VaultEntry replacement = manager.entryAt(0);
+        replacement.algorithm = QStringLiteral("replaced");
+        manager.addEntry(replacement);
+        REQUIRE(manager.entryCount() == 2);
+    }
+
+    QFile index(dir.filePath(QString::fromLatin1(VaultManager::kIndexFileName)));
+    REQUIRE(index.open(QIODevice::Append));
+    index.write(QByteArray("\x40\x00\x00\x00torn", 8));
+    index.close();
+
+    VaultManager reopened;
+    reopened.setStorageDirectory(dir.path());
+    REQUIRE(reopened.entryCount() == 2);
+    const auto first = reopened.entryAt(0);
+    REQUIRE(first.storedPath == dir.filePath(QStringLiteral("a.vault")));
+    REQUIRE(first.algorithm == QStringLiteral("replaced"));
+    REQUIRE(first.nonce == QByteArray(12, '\x5a'));
+    REQUIRE(first.timestamp == stamp);
+    REQUIRE(reopened.entries().at(1).originalPath == QStringLiteral("/src/b.vault"));
+    REQUIRE(reopened.index().indexOf(dir.filePath(QStringLiteral("b.vault"))) == 1);
+}
+
+TEST_CASE("A vault index held by another owner opens read-only", "[vault][index][lock]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString indexPath = dir.filePath(QString::fromLatin1(VaultManager::kIndexFileName));
+    dynamicencrypt::core::VaultEntry entry;
+    entry.algorithm = QStringLiteral("demo");
+    qint64 lockedSize = 0;
+    {
+        VaultManager owner;
+        owner.setStorageDirectory(dir.path());
+        REQUIRE(owner.index().isOpen());
+        entry.storedPath = dir.filePath(QStringLiteral("a.vault"));
+        owner.addEntry(entry);
+
+        // Bytes past the last complete record look like an append the owner has not finished.
+        QFile index(indexPath);
+        REQUIRE(index.open(QIODevice::Append));
+        index.write(QByteArray("\x40\x00\x00\x00torn", 8));
+        index.close();
+        lockedSize = QFileInfo(indexPath).size();
+
+        VaultManager second;
+        second.setStorageDirectory(dir.path());
+        REQUIRE(second.index().isReadOnly());
+        REQUIRE_FALSE(second.index().isOpen());
+        REQUIRE(second.entryCount() == 1);
+        // Entries carry the only wrapped copy of a data key, so the second owner refuses to hold them.
+        entry.storedPath = dir.filePath(QStringLiteral("b.vault"));
+        REQUIRE_THROWS_AS(second.requireWritableIndex(), std::runtime_error);
+        REQUIRE_THROWS_AS(second.addEntry(entry), std::runtime_error);
+        REQUIRE_THROWS_AS(second.addEntries({entry, entry}), std::runtime_error);
+        REQUIRE_THROWS_AS(second.compactIndex(), std::runtime_error);
+        REQUIRE_THROWS_AS(dynamicencrypt::core::KeyRotator(second).rotate(generateSymmetricKey(256), generateSymmetricKey(256)),
+                          std::runtime_error);
+        REQUIRE(second.entryCount() == 1);
+        REQUIRE(QFileInfo(indexPath).size() == lockedSize);
+    }
+
+    VaultManager reopened;
+    reopened.setStorageDirectory(dir.path());
+    REQUIRE(reopened.index().isOpen());
+    REQUIRE_FALSE(reopened.index().isReadOnly());
+    REQUIRE(reopened.entryCount() == 1);
+    REQUIRE(QFileInfo(indexPath).size() < lockedSize);
+}
+
+TEST_CASE("VaultManager reports row-level entry changes", "[vault][model]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    VaultManager manager;
+    manager.setStorageDirectory(dir.path());
+    // A view can pick up the count and version without a snapshot, which would decode every entry.
+    REQUIRE_FALSE(manager.existingSnapshot());
+    const auto [startRows, startVersion] = manager.versionedEntryCount();
+    REQUIRE(startRows == 0);
+
+    std::vector<std::pair<char, qsizetype>> events;
+    std::vector<quint64> versions;
+    const auto record = [&](char kind, qsizetype pos, quint64 version)
+    {
+        events.emplace_back(kind, pos);
+        versions.push_back(version);
+        REQUIRE(manager.snapshot()->version() == version);
+    };
+    QObject::connect(&manager, &VaultManager::entryInserted, [&](qsizetype pos, quint64 version) { record('i', pos, version); });
+    QObject::connect(&manager, &VaultManager::entryChanged, [&](qsizetype pos, quint64 version) { record('c', pos, version); });
+    QObject::connect(&manager, &VaultManager::entryRemoved, [&](qsizetype pos, quint64 version) { record('r', pos, version); });
+
+    dynamicencrypt::core::VaultEntry entry;
+    entry.algorithm = QStringLiteral("demo");
+    for (const char *name : {"a.vault", "b.vault", "a.vault"})
+    {
+        entry.storedPath = dir.filePath(QLatin1String(name));
+        manager.addEntry(entry);
+    }
+    REQUIRE(manager.removeEntry(dir.filePath(QStringLiteral("a.vault"))));
+    REQUIRE_FALSE(manager.removeEntry(dir.filePath(QStringLiteral("missing.vault"))));
+
+    const std::vector<std::pair<char, qsizetype>> expected{{'i', 0}, {'i', 1}, {'c', 0}, {'r', 0}};
+    REQUIRE(events == expected);
+    REQUIRE(versions.front() == startVersion + 1);
+    for (std::size_t i = 1; i < versions.size(); ++i)
+    {
+        REQUIRE(versions[i] == versions[i - 1] + 1);
+    }
+    REQUIRE(manager.entryCount() == 1);
+    REQUIRE(manager.entryAt(0).storedPath == dir.filePath(QStringLiteral("b.vault")));
+    REQUIRE(manager.existingSnapshot() == manager.snapshot());
+    REQUIRE(manager.versionedEntryCount() == std::pair<qsizetype, quint64>(1, versions.back()));
+}
+
+TEST_CASE("Entry snapshots stay immutable while threads add entries", "[vault][snapshot]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    VaultManager manager;
+    manager.setStorageDirectory(dir.path());
+
+    dynamicencrypt::core::VaultEntry seed;
+    seed.storedPath = dir.filePath(QStringLiteral("seed.vault"));
+    manager.addEntry(seed);
+    const auto before = manager.snapshot();
+
+    constexpr int kWriters = 4;
+    constexpr int kPerWriter = 300;
+    std::atomic_bool done{false};
+    std::atomic_bool consistent{true};
+    std::thread reader([&]()
+                       {
+        while (!done.load())
+        {
+            const auto snapshot = manager.snapshot();
+            qsizetype seen = 0;
+            snapshot->forEach([&](const dynamicencrypt::core::VaultEntry &entry)
+                              { seen += entry.storedPath.isEmpty() ? 0 : 1; });
+            if (seen != snapshot->size() || snapshot->version() < before->version())
+            {
+                consistent = false;
+            }
+        } });
+    std::vector<std::thread> writers;
+    for (int w = 0; w < kWriters; ++w)
+    {
+        writers.emplace_back([&, w]()
+                             {
+            for (int i = 0; i < kPerWriter; ++i)
+            {
+                dynamicencrypt::core::VaultEntry entry;
+                entry.storedPath = dir.filePath(QStringLiteral("w%1-%2.vault").arg(w).arg(i));
+                entry.algorithm = QStringLiteral("demo");
+                manager.addEntry(std::move(entry));
+            } });
+    }
+    for (std::thread &writer : writers)
+    {
+        writer.join();
+    }
+    done = true;
+    reader.join();
+
+    REQUIRE(consistent);
+    REQUIRE(before->size() == 1);
+    REQUIRE(before->at(0).storedPath == seed.storedPath);
+    const auto after = manager.snapshot();
+    REQUIRE(after->size() == 1 + kWriters * kPerWriter);
+    REQUIRE(after->version() == before->version() + kWriters * kPerWriter);
+    REQUIRE(manager.entryCount() == after->size());
+
+    // Removal rebuilds only the chunks from the removed position on; earlier snapshots are untouched.
+    REQUIRE(manager.removeEntry(seed.storedPath));
+    REQUIRE(manager.snapshot()->size() == kWriters * kPerWriter);
+    REQUIRE(after->at(0).storedPath == seed.storedPath);
+
+    VaultManager reopened;
+    reopened.setStorageDirectory(dir.path());
+    REQUIRE(reopened.entryCount() == kWriters * kPerWriter);
+}
+
+TEST_CASE("SecureRandom serves distinct bytes across buffer refills and threads", "[random]")
+{
+    using dynamicencrypt::core::SecureRandom;
+
+    // Larger than one per-thread buffer so the refill path is exercised.
+    const QByteArray first = SecureRandom::bytes(10000);
+    const QByteArray second = SecureRandom::bytes(10000);
+    REQUIRE(first.size() == 10000);
+    REQUIRE(first != second);
+    REQUIRE(std::count(first.begin(), first.end(), '\0') < 200);
+
+    QByteArray fromThread;
+    std::thread worker([&fromThread]() { fromThread = SecureRandom::bytes(64); });
+    worker.join();
+    REQUIRE(fromThread != SecureRandom::bytes(64));
+
+    auto a = generateSymmetricKey(256);
+    auto b = generateSymmetricKey(256);
+    REQUIRE(a.size() == 32);
+    REQUIRE(a.raw() != b.raw());
+}
+
+TEST_CASE("AES-256-GCM driver matches reference vectors and rejects tampering", "[plugin][gcm]")
+{
+    using dynamicencrypt::core::asBytes;
+    using dynamicencrypt::core::asWritableBytes;
+
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    dynamicencrypt::core::CryptoDriver *gcm = nullptr;
+    for (auto *driver : manager.drivers())
+    {
+        if (driver->name() == QStringLiteral("AES-256-GCM"))
+        {
+            gcm = driver;
+        }
+    }
+    REQUIRE(gcm != nullptr);
+
+    // NIST SP 800-38D test case 14, and a 43-byte message cross-checked against OpenSSL.
+    struct Vector
+    {
+        QByteArray key;
+        QByteArray nonce;
+        QByteArray plaintext;
+        QByteArray sealed;
+    };
+    QByteArray sequentialKey(32, Qt::Uninitialized);
+    QByteArray sequentialNonce(12, Qt::Uninitialized);
+    for (int i = 0; i < 32; ++i)
+    {
+        sequentialKey[i] = static_cast<char>(i);
+    }
+    for (int i = 0; i < 12; ++i)
+    {
+        sequentialNonce[i] = static_cast<char>(0xa0 + i);
+    }
+    const Vector vectors[] = {
+        {QByteArray(32, '\0'), QByteArray(12, '\0'), QByteArray(16, '\0'),
+         QByteArray::fromHex("cea7403d4d606b6e074ec5d3baf39d18d0d1c8a799996bf0265b98b5d48ab919")},
+        {sequentialKey, sequentialNonce, QByteArray("The quick brown fox jumps over the lazy dog"),
+         QByteArray::fromHex("b270190d34be6bdc0945e5a1680daefe16c32130f8c22f1cef2e49f01ad95575ba136793ce582a1d3bf363"
+                             "af25a0aa0a8f7eef17336963402c1511")},
+    };
+    for (const Vector &vector : vectors)
+    {
+        QByteArray sealed(vector.plaintext.size() + 16, Qt::Uninitialized);
+        gcm->encryptSegment(asBytes(vector.plaintext), asWritableBytes(sealed), vector.key, asBytes(vector.nonce));
+        REQUIRE(sealed.toHex() == vector.sealed.toHex());
+        QByteArray opened(vector.plaintext.size(), Qt::Uninitialized);
+        gcm->decryptSegment(asBytes(sealed), asWritableBytes(opened), vector.key, asBytes(vector.nonce));
+        REQUIRE(opened == vector.plaintext);
+    }
+
+    auto key = generateSymmetricKey(256);
+    for (int size : {0, 1, 15, 16, 17, 1000, 70000})
+    {
+        QByteArray plaintext(size, Qt::Uninitialized);
+        for (int i = 0; i < size; ++i)
+        {
+            plaintext[i] = static_cast<char>(i * 13);
+        }
+        QByteArray cipher = manager.encryptSymmetric(gcm, plaintext, key);
+        REQUIRE(cipher.size() == size + 28);
+        REQUIRE(manager.decryptSymmetric(gcm, cipher, key) == plaintext);
+        cipher[cipher.size() / 2] = static_cast<char>(cipher.at(cipher.size() / 2) ^ 1);
+        REQUIRE_THROWS_AS(manager.decryptSymmetric(gcm, cipher, key), std::runtime_error);
+    }
+    REQUIRE_THROWS_AS(manager.encryptSymmetric(gcm, QByteArray("x"), generateSymmetricKey(128)), std::invalid_argument);
+
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    Storage storage;
+    QByteArray plaintext(5000, Qt::Uninitialized);
+    for (int i = 0; i < plaintext.size(); ++i)
+    {
+        plaintext[i] = static_cast<char>(i * 5);
+    }
+    const QString plainPath = dir.filePath(QStringLiteral("plain.bin"));
+    const QString vaultPath = dir.filePath(QStringLiteral("plain.bin.vault"));
+    const QString restoredPath = dir.filePath(QStringLiteral("restored.bin"));
+    storage.store(plainPath, plaintext);
+    manager.encryptFile(gcm, plainPath, vaultPath, key, nullptr, 7);
+    REQUIRE(manager.decryptSymmetric(gcm, storage.load(vaultPath), key) == plaintext);
+    manager.decryptFile(gcm, vaultPath, restoredPath, key, 5);
+    REQUIRE(storage.load(restoredPath) == plaintext);
+
+    QByteArray tampered = storage.load(vaultPath);
+    tampered[100] = static_cast<char>(tampered.at(100) ^ 0x40);
+    storage.store(vaultPath, tampered);
+    QFile::remove(restoredPath);
+    REQUIRE_THROWS(manager.decryptFile(gcm, vaultPath, restoredPath, key, 64));
+    REQUIRE_FALSE(QFile::exists(restoredPath));
+
+    VaultManager::SegmentOptions options;
+    options.segmentSize = 1024;
+    const QByteArray segmented = manager.encryptSegmented(gcm, plaintext, key, options);
+    REQUIRE(manager.decryptSegmented(gcm, segmented, key, options) == plaintext);
+}
+
+TEST_CASE("ChaCha20-Poly1305 driver matches OpenSSL and rejects tampering", "[plugin][chacha]")
+{
+    using dynamicencrypt::core::asBytes;
+    using dynamicencrypt::core::asWritableBytes;
+
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    dynamicencrypt::core::CryptoDriver *chacha = nullptr;
+    for (auto *driver : manager.drivers())
+    {
+        if (driver->name() == QStringLiteral("ChaCha20-Poly1305"))
+        {
+            chacha = driver;
+        }
+    }
+    REQUIRE(chacha != nullptr);
+
+    QByteArray sequentialKey(32, Qt::Uninitialized);
+    QByteArray sequentialNonce(12, Qt::Uninitialized);
+    for (int i = 0; i < 32; ++i)
+    {
+        sequentialKey[i] = static_cast<char>(i);
+    }
+    for (int i = 0; i < 12; ++i)
+    {
+        sequentialNonce[i] = static_cast<char>(0xa0 + i);
+    }
+    QByteArray patterned(5000, Qt::Uninitialized);
+    for (int i = 0; i < patterned.size(); ++i)
+    {
+        patterned[i] = static_cast<char>(i * 13);
+    }
+    const auto seal = [&](const QByteArray &key, const QByteArray &nonce, const QByteArray &plaintext)
+    {
+        QByteArray sealed(plaintext.size() + 16, Qt::Uninitialized);
+        chacha->encryptSegment(asBytes(plaintext), asWritableBytes(sealed), key, asBytes(nonce));
+        QByteArray opened(plaintext.size(), Qt::Uninitialized);
+        chacha->decryptSegment(asBytes(sealed), asWritableBytes(opened), key, asBytes(nonce));
+        REQUIRE(opened == plaintext);
+        return sealed;
+    };
+
+    // Expected outputs from OpenSSL's EVP_chacha20_poly1305 with no associated data. The first
+    // keystream block matches RFC 8439 A.1 test vector #2. The 5000-byte message runs every SIMD width.
+    REQUIRE(seal(QByteArray(32, '\0'), QByteArray(12, '\0'), QByteArray(16, '\0')).toHex() ==
+            "9f07e7be5551387a98ba977c732d080dc34a88047320f52aa2c6683ef8084d2f");
+    REQUIRE(seal(sequentialKey, sequentialNonce, QByteArray("The quick brown fox jumps over the lazy dog")).toHex() ==
+            "58c31d7f3c93abcecb2f9166938d93dbfb31ab9f291f0dd3c7f8b4c71410e378"
+            "04e536e6cfb386aaa2a392abce7e3e15f4cd31353304b0e6d23425");
+    REQUIRE(QCryptographicHash::hash(seal(sequentialKey, sequentialNonce, patterned), QCryptographicHash::Sha256)
+                .toHex() == "75aafc5c889d2b782e76c663eabedc868b67392db70ffd278eb2e0c11aa02dcb");
+
+    auto key = generateSymmetricKey(256);
+    const QByteArray longPattern = patterned.repeated(14);
+    for (int size : {0, 1, 63, 64, 65, 1000, 70000})
+    {
+        const QByteArray plaintext = longPattern.left(size);
+        QByteArray cipher = manager.encryptSymmetric(chacha, plaintext, key);
+        REQUIRE(cipher.size() == size + 28);
+        REQUIRE(manager.decryptSymmetric(chacha, cipher, key) == plaintext);
+        cipher[cipher.size() / 2] = static_cast<char>(cipher.at(cipher.size() / 2) ^ 1);
+        REQUIRE_THROWS_AS(manager.decryptSymmetric(chacha, cipher, key), std::runtime_error);
+    }
+    REQUIRE_THROWS_AS(manager.encryptSymmetric(chacha, QByteArray("x"), generateSymmetricKey(128)),
+                      std::invalid_argument);
+
+    // Odd chunk sizes keep the streaming contexts off block boundaries.
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    Storage storage;
+    const QString plainPath = dir.filePath(QStringLiteral("plain.bin"));
+    const QString vaultPath = dir.filePath(QStringLiteral("plain.bin.vault"));
+    const QString restoredPath = dir.filePath(QStringLiteral("restored.bin"));
+    storage.store(plainPath, patterned);
+    manager.encryptFile(chacha, plainPath, vaultPath, key, nullptr, 7);
+    REQUIRE(manager.decryptSymmetric(chacha, storage.load(vaultPath), key) == patterned);
+    manager.decryptFile(chacha, vaultPath, restoredPath, key, 1000);
+    REQUIRE(storage.load(restoredPath) == patterned);
+
+    QByteArray tampered = storage.load(vaultPath);
+    tampered[tampered.size() - 1] = static_cast<char>(tampered.at(tampered.size() - 1) ^ 0x01);
+    storage.store(vaultPath, tampered);
+    QFile::remove(restoredPath);
+    REQUIRE_THROWS(manager.decryptFile(chacha, vaultPath, restoredPath, key, 64));
+    REQUIRE_FALSE(QFile::exists(restoredPath));
+}
+
+TEST_CASE("Plugin discovery serves cached metadata and loads libraries on first use", "[plugin][lazy]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString cacheFile = dir.filePath(QStringLiteral("plugin-cache.json"));
+    const QStringList searchPaths{QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))};
+    const auto isLoaded = [](dynamicencrypt::core::CryptoDriver *driver)
+    { return dynamic_cast<dynamicencrypt::core::LazyDriver &>(*driver).isLoaded(); };
+
+    VaultManager cold;
+    cold.pluginCache().setFilePath(cacheFile);
+    cold.discoverPlugins(searchPaths);
+    const auto descriptors = cold.pluginDescriptors();
+    REQUIRE(descriptors.size() >= 3);
+    REQUIRE(cold.pluginCache().misses() >= static_cast<int>(descriptors.size()));
+    REQUIRE(QFile::exists(cacheFile));
+    for (auto *driver : cold.drivers())
+    {
+        REQUIRE_FALSE(isLoaded(driver));
+    }
+
+    VaultManager warm;
+    warm.pluginCache().setFilePath(cacheFile);
+    warm.discoverPlugins(searchPaths);
+    REQUIRE(warm.pluginCache().misses() == 0);
+    const auto drivers = warm.drivers();
+    REQUIRE(drivers.size() == descriptors.size());
+    dynamicencrypt::core::CryptoDriver *gcm = nullptr;
+    for (std::size_t i = 0; i < drivers.size(); ++i)
+    {
+        REQUIRE(drivers[i]->name() == descriptors[i].name);
+        REQUIRE(drivers[i]->version() == descriptors[i].version);
+        if (descriptors[i].name == QStringLiteral("AES-256-GCM"))
+        {
+            REQUIRE(descriptors[i].capabilities.tags.contains(QStringLiteral("aead")));
+            gcm = drivers[i];
+        }
+    }
+    REQUIRE(gcm != nullptr);
+    REQUIRE_FALSE(isLoaded(gcm));
+
+    auto key = generateSymmetricKey(256);
+    const QByteArray cipher = warm.encryptSymmetric(gcm, QByteArray("lazy"), key);
+    REQUIRE(warm.decryptSymmetric(gcm, cipher, key) == QByteArray("lazy"));
+    for (auto *driver : drivers)
+    {
+        REQUIRE(isLoaded(driver) == (driver == gcm));
+    }
+}
+
+TEST_CASE("Driver capabilities drive chunk sizing and driver preference", "[plugin][capabilities]")
+{
+    using dynamicencrypt::core::CpuFeatures;
+    using dynamicencrypt::core::PluginDescriptor;
+
+    const QJsonObject metaData = QJsonDocument::fromJson(R"({
+        "capabilities": ["aead"], "threadSafe": true, "chunkSize": 1000, "chunkAlignment": 64,
+        "simd": [{"tier": "wide", "requires": ["avx2"], "speedRank": 80}, {"tier": "scalar", "speedRank": 15}]
+    })").object();
+    CpuFeatures cpu;
+    REQUIRE(PluginDescriptor::parseCapabilities(metaData, cpu).simdTier == QStringLiteral("scalar"));
+    REQUIRE(PluginDescriptor::parseCapabilities(metaData, cpu).speedRank == 15);
+    cpu.avx2 = true;
+    const auto parsed = PluginDescriptor::parseCapabilities(metaData, cpu);
+    REQUIRE(parsed.simdTier == QStringLiteral("wide"));
+    REQUIRE(parsed.speedRank == 80);
+    REQUIRE(parsed.threadSafe);
+    REQUIRE_FALSE(parsed.streaming);
+    REQUIRE(parsed.chunkAlignment == 64);
+
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    dynamicencrypt::core::CryptoDriver *best = nullptr;
+    int bestRank = -1;
+    for (auto *driver : manager.drivers())
+    {
+        const auto capabilities = driver->capabilities();
+        REQUIRE(capabilities.threadSafe);
+        REQUIRE_FALSE(capabilities.simdTier.isEmpty());
+        const qsizetype chunk = VaultManager::chunkSizeFor(driver);
+        REQUIRE(chunk >= capabilities.chunkSize);
+        REQUIRE(chunk % capabilities.chunkAlignment == 0);
+        REQUIRE(VaultManager::chunkSizeFor(driver, 4096) == 4096);
+        if (capabilities.tags.contains(QStringLiteral("aead")) && capabilities.speedRank > bestRank)
+        {
+            best = driver;
+            bestRank = capabilities.speedRank;
+        }
+    }
+    REQUIRE(best != nullptr);
+    REQUIRE(manager.preferredDriver({{QStringLiteral("aead")}, true}) == best);
+    // The XOR demo ranks 0, so even without requirements a real cipher is preferred.
+    REQUIRE(manager.preferredDriver() == best);
+    REQUIRE(manager.preferredDriver({{QStringLiteral("no-such-capability")}}) == nullptr);
+}
+
+TEST_CASE("Prepared keys match raw-key results and stay bound to their driver", "[plugin][prepared]")
+{
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    const auto drivers = manager.drivers();
+    REQUIRE(drivers.size() >= 3);
+
+    auto key = generateSymmetricKey(256);
+    const QByteArray plaintext("prepared record");
+    std::vector<dynamicencrypt::core::KeyHandle> handles;
+    for (auto *driver : drivers)
+    {
+        const auto handle = manager.prepareKey(driver, key);
+        REQUIRE(handle.isValid());
+        const QByteArray cipher = manager.encryptSymmetric(handle, plaintext);
+        REQUIRE(manager.decryptSymmetric(driver, cipher, key) == plaintext);
+        REQUIRE(manager.decryptSymmetric(handle, manager.encryptSymmetric(driver, plaintext, key)) == plaintext);
+        handles.push_back(handle);
+    }
+    REQUIRE(manager.keyRegistry().size() == static_cast<qsizetype>(drivers.size()));
+
+    // A key prepared by one driver is rejected by another rather than misread.
+    const auto foreign = manager.keyRegistry().find(handles.back());
+    QByteArray out(plaintext.size() + 64, Qt::Uninitialized);
+    REQUIRE_THROWS_AS(drivers.front()->encrypt(dynamicencrypt::core::asBytes(plaintext),
+                                               dynamicencrypt::core::asWritableBytes(out), *foreign.key),
+                      std::invalid_argument);
+
+    // The default prepared key keeps a zeroizing copy that is wiped on release.
+    int wipes = 0;
+    ZeroizingBuffer::setOnWipe([&](const QByteArray &) { ++wipes; });
+    REQUIRE(manager.releaseKey(handles.front()));
+    ZeroizingBuffer::setOnWipe({});
+    REQUIRE(wipes == 1);
+    REQUIRE_FALSE(manager.releaseKey(handles.front()));
+    REQUIRE_THROWS_AS(manager.encryptSymmetric(handles.front(), plaintext), std::invalid_argument);
+
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    REQUIRE(manager.keyRegistry().size() == 0);
+}
+
+TEST_CASE("Secrets live in the secure arena and recycle without new mappings", "[zeroize][arena]")
+{
+    using dynamicencrypt::core::SecureArena;
+
+    // The calling thread's random buffer is itself an arena block; create it before counting.
+    dynamicencrypt::core::SecureRandom::bytes(1);
+    const auto before = SecureArena::stats();
+    {
+        auto key = generateSymmetricKey(256);
+        REQUIRE(SecureArena::stats().liveBlocks == before.liveBlocks + 1);
+        REQUIRE(SecureArena::capacity(key.raw().constData()) >= 32);
+
+        // materialize() copies out of the arena, so the copy survives the wipe.
+        const QByteArray copy = key.materialize();
+        REQUIRE(copy.constData() != key.raw().constData());
+        key.secureWipe();
+        REQUIRE(copy.size() == 32);
+        REQUIRE(key.raw().isEmpty());
+    }
+    REQUIRE(SecureArena::stats().liveBlocks == before.liveBlocks);
+
+    // Once a size class is warm, churn is served from its free list: no new slabs or mappings.
+    { ZeroizingBuffer warm(4096); }
+    const auto warmed = SecureArena::stats();
+    for (int i = 0; i < 1000; ++i)
+    {
+        ZeroizingBuffer buffer(4096);
+        REQUIRE(std::all_of(buffer.data(), buffer.data() + buffer.size(), [](char c) { return c == 0; }));
+        std::memset(buffer.data(), 0x5A, static_cast<std::size_t>(buffer.size()));
+    }
+    const auto after = SecureArena::stats();
+    REQUIRE(after.slabs == warmed.slabs);
+    REQUIRE(after.mappedBytes == warmed.mappedBytes);
+    REQUIRE(after.liveBlocks == warmed.liveBlocks);
+
+    // Blocks above the largest size class get, and give back, a mapping of their own.
+    {
+        ZeroizingBuffer large(static_cast<int>(SecureArena::kLargestClass) + 1);
+        REQUIRE(SecureArena::stats().mappedBytes > after.mappedBytes);
+    }
+    REQUIRE(SecureArena::stats().mappedBytes == after.mappedBytes);
+}
+
+TEST_CASE("Wipe telemetry counts every thread's wipes without a shared lock", "[zeroize][telemetry]")
+{
+    using dynamicencrypt::core::WipeTelemetry;
+
+    constexpr int kThreads = 8;
+    constexpr int kWipesPerThread = 1000;
+    std::atomic<int> observed{0};
+    std::atomic<bool> allZero{true};
+    const auto before = WipeTelemetry::totals();
+    WipeTelemetry::setObserver([&](std::span<const std::byte> wiped)
+                               {
+        observed.fetch_add(1, std::memory_order_relaxed);
+        if (!std::all_of(wiped.begin(), wiped.end(), [](std::byte b) { return b == std::byte{0}; }))
+        {
+            allZero = false;
+        } });
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t)
+    {
+        threads.emplace_back([]()
+                             {
+            for (int i = 0; i < kWipesPerThread; ++i)
+            {
+                ZeroizingBuffer buffer(QByteArray(64, 'k'));
+            } });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    WipeTelemetry::setObserver({});
+    { ZeroizingBuffer unobserved(QByteArray(64, 'k')); }
+
+    // The worker threads have exited, so their counts come from the retired totals.
+    const auto after = WipeTelemetry::totals();
+    REQUIRE(after.wipes - before.wipes == kThreads * kWipesPerThread + 1);
+    REQUIRE(after.bytes - before.bytes == (kThreads * kWipesPerThread + 1) * 64);
+    REQUIRE(observed == kThreads * kWipesPerThread);
+    REQUIRE(allZero);
+}
+
+
+TEST_CASE("Metrics count each operation once and split cipher from I/O time", "[metrics]")
+{
+    using dynamicencrypt::core::LatencyHistogram;
+
+    for (const qint64 nanos : {qint64{3}, qint64{900}, qint64{123456}, qint64{7000000000}})
+    {
+        const qint64 bucketValue = LatencyHistogram::valueOf(LatencyHistogram::bucketOf(nanos));
+        REQUIRE(std::abs(bucketValue - nanos) <= nanos / 16);
+    }
+
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    auto *driver = manager.driverNamed(QStringLiteral("Demo AES (XOR placeholder)"));
+    REQUIRE(driver);
+    auto key = generateSymmetricKey(256);
+    manager.resetMetrics();
+
+    auto metricsFor = [&](const dynamicencrypt::core::MetricsSnapshot &snapshot)
+    {
+        const auto it = std::find_if(snapshot.drivers.cbegin(), snapshot.drivers.cend(),
+                                     [&](const dynamicencrypt::core::DriverMetrics &d) { return d.driver == driver->name(); });
+        REQUIRE(it != snapshot.drivers.cend());
+        return *it;
+    };
+
+    const QByteArray plaintext(4096, 'm');
+    for (int i = 0; i < 10; ++i)
+    {
+        REQUIRE(manager.decryptSymmetric(driver, manager.encryptSymmetric(driver, plaintext, key), key) == plaintext);
+    }
+    const auto inMemory = manager.metrics();
+    const auto memoryOnly = metricsFor(inMemory);
+    // The QByteArray overloads delegate to the span overloads without being counted twice.
+    REQUIRE(memoryOnly.encrypt.operations == 10);
+    REQUIRE(memoryOnly.decrypt.operations == 10);
+    REQUIRE(memoryOnly.encrypt.bytesIn == 10 * 4096);
+    REQUIRE(memoryOnly.decrypt.bytesOut == 10 * 4096);
+    REQUIRE(memoryOnly.encrypt.ioNanos == 0);
+    REQUIRE(memoryOnly.encrypt.p50Nanos() > 0);
+    REQUIRE(memoryOnly.encrypt.p99Nanos() >= memoryOnly.encrypt.p50Nanos());
+
+    const QString plainPath = dir.filePath(QStringLiteral("plain.bin"));
+    manager.storage().store(plainPath, plaintext);
+    manager.encryptMappedFile(driver, plainPath, dir.filePath(QStringLiteral("plain.bin.vault")), key);
+    const auto withFile = manager.metrics();
+    const auto fileDelta = metricsFor(withFile.since(inMemory));
+    REQUIRE(fileDelta.encrypt.operations == 1);
+    REQUIRE(fileDelta.encrypt.ioNanos > 0);
+    REQUIRE(withFile.storage.writes == 2);
+    REQUIRE(withFile.storage.bytesRead == 4096);
+
+    const QJsonObject json = withFile.toJson();
+    REQUIRE(json.value(QStringLiteral("drivers")).toObject().value(driver->name()).toObject()
+                .value(QStringLiteral("encrypt")).toObject().value(QStringLiteral("operations")).toInteger() == 11);
+
+    // Counters follow the driver's name across rediscovery.
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    driver = manager.driverNamed(QStringLiteral("Demo AES (XOR placeholder)"));
+    REQUIRE(driver);
+    manager.encryptSymmetric(driver, plaintext, key);
+    REQUIRE(metricsFor(manager.metrics()).encrypt.operations == 12);
+    REQUIRE(manager.metrics().drivers.size() == withFile.drivers.size());
+}
+
+TEST_CASE("Directory trees encrypt on a work-stealing pool and land in the vault in batches", "[vault][directory]")
+{
+    using dynamicencrypt::core::DirectoryEncryptor;
+    using dynamicencrypt::core::DirectoryJobOptions;
+    using dynamicencrypt::core::WorkStealingPool;
+
+    {
+        // Tasks spawned from workers all run before wait() returns; an escaped exception is rethrown.
+        WorkStealingPool pool(4);
+        std::atomic<int> leaves{0};
+        std::function<void(int)> spawn = [&](int depth)
+        {
+            if (depth == 0)
+            {
+                ++leaves;
+                return;
+            }
+            pool.submit([&, depth]() { spawn(depth - 1); });
+            pool.submit([&, depth]() { spawn(depth - 1); });
+        };
+        pool.submit([&]() { spawn(10); });
+        pool.wait();
+        REQUIRE(leaves == 1024);
+        pool.submit([]() { throw std::runtime_error("task failed"); });
+        REQUIRE_THROWS_AS(pool.wait(), std::runtime_error);
+        pool.wait();
+    }
+
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    auto *driver = manager.preferredDriver();
+    REQUIRE(driver);
+    manager.setStorageDirectory(dir.filePath(QStringLiteral("vault")));
+    manager.snapshot();
+
+    const QDir source(dir.filePath(QStringLiteral("tree")));
+    int files = 0;
+    for (int a = 0; a < 4; ++a)
+    {
+        for (int b = 0; b < 3; ++b)
+        {
+            const QString sub = QStringLiteral("d%1/e%2").arg(a).arg(b);
+            REQUIRE(source.mkpath(sub));
+            for (int f = 0; f < 5; ++f, ++files)
+            {
+                manager.storage().store(source.filePath(QStringLiteral("%1/f%2.txt").arg(sub).arg(f)),
+                                        QByteArray(100 + files, static_cast<char>('a' + f)));
+            }
+        }
+    }
+    const QByteArray large(4 << 20, 'L');
+    manager.storage().store(source.filePath(QStringLiteral("large.bin")), large);
+    ++files;
+
+    // Emitted on the worker threads.
+    std::atomic<int> batches{0};
+    QObject::connect(&manager, &VaultManager::entriesInserted, [&](qsizetype, qsizetype) { ++batches; });
+    QObject::connect(&manager, &VaultManager::entryInserted, [&](qsizetype) { ++batches; });
+    std::atomic<qint64> lastDone{0};
+    std::atomic_bool ordered{true};
+    dynamicencrypt::core::JobControl control;
+    control.progress = [&](qint64 done, qint64 total)
+    {
+        if (done > total || done != lastDone + 1)
+        {
+            ordered = false;
+        }
+        lastDone = done;
+    };
+
+    DirectoryJobOptions options;
+    options.threadCount = 4;
+    options.batchSize = 8;
+    auto key = generateSymmetricKey(256);
+    const QString output = dir.filePath(QStringLiteral("vault/tree"));
+    const auto result = DirectoryEncryptor(manager, options).encryptTree(driver, source.path(), output, key, control);
+
+    REQUIRE(result.failures.empty());
+    REQUIRE(result.files == files);
+    REQUIRE(result.directories == 1 + 4 + 4 * 3);
+    REQUIRE(ordered);
+    REQUIRE(lastDone == files);
+    REQUIRE(manager.entryCount() == files);
+    // Entries arrive in batches of up to batchSize per worker, not one write per file.
+    REQUIRE(batches < files / 2);
+    REQUIRE(manager.snapshot()->size() == files);
+
+    const QString restored = dir.filePath(QStringLiteral("large.out"));
+    // Each file has its own data key, so decrypting goes through the vault entry.
+    manager.decryptEntry(*manager.findEntry(QDir(output).filePath(QStringLiteral("large.bin.vault"))), restored, key);
+    REQUIRE(manager.storage().load(restored) == large);
+    const QString small = QDir(output).filePath(QStringLiteral("d2/e1/f3.txt.vault"));
+    manager.decryptEntry(*manager.findEntry(small), restored, key);
+    REQUIRE(manager.storage().load(restored) == manager.storage().load(source.filePath(QStringLiteral("d2/e1/f3.txt"))));
+    REQUIRE(manager.index().indexOf(small) >= 0);
+
+    // An output tree inside the source is skipped rather than encrypted into itself.
+    const auto nested = DirectoryEncryptor(manager, options)
+                            .encryptTree(driver, source.path(), source.filePath(QStringLiteral("out")), key);
+    REQUIRE(nested.files == files);
+    REQUIRE_THROWS_AS(DirectoryEncryptor(manager).encryptTree(driver, source.path(), source.path(), key),
+                      std::invalid_argument);
+}
+
+TEST_CASE("Vault queries by path, algorithm and time range match a full scan", "[vault][query]")
+{
+    using dynamicencrypt::core::EntryQuery;
+    using dynamicencrypt::core::VaultEntry;
+
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    VaultManager manager;
+    manager.setStorageDirectory(dir.path());
+
+    const QDateTime epoch = QDateTime::fromMSecsSinceEpoch(1704067200000, QTimeZone::UTC);
+    const QStringList algorithms{QStringLiteral("AES-GCM"), QStringLiteral("ChaCha20-Poly1305"), QStringLiteral("XOR")};
+    std::vector<VaultEntry> batch;
+    for (int i = 0; i < 3000; ++i)
+    {
+        VaultEntry entry;
+        entry.originalPath = QStringLiteral("/data/file%1").arg(i % 500);
+        entry.storedPath = dir.filePath(QStringLiteral("%1.vault").arg(i));
+        entry.algorithm = algorithms[i % 3];
+        entry.timestamp = epoch.addSecs((i * 7919) % 3000);
+        batch.push_back(entry);
+    }
+    manager.addEntries(batch);
+    // Queried once so that later writes update the indexes instead of building them.
+    REQUIRE(manager.findEntry(batch.front().storedPath).has_value());
+    VaultEntry moved = batch[10];
+    moved.algorithm = QStringLiteral("XOR");
+    moved.timestamp = epoch.addSecs(-60);
+    manager.addEntry(moved);
+    REQUIRE(manager.removeEntry(batch[11].storedPath));
+
+    auto scan = [&](const EntryQuery &query)
+    {
+        std::vector<VaultEntry> matches;
+        manager.snapshot()->forEach([&](const VaultEntry &entry)
+                                    {
+            if ((query.originalPath.isEmpty() || entry.originalPath == query.originalPath) &&
+                (query.algorithm.isEmpty() || entry.algorithm == query.algorithm) &&
+                (!query.from.isValid() || entry.timestamp >= query.from) &&
+                (!query.until.isValid() || entry.timestamp < query.until))
+            {
+                matches.push_back(entry);
+            } });
+        std::sort(matches.begin(), matches.end(), [](const VaultEntry &a, const VaultEntry &b)
+                  { return a.timestamp != b.timestamp ? a.timestamp < b.timestamp : a.storedPath < b.storedPath; });
+        if (query.newestFirst)
+        {
+            std::reverse(matches.begin(), matches.end());
+        }
+        if (query.limit >= 0 && matches.size() > static_cast<std::size_t>(query.limit))
+        {
+            matches.resize(static_cast<std::size_t>(query.limit));
+        }
+        return matches;
+    };
+    auto storedPaths = [](const std::vector<VaultEntry> &entries)
+    {
+        QStringList paths;
+        for (const VaultEntry &entry : entries)
+        {
+            paths << entry.storedPath;
+        }
+        return paths;
+    };
+
+    std::vector<EntryQuery> queries(6);
+    queries[0].originalPath = QStringLiteral("/data/file10");
+    queries[1].algorithm = QStringLiteral("XOR");
+    queries[2].from = epoch.addSecs(100);
+    queries[2].until = epoch.addSecs(400);
+    queries[3].algorithm = QStringLiteral("AES-GCM");
+    queries[3].from = epoch.addSecs(2000);
+    queries[3].newestFirst = true;
+    queries[3].limit = 25;
+    queries[4].originalPath = QStringLiteral("/data/file11");
+    queries[4].algorithm = QStringLiteral("ChaCha20-Poly1305");
+    queries[5].until = epoch;
+    for (const EntryQuery &query : queries)
+    {
+        const auto expected = scan(query);
+        REQUIRE_FALSE(expected.empty());
+        REQUIRE(storedPaths(manager.findEntries(query)) == storedPaths(expected));
+    }
+    REQUIRE(manager.findEntries(queries[5]).front().storedPath == moved.storedPath);
+    REQUIRE(manager.findEntries({QString(), QStringLiteral("missing")}).empty());
+
+    REQUIRE_FALSE(manager.findEntry(batch[11].storedPath).has_value());
+    REQUIRE(manager.findEntry(moved.storedPath)->algorithm == QStringLiteral("XOR"));
+    const auto counts = manager.algorithmCounts();
+    REQUIRE(counts.value(QStringLiteral("XOR")) == 1000);
+    REQUIRE(counts.value(QStringLiteral("AES-GCM")) + counts.value(QStringLiteral("ChaCha20-Poly1305")) == 1999);
+    REQUIRE(manager.entryAt(manager.positionOf(moved.storedPath)).storedPath == moved.storedPath);
+    REQUIRE(manager.positionOf(batch[11].storedPath) == -1);
+
+    // Switching vaults drops the indexes along with the entries.
+    QTemporaryDir other;
+    REQUIRE(other.isValid());
+    manager.setStorageDirectory(other.path());
+    REQUIRE(manager.findEntries({}).empty());
+}
+
+TEST_CASE("Repeated directory passes re-encrypt only files the change cache sees as modified", "[vault][directory][cache]")
+{
+    using dynamicencrypt::core::ChangeCache;
+    using dynamicencrypt::core::DirectoryEncryptor;
+    using dynamicencrypt::core::DirectoryJobOptions;
+    using dynamicencrypt::core::FileSignature;
+
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString vault = dir.filePath(QStringLiteral("vault"));
+    const QString pluginDir = QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"));
+    auto manager = std::make_unique<VaultManager>();
+    manager->discoverPlugins({pluginDir});
+    auto *driver = manager->preferredDriver();
+    REQUIRE(driver);
+    manager->setStorageDirectory(vault);
+
+    const QDir source(dir.filePath(QStringLiteral("tree")));
+    REQUIRE(source.mkpath(QStringLiteral("sub")));
+    const int files = 12;
+    for (int i = 0; i < files; ++i)
+    {
+        const QString name = QStringLiteral("f%1.txt").arg(i);
+        manager->storage().store(source.filePath(i % 2 ? QStringLiteral("sub/") + name : name),
+                                 QByteArray(200 + i, static_cast<char>('a' + i)));
+    }
+    const QString edited = source.filePath(QStringLiteral("sub/f3.txt"));
+    const QString touched = source.filePath(QStringLiteral("f4.txt"));
+    const FileSignature before = FileSignature::of(touched);
+    REQUIRE(before.size == 204);
+    REQUIRE(FileSignature::of(source.filePath(QStringLiteral("missing"))).size == -1);
+
+    DirectoryJobOptions options;
+    options.threadCount = 4;
+    auto key = generateSymmetricKey(256);
+    const QString output = QDir(vault).filePath(QStringLiteral("tree"));
+    auto pass = [&](const DirectoryJobOptions &opts, const Key<SymmetricKeyTag> &k, const QString &out)
+    { return DirectoryEncryptor(*manager, opts).encryptTree(driver, source.path(), out, k); };
+
+    auto result = pass(options, key, output);
+    REQUIRE(result.files == files);
+    REQUIRE(result.unchanged == 0);
+    REQUIRE(manager->changeCache().size() == files);
+    REQUIRE(QFileInfo::exists(QDir(vault).filePath(QString::fromLatin1(ChangeCache::kFileName))));
+
+    result = pass(options, key, output);
+    REQUIRE(result.files == 0);
+    REQUIRE(result.unchanged == files);
+    REQUIRE(manager->entryCount() == files);
+
+    // A modified file is encrypted again, and its new content is what the vault holds.
+    const QByteArray changed("edited since the last pass");
+    manager->storage().store(edited, changed);
+    result = pass(options, key, output);
+    REQUIRE(result.files == 1);
+    REQUIRE(result.unchanged == files - 1);
+    const QString restored = dir.filePath(QStringLiteral("restored"));
+    manager->decryptEntry(*manager->findEntry(QDir(output).filePath(QStringLiteral("sub/f3.txt.vault"))), restored, key);
+    REQUIRE(manager->storage().load(restored) == changed);
+
+    // With content hashes recorded, a file whose mtime moved but whose bytes did not is still skipped.
+    DirectoryJobOptions hashed = options;
+    hashed.changeDetection = DirectoryJobOptions::ChangeDetection::ContentHash;
+    const QString hashedOutput = QDir(vault).filePath(QStringLiteral("hashed"));
+    REQUIRE(pass(hashed, key, hashedOutput).files == files);
+    {
+        QFile file(touched);
+        REQUIRE(file.open(QIODevice::ReadWrite));
+        REQUIRE(file.setFileTime(QDateTime::currentDateTimeUtc().addSecs(60), QFileDevice::FileModificationTime));
+    }
+    REQUIRE_FALSE(FileSignature::of(touched) == before);
+    result = pass(hashed, key, hashedOutput);
+    REQUIRE(result.files == 0);
+    REQUIRE(result.unchanged == files);
+    // The skip refreshed the cached signature, so metadata is enough from here on.
+    REQUIRE(pass(options, key, hashedOutput).unchanged == files);
+
+    // Another key, or detection turned off, encrypts everything.
+    auto otherKey = generateSymmetricKey(256);
+    REQUIRE(pass(options, otherKey, hashedOutput).files == files);
+    DirectoryJobOptions off = options;
+    off.changeDetection = DirectoryJobOptions::ChangeDetection::Off;
+    REQUIRE(pass(off, otherKey, hashedOutput).files == files);
+
+    // A deleted source file loses its record, and the cache survives reopening the vault.
+    REQUIRE(QFile::remove(source.filePath(QStringLiteral("f0.txt"))));
+    REQUIRE(pass(options, otherKey, hashedOutput).unchanged == files - 1);
+    REQUIRE(manager->changeCache().size() == files - 1);
+    manager = std::make_unique<VaultManager>();
+    manager->discoverPlugins({pluginDir});
+    driver = manager->preferredDriver();
+    manager->setStorageDirectory(vault);
+    REQUIRE(manager->changeCache().size() == files - 1);
+    result = pass(options, otherKey, hashedOutput);
+    REQUIRE(result.files == 0);
+    REQUIRE(result.unchanged == files - 1);
+}
+
+TEST_CASE("Master key rotation rewraps data keys and leaves payloads untouched", "[vault][envelope]")
+{
+    using dynamicencrypt::core::DirectoryEncryptor;
+    using dynamicencrypt::core::KeyRotator;
+    using dynamicencrypt::core::OperationCancelled;
+
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString vault = dir.filePath(QStringLiteral("vault"));
+    const QString pluginDir = QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"));
+    auto manager = std::make_unique<VaultManager>();
+    manager->discoverPlugins({pluginDir});
+    auto *driver = manager->preferredDriver();
+    REQUIRE(driver);
+    manager->setStorageDirectory(vault);
+
+    auto oldKey = generateSymmetricKey(256);
+    auto newKey = generateSymmetricKey(256);
+    QByteArray wrapped;
+    const auto dataKey = VaultManager::createDataKey(driver, oldKey, &wrapped);
+    REQUIRE(VaultManager::isWrappedUnder(wrapped, oldKey));
+    REQUIRE_FALSE(VaultManager::isWrappedUnder(wrapped, newKey));
+    REQUIRE(VaultManager::unwrapDataKey(driver, wrapped, oldKey).raw() == dataKey.raw());
+    REQUIRE_THROWS_AS(VaultManager::unwrapDataKey(driver, wrapped, newKey), std::runtime_error);
+
+    const QDir source(dir.filePath(QStringLiteral("tree")));
+    REQUIRE(source.mkpath(QStringLiteral(".")));
+    const int files = 20;
+    for (int i = 0; i < files; ++i)
+    {
+        manager->storage().store(source.filePath(QStringLiteral("f%1.bin").arg(i)), QByteArray((i + 1) * 4096, static_cast<char>(i)));
+    }
+    const QString output = QDir(vault).filePath(QStringLiteral("tree"));
+    REQUIRE(DirectoryEncryptor(*manager).encryptTree(driver, source.path(), output, oldKey).files == files);
+    // An entry from before envelopes, encrypted with the master key itself.
+    const QString legacy = QDir(vault).filePath(QStringLiteral("legacy.vault"));
+    manager->encryptFile(driver, source.filePath(QStringLiteral("f0.bin")), legacy, oldKey);
+    manager->addEntry({source.filePath(QStringLiteral("f0.bin")), legacy, driver->name(), {}, QDateTime::currentDateTimeUtc()});
+
+    std::vector<QByteArray> payloads;
+    std::vector<QByteArray> oldWrapped;
+    for (const auto &entry : manager->entries())
+    {
+        payloads.push_back(manager->storage().load(entry.storedPath));
+        if (!entry.wrappedKey.isEmpty())
+        {
+            oldWrapped.push_back(entry.wrappedKey);
+        }
+    }
+    REQUIRE(oldWrapped.size() == static_cast<std::size_t>(files));
+    manager->resetMetrics();
+    auto result = KeyRotator(*manager).rotate(oldKey, newKey);
+    REQUIRE(result.failures.empty());
+    REQUIRE(result.rewrapped == files);
+    REQUIRE(result.direct == 1);
+    // The old wrapped keys must be gone from the index file, not just superseded.
+    {
+        QFile index(QDir(vault).filePath(QString::fromLatin1(VaultManager::kIndexFileName)));
+        REQUIRE(index.open(QIODevice::ReadOnly));
+        const QByteArray raw = index.readAll();
+        for (const QByteArray &wrappedKey : oldWrapped)
+        {
+            REQUIRE_FALSE(raw.contains(wrappedKey));
+        }
+    }
+    // No payload was read, rewritten or counted as cipher work.
+    const auto metrics = manager->metrics();
+    REQUIRE(metrics.storage.bytesRead == 0);
+    REQUIRE(std::all_of(metrics.drivers.cbegin(), metrics.drivers.cend(), [](const auto &entry)
+                        { return entry.encrypt.operations == 0 && entry.decrypt.operations == 0; }));
+    for (std::size_t i = 0; i < payloads.size(); ++i)
+    {
+        REQUIRE(manager->storage().load(manager->entryAt(static_cast<qsizetype>(i)).storedPath) == payloads[i]);
+    }
+
+    const QString restored = dir.filePath(QStringLiteral("restored"));
+    const auto sample = *manager->findEntry(QDir(output).filePath(QStringLiteral("f7.bin.vault")));
+    REQUIRE_THROWS_AS(manager->decryptEntry(sample, restored, oldKey), std::runtime_error);
+    manager->decryptEntry(sample, restored, newKey);
+    REQUIRE(manager->storage().load(restored) == manager->storage().load(source.filePath(QStringLiteral("f7.bin"))));
+    // The change cache follows the rotation, so a pass with the new key still finds nothing to do.
+    REQUIRE(DirectoryEncryptor(*manager).encryptTree(driver, source.path(), output, newKey).unchanged == files);
+
+    // The rotation is persisted, and repeating it finds every entry current.
+    manager = std::make_unique<VaultManager>();
+    manager->discoverPlugins({pluginDir});
+    manager->setStorageDirectory(vault);
+    REQUIRE(VaultManager::isWrappedUnder(manager->findEntry(sample.storedPath)->wrappedKey, newKey));
+    result = KeyRotator(*manager).rotate(oldKey, newKey);
+    REQUIRE(result.rewrapped == 0);
+    REQUIRE(result.current == files);
+
+    // A cancelled rotation keeps its finished batches, and a second run completes the rest.
+    auto nextKey = generateSymmetricKey(256);
+    std::atomic_bool cancelled{false};
+    dynamicencrypt::core::JobControl control;
+    control.cancelled = &cancelled;
+    control.progress = [&](qint64 done, qint64) { cancelled = done >= 10; };
+    REQUIRE_THROWS_AS(KeyRotator(*manager, 4).rotate(newKey, nextKey, control), OperationCancelled);
+    result = KeyRotator(*manager, 4).rotate(newKey, nextKey);
+    REQUIRE(result.current > 0);
+    REQUIRE(result.rewrapped > 0);
+    REQUIRE(result.current + result.rewrapped == files);
+    REQUIRE_THROWS_AS(KeyRotator(*manager).rotate(nextKey, nextKey), std::invalid_argument);
+}
+
+TEST_CASE("Vault scrub verifies stored files against their digests in parallel", "[vault][scrub]")
+{
+    using dynamicencrypt::core::DirectoryEncryptor;
+    using dynamicencrypt::core::OperationCancelled;
+    using dynamicencrypt::core::ScrubOptions;
+    using dynamicencrypt::core::ScrubResult;
+    using dynamicencrypt::core::VaultEntry;
+    using dynamicencrypt::core::VaultScrubber;
+
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    VaultManager manager;
+    manager.discoverPlugins({QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("plugins"))});
+    auto *driver = manager.preferredDriver();
+    REQUIRE(driver);
+    const QString vault = dir.filePath(QStringLiteral("vault"));
+    manager.setStorageDirectory(vault);
+
+    const QDir source(dir.filePath(QStringLiteral("tree")));
+    REQUIRE(source.mkpath(QStringLiteral("sub")));
+    const int files = 30;
+    for (int i = 0; i < files; ++i)
+    {
+        manager.storage().store(source.filePath(QStringLiteral("sub/f%1.bin").arg(i)), QByteArray(1000 * i, static_cast<char>(i)));
+    }
+    manager.storage().store(source.filePath(QStringLiteral("large.bin")), QByteArray(3 << 20, 'L'));
+    auto key = generateSymmetricKey(256);
+    const QString output = QDir(vault).filePath(QStringLiteral("tree"));
+    REQUIRE(DirectoryEncryptor(manager).encryptTree(driver, source.path(), output, key).files == files + 1);
+    // An entry recorded without a digest.
+    const QString legacy = QDir(vault).filePath(QStringLiteral("legacy.vault"));
+    manager.encryptFile(driver, source.filePath(QStringLiteral("large.bin")), legacy, key);
+    manager.addEntry({source.filePath(QStringLiteral("large.bin")), legacy, driver->name(), {}, QDateTime::currentDateTimeUtc()});
+
+    qint64 stored = 0;
+    for (const auto &entry : manager.entries())
+    {
+        stored += QFileInfo(entry.storedPath).size();
+        if (entry.storedPath != legacy)
+        {
+            REQUIRE(entry.digest == QCryptographicHash::hash(manager.storage().load(entry.storedPath), VaultManager::kDigestAlgorithm));
+        }
+    }
+
+    ScrubOptions options;
+    options.threadCount = 4;
+    options.maxConcurrentReads = 2;
+    options.readSize = 64 << 10;
+    std::atomic<qint64> lastDone{0};
+    std::atomic_bool ordered{true};
+    dynamicencrypt::core::JobControl control;
+    control.progress = [&](qint64 done, qint64 total)
+    {
+        if (done < lastDone || done > total || total != stored)
+        {
+            ordered = false;
+        }
+        lastDone = done;
+    };
+    // The index lock held for the session is bookkeeping, not an untracked file.
+    REQUIRE(QFileInfo::exists(dynamicencrypt::core::VaultIndex::lockPath(
+        QDir(vault).filePath(QString::fromLatin1(VaultManager::kIndexFileName)))));
+    manager.resetMetrics();
+    auto result = VaultScrubber(manager, options).scrub(control);
+    REQUIRE(result.clean());
+    REQUIRE(result.issues.empty());
+    REQUIRE(result.files == files + 2);
+    REQUIRE(result.verified == files + 1);
+    REQUIRE(result.unverified == 1);
+    REQUIRE(result.bytes == stored);
+    REQUIRE(lastDone == stored);
+    REQUIRE(ordered);
+    REQUIRE(result.bytesPerSecond() > 0);
+    REQUIRE(manager.metrics().storage.bytesRead == static_cast<quint64>(stored));
+
+    // One flipped byte, one deleted file and one stray file are each reported.
+    const QString corrupted = QDir(output).filePath(QStringLiteral("sub/f7.bin.vault"));
+    const QString deleted = QDir(output).filePath(QStringLiteral("sub/f9.bin.vault"));
+    const QString stray = QDir(vault).filePath(QStringLiteral("stray.bin"));
+    {
+        QFile file(corrupted);
+        REQUIRE(file.open(QIODevice::ReadWrite));
+        REQUIRE(file.seek(100));
+        char byte = 0;
+        REQUIRE(file.getChar(&byte));
+        REQUIRE(file.seek(100));
+        REQUIRE(file.putChar(static_cast<char>(byte ^ 0x01)));
+    }
+    REQUIRE(QFile::remove(deleted));
+    manager.storage().store(stray, QByteArray("not in the vault"));
+    options.maxConcurrentReads = 1;
+    result = VaultScrubber(manager, options).scrub();
+    REQUIRE_FALSE(result.clean());
+    REQUIRE(result.verified == files - 1);
+    REQUIRE(result.issues.size() == 3);
+    auto problemAt = [&](const QString &path)
+    {
+        for (const ScrubResult::Issue &issue : result.issues)
+        {
+            if (QDir::cleanPath(issue.path) == QDir::cleanPath(path))
+            {
+                return issue.problem;
+            }
+        }
+        FAIL("no issue for " << path.toStdString());
+        return ScrubResult::Problem::Untracked;
+    };
+    REQUIRE(problemAt(corrupted) == ScrubResult::Problem::Corrupt);
+    REQUIRE(problemAt(deleted) == ScrubResult::Problem::Missing);
+    REQUIRE(problemAt(stray) == ScrubResult::Problem::Untracked);
+
+    // Entries without a digest can be given the one of their current content, unless the entry is written
+    // again while the scrub runs: its hash is then of a payload the entry no longer describes.
+    options.recordMissingDigests = true;
+    const VaultEntry recorded = *manager.findEntry(legacy);
+    VaultEntry rewritten = recorded;
+    rewritten.nonce = QByteArray(12, 'n');
+    rewritten.timestamp = recorded.timestamp.addSecs(1);
+    std::atomic_bool written{false};
+    dynamicencrypt::core::JobControl writing;
+    writing.progress = [&](qint64, qint64)
+    {
+        if (!written.exchange(true))
+        {
+            manager.addEntry(rewritten);
+        }
+    };
+    REQUIRE(VaultScrubber(manager, options).scrub(writing).unverified == 1);
+    REQUIRE(written);
+    REQUIRE(manager.findEntry(legacy)->nonce == rewritten.nonce);
+    REQUIRE(manager.findEntry(legacy)->digest.isEmpty());
+    manager.addEntry(recorded);
+    REQUIRE(VaultScrubber(manager, options).scrub().unverified == 1);
+    REQUIRE_FALSE(manager.findEntry(legacy)->digest.isEmpty());
+    REQUIRE(VaultScrubber(manager, options).scrub().unverified == 0);
+
+    std::atomic_bool cancelled{false};
+    dynamicencrypt::core::JobControl cancelling;
+    cancelling.cancelled = &cancelled;
+    cancelling.progress = [&](qint64, qint64) { cancelled = true; };
+    REQUIRE_THROWS_AS(VaultScrubber(manager, options).scrub(cancelling), OperationCancelled);
+    REQUIRE_THROWS_AS(VaultScrubber(manager, ScrubOptions{0, 0}), std::invalid_argument);
+}
+
+TEST_CASE("Command line encrypts, decrypts and reports exit codes", "[cli]")
+{
+    const QString binDir = QCoreApplication::applicationDirPath();
+    const QString cli = QStandardPaths::findExecutable(QStringLiteral("dynamicencrypt-cli"), {binDir});
+    REQUIRE_FALSE(cli.isEmpty());
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QDir root(dir.path());
+
+    // A private home shows whether a command touched the default vault under Documents.
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert(QStringLiteral("HOME"), root.filePath(QStringLiteral("home")));
+    environment.insert(QStringLiteral("XDG_CONFIG_HOME"), root.filePath(QStringLiteral("home/.config")));
+    auto run = [&](QStringList arguments)
+    {
+        arguments.prepend(QDir(binDir).filePath(QStringLiteral("plugins")));
+        arguments.prepend(QStringLiteral("--plugins"));
+        QProcess process;
+        process.setProcessEnvironment(environment);
+        process.start(cli, arguments);
+        REQUIRE(process.waitForFinished(60000));
+        REQUIRE(process.exitStatus() == QProcess::NormalExit);
+        return process.exitCode();
+    };
+
+    Storage storage;
+    const QString keyFile = root.filePath(QStringLiteral("master.key"));
+    const QString otherKeyFile = root.filePath(QStringLiteral("other.key"));
+    storage.store(keyFile, QByteArray(32, '\x11'));
+    storage.store(otherKeyFile, QByteArray(32, '\x22'));
+    const QByteArray content = QByteArray("command line payload ").repeated(4096);
+    const QString plain = root.filePath(QStringLiteral("plain.txt"));
+    storage.store(plain, content);
+    const QString restored = root.filePath(QStringLiteral("restored"));
+
+    REQUIRE(run({QStringLiteral("--list-drivers")}) == 0);
+    REQUIRE(run({QStringLiteral("-k"), keyFile, QStringLiteral("encrypt"), plain}) == 0);
+    const QString encrypted = plain + QStringLiteral(".vault");
+    REQUIRE(QFileInfo::exists(encrypted));
+    REQUIRE(storage.load(encrypted) != content);
+    REQUIRE(run({QStringLiteral("-k"), keyFile, QStringLiteral("decrypt"), encrypted, QStringLiteral("-o"), restored}) == 0);
+    REQUIRE(storage.load(QDir(restored).filePath(QStringLiteral("plain.txt"))) == content);
+
+    // The default driver authenticates, so the wrong key is a per-file failure.
+    REQUIRE(run({QStringLiteral("-k"), otherKeyFile, QStringLiteral("decrypt"), encrypted, QStringLiteral("-o"),
+                 root.filePath(QStringLiteral("wrong"))}) == 1);
+    REQUIRE(run({QStringLiteral("frobnicate"), plain}) == 2);
+    REQUIRE(run({QStringLiteral("encrypt"), plain}) == 2);
+    REQUIRE(run({QStringLiteral("-k"), keyFile, QStringLiteral("encrypt"), root.filePath(QStringLiteral("missing.txt"))}) == 2);
+
+    // With --vault the file becomes an entry with its own data key, found again on decrypt.
+    const QString vault = root.filePath(QStringLiteral("vault"));
+    const QString vaultOutput = root.filePath(QStringLiteral("vaulted"));
+    REQUIRE(run({QStringLiteral("-k"), keyFile, QStringLiteral("--vault"), vault, QStringLiteral("encrypt"), plain,
+                 QStringLiteral("-o"), vaultOutput}) == 0);
+    {
+        VaultManager manager(VaultManager::InitialVault::None);
+        manager.setStorageDirectory(vault);
+        REQUIRE(manager.entryCount() == 1);
+        REQUIRE_FALSE(manager.entryAt(0).wrappedKey.isEmpty());
+    }
+    const QString vaultRestored = root.filePath(QStringLiteral("vault-restored"));
+    REQUIRE(run({QStringLiteral("-k"), keyFile, QStringLiteral("--vault"), vault, QStringLiteral("decrypt"),
+                 QDir(vaultOutput).filePath(QStringLiteral("plain.txt.vault")), QStringLiteral("-o"), vaultRestored}) == 0);
+    REQUIRE(storage.load(QDir(vaultRestored).filePath(QStringLiteral("plain.txt"))) == content);
+
+    // While another owner, such as the GUI, holds the vault, nothing that makes or rewraps data keys runs.
+    {
+        dynamicencrypt::core::VaultIndex holder;
+        holder.open(QDir(vault).filePath(QString::fromLatin1(VaultManager::kIndexFileName)));
+        REQUIRE(holder.isOpen());
+        const QString lockedOutput = root.filePath(QStringLiteral("locked"));
+        REQUIRE(run({QStringLiteral("-k"), keyFile, QStringLiteral("--vault"), vault, QStringLiteral("encrypt"), plain,
+                     QStringLiteral("-o"), lockedOutput}) == 1);
+        REQUIRE_FALSE(QFileInfo::exists(QDir(lockedOutput).filePath(QStringLiteral("plain.txt.vault"))));
+        REQUIRE(run({QStringLiteral("-k"), keyFile, QStringLiteral("--vault"), vault, QStringLiteral("--new-key-file"),
+                     otherKeyFile, QStringLiteral("rotate")}) == 1);
+    }
+    {
+        VaultManager manager(VaultManager::InitialVault::None);
+        manager.setStorageDirectory(vault);
+        REQUIRE(VaultManager::isWrappedUnder(manager.entryAt(0).wrappedKey,
+                                              dynamicencrypt::core::importSymmetricKey(keyFile)));
+    }
+
+#if defined(Q_OS_LINUX)
+    REQUIRE_FALSE(QFileInfo::exists(root.filePath(QStringLiteral("home/Documents/DynamicEncryptVault"))));
+#endif
+}